@@ -0,0 +1,181 @@
+#include <stdio.h>
+
+#include "asm.h"
+#include "utils.h"
+
+static const char *const _reg64[] = {
+  "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+  "r8",  "r9",  "r10", "r11", "r12", "r13", "r14", "r15",
+};
+
+static const char *const _reg8[] = {
+  "al",  "cl",  "dl",   "bl",   "spl",  "bpl",  "sil",  "dil",
+  "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b",
+};
+
+static const char *const _cc[] = {
+  "o", "no", "b", "ae", "e", "ne", "be", "a",
+  "s", "ns", "p", "np", "l", "ge", "le", "g",
+};
+
+static const char *const _mnemonic[X86_OP_COUNT] = {
+  [X86_MOV] = "movq",         [X86_LEA] = "leaq",
+  [X86_ADD] = "addq",         [X86_SUB] = "subq",
+  [X86_IMUL] = "imulq",       [X86_AND] = "andq",
+  [X86_OR] = "orq",           [X86_XOR] = "xorq",
+  [X86_CMP] = "cmpq",         [X86_NEG] = "negq",
+  [X86_CQO] = "cqto",         [X86_IDIV] = "idivq",
+  [X86_JMP] = "jmp",          [X86_CALL] = "call",
+  [X86_RET] = "ret",          [X86_PUSH] = "pushq",
+  [X86_POP] = "popq",         [X86_MOVSD] = "movsd",
+  [X86_MOVQ] = "movq",        [X86_ADDSD] = "addsd",
+  [X86_SUBSD] = "subsd",      [X86_MULSD] = "mulsd",
+  [X86_DIVSD] = "divsd",      [X86_UCOMISD] = "ucomisd",
+  [X86_CVTSI2SD] = "cvtsi2sdq",
+};
+
+/* Write operand O. */
+static void _emit_opnd (sink *out, x86_opnd *o);
+
+static void
+_emit_reg (sink *out, U32 reg)
+{
+  char buf[8];
+
+  sink_putch (out, '%');
+  if (X86_IS_XMM (reg))
+    {
+      snprintf (buf, sizeof (buf), "xmm%u", reg - X86_XMM0);
+      sink_puts (out, buf);
+    }
+  else
+    sink_puts (out, _reg64[reg]);
+}
+
+static void
+_emit_opnd (sink *out, x86_opnd *o)
+{
+  char buf[32];
+
+  switch (o->kind)
+    {
+    case X86_REG:
+      _emit_reg (out, o->reg);
+      break;
+    case X86_IMM:
+      snprintf (buf, sizeof (buf), "$%ld", o->imm);
+      sink_puts (out, buf);
+      break;
+    case X86_MEM:
+      snprintf (buf, sizeof (buf), "%ld(", o->imm);
+      sink_puts (out, buf);
+      _emit_reg (out, o->reg);
+      sink_putch (out, ')');
+      break;
+    case X86_BLOCK:
+      snprintf (buf, sizeof (buf), ".Lbb%ld", o->imm);
+      sink_puts (out, buf);
+      break;
+    case X86_SYM:
+      sink_puts (out, ir_runtime_names[o->imm]);
+      break;
+    case X86_STR:
+      snprintf (buf, sizeof (buf), ".LC%ld(%%rip)", o->imm);
+      sink_puts (out, buf);
+      break;
+    }
+}
+
+void
+asm_emit (x86_func *xf, sink *out)
+{
+  x86_block *bb;
+  x86_insn *in;
+  string *str;
+  char buf[64], *lit;
+  U32 i, len;
+
+  sink_puts (out, "\t.text\n\t.globl main\n\t.type main, @function\nmain:\n");
+
+  for (i = 0; i < xf->blocks.size; ++i)
+    {
+      bb = x86_block_get (xf, i);
+      snprintf (buf, sizeof (buf), ".Lbb%u:\n", i);
+      sink_puts (out, buf);
+
+      for (in = bb->head; in; in = in->next)
+        {
+          sink_putch (out, '\t');
+          switch (in->op)
+            {
+            case X86_SETCC:
+              /* setCC %r8b; movzbq %r8b, %r8 */
+              sink_puts (out, "set");
+              sink_puts (out, _cc[in->cc]);
+              sink_puts (out, " %");
+              sink_puts (out, _reg8[in->dst.reg]);
+              sink_puts (out, "\n\tmovzbq %");
+              sink_puts (out, _reg8[in->dst.reg]);
+              sink_puts (out, ", ");
+              _emit_opnd (out, &in->dst);
+              break;
+            case X86_JCC:
+              sink_putch (out, 'j');
+              sink_puts (out, _cc[in->cc]);
+              sink_putch (out, ' ');
+              _emit_opnd (out, &in->dst);
+              break;
+            case X86_CQO:
+            case X86_RET:
+              sink_puts (out, _mnemonic[in->op]);
+              break;
+            case X86_JMP:
+            case X86_CALL:
+            case X86_NEG:
+            case X86_IDIV:
+            case X86_PUSH:
+            case X86_POP:
+              sink_puts (out, _mnemonic[in->op]);
+              sink_putch (out, ' ');
+              _emit_opnd (out, &in->dst);
+              break;
+            default:
+              if (in->op == X86_MOV && in->src.kind == X86_IMM
+                  && (in->src.imm < -2147483648L || in->src.imm > 2147483647L))
+                sink_puts (out, "movabsq");
+              else if (in->op == X86_MOVSD && in->dst.kind == X86_REG
+                       && in->src.kind == X86_REG)
+                sink_puts (out, "movapd");
+              else
+                sink_puts (out, _mnemonic[in->op]);
+              sink_putch (out, ' ');
+              _emit_opnd (out, &in->src);
+              sink_puts (out, ", ");
+              _emit_opnd (out, &in->dst);
+              break;
+            }
+          sink_putch (out, '\n');
+        }
+    }
+
+  sink_puts (out, "\t.size main, .-main\n");
+
+  /* Strings keep their escapes, which .string understands the way C does,
+     and follow the header the runtime reads their length from. */
+  if (xf->strs.size)
+    sink_puts (out, "\t.section .rodata\n");
+  for (i = 0; i < xf->strs.size; ++i)
+    {
+      str = *(string **)dageti (&xf->strs, i);
+      lit = aralloc (&xf->ar, str->size + 1);
+      len = strnlen (lit, unescape (lit, str->data, str->size));
+      arfree (lit);
+      snprintf (buf, sizeof (buf),
+                "\t.balign 8\n\t.quad %u, 0\n.LC%u:\n\t.string \"", len, i);
+      sink_puts (out, buf);
+      sink_write (out, str->data, str->size);
+      sink_puts (out, "\"\n");
+    }
+
+  sink_puts (out, "\t.section .note.GNU-stack,\"\",@progbits\n");
+}
@@ -0,0 +1,11 @@
+#ifndef ASM_H
+#define ASM_H
+
+#include "sink.h"
+#include "x86.h"
+
+/* Write XF as GNU assembler source (AT&T syntax) defining main, for the
+   x86-64 System V ABI.  XF must have been through x86_finish. */
+void asm_emit (x86_func *xf, sink *out);
+
+#endif /* not ASM_H */
@@ -4,8 +4,9 @@
 /* Parse an expression. */
 static void *_ast_parse_expression (ast *ctx, lex *lexer);
 
-/* Append expression to current block */
-static void _append_to_block (ast *ctx, ast_node *new);
+/* Parse a statement: a block, IF, WHILE, FOR, call or assignment.  The
+   ; after it is left to the enclosing block. */
+static ast_node *_parse_statement (ast *ctx);
 
 /* Get strategy given AST type. */
 static const ast_strategy *_ast_get_strategy (enum ast_type type);
@@ -16,6 +17,10 @@ static inline ast_node *_reverse_ast_list (ast_node *head);
 /* Get operator precedence for given operator. */
 static int _get_precedence (char op);
 
+/* Unary minus on the operator stack, '-' with no left operand in the
+   AST. */
+#define AST_OP_NEG_MARK '~'
+
 /* Create new AST node. */
 static ast_node *_ast_new_node (ast *ctx, short type);
 
@@ -34,6 +39,58 @@ static int _is_token_op (int tok);
 /* Check if token is a valid expression terminator */
 static int _is_expression_terminator (int tok);
 
+/* Check if token is a keyword that ends an expression inside a
+   statement. */
+static int _is_statement_keyword (int tok);
+
+/* Check if NAME is a function built into expressions, see
+   _ast_builtins. */
+static int _is_builtin (string *name);
+
+/* Parse a call of a builtin function, the lexer at its name. */
+static ast_node *_create_builtin (ast *ctx, lex *lexer);
+
+/* Parse the type after the ':' of a declaration into DATA, with the
+   array size if any.  Returns 1 on error. */
+static int _parse_type (ast *ctx, ast_data_var_declare *data);
+
+/* Parse the declaration of a constant, the lexer at its name, and
+   declare it.  Returns 1 on error. */
+static int _create_const (ast *ctx);
+
+/* Check if NODE, declared under a name, is a constant. */
+static int _is_const (ast_node *node);
+
+/* A copy of constant NODE to put where its name is used. */
+static ast_node *_const_value (ast *ctx, ast_node *node);
+
+/* Parse the arguments of a call of ROUTINE, the lexer after its name. */
+static ast_node *_create_call (ast *ctx, ast_node *routine);
+
+/* Declare NODE under its name until _scope_close, saving it in SCOPE. */
+static void _scope_put (ast *ctx, da *scope, ast_node *node);
+
+/* Drop the declarations of SCOPE, bringing back those they hid. */
+static void _scope_close (ast *ctx, da *scope);
+
+/* Check if variable declaration VAR is an array. */
+static int _is_array (ast_node *var);
+
+/* Check if a value of expression EXP can be stored in a variable of
+   DATATYPE.  Strings only go to strings, and reals not to integers or
+   booleans, which the backends would each convert differently. */
+static int _assignable (U16 datatype, ast_node *exp);
+
+/* Functions callable in expressions and their number of arguments. */
+static const struct
+{
+  const char *name;
+  U8 nargs;
+} _ast_builtins[] = {
+  { "length", 1 },
+  { "copy", 3 },
+};
+
 // [ Program Name ] {{{
 static ast_node *
 _create_progname (ast *ctx, void *args)
@@ -76,22 +133,42 @@ _create_var_declare (ast *ctx, void *args)
 
   ast_node *new;
   ast_data_var_declare *data;
-  string *var_name, *datatype;
   int token;
 
-  var_name = stringcpy (&ctx->ar, ctx->lexer->str);
+  new = _ast_new_node (ctx, AST_VAR_DECLARE);
+  data = aralloc (&ctx->ar, sizeof (ast_data_var_declare));
+  data->name = stringcpy (&ctx->ar, ctx->lexer->str);
+  data->flags = 0;
+  new->data = data;
 
   token = lex_next_token (ctx->lexer);
   AST_ERROR_IF (token != ':', "Expected ':'");
+  if (_parse_type (ctx, data))
+    goto ast_err_exit;
 
   token = lex_next_token (ctx->lexer);
-  AST_ERROR_IF (token != TOKEN_IDENTF, "Expected data type of variable.");
-  datatype = stringcpy (&ctx->ar, ctx->lexer->str);
+  AST_EXPECT_SEMICOLON ();
 
-  new = _ast_new_node (ctx, AST_VAR_DECLARE);
-  data = aralloc (&ctx->ar, sizeof (ast_data_var_declare));
-  data->name = var_name;
-  new->data = data;
+  stput (ctx->ident_table, data->name->data, &new);
+
+  return new;
+
+ast_err_exit:
+  AST_LOG ("VAR declaration error exit.");
+  return NULL;
+}
+
+static int
+_parse_type (ast *ctx, ast_data_var_declare *data)
+{
+  string *datatype;
+  void *ptr;
+  int token;
+
+  token = lex_next_token (ctx->lexer);
+  AST_ERROR_IF (token != TOKEN_IDENTF, "Expected data type of variable.");
+  datatype = ctx->lexer->str;
+  data->arsize = 0;
 
   if (streq (datatype->data, "integer"))
     data->datatype = AST_INTLIT;
@@ -104,40 +181,45 @@ _create_var_declare (ast *ctx, void *args)
   else
     AST_ERROR_IF (true, "Unknown datatype.");
 
-  token = lex_next_token (ctx->lexer);
-  if (token == '[')
+  if (lex_peek (ctx->lexer) == '[')
     {
+      lex_next_token (ctx->lexer);
       token = lex_next_token (ctx->lexer);
-      AST_ERROR_IF (token != TOKEN_INTLIT, "Expected integer for array size.");
-      data->arsize = ctx->lexer->int_num;
+      ptr = token == TOKEN_IDENTF
+                ? stget (ctx->ident_table, ctx->lexer->str->data)
+                : NULL;
+      if (ptr && (*(ast_node **)ptr)->type == AST_INTLIT)
+        {
+          data->arsize = *(long *)(*(ast_node **)ptr)->data;
+          AST_ERROR_IF (*(long *)(*(ast_node **)ptr)->data < 1,
+                        "Array size must be positive.");
+        }
+      else
+        {
+          AST_ERROR_IF (token != TOKEN_INTLIT,
+                        "Expected integer for array size.");
+          data->arsize = ctx->lexer->int_num;
+        }
 
       token = lex_next_token (ctx->lexer);
       AST_ERROR_IF (token != ']', "Expected ']'");
-
-      token = lex_next_token (ctx->lexer);
     }
 
-  AST_EXPECT_SEMICOLON ();
-
-  stput (ctx->ident_table, data->name->data, &new);
-
-  if (strcmp (datatype->data, "string") == 0 && data->arsize < 1)
-    {
-      data->arsize = 256;
-    }
+  if (data->datatype == AST_STRLIT && data->arsize < 1)
+    data->arsize = 256;
 
-  return new;
+  return 0;
 
 ast_err_exit:
-  AST_LOG ("VAR declaration error exit.");
-  return NULL;
+  return 1;
 }
 
 static void
 _print_var_declare (ast_node *node)
 {
   ast_data_var_declare *data = node->data;
-  printf ("(var %s ", data->name->data);
+  printf ((data->flags & AST_VAR_REF) ? "(var& %s " : "(var %s ",
+          data->name->data);
   _ast_print_datatype (data->datatype);
   printf (")");
 }
@@ -145,6 +227,114 @@ _print_var_declare (ast_node *node)
 const ast_strategy ast_var_declare_strategy
     = { .create = _create_var_declare, .print = _print_var_declare };
 // }}}
+// [ CONST declaration ] {{{
+static int
+_create_const (ast *ctx)
+{
+  ast_node *new = NULL;
+  string *name;
+  void *ptr;
+  int token, sign = 0;
+
+  name = stringcpy (&ctx->ar, ctx->lexer->str);
+  token = lex_next_token (ctx->lexer);
+  AST_ERROR_IF (token != '=', "Expected '='");
+
+  token = lex_next_token (ctx->lexer);
+  if (token == '-' || token == '+')
+    {
+      sign = token;
+      token = lex_next_token (ctx->lexer);
+    }
+
+  if (token == TOKEN_INTLIT)
+    {
+      new = _ast_new_node (ctx, AST_INTLIT);
+      new->data = aralloc (&ctx->ar, sizeof (long));
+      *(long *)new->data = ctx->lexer->int_num;
+    }
+  else if (token == TOKEN_FLOATLIT)
+    {
+      new = _ast_new_node (ctx, AST_FLOATLIT);
+      new->data = aralloc (&ctx->ar, sizeof (double));
+      *(double *)new->data = ctx->lexer->float_num;
+    }
+  else if (token == TOKEN_STRLIT)
+    {
+      new = _ast_new_node (ctx, AST_STRLIT);
+      new->data = stringcpy (&ctx->ar, ctx->lexer->str);
+    }
+  else if (token == TOKEN_IDENTF
+           && (streq (ctx->lexer->str->data, "true")
+               || streq (ctx->lexer->str->data, "false")))
+    {
+      new = _ast_new_node (ctx, AST_BOOL);
+      new->data = aralloc (&ctx->ar, sizeof (U16));
+      *(U16 *)new->data = streq (ctx->lexer->str->data, "true");
+    }
+  else if (token == TOKEN_IDENTF)
+    {
+      /* Another constant, declared before. */
+      ptr = stget (ctx->ident_table, ctx->lexer->str->data);
+      if (ptr && _is_const (*(ast_node **)ptr))
+        new = _const_value (ctx, *(ast_node **)ptr);
+    }
+  AST_ERROR_IF (!new, "Expected constant.");
+
+  AST_ERROR_IF (sign && new->type != AST_INTLIT
+                    && new->type != AST_FLOATLIT,
+                "Only numbers take a sign.");
+  if (sign == '-' && new->type == AST_INTLIT)
+    *(long *)new->data = (long)-(unsigned long)*(long *)new->data;
+  else if (sign == '-')
+    *(double *)new->data = -*(double *)new->data;
+
+  token = lex_next_token (ctx->lexer);
+  AST_EXPECT_SEMICOLON ();
+
+  stput (ctx->ident_table, name->data, &new);
+  return 0;
+
+ast_err_exit:
+  AST_LOG ("CONST declaration error exit.");
+  return 1;
+}
+
+int
+_is_const (ast_node *node)
+{
+  return node->type == AST_INTLIT || node->type == AST_FLOATLIT
+         || node->type == AST_STRLIT || node->type == AST_BOOL;
+}
+
+ast_node *
+_const_value (ast *ctx, ast_node *node)
+{
+  ast_node *new = _ast_new_node (ctx, node->type);
+
+  /* Passes after parsing rewrite literals in place, so each use gets
+     its own. */
+  switch (node->type)
+    {
+    case AST_INTLIT:
+      new->data = aralloc (&ctx->ar, sizeof (long));
+      *(long *)new->data = *(long *)node->data;
+      break;
+    case AST_FLOATLIT:
+      new->data = aralloc (&ctx->ar, sizeof (double));
+      *(double *)new->data = *(double *)node->data;
+      break;
+    case AST_BOOL:
+      new->data = aralloc (&ctx->ar, sizeof (U16));
+      *(U16 *)new->data = *(U16 *)node->data;
+      break;
+    default:
+      new->data = stringcpy (&ctx->ar, node->data);
+      break;
+    }
+  return new;
+}
+// }}}
 // [ VAR assign ] {{{
 static ast_node *
 _create_var_assign (ast *ctx, void *args)
@@ -153,31 +343,32 @@ _create_var_assign (ast *ctx, void *args)
   ast_data_var_assign *data;
   ast_var_assign_arg *arg_data = args;
   int token = arg_data->token;
+  U32 i;
 
   AST_ERROR_IF (arg_data->var->type != AST_VAR_DECLARE,
                 "Expected identifier variable.");
+  AST_ERROR_IF (!arg_data->index && _is_array (arg_data->var),
+                "Expected '[' after array.");
   AST_ERROR_IF (token != TOKEN_INFEQ, "Expected ':='");
+  for (i = 0; i < ctx->loop_stk->size; ++i)
+    AST_ERROR_IF (*(ast_node **)dageti (ctx->loop_stk, i) == arg_data->var,
+                  "Cannot assign the control variable of a for loop.");
 
   new = _ast_new_node (ctx, AST_VAR_ASSIGN);
   data = aralloc (&ctx->ar, sizeof (ast_data_var_assign));
   data->var = arg_data->var;
+  data->index = arg_data->index;
 
   exp = _ast_parse_expression (ctx, ctx->lexer);
-  if (exp)
-    {
-      token = lex_next_token (ctx->lexer);
-      AST_EXPECT_SEMICOLON ();
+  if (!exp)
+    goto ast_err_exit;
 
-      /* TODO: Report error if datatype mismatch. */
+  AST_ERROR_IF (
+      !_assignable (((ast_data_var_declare *)data->var->data)->datatype, exp),
+      "Type of value does not match the variable.");
 
-      data->value = exp;
-      new->data = data;
-      _append_to_block (ctx, new);
-    }
-  else
-    {
-      goto ast_err_exit;
-    }
+  data->value = exp;
+  new->data = data;
 
   return new;
 
@@ -192,6 +383,11 @@ _print_var_assign (ast_node *node)
   ast_data_var_assign *assign_data = node->data;
   ast_data_var_declare *data = assign_data->var->data;
   printf ("(var %s ", data->name->data);
+  if (assign_data->index)
+    {
+      _ast_print_node (assign_data->index);
+      printf (" ");
+    }
   _ast_print_node (assign_data->value);
   printf (")");
 }
@@ -199,62 +395,91 @@ _print_var_assign (ast_node *node)
 const ast_strategy ast_var_assign_strategy
     = { .create = _create_var_assign, .print = _print_var_assign };
 // }}}
+// [ Array index ] {{{
+static ast_node *
+_create_index (ast *ctx, void *args)
+{
+  ast_node *new, *var = args;
+  ast_data_index *data;
+  int token;
+
+  AST_ERROR_IF (!_is_array (var), "Only arrays can be indexed.");
+
+  new = _ast_new_node (ctx, AST_INDEX);
+  data = aralloc (&ctx->ar, sizeof (ast_data_index));
+  data->var = var;
+  data->check = 1;
+  new->data = data;
+
+  data->index = _ast_parse_expression (ctx, ctx->lexer);
+  if (!data->index)
+    goto ast_err_exit;
+  token = lex_next_token (ctx->lexer);
+  AST_ERROR_IF (token != ']', "Expected ']'");
+
+  return new;
+
+ast_err_exit:
+  AST_LOG ("Array index error exit.");
+  return NULL;
+}
+
+static void
+_print_index (ast_node *node)
+{
+  ast_data_index *data = node->data;
+  printf ("(index %s ",
+          ((ast_data_var_declare *)data->var->data)->name->data);
+  _ast_print_node (data->index);
+  if (!data->check)
+    printf (" unchecked");
+  printf (")");
+}
+
+const ast_strategy ast_index_strategy
+    = { .create = _create_index, .print = _print_index };
+// }}}
 //  [ Block - BEGIN and END ] {{{
 static ast_node *
 _create_block (ast *ctx, void *args)
 {
-  ast_node *new, *block, *cond;
+  ast_node *new, *stmt, **tail;
   ast_data_block *data;
-  ast_data_block *block_data;
-  U32 i;
+  int token;
 
-  /* BEGIN */
-  if (args == (void *)0x0)
-    {
-      ctx->flags &= ~AST_FLAG_READ_VAR;
-      new = _ast_new_node (ctx, AST_BLOCK);
-      AST_LOG ("Block %p begin.", new);
+  (void)args;
 
-      data = aralloc (&ctx->ar, sizeof (ast_data_block));
-      data->parent = ctx->currentIndent;
-      new->data = data;
+  new = _ast_new_node (ctx, AST_BLOCK);
+  AST_LOG ("Block %p begin.", new);
 
-      _append_to_block (ctx, new);
+  data = aralloc (&ctx->ar, sizeof (ast_data_block));
+  data->next = NULL;
+  new->data = data;
+  tail = &data->next;
 
-      dapush (ctx->block_stk, &new);
-    }
-  /* END */
-  else
+  while ((token = lex_peek (ctx->lexer)) != TOKEN_BLOCK_END)
     {
-      AST_ERROR_IF (ctx->block_stk->size == 0, "Invalid use of \"end\".");
-      block = *(ast_node **)dageti (ctx->block_stk, 0);
-      AST_LOG ("End of Block %p.", block);
-      block_data = block->data;
-      block_data->next = _reverse_ast_list (block_data->next);
-
-      /* Remove all child conditions of the block. */
-      new = block_data->next;
-      while (new)
+      AST_ERROR_IF (token == TOKEN_END, "Expected \"end\".");
+
+      /* Empty statement. */
+      if (token == ';')
         {
-          if (new->type == AST_COND)
-            {
-              for (i = 0; i < ctx->cond_stk->size; ++i)
-                {
-                  cond = *(ast_node **)dageti (ctx->cond_stk, i);
-                  if (cond == new)
-                    {
-                      AST_LOG ("Remove child condition from stack.");
-                      if (ctx->flags & AST_FLAG_DEBUG)
-                        ast_print_tree (cond, " ");
-                      dadel (ctx->cond_stk, i);
-                    }
-                }
-            }
-          new = new->next;
+          lex_next_token (ctx->lexer);
+          continue;
         }
 
-      dadel (ctx->block_stk, 0);
+      stmt = _parse_statement (ctx);
+      if (!stmt)
+        goto ast_err_exit;
+      *tail = stmt;
+      tail = &stmt->next;
+
+      token = lex_peek (ctx->lexer);
+      AST_ERROR_IF (token != ';' && token != TOKEN_BLOCK_END,
+                    "Expected semicolon (;)");
     }
+  lex_next_token (ctx->lexer);
+  AST_LOG ("End of Block %p.", new);
 
   return new;
 
@@ -276,6 +501,57 @@ const ast_strategy ast_block_strategy
     = { .create = _create_block, .print = _print_block };
 // }}}
 // [ Funcation call ] {{{
+static ast_node *
+_create_write_arg (ast *ctx, string *name, ast_node *value)
+{
+  ast_node *new;
+  ast_data_write_arg *data;
+
+  AST_ERROR_IF (!streq (name->data, "write") && !streq (name->data, "writeln"),
+                "Field width is only allowed in write and writeln.");
+
+  new = _ast_new_node (ctx, AST_WRITE_ARG);
+  data = aralloc (&ctx->ar, sizeof (ast_data_write_arg));
+  data->value = value;
+  data->decimals = NULL;
+  new->data = data;
+
+  lex_next_token (ctx->lexer);
+  data->width = _ast_parse_expression (ctx, ctx->lexer);
+  AST_ERROR_IF (!data->width, "Expected field width after ':'.");
+
+  if (lex_peek (ctx->lexer) == ':')
+    {
+      lex_next_token (ctx->lexer);
+      data->decimals = _ast_parse_expression (ctx, ctx->lexer);
+      AST_ERROR_IF (!data->decimals, "Expected decimals after ':'.");
+    }
+
+  return new;
+
+ast_err_exit:
+  AST_LOG ("Write argument error exit.");
+  return NULL;
+}
+
+static void
+_print_write_arg (ast_node *node)
+{
+  ast_data_write_arg *data = node->data;
+  printf ("(: ");
+  _ast_print_node (data->value);
+  printf (" ");
+  _ast_print_node (data->width);
+  if (data->decimals)
+    {
+      printf (" ");
+      _ast_print_node (data->decimals);
+    }
+  printf (")");
+}
+
+const ast_strategy ast_write_arg_strategy = { .print = _print_write_arg };
+
 static ast_node *
 _create_funcall (ast *ctx, void *args)
 {
@@ -288,6 +564,7 @@ _create_funcall (ast *ctx, void *args)
   data = aralloc (&ctx->ar, sizeof (ast_data_funcall));
   data->name = str_data;
   data->args_head = (void *)0;
+  data->routine = NULL;
   new->data = data;
 
   token = lex_peek (ctx->lexer);
@@ -296,6 +573,12 @@ _create_funcall (ast *ctx, void *args)
       expression = _ast_parse_expression (ctx, ctx->lexer);
       if (expression)
         {
+          if (lex_peek (ctx->lexer) == ':')
+            {
+              expression = _create_write_arg (ctx, str_data, expression);
+              if (!expression)
+                goto ast_err_exit;
+            }
           expression->next = data->args_head;
           data->args_head = expression;
         }
@@ -312,17 +595,10 @@ _create_funcall (ast *ctx, void *args)
         }
     }
 
-  if (token == ')')
-    {
-      lex_next_token (ctx->lexer);
-      token = lex_peek (ctx->lexer);
-    }
-
-  if (!(ctx->cond_stk->size > 0 && token == TOKEN_ELSE))
-    AST_EXPECT_SEMICOLON ();
+  AST_ERROR_IF (token != ')', "Expected ')'");
+  lex_next_token (ctx->lexer);
 
   data->args_head = _reverse_ast_list (data->args_head);
-  _append_to_block (ctx, new);
 
   return new;
 
@@ -347,132 +623,549 @@ const ast_strategy ast_funcall_strategy
 static ast_node *
 _create_cond (ast *ctx, void *args)
 {
-  ast_node *new, *expression, *cond;
+  ast_node *new;
   ast_data_cond *data;
   int token;
 
-  /* IF */
-  if (args == (void *)0x0)
+  (void)args;
+
+  new = _ast_new_node (ctx, AST_COND);
+  data = aralloc (&ctx->ar, sizeof (ast_data_cond));
+  data->yes = NULL;
+  data->no = NULL;
+  new->data = data;
+
+  data->cond = _ast_parse_expression (ctx, ctx->lexer);
+  AST_ERROR_IF (!data->cond, "Expected condition expression after \"if\".");
+  token = lex_next_token (ctx->lexer);
+  AST_ERROR_IF (token != TOKEN_THEN, "Expected \"then\" after condition.");
+
+  data->yes = _parse_statement (ctx);
+  if (!data->yes)
+    goto ast_err_exit;
+
+  if (lex_peek (ctx->lexer) == TOKEN_ELSE)
+    {
+      AST_LOG ("Found ELSE for IF.");
+      lex_next_token (ctx->lexer);
+      data->no = _parse_statement (ctx);
+      if (!data->no)
+        goto ast_err_exit;
+    }
+
+  return new;
+
+ast_err_exit:
+  AST_LOG ("Condition error exit.");
+  return NULL;
+}
+
+static void
+_print_cond (ast_node *node)
+{
+  ast_data_cond *data = node->data;
+  printf ("(if ");
+  _ast_print_node (data->cond);
+  printf ("\n    ");
+  ast_print_tree (data->yes, "\n  ");
+  if (data->no)
+    {
+      printf ("\n    ");
+      ast_print_tree (data->no, "\n  ");
+    }
+  printf (")");
+}
+
+const ast_strategy ast_cond_strategy
+    = { .create = _create_cond, .print = _print_cond };
+// }}}
+// [ WHILE ] {{{
+static ast_node *
+_create_while (ast *ctx, void *args)
+{
+  ast_node *new;
+  ast_data_while *data;
+  int token;
+
+  (void)args;
+
+  new = _ast_new_node (ctx, AST_WHILE);
+  data = aralloc (&ctx->ar, sizeof (ast_data_while));
+  new->data = data;
+
+  data->cond = _ast_parse_expression (ctx, ctx->lexer);
+  AST_ERROR_IF (!data->cond, "Expected condition expression.");
+  token = lex_next_token (ctx->lexer);
+  AST_ERROR_IF (token != TOKEN_DO, "Expected \"do\" after while.");
+
+  data->next = _parse_statement (ctx);
+  if (!data->next)
+    goto ast_err_exit;
+
+  return new;
+
+ast_err_exit:
+  AST_LOG ("While error exit");
+  return NULL;
+}
+
+static void
+_print_while (ast_node *node)
+{
+  ast_data_while *data = node->data;
+  printf ("(while ");
+  _ast_print_node (data->cond);
+  printf ("\n    ");
+  ast_print_tree (data->next, "\n  ");
+  printf (")");
+}
+
+const ast_strategy ast_while_strategy
+    = { .create = _create_while, .print = _print_while };
+// }}}
+// [ FOR ] {{{
+static ast_node *
+_create_for (ast *ctx, void *args)
+{
+  ast_node *new, *var;
+  ast_data_for *data;
+  void *ptr;
+  int token;
+  U32 i;
+
+  (void)args;
+
+  token = lex_next_token (ctx->lexer);
+  AST_ERROR_IF (token != TOKEN_IDENTF, "Expected control variable.");
+  ptr = stget (ctx->ident_table, ctx->lexer->str->data);
+  if (!ptr)
+    AST_EXPECT_IDENTF ();
+  var = *(ast_node **)ptr;
+  AST_ERROR_IF (var->type != AST_VAR_DECLARE || _is_array (var)
+                    || ((ast_data_var_declare *)var->data)->datatype
+                           != AST_INTLIT,
+                "Control variable must be an integer.");
+  AST_ERROR_IF (((ast_data_var_declare *)var->data)->flags & AST_VAR_REF,
+                "Control variable cannot be a var parameter.");
+  for (i = 0; i < ctx->loop_stk->size; ++i)
+    AST_ERROR_IF (*(ast_node **)dageti (ctx->loop_stk, i) == var,
+                  "Cannot assign the control variable of a for loop.");
+
+  new = _ast_new_node (ctx, AST_FOR);
+  data = aralloc (&ctx->ar, sizeof (ast_data_for));
+  data->var = var;
+  new->data = data;
+
+  token = lex_next_token (ctx->lexer);
+  AST_ERROR_IF (token != TOKEN_INFEQ, "Expected ':='");
+  data->from = _ast_parse_expression (ctx, ctx->lexer);
+  AST_ERROR_IF (!data->from, "Expected initial value.");
+  AST_ERROR_IF (!_assignable (AST_INTLIT, data->from),
+                "Initial value must be an integer.");
+
+  token = lex_next_token (ctx->lexer);
+  AST_ERROR_IF (token != TOKEN_TO && token != TOKEN_DOWNTO,
+                "Expected \"to\" or \"downto\".");
+  data->down = token == TOKEN_DOWNTO;
+  data->to = _ast_parse_expression (ctx, ctx->lexer);
+  AST_ERROR_IF (!data->to, "Expected final value.");
+  AST_ERROR_IF (!_assignable (AST_INTLIT, data->to),
+                "Final value must be an integer.");
+
+  token = lex_next_token (ctx->lexer);
+  AST_ERROR_IF (token != TOKEN_DO, "Expected \"do\" after for.");
+
+  /* The control variable is read-only in the body. */
+  dapush (ctx->loop_stk, &var);
+  data->body = _parse_statement (ctx);
+  dadel (ctx->loop_stk, 0);
+  if (!data->body)
+    goto ast_err_exit;
+
+  return new;
+
+ast_err_exit:
+  AST_LOG ("For error exit");
+  return NULL;
+}
+
+static void
+_print_for (ast_node *node)
+{
+  ast_data_for *data = node->data;
+  printf ("(for %s ",
+          ((ast_data_var_declare *)data->var->data)->name->data);
+  _ast_print_node (data->from);
+  printf (data->down ? " downto " : " to ");
+  _ast_print_node (data->to);
+  printf ("\n    ");
+  ast_print_tree (data->body, "\n  ");
+  printf (")");
+}
+
+const ast_strategy ast_for_strategy
+    = { .create = _create_for, .print = _print_for };
+// }}}
+// [ Routine ] {{{
+static ast_node *
+_create_routine (ast *ctx, void *args)
+{
+  stringbuilder sb = { 0 };
+  ast_node *new, *param, *first, **tail;
+  ast_data_routine *data;
+  ast_data_var_declare *var, type;
+  da scope = { 0 };
+  U8 ref;
+  int token;
+
+  token = lex_next_token (ctx->lexer);
+  AST_ERROR_IF (token != TOKEN_IDENTF, "Expected routine name.");
+
+  new = _ast_new_node (ctx, AST_ROUTINE);
+  data = aralloc (&ctx->ar, sizeof (ast_data_routine));
+  data->name = stringcpy (&ctx->ar, ctx->lexer->str);
+  data->params = data->locals = data->result = data->body = NULL;
+  data->nparams = 0;
+  data->recursive = 0;
+  new->data = data;
+
+  /* Visible in its own body already, for recursive calls. */
+  stput (ctx->ident_table, data->name->data, &new);
+  dainit (&scope, &ctx->ar, sizeof (ast_node *), 8);
+  ctx->routine = new;
+
+  tail = &data->params;
+  if (lex_peek (ctx->lexer) == '(')
+    {
+      lex_next_token (ctx->lexer);
+      while (lex_peek (ctx->lexer) != ')')
+        {
+          ref = lex_peek (ctx->lexer) == TOKEN_VAR;
+          if (ref)
+            lex_next_token (ctx->lexer);
+
+          /* A group of names sharing one type. */
+          first = NULL;
+          do
+            {
+              token = lex_next_token (ctx->lexer);
+              AST_ERROR_IF (token != TOKEN_IDENTF, "Expected parameter name.");
+              param = _ast_new_node (ctx, AST_VAR_DECLARE);
+              var = aralloc (&ctx->ar, sizeof (ast_data_var_declare));
+              var->name = stringcpy (&ctx->ar, ctx->lexer->str);
+              var->flags = AST_VAR_LOCAL | (ref ? AST_VAR_REF : 0);
+              param->data = var;
+              *tail = param;
+              tail = &param->next;
+              if (!first)
+                first = param;
+              ++data->nparams;
+              token = lex_next_token (ctx->lexer);
+            }
+          while (token == ',');
+          AST_ERROR_IF (token != ':', "Expected ':'");
+
+          if (_parse_type (ctx, &type))
+            goto ast_err_exit;
+          for (param = first; param; param = param->next)
+            {
+              var = param->data;
+              var->datatype = type.datatype;
+              var->arsize = type.arsize;
+              AST_ERROR_IF (!ref && _is_array (param),
+                            "Array parameters must be var parameters.");
+              _scope_put (ctx, &scope, param);
+            }
+
+          token = lex_peek (ctx->lexer);
+          AST_ERROR_IF (token != ';' && token != ')',
+                        "Expected ';' or ')' after parameter.");
+          if (token == ';')
+            lex_next_token (ctx->lexer);
+        }
+      lex_next_token (ctx->lexer);
+    }
+
+  /* 1 signify function. */
+  if (args)
+    {
+      token = lex_next_token (ctx->lexer);
+      AST_ERROR_IF (token != ':', "Expected ':' and the result type.");
+      data->result = _ast_new_node (ctx, AST_VAR_DECLARE);
+      var = aralloc (&ctx->ar, sizeof (ast_data_var_declare));
+      sbinit (&sb, &ctx->ar);
+      sbappend (&sb, "__result");
+      var->name = sbflush (&sb);
+      var->flags = AST_VAR_LOCAL;
+      data->result->data = var;
+      if (_parse_type (ctx, var))
+        goto ast_err_exit;
+      AST_ERROR_IF (var->datatype == AST_STRLIT || var->arsize > 0,
+                    "Functions return integer, real or boolean, not "
+                    "strings or arrays.");
+    }
+
+  token = lex_next_token (ctx->lexer);
+  AST_EXPECT_SEMICOLON ();
+
+  tail = &data->locals;
+  while (lex_peek (ctx->lexer) == TOKEN_VAR)
+    {
+      lex_next_token (ctx->lexer);
+      while (lex_peek (ctx->lexer) == TOKEN_IDENTF)
+        {
+          lex_next_token (ctx->lexer);
+          param = _ast_get_strategy (AST_VAR_DECLARE)->create (ctx, NULL);
+          if (!param)
+            goto ast_err_exit;
+          ((ast_data_var_declare *)param->data)->flags = AST_VAR_LOCAL;
+          AST_ERROR_IF (_is_array (param),
+                        "Arrays must be declared in the program.");
+          /* Already declared, only to be dropped at the end. */
+          dapush (&scope, &param);
+          *tail = param;
+          tail = &param->next;
+        }
+    }
+
+  token = lex_next_token (ctx->lexer);
+  AST_ERROR_IF (token != TOKEN_BEGIN, "Expected \"begin\".");
+  data->body = _ast_get_strategy (AST_BLOCK)->create (ctx, NULL);
+  if (!data->body)
+    goto ast_err_exit;
+  token = lex_next_token (ctx->lexer);
+  AST_EXPECT_SEMICOLON ();
+
+  _scope_close (ctx, &scope);
+  ctx->routine = NULL;
+
+  return new;
+
+ast_err_exit:
+  AST_LOG ("Routine error exit.");
+  return NULL;
+}
+
+static void
+_print_routine (ast_node *node)
+{
+  ast_data_routine *data = node->data;
+  printf ("(%s %s (", data->result ? "function" : "procedure",
+          data->name->data);
+  ast_print_tree (data->params, " ");
+  printf (")");
+  if (data->result)
+    {
+      printf (" ");
+      _ast_print_datatype (
+          ((ast_data_var_declare *)data->result->data)->datatype);
+    }
+  if (data->locals)
+    {
+      printf ("\n  ");
+      ast_print_tree (data->locals, "\n  ");
+    }
+  printf ("\n  ");
+  _ast_print_node (data->body);
+  printf (")");
+}
+
+const ast_strategy ast_routine_strategy
+    = { .create = _create_routine, .print = _print_routine };
+
+static ast_node *
+_create_call (ast *ctx, ast_node *routine)
+{
+  ast_data_routine *rdata = routine->data;
+  ast_data_var_declare *param, *var;
+  ast_node *new, *arg, *p, **tail;
+  ast_data_funcall *data;
+  void *ptr;
+  int token;
+  U32 i;
+
+  new = _ast_new_node (ctx, AST_FUNCALL);
+  data = aralloc (&ctx->ar, sizeof (ast_data_funcall));
+  data->name = rdata->name;
+  data->args_head = NULL;
+  data->routine = routine;
+  new->data = data;
+
+  if (routine == ctx->routine)
+    rdata->recursive = 1;
+
+  tail = &data->args_head;
+  p = rdata->params;
+  if (lex_peek (ctx->lexer) == '(')
     {
-      AST_ERROR_IF (ctx->block_stk->size < 1,
-                    "IF should be used inside a block.");
-      new = _ast_new_node (ctx, AST_COND);
-      data = aralloc (&ctx->ar, sizeof (ast_data_cond));
-      expression = _ast_parse_expression (ctx, ctx->lexer);
-      if (expression)
-        {
-          data->cond = expression;
-          token = lex_next_token (ctx->lexer);
-          AST_ERROR_IF (token != TOKEN_THEN,
-                        "Expected \"then\" after condition.");
-        }
-      else
+      lex_next_token (ctx->lexer);
+      while (lex_peek (ctx->lexer) != ')')
         {
-          AST_ERROR_IF (true, "Expected condition expression after \"if\".");
-        }
-      new->data = data;
-      _append_to_block (ctx, new);
-      dapush (ctx->cond_stk, &new);
-    }
-  /* ELSE */
-  else
-    {
-      if (ctx->cond_stk->size == 0)
-        AST_ERROR_IF (1, "Invalid usage of \"else\".");
+          AST_ERROR_IF (!p, "Too many arguments.");
+          param = p->data;
+
+          /* Whole arrays are only passed to var parameters. */
+          if (_is_array (p))
+            {
+              token = lex_next_token (ctx->lexer);
+              AST_ERROR_IF (token != TOKEN_IDENTF, "Expected array.");
+              ptr = stget (ctx->ident_table, ctx->lexer->str->data);
+              if (!ptr)
+                AST_EXPECT_IDENTF ();
+              AST_ERROR_IF ((*(ast_node **)ptr)->type != AST_VAR_DECLARE,
+                            "Expected array.");
+              /* A copy, the declaration is linked in its own list. */
+              arg = _ast_new_node (ctx, AST_VAR_DECLARE);
+              arg->data = (*(ast_node **)ptr)->data;
+            }
+          else
+            {
+              arg = _ast_parse_expression (ctx, ctx->lexer);
+              AST_ERROR_IF (!arg, "Invalid expression.");
+              AST_ERROR_IF (!_assignable (param->datatype, arg),
+                            "Type of argument does not match.");
+            }
 
-      cond = *(ast_node **)dageti (ctx->cond_stk, 0);
-      data = cond->data;
-      data->no = (void *)0xDEADBEEF;
+          if (param->flags & AST_VAR_REF)
+            {
+              AST_ERROR_IF (arg->type != AST_VAR_DECLARE
+                                && arg->type != AST_INDEX,
+                            "Expected variable for var parameter.");
+              var = (arg->type == AST_INDEX
+                         ? ((ast_data_index *)arg->data)->var
+                         : arg)
+                        ->data;
+              AST_ERROR_IF (var->datatype != param->datatype
+                                || (arg->type == AST_VAR_DECLARE
+                                    && _is_array (arg) != _is_array (p))
+                                || (_is_array (p)
+                                    && var->arsize != param->arsize),
+                            "Type of var argument does not match.");
+              for (i = 0; i < ctx->loop_stk->size; ++i)
+                AST_ERROR_IF ((*(ast_node **)dageti (ctx->loop_stk, i))->data
+                                  == arg->data,
+                              "Cannot pass the control variable of a for "
+                              "loop.");
+            }
 
-      if (!data->yes)
-        AST_ERROR_IF (1, "Invalid usage of \"else\".");
+          arg->next = NULL;
+          *tail = arg;
+          tail = &arg->next;
+          p = p->next;
 
-      AST_LOG ("Found ELSE for IF.");
-      if (ctx->flags & AST_FLAG_DEBUG)
-        ast_print_tree (cond, " ");
+          /* The expression may have taken the comma already. */
+          if (lex_peek (ctx->lexer) == ',')
+            lex_next_token (ctx->lexer);
+        }
+      lex_next_token (ctx->lexer);
     }
+  AST_ERROR_IF (p, "Too few arguments.");
 
   return new;
 
 ast_err_exit:
-  AST_LOG ("Condition error exit.");
+  AST_LOG ("Call error exit.");
   return NULL;
 }
 
 static void
-_print_cond (ast_node *node)
+_scope_put (ast *ctx, da *scope, ast_node *node)
 {
-  ast_data_cond *data = node->data;
-  printf ("(if ");
-  _ast_print_node (data->cond);
-  printf ("\n    ");
-  if (data->yes)
-    ast_print_tree (data->yes, "\n  ");
-  if (data->no)
+  stput (ctx->ident_table,
+         ((ast_data_var_declare *)node->data)->name->data, &node);
+  dapush (scope, &node);
+}
+
+static void
+_scope_close (ast *ctx, da *scope)
+{
+  ast_node *node;
+  U32 i;
+
+  for (i = 0; i < scope->size; ++i)
     {
-      printf ("\n    ");
-      if (data->no == (void *)0xDEADBEEF)
-        printf ("0xDEADBEEF");
-      else
-        ast_print_tree (data->no, "\n  ");
+      node = *(ast_node **)dageti (scope, i);
+      stdel (ctx->ident_table,
+             ((ast_data_var_declare *)node->data)->name->data);
     }
-  printf (")");
 }
-
-const ast_strategy ast_cond_strategy
-    = { .create = _create_cond, .print = _print_cond };
 // }}}
-// [ WHILE ] {{{
+// [ Statement ] {{{
 static ast_node *
-_create_while (ast *ctx, void *args)
+_parse_statement (ast *ctx)
 {
-  ast_node *new, *exp;
-  ast_data_while *data;
+  ast_var_assign_arg var_assign_arg = { 0 };
+  ast_node *new, *routine, *result;
+  string *str_data;
+  void *ptr;
   int token;
 
-  (void)args;
+  token = lex_next_token (ctx->lexer);
+  switch (token)
+    {
+    case TOKEN_BEGIN:
+      return _ast_get_strategy (AST_BLOCK)->create (ctx, NULL);
+    case TOKEN_IF:
+      return _ast_get_strategy (AST_COND)->create (ctx, NULL);
+    case TOKEN_WHILE:
+      return _ast_get_strategy (AST_WHILE)->create (ctx, NULL);
+    case TOKEN_FOR:
+      return _ast_get_strategy (AST_FOR)->create (ctx, NULL);
+    case TOKEN_IDENTF:
+      break;
+    default:
+      AST_ERROR_IF (true, "Expected statement.");
+    }
 
-  AST_ERROR_IF (ctx->block_stk->size < 1,
-                "WHILE should be used inside a block.");
-  new = _ast_new_node (ctx, AST_WHILE);
-  data = aralloc (&ctx->ar, sizeof (ast_data_while));
-  exp = _ast_parse_expression (ctx, ctx->lexer);
-  if (exp)
+  str_data = stringcpy (&ctx->ar, ctx->lexer->str);
+  ptr = stget (ctx->ident_table, str_data->data);
+  token = lex_peek (ctx->lexer);
+
+  if (ptr && (*(ast_node **)ptr)->type == AST_ROUTINE)
     {
-      data->cond = exp;
-      token = lex_next_token (ctx->lexer);
-      AST_ERROR_IF (token != TOKEN_DO, "Expected \"do\" after while.");
+      routine = *(ast_node **)ptr;
+      result = ((ast_data_routine *)routine->data)->result;
+      if (token != TOKEN_INFEQ)
+        {
+          AST_ERROR_IF (result, "Expected procedure.");
+          return _create_call (ctx, routine);
+        }
+      /* name := value sets the value of the function being parsed. */
+      AST_ERROR_IF (routine != ctx->routine || !result,
+                    "Expected variable or function being declared.");
+      var_assign_arg.var = result;
+    }
+  else if (token == '(')
+    {
+      lex_next_token (ctx->lexer);
+      return _ast_get_strategy (AST_FUNCALL)->create (ctx, str_data);
     }
   else
     {
-      AST_ERROR_IF (true, "Expected condition expression.");
+      if (!ptr)
+        AST_EXPECT_IDENTF ();
+      var_assign_arg.var = *((ast_node **)ptr);
+      AST_ERROR_IF (_is_const (var_assign_arg.var),
+                    "Cannot assign to a constant.");
     }
 
-  new->data = data;
-  _append_to_block (ctx, new);
-
-  dapush (ctx->loop_stk, new);
-
-  return new;
+  token = lex_next_token (ctx->lexer);
+  var_assign_arg.index = NULL;
+  if (token == '[')
+    {
+      new = _ast_get_strategy (AST_INDEX)->create (ctx, var_assign_arg.var);
+      if (!new)
+        goto ast_err_exit;
+      var_assign_arg.index = new;
+      token = lex_next_token (ctx->lexer);
+    }
+  var_assign_arg.token = token;
+  return _ast_get_strategy (AST_VAR_ASSIGN)->create (ctx, &var_assign_arg);
 
 ast_err_exit:
-  AST_LOG ("While error exit");
+  AST_LOG ("Statement error exit.");
   return NULL;
 }
-
-static void
-_print_while (ast_node *node)
-{
-  ast_data_while *data = node->data;
-  printf ("(while ");
-  _ast_print_node (data->cond);
-  printf ("\n    ");
-  ast_print_tree (data->next, "\n  ");
-  printf (")");
-}
-
-const ast_strategy ast_while_strategy
-    = { .create = _create_while, .print = _print_while };
 // }}}
 
 static const ast_strategy *strategy_registry[AST_STRATEGY_COUNT]
@@ -483,19 +1176,19 @@ static const ast_strategy *strategy_registry[AST_STRATEGY_COUNT]
         [AST_VAR_ASSIGN] = &ast_var_assign_strategy,
         [AST_FUNCALL] = &ast_funcall_strategy,
         [AST_COND] = &ast_cond_strategy,
-        [AST_WHILE] = &ast_while_strategy };
+        [AST_WHILE] = &ast_while_strategy,
+        [AST_FOR] = &ast_for_strategy,
+        [AST_ROUTINE] = &ast_routine_strategy,
+        [AST_WRITE_ARG] = &ast_write_arg_strategy,
+        [AST_INDEX] = &ast_index_strategy };
 
 int
 ast_init (ast *ctx)
 {
-  ctx->block_stk = aralloc (&ctx->ar, sizeof (da));
-  ctx->cond_stk = aralloc (&ctx->ar, sizeof (da));
   ctx->loop_stk = aralloc (&ctx->ar, sizeof (da));
   ctx->ident_table = aralloc (&ctx->ar, sizeof (ht));
 
-  dainit (ctx->block_stk, &ctx->ar, 16, sizeof (ast_node *));
-  dainit (ctx->cond_stk, &ctx->ar, 16, sizeof (ast_node *));
-  dainit (ctx->loop_stk, &ctx->ar, 16, sizeof (ast_node *));
+  dainit (ctx->loop_stk, &ctx->ar, sizeof (ast_node *), 16);
   htinit (ctx->ident_table, &ctx->ar, 16, sizeof (ast_node *));
 
   return 0;
@@ -504,11 +1197,7 @@ ast_init (ast *ctx)
 ast_node *
 ast_parse (ast *ctx)
 {
-  ast_node *new;
-  ast_data_cond *cond_data;
-  ast_var_assign_arg var_assign_arg = { 0 };
-  string *str_data;
-  void *ptr;
+  ast_node *new, **tail;
   int token;
 
   ctx->root = NULL;
@@ -519,54 +1208,25 @@ ast_parse (ast *ctx)
     goto ast_err_exit;
 
   ctx->root = new;
+  tail = &new->next;
 
   while ((token = lex_next_token (ctx->lexer)) != TOKEN_END)
     {
-      /*  Handle end of condition. */
-      if (ctx->cond_stk->size > 0)
-        {
-          cond_data = (*(ast_node **)dageti (ctx->cond_stk, 0))->data;
-          AST_ERROR_IF (
-              !cond_data,
-              "Unreachable. Condition stack shouldn't have null pointer.");
-
-          /* Remove IF if it is completed. */
-          if (cond_data->yes && cond_data->no
-              && cond_data->no != (void *)0xDEADBEEF)
-            {
-              AST_LOG ("Getting rid of IF (else found).");
-              if (ctx->flags & AST_FLAG_DEBUG)
-                lex_print_token (ctx->lexer, token);
-              dadel (ctx->cond_stk, 0);
-            }
-        }
-      if (token == TOKEN_ELSE)
-        {
-          /* 1 signify ELSE. */
-          new = _ast_get_strategy (AST_COND)->create (ctx, (void *)0x1);
-          if (!new)
-            goto ast_err_exit;
-
-          continue;
-        }
+      AST_ERROR_IF (ctx->flags & AST_FLAG_FOUND_ENTRY,
+                    "Expected end of program after \".\".");
       if (token == TOKEN_VAR)
         {
-          AST_ERROR_IF (ctx->block_stk->size > 0,
-                        "Variable declaration not allowed inside block.");
+          ctx->flags &= ~AST_FLAG_READ_CONST;
           ctx->flags |= AST_FLAG_READ_VAR;
         }
-      else if (token == TOKEN_BEGIN)
+      else if (token == TOKEN_CONST)
         {
-          /* 0 signify block begin. */
-          _ast_get_strategy (AST_BLOCK)->create (ctx, (void *)0x0);
-          if (!new)
-            goto ast_err_exit;
+          ctx->flags &= ~AST_FLAG_READ_VAR;
+          ctx->flags |= AST_FLAG_READ_CONST;
         }
-      else if (token == TOKEN_BLOCK_END)
+      else if ((ctx->flags & AST_FLAG_READ_CONST) && token == TOKEN_IDENTF)
         {
-          /* 1 signify block end. */
-          _ast_get_strategy (AST_BLOCK)->create (ctx, (void *)0x1);
-          if (!new)
+          if (_create_const (ctx))
             goto ast_err_exit;
         }
       else if ((ctx->flags & AST_FLAG_READ_VAR) && token == TOKEN_IDENTF)
@@ -574,78 +1234,44 @@ ast_parse (ast *ctx)
           new = _ast_get_strategy (AST_VAR_DECLARE)->create (ctx, NULL);
           if (!new)
             goto ast_err_exit;
-
-          new->next = ctx->root;
-          ctx->root = new;
+          *tail = new;
+          tail = &new->next;
         }
-      else if (token == TOKEN_WHILE)
+      else if (token == TOKEN_PROCEDURE || token == TOKEN_FUNCTION)
         {
-          new = _ast_get_strategy (AST_WHILE)->create (ctx, NULL);
+          ctx->flags &= ~(AST_FLAG_READ_VAR | AST_FLAG_READ_CONST);
+          /* 1 signify function. */
+          new = _ast_get_strategy (AST_ROUTINE)
+                    ->create (ctx, (void *)(long)(token == TOKEN_FUNCTION));
           if (!new)
             goto ast_err_exit;
+          *tail = new;
+          tail = &new->next;
         }
-      else if (token == TOKEN_IF)
+      /* Main block. */
+      else if (token == TOKEN_BEGIN)
         {
-          /* 0 signify IF. */
-          new = _ast_get_strategy (AST_COND)->create (ctx, (void *)0x0);
+          new = _ast_get_strategy (AST_BLOCK)->create (ctx, NULL);
           if (!new)
             goto ast_err_exit;
-        }
-      else if (ctx->block_stk->size > 0 && token == TOKEN_IDENTF)
-        {
-          str_data = stringcpy (&ctx->ar, ctx->lexer->str);
           token = lex_next_token (ctx->lexer);
+          AST_ERROR_IF (token != '.', "Expected \".\" after main block.");
 
-          if (token == '(')
-            {
-              new = _ast_get_strategy (AST_FUNCALL)->create (ctx, str_data);
-              if (!new)
-                goto ast_err_exit;
-            }
-          else if ((ptr = stget (ctx->ident_table, str_data->data))
-                   != (void *)0)
-            {
-              var_assign_arg.token = token;
-              var_assign_arg.var = *((ast_node **)ptr);
-              new = _ast_get_strategy (AST_VAR_ASSIGN)
-                        ->create (ctx, &var_assign_arg);
-              if (!new)
-                goto ast_err_exit;
-            }
-          else
-            {
-              AST_EXPECT_IDENTF ();
-            }
+          AST_LOG ("Found entry block.");
+          ctx->flags |= AST_FLAG_FOUND_ENTRY;
+          new->type = AST_MAIN_BLOCK;
+          *tail = new;
+          tail = &new->next;
         }
       else
         {
-          switch (token)
-            {
-            /* Main block. */
-            case '.':
-              if (!(ctx->flags & AST_FLAG_FOUND_ENTRY)
-                  && ctx->root->type == AST_BLOCK)
-                {
-                  AST_LOG ("Found entry block.");
-                  ctx->flags |= AST_FLAG_FOUND_ENTRY;
-                  ctx->root->type = AST_MAIN_BLOCK;
-                }
-              break;
-            default:
-              AST_LOG ("Else case token (%d) '%c'", token, (char)token);
-              break;
-            }
+          AST_ERROR_IF (true, "Expected declaration or \"begin\".");
         }
     }
 
   AST_ERROR_IF (!(ctx->flags & AST_FLAG_FOUND_ENTRY),
                 "Cannot find entry point.");
 
-  if (ctx->root)
-    ctx->root = _reverse_ast_list (ctx->root);
-
-  /* TODO: Report unclosed blocks. */
-
   return ctx->root;
 
 ast_err_exit:
@@ -672,6 +1298,67 @@ ast_fold (ast *ctx)
   arfold (&ctx->ar);
 }
 
+int
+ast_exp_type (ast_node *exp)
+{
+  ast_data_funcall *fun_data;
+  ast_data_routine *routine;
+  ast_data_op *op_data;
+  int left, right;
+
+  switch (exp->type)
+    {
+    case AST_VAR_DECLARE:
+      return ((ast_data_var_declare *)exp->data)->datatype;
+    case AST_FUNCALL:
+      fun_data = exp->data;
+      if (fun_data->routine)
+        {
+          routine = fun_data->routine->data;
+          return ((ast_data_var_declare *)routine->result->data)->datatype;
+        }
+      return streq (fun_data->name->data, "length") ? AST_INTLIT
+                                                     : AST_STRLIT;
+    case AST_INDEX:
+      return ast_exp_type (((ast_data_index *)exp->data)->var);
+    case AST_OP:
+      op_data = exp->data;
+      if (op_data->op == '!' || ast_is_compare (op_data->op))
+        return AST_BOOL;
+      right = ast_exp_type (op_data->right);
+      if (!op_data->left)
+        return right;
+      left = ast_exp_type (op_data->left);
+      if (left == AST_STRLIT || right == AST_STRLIT)
+        return AST_STRLIT;
+      if (left == AST_FLOATLIT || right == AST_FLOATLIT)
+        return AST_FLOATLIT;
+      return AST_INTLIT;
+    default:
+      return exp->type;
+    }
+}
+
+int
+ast_is_compare (U8 op)
+{
+  return op == '<' || op == '>' || op == '=' || op == (U8)TOKEN_LEQ
+         || op == (U8)TOKEN_GEQ || op == (U8)TOKEN_NEQ;
+}
+
+int
+ast_log2 (ast_node *exp)
+{
+  long value;
+
+  if (exp->type != AST_INTLIT)
+    return 0;
+  value = *(long *)exp->data;
+  if (value < 2 || (value & (value - 1)))
+    return 0;
+  return __builtin_ctzl (value);
+}
+
 void *
 _ast_parse_expression (ast *ctx, lex *lexer)
 {
@@ -680,26 +1367,25 @@ _ast_parse_expression (ast *ctx, lex *lexer)
   long *int_data;
   double *float_data;
   void *ptr;
-  int token, current_prec, top_prec;
+  int token, current_prec, top_prec, depth = 0;
   char current_op, top_op;
   U16 *bool_data;
+  U8 operand = 1; /* An operand comes next, so - and ! are prefixes. */
 
   dainit (&value_stk, &ctx->ar, sizeof (ast_node), 8);
   dainit (&op_stk, &ctx->ar, sizeof (char), 8);
 
   token = lex_next_token (lexer);
 
-  while (!_is_expression_terminator (token))
+  /* A ) closes the expression only outside of its own parentheses. */
+  while (!_is_expression_terminator (token) || (token == ')' && depth > 0))
     {
       if (token == TOKEN_STRLIT)
         {
           new = _ast_new_node (ctx, AST_STRLIT);
           new->data = stringcpy (&ctx->ar, lexer->str);
-
-          dafold (&value_stk);
-          dafold (&op_stk);
-
-          return new;
+          dapush (&value_stk, new);
+          operand = 0;
         }
       else if (token == TOKEN_INTLIT || token == TOKEN_FLOATLIT)
         {
@@ -718,6 +1404,7 @@ _ast_parse_expression (ast *ctx, lex *lexer)
               new->data = float_data;
             }
           dapush (&value_stk, new);
+          operand = 0;
         }
       else if (token == TOKEN_IDENTF)
         {
@@ -725,10 +1412,33 @@ _ast_parse_expression (ast *ctx, lex *lexer)
             {
               var = *((ast_node **)ptr);
 
-              AST_ERROR_IF (var->type != AST_VAR_DECLARE,
-                            "Expected identifier variable.");
+              if (_is_const (var))
+                var = _const_value (ctx, var);
+              else if (var->type == AST_ROUTINE)
+                {
+                  AST_ERROR_IF (!((ast_data_routine *)var->data)->result,
+                                "A procedure has no value.");
+                  var = _create_call (ctx, var);
+                  if (!var)
+                    goto ast_err_exit;
+                }
+              else if (_is_array (var))
+                {
+                  token = lex_next_token (lexer);
+                  AST_ERROR_IF (token != '[', "Expected '[' after array.");
+                  var = _ast_get_strategy (AST_INDEX)->create (ctx, var);
+                  if (!var)
+                    goto ast_err_exit;
+                }
               dapush (&value_stk, var);
             }
+          else if (lex_peek (lexer) == '(' && _is_builtin (lexer->str))
+            {
+              new = _create_builtin (ctx, lexer);
+              if (!new)
+                goto ast_err_exit;
+              dapush (&value_stk, new);
+            }
           else if (strcmp (lexer->str->data, "true") == 0
                    || strcmp (lexer->str->data, "false") == 0)
             {
@@ -736,20 +1446,24 @@ _ast_parse_expression (ast *ctx, lex *lexer)
               bool_data = aralloc (&ctx->ar, sizeof (U16));
               *bool_data = strcmp (lexer->str->data, "true") == 0 ? 1 : 0;
               new->data = bool_data;
-              return new;
+              dapush (&value_stk, new);
             }
           else
             {
               AST_EXPECT_IDENTF ();
             }
+          operand = 0;
         }
       else if (token == '(')
         {
           current_op = (char)token;
           dapush (&op_stk, &current_op);
+          ++depth;
         }
       else if (token == ')')
         {
+          --depth;
+          operand = 0;
           while (op_stk.size > 0)
             {
               top_op = *(char *)dageti (&op_stk, 0);
@@ -767,11 +1481,22 @@ _ast_parse_expression (ast *ctx, lex *lexer)
                 }
             }
         }
+      else if (_is_token_op (token) && operand)
+        {
+          /* Prefix operators, a + sign does nothing. */
+          AST_ERROR_IF (token != '-' && token != '+' && token != '!',
+                        "Expected operand.");
+          current_op = token == '-' ? AST_OP_NEG_MARK : (char)token;
+          if (token != '+')
+            dapush (&op_stk, &current_op);
+        }
       else if (_is_token_op (token))
         {
+          AST_ERROR_IF (token == '!', "Expected operator.");
           current_op = (char)token;
           current_prec = _get_precedence (current_op);
 
+          /* Operators of the same precedence group from the left. */
           while (op_stk.size > 0)
             {
               top_op = *(char *)dageti (&op_stk, 0);
@@ -780,7 +1505,7 @@ _ast_parse_expression (ast *ctx, lex *lexer)
 
               top_prec = _get_precedence (top_op);
 
-              if (top_prec > current_prec)
+              if (top_prec >= current_prec)
                 {
                   dadel (&op_stk, 0);
                   node = _create_op_node (ctx, top_op, &value_stk);
@@ -793,19 +1518,21 @@ _ast_parse_expression (ast *ctx, lex *lexer)
             }
 
           dapush (&op_stk, &current_op);
+          operand = 1;
         }
       else
         {
           break;
         }
 
-      if (lex_peek (lexer) == ';')
+      if (lex_peek (lexer) == ';' || lex_peek (lexer) == ':')
         break;
 
-      if (lex_peek (lexer) == ')' && op_stk.size == 0)
+      /* The ) of a call or ] of an index around the expression. */
+      if ((lex_peek (lexer) == ')' || lex_peek (lexer) == ']') && depth == 0)
         break;
 
-      if (lex_peek (lexer) == TOKEN_THEN || lex_peek (lexer) == TOKEN_DO)
+      if (_is_statement_keyword (lex_peek (lexer)))
         break;
 
       token = lex_next_token (lexer);
@@ -829,99 +1556,6 @@ ast_err_exit:
   return (ast_node *)0;
 }
 
-void
-_append_to_block (ast *ctx, ast_node *new)
-{
-  ast_data_while *while_data;
-  ast_data_cond *cond_data;
-  ast_data_block *block_data;
-
-  if (ctx->flags & AST_FLAG_DEBUG)
-    {
-      ast_print_tree (new, " ");
-      printf ("\n");
-    }
-  /* Append to WHILE loop. */
-  else if (ctx->loop_stk->size > 0)
-    {
-      ctx->currentIndent = *(ast_node **)dageti (ctx->block_stk, 0);
-      AST_LOG ("Appending to loop %p.", ctx->currentIndent);
-      if (ctx->currentIndent)
-        {
-          while_data = ctx->currentIndent->data;
-          new->next = while_data->next;
-          while_data->next = new;
-        }
-      else
-        {
-          CLOMY_FAIL ("[AST] Block stack shouldn't contain null pointer.");
-        }
-    }
-  /* Append to IF condition. */
-  else if (ctx->cond_stk->size > 0)
-    {
-      ctx->currentIndent = *(ast_node **)dageti (ctx->cond_stk, 0);
-      cond_data = ctx->currentIndent->data;
-      /* Append to NO branch. */
-      if (cond_data->no == (void *)0xDEADBEEF)
-        {
-          AST_LOG ("Appending to condition NO.");
-          cond_data->no = new;
-        }
-      /* Append to block NO branch. */
-      else if (cond_data->no && cond_data->no != (void *)0xDEADBEEF
-               && cond_data->yes->type == AST_BLOCK)
-        {
-          AST_LOG ("Appending to condition NO branch.");
-          block_data = cond_data->no->data;
-          new->next = block_data->next;
-          block_data->next = new;
-        }
-      /* Append to YES branch. */
-      else if (!cond_data->yes)
-        {
-          AST_LOG ("Appending to condition YES.");
-          cond_data->yes = new;
-        }
-      /* Append to block YES branch. */
-      else if (cond_data->yes && cond_data->yes->type == AST_BLOCK)
-        {
-          AST_LOG ("Appending to condition YES block.");
-          block_data = cond_data->yes->data;
-          new->next = block_data->next;
-          block_data->next = new;
-        }
-      else
-        {
-          CLOMY_FAIL ("[AST] Unreachable IF placement.");
-        }
-    }
-  /* Append to current block. */
-  else if (ctx->block_stk->size > 0)
-    {
-      ctx->currentIndent = *(ast_node **)dageti (ctx->block_stk, 0);
-      AST_LOG ("Appending to block %p.", ctx->currentIndent);
-      if (ctx->currentIndent)
-        {
-          block_data = ctx->currentIndent->data;
-          new->next = block_data->next;
-          block_data->next = new;
-        }
-      else
-        {
-          CLOMY_FAIL ("[AST] Block stack shouldn't contain null pointer.");
-        }
-    }
-  /* Append to root. */
-  else
-    {
-      AST_LOG ("Appending to root.");
-      new->next = ctx->root;
-      ctx->root = new;
-      ctx->currentIndent = ctx->root;
-    }
-}
-
 int
 _get_precedence (char op)
 {
@@ -934,6 +1568,9 @@ _get_precedence (char op)
     case '/':
     case '%':
       return 2;
+    case '!':
+    case AST_OP_NEG_MARK:
+      return 3;
     default:
       return 0;
     }
@@ -954,10 +1591,11 @@ _create_op_node (ast *ctx, char op, da *value_stk)
   ast_node *new_node = _ast_new_node (ctx, AST_OP);
   ast_data_op *op_data = aralloc (&ctx->ar, sizeof (ast_data_op));
 
-  op_data->op = op;
+  op_data->op = op == AST_OP_NEG_MARK ? '-' : op;
+  op_data->left = NULL;
 
   op_data->right = dapop (value_stk);
-  if (op != '!')
+  if (op != '!' && op != AST_OP_NEG_MARK)
     op_data->left = dapop (value_stk);
 
   new_node->data = op_data;
@@ -1010,6 +1648,20 @@ _ast_print_node (ast_node *n)
       break;
     case AST_OP:
       op_data = n->data;
+      if (op_data->op == AST_OP_SHL || op_data->op == AST_OP_SHR)
+        {
+          printf ("(%s ", op_data->op == AST_OP_SHL ? "<<" : ">>");
+          _ast_print_node (op_data->left);
+          printf (" %d)", ast_log2 (op_data->right));
+          break;
+        }
+      if (op_data->op == AST_OP_AND)
+        {
+          printf ("(& ");
+          _ast_print_node (op_data->left);
+          printf (" %ld)", *(long *)((ast_node *)op_data->right)->data - 1);
+          break;
+        }
       printf ("(%c ", op_data->op);
       if (op_data->left)
         {
@@ -1031,9 +1683,9 @@ _ast_print_node (ast_node *n)
 static int
 _is_token_op (int tok)
 {
-  return tok == '+' || tok == '-' || tok == '*' || tok == '/' || tok == '!'
-         || tok == '>' || tok == '<' || tok == TOKEN_GEQ || tok == TOKEN_LEQ
-         || tok == TOKEN_NEQ;
+  return tok == '+' || tok == '-' || tok == '*' || tok == '/' || tok == '%'
+         || tok == '!' || tok == '>' || tok == '<' || tok == '='
+         || tok == TOKEN_GEQ || tok == TOKEN_LEQ || tok == TOKEN_NEQ;
 }
 
 static int
@@ -1042,6 +1694,84 @@ _is_expression_terminator (int tok)
   return tok == ',' || tok == ')' || tok == ';' || tok == TOKEN_END;
 }
 
+static int
+_is_statement_keyword (int tok)
+{
+  return tok == TOKEN_THEN || tok == TOKEN_DO || tok == TOKEN_ELSE
+         || tok == TOKEN_BLOCK_END || tok == TOKEN_TO || tok == TOKEN_DOWNTO;
+}
+
+static int
+_is_array (ast_node *var)
+{
+  ast_data_var_declare *data = var->data;
+
+  return data->arsize > 0 && data->datatype != AST_STRLIT;
+}
+
+int
+_assignable (U16 datatype, ast_node *exp)
+{
+  int type = ast_exp_type (exp);
+
+  if (datatype == AST_STRLIT || type == AST_STRLIT)
+    return datatype == type;
+  return datatype == AST_FLOATLIT || type != AST_FLOATLIT;
+}
+
+static int
+_is_builtin (string *name)
+{
+  U32 i;
+
+  for (i = 0; i < sizeof (_ast_builtins) / sizeof (*_ast_builtins); ++i)
+    if (streq (name->data, _ast_builtins[i].name))
+      return 1;
+  return 0;
+}
+
+static ast_node *
+_create_builtin (ast *ctx, lex *lexer)
+{
+  ast_node *new, *arg;
+  ast_data_funcall *data;
+  U32 i, nargs = 0;
+  int token;
+
+  new = _ast_new_node (ctx, AST_FUNCALL);
+  data = aralloc (&ctx->ar, sizeof (ast_data_funcall));
+  data->name = stringcpy (&ctx->ar, lexer->str);
+  data->args_head = NULL;
+  data->routine = NULL;
+  new->data = data;
+
+  lex_next_token (lexer);
+  while (lex_peek (lexer) != ')')
+    {
+      arg = _ast_parse_expression (ctx, lexer);
+      AST_ERROR_IF (!arg, "Invalid expression.");
+      arg->next = data->args_head;
+      data->args_head = arg;
+      ++nargs;
+
+      /* The expression may have taken the comma already. */
+      if (lex_peek (lexer) == ',')
+        lex_next_token (lexer);
+    }
+  token = lex_next_token (lexer);
+  AST_ERROR_IF (token != ')', "Expected ')'");
+  data->args_head = _reverse_ast_list (data->args_head);
+
+  for (i = 0; !streq (data->name->data, _ast_builtins[i].name); ++i)
+    ;
+  AST_ERROR_IF (nargs != _ast_builtins[i].nargs,
+                "Wrong number of arguments.");
+  return new;
+
+ast_err_exit:
+  return NULL;
+}
+
 static inline ast_node *
 _reverse_ast_list (ast_node *head)
 {
@@ -8,6 +8,7 @@
 #define AST_FLAG_DEBUG (1 << 0)
 #define AST_FLAG_FOUND_ENTRY (1 << 1)
 #define AST_FLAG_READ_VAR (1 << 2)
+#define AST_FLAG_READ_CONST (1 << 3)
 
 /* Debug print */
 #define AST_LOG(format, ...)                                                  \
@@ -18,10 +19,12 @@
     }                                                                         \
   while (0)
 
+/* Report MSG and fail the node being created when COND holds.  The
+   arena stays alive for the callers on the way out, whoever called
+   ast_parse folds it. */
 #define AST_ERROR_IF(cond, msg)                                               \
   if ((cond))                                                                 \
     {                                                                         \
-      ast_fold (ctx);                                                         \
       lex_error (ctx->lexer, (msg));                                          \
       goto ast_err_exit;                                                      \
     }
@@ -59,6 +62,10 @@ enum ast_type
   AST_OP,
   AST_COND,
   AST_WHILE,
+  AST_WRITE_ARG,
+  AST_INDEX,
+  AST_FOR,
+  AST_ROUTINE,
   AST_STRATEGY_COUNT
 };
 
@@ -69,22 +76,36 @@ typedef struct ast_node
   void *data;
 } ast_node;
 
+/* Flags of ast_data_var_declare. */
+#define AST_VAR_LOCAL (1 << 0) /* Parameter, local or result of a routine. */
+#define AST_VAR_REF (1 << 1)   /* var parameter, the caller's variable. */
+
 typedef struct ast_data_var_declare
 {
   string *name;
   U16 datatype;
   U32l arsize;
+  U8 flags;
 } ast_data_var_declare;
 
 typedef struct ast_data_var_assign
 {
   ast_node *var;
+  ast_node *index; /* AST_INDEX when assigning an array element. */
   ast_node *value;
 } ast_data_var_assign;
 
+/* Element INDEX of array VAR, counted from 0.  CHECK is cleared when the
+   index is known to be in bounds, see range.h. */
+typedef struct ast_data_index
+{
+  ast_node *var;
+  ast_node *index;
+  U8 check;
+} ast_data_index;
+
 typedef struct ast_data_block
 {
-  ast_node *parent;
   ast_node *next;
 } ast_data_block;
 
@@ -92,8 +113,38 @@ typedef struct ast_data_funcall
 {
   string *name;
   ast_node *args_head;
+  ast_node *routine; /* AST_ROUTINE called, NULL for builtins. */
 } ast_data_funcall;
 
+/* A procedure, or a function when RESULT holds the variable its value is
+   assigned to.  PARAMS and LOCALS are lists of AST_VAR_DECLARE. */
+typedef struct ast_data_routine
+{
+  string *name;
+  ast_node *params;
+  ast_node *locals;
+  ast_node *result;
+  ast_node *body;
+  U32 nparams;
+  U8 recursive; /* The body calls the routine itself. */
+} ast_data_routine;
+
+/* A write argument with a field width, VALUE:WIDTH or
+   VALUE:WIDTH:DECIMALS.  DECIMALS is NULL when not given. */
+typedef struct ast_data_write_arg
+{
+  ast_node *value;
+  ast_node *width;
+  ast_node *decimals;
+} ast_data_write_arg;
+
+/* Integer shifts and mask that simplify.c and range.c put in place of a
+   multiply, divide or mod by a power of two, only where they give the
+   same value.  RIGHT stays that power of two, see ast_log2. */
+#define AST_OP_SHL 'l' /* LEFT << log2 RIGHT. */
+#define AST_OP_SHR 'r' /* LEFT >> log2 RIGHT, LEFT >= 0. */
+#define AST_OP_AND '&' /* LEFT & RIGHT - 1, LEFT >= 0. */
+
 typedef struct ast_data_op
 {
   U8 op;
@@ -114,15 +165,25 @@ typedef struct ast_data_while
   ast_node *next;
 } ast_data_while;
 
+/* FOR VAR := FROM to TO do BODY, or downto when DOWN is set.  TO is
+   evaluated once before the first iteration and VAR is read-only in
+   BODY. */
+typedef struct ast_data_for
+{
+  ast_node *var;
+  ast_node *from;
+  ast_node *to;
+  ast_node *body;
+  U8 down;
+} ast_data_for;
+
 typedef struct
 {
   arena ar;
   lex *lexer;
   ast_node *root;
-  ast_node *currentIndent;
-  da *block_stk;
-  da *cond_stk;
-  da *loop_stk;
+  ast_node *routine; /* AST_ROUTINE being parsed, NULL in the program. */
+  da *loop_stk; /* Control variables of the enclosing FOR loops. */
   ht *ident_table;
   U8 flags;
 } ast;
@@ -138,14 +199,26 @@ typedef struct
 {
   int token;
   ast_node *var;
+  ast_node *index;
 } ast_var_assign_arg;
 
 int ast_init (ast *ctx);
 
+/* Parse the whole program.  Returns NULL after reporting the error, the
+   tree is left to ast_fold then. */
 ast_node *ast_parse (ast *ctx);
 
 void ast_print_tree (ast_node *root, char *delim);
 
 void ast_fold (ast *ctx);
 
+/* AST datatype of the value of expression EXP. */
+int ast_exp_type (ast_node *exp);
+
+/* Check if operator OP compares its operands. */
+int ast_is_compare (U8 op);
+
+/* K when EXP is the integer literal 2^K with K > 0, 0 otherwise. */
+int ast_log2 (ast_node *exp);
+
 #endif /* AST_H */
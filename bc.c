@@ -0,0 +1,700 @@
+#include <ctype.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+#include "bc.h"
+#include "runtime/libpascal.h"
+#include "utils.h"
+
+/* Jump target patched once every block has its address. */
+typedef struct
+{
+  U32 pc;
+  U32 target; /* Block number. */
+  U32 branch; /* Fused branch number, UINT32_MAX for wide targets. */
+} bc_fixup;
+
+typedef struct
+{
+  bc_prog *p;
+  ir_func *fn;
+  da code;   /* bc_insn */
+  da consts; /* S64 */
+  da strs;   /* char */
+  da fixups; /* bc_fixup */
+  U32 *uses;
+  U32 *folded;  /* Uses of constants that became immediates. */
+  ir_insn **def; /* The only definition of every vreg, or NULL. */
+  U32 *block_pc;
+  U8 *no_fuse; /* Branches too far for a compare and branch. */
+  U32 nbranches;
+} bc_gen_ctx;
+
+static const struct
+{
+  const char *name;
+  const char *opnds; /* r register, w 32-bit, k 16-bit signed, j jump */
+  const char *kinds; /* Of each operand: i integer, f real, s string,
+                        a array, n integer or real, * the same as the
+                        other, - not a register */
+} _bc_ops[BC_OP_COUNT] = {
+  [BC_HALT] = { "halt", "", "" },
+  [BC_MOV] = { "mov", "rr", "**" },
+  [BC_LOADI] = { "loadi", "rw", "i-" },
+  [BC_LOADK] = { "loadk", "rw", "n-" },
+  [BC_LOADS] = { "loads", "rw", "s-" },
+  [BC_ADD_I] = { "add.i", "rrr", "iii" },
+  [BC_SUB_I] = { "sub.i", "rrr", "iii" },
+  [BC_MUL_I] = { "mul.i", "rrr", "iii" },
+  [BC_DIV_I] = { "div.i", "rrr", "iii" },
+  [BC_MOD_I] = { "mod.i", "rrr", "iii" },
+  [BC_ADDK_I] = { "addk.i", "rrk", "ii-" },
+  [BC_NEG_I] = { "neg.i", "rr", "ii" },
+  [BC_NOT] = { "not", "rr", "ii" },
+  [BC_ADD_F] = { "add.f", "rrr", "fff" },
+  [BC_SUB_F] = { "sub.f", "rrr", "fff" },
+  [BC_MUL_F] = { "mul.f", "rrr", "fff" },
+  [BC_DIV_F] = { "div.f", "rrr", "fff" },
+  [BC_NEG_F] = { "neg.f", "rr", "ff" },
+  [BC_ITOF] = { "itof", "rr", "fi" },
+  [BC_LT_I] = { "lt.i", "rrr", "iii" },
+  [BC_LE_I] = { "le.i", "rrr", "iii" },
+  [BC_GT_I] = { "gt.i", "rrr", "iii" },
+  [BC_GE_I] = { "ge.i", "rrr", "iii" },
+  [BC_EQ_I] = { "eq.i", "rrr", "iii" },
+  [BC_NE_I] = { "ne.i", "rrr", "iii" },
+  [BC_LT_F] = { "lt.f", "rrr", "iff" },
+  [BC_LE_F] = { "le.f", "rrr", "iff" },
+  [BC_GT_F] = { "gt.f", "rrr", "iff" },
+  [BC_GE_F] = { "ge.f", "rrr", "iff" },
+  [BC_EQ_F] = { "eq.f", "rrr", "iff" },
+  [BC_NE_F] = { "ne.f", "rrr", "iff" },
+  [BC_JMP] = { "jmp", "w", "-" },
+  [BC_JT] = { "jt", "rw", "i-" },
+  [BC_JF] = { "jf", "rw", "i-" },
+  [BC_BLT_I] = { "blt.i", "rrj", "ii-" },
+  [BC_BLE_I] = { "ble.i", "rrj", "ii-" },
+  [BC_BGT_I] = { "bgt.i", "rrj", "ii-" },
+  [BC_BGE_I] = { "bge.i", "rrj", "ii-" },
+  [BC_BEQ_I] = { "beq.i", "rrj", "ii-" },
+  [BC_BNE_I] = { "bne.i", "rrj", "ii-" },
+  [BC_BLT_F] = { "blt.f", "rrj", "ff-" },
+  [BC_BLE_F] = { "ble.f", "rrj", "ff-" },
+  [BC_BGT_F] = { "bgt.f", "rrj", "ff-" },
+  [BC_BGE_F] = { "bge.f", "rrj", "ff-" },
+  [BC_BEQ_F] = { "beq.f", "rrj", "ff-" },
+  [BC_BNE_F] = { "bne.f", "rrj", "ff-" },
+  [BC_WRITE_I] = { "write.i", "r", "i" },
+  [BC_WRITE_F] = { "write.f", "r", "f" },
+  [BC_WRITE_S] = { "write.s", "r", "s" },
+  [BC_WRITE_IW] = { "write.iw", "rr", "ii" },
+  [BC_WRITE_FW] = { "write.fw", "rr", "fi" },
+  [BC_WRITE_FX] = { "write.fx", "rrr", "fii" },
+  [BC_WRITE_SW] = { "write.sw", "rr", "si" },
+  [BC_LEN_S] = { "len.s", "rr", "is" },
+  [BC_CAT_S] = { "cat.s", "rrr", "sss" },
+  [BC_DROP_S] = { "drop.s", "rrr", "ssi" },
+  [BC_TAKE_S] = { "take.s", "rrr", "ssi" },
+  [BC_CMP_S] = { "cmp.s", "rrr", "iss" },
+  [BC_DUP_S] = { "dup.s", "rr", "ss" },
+  [BC_FREE_S] = { "free.s", "r", "s" },
+  [BC_APP_S] = { "app.s", "rrr", "sss" },
+  [BC_ARRAY] = { "array", "rr", "ai" },
+  [BC_BOUNDS] = { "bounds", "rr", "ii" },
+  [BC_LOAD] = { "load", "rrr", "nai" },
+  [BC_STORE] = { "store", "rrr", "ain" },
+};
+
+/* Opcode of a call to each runtime function. */
+static const U16 _bc_call[IR_RT_COUNT] = {
+  [IR_RT_WRITE_INT] = BC_WRITE_I,    [IR_RT_WRITE_REAL] = BC_WRITE_F,
+  [IR_RT_WRITE_STR] = BC_WRITE_S,    [IR_RT_WRITE_INT_W] = BC_WRITE_IW,
+  [IR_RT_WRITE_REAL_W] = BC_WRITE_FW, [IR_RT_WRITE_FIXED] = BC_WRITE_FX,
+  [IR_RT_WRITE_STR_W] = BC_WRITE_SW, [IR_RT_LENGTH] = BC_LEN_S,
+  [IR_RT_CONCAT] = BC_CAT_S,         [IR_RT_DROP] = BC_DROP_S,
+  [IR_RT_TAKE] = BC_TAKE_S,          [IR_RT_DUP] = BC_DUP_S,
+  [IR_RT_FREE] = BC_FREE_S,          [IR_RT_APPEND] = BC_APP_S,
+  [IR_RT_COMPARE] = BC_CMP_S,
+  [IR_RT_ARRAY] = BC_ARRAY,          [IR_RT_BOUNDS] = BC_BOUNDS,
+};
+
+/* Integer and real opcode of every IR operation, 0 where there is none. */
+static const U16 _bc_int[IR_OP_COUNT] = {
+  [IR_ADD] = BC_ADD_I, [IR_SUB] = BC_SUB_I, [IR_MUL] = BC_MUL_I,
+  [IR_DIV] = BC_DIV_I, [IR_MOD] = BC_MOD_I, [IR_NEG] = BC_NEG_I,
+  [IR_LT] = BC_LT_I,   [IR_LE] = BC_LE_I,   [IR_GT] = BC_GT_I,
+  [IR_GE] = BC_GE_I,   [IR_EQ] = BC_EQ_I,   [IR_NE] = BC_NE_I,
+};
+
+static const U16 _bc_real[IR_OP_COUNT] = {
+  [IR_ADD] = BC_ADD_F, [IR_SUB] = BC_SUB_F, [IR_MUL] = BC_MUL_F,
+  [IR_DIV] = BC_DIV_F, [IR_NEG] = BC_NEG_F, [IR_LT] = BC_LT_F,
+  [IR_LE] = BC_LE_F,   [IR_GT] = BC_GT_F,   [IR_GE] = BC_GE_F,
+  [IR_EQ] = BC_EQ_F,   [IR_NE] = BC_NE_F,
+};
+
+/* The opposite integer comparison, to branch on the false edge. */
+static const U8 _negate[IR_OP_COUNT] = {
+  [IR_LT] = IR_GE, [IR_LE] = IR_GT, [IR_GT] = IR_LE,
+  [IR_GE] = IR_LT, [IR_EQ] = IR_NE, [IR_NE] = IR_EQ,
+};
+
+/* Generate the whole function, returns 1 on error and 2 when some fused
+   branch was out of reach and the generation has to be redone. */
+static int _gen (bc_gen_ctx *ctx);
+
+static int _gen_insn (bc_gen_ctx *ctx, ir_insn *in, U32 next,
+                      ir_insn **skip);
+
+static bc_insn *_emit (bc_gen_ctx *ctx, U16 op, U32 a, U32 b, U32 c);
+static void _emit_wide (bc_gen_ctx *ctx, U16 op, U32 a, U32 w);
+
+/* Emit jump OP to block TARGET, BRANCH as in bc_fixup. */
+static void _emit_jump (bc_gen_ctx *ctx, U16 op, U32 a, U32 b, U32 target,
+                        U32 branch);
+
+/* Check if IN adds a small constant, returning the other operand in REG,
+   the constant in K and the vreg holding it. */
+static U32 _addk (bc_gen_ctx *ctx, ir_insn *in, U32 *reg, S16 *k);
+
+static void _count_use (U32 *use, void *arg);
+
+/* Whether a register of KIND can be an operand written C in the kinds
+   of _bc_ops. */
+static int _kind_ok (char c, U8 kind);
+
+/* Whether a literal of P starts at OFF, after its header. */
+static int _str_ok (const bc_prog *p, U32 off);
+
+int
+bc_gen (bc_prog *p, ir_func *fn)
+{
+  bc_gen_ctx ctx = { 0 };
+  ir_block *bb;
+  ir_insn *in;
+  U32 i, n = fn->vregs.size, reg, *defs;
+  U8 *kinds;
+  S16 k;
+  int status;
+
+  if (n > BC_MAX_REGS)
+    {
+      fprintf (stderr, "Error: Too many registers for the bytecode.\n");
+      return 1;
+    }
+
+  ctx.p = p;
+  ctx.fn = fn;
+  kinds = aralloc (&p->ar, n ? n : 1);
+  for (i = 0; i < n; ++i)
+    switch (ir_vreg_get (fn, i)->type)
+      {
+      case IR_REAL:
+        kinds[i] = BC_KIND_REAL;
+        break;
+      case IR_STR:
+        kinds[i] = BC_KIND_STR;
+        break;
+      case IR_PTR:
+        kinds[i] = BC_KIND_ARRAY;
+        break;
+      default:
+        kinds[i] = BC_KIND_INT;
+        break;
+      }
+  if (dainit (&ctx.code, &p->ar, sizeof (bc_insn), 64)
+      || dainit (&ctx.consts, &p->ar, sizeof (S64), 8)
+      || dainit (&ctx.strs, &p->ar, 1, 64)
+      || dainit (&ctx.fixups, &p->ar, sizeof (bc_fixup), 16))
+    return 1;
+
+  ctx.uses = aralloc (&p->ar, 3 * n * sizeof (U32));
+  memset (ctx.uses, 0, 3 * n * sizeof (U32));
+  ctx.folded = ctx.uses + n;
+  defs = ctx.folded + n;
+  ctx.def = aralloc (&p->ar, n * sizeof (ir_insn *));
+  memset (ctx.def, 0, n * sizeof (ir_insn *));
+  ctx.block_pc = aralloc (&p->ar, fn->blocks.size * sizeof (U32));
+
+  for (i = 0; i < fn->blocks.size; ++i)
+    {
+      bb = ir_block_get (fn, i);
+      for (in = bb->head; in; in = in->next)
+        {
+          ir_for_each_use (in, _count_use, ctx.uses);
+          if (in->dst != IR_NONE)
+            {
+              ++defs[in->dst];
+              ctx.def[in->dst] = in;
+            }
+        }
+    }
+  for (i = 0; i < n; ++i)
+    if (defs[i] != 1)
+      ctx.def[i] = NULL;
+
+  /* Constants only added as immediates need no register. */
+  for (i = 0; i < fn->blocks.size; ++i)
+    for (in = ir_block_get (fn, i)->head; in; in = in->next)
+      {
+        reg = _addk (&ctx, in, &reg, &k);
+        if (reg)
+          ++ctx.folded[reg];
+        ctx.nbranches += in->op == IR_BR;
+      }
+  ctx.no_fuse = aralloc (&p->ar, ctx.nbranches + 1);
+  memset (ctx.no_fuse, 0, ctx.nbranches + 1);
+
+  while ((status = _gen (&ctx)) == 2)
+    ;
+
+  if (status == 0)
+    {
+      p->code = ctx.code.data;
+      p->ncode = ctx.code.size;
+      p->consts = ctx.consts.data;
+      p->nconsts = ctx.consts.size;
+      p->strs = ctx.strs.data;
+      p->strs_size = ctx.strs.size;
+      p->nregs = n;
+      p->kinds = kinds;
+    }
+
+  arfree (ctx.no_fuse);
+  arfree (ctx.block_pc);
+  arfree (ctx.def);
+  arfree (ctx.uses);
+  dafold (&ctx.fixups);
+  return status;
+}
+
+static int
+_gen (bc_gen_ctx *ctx)
+{
+  ir_func *fn = ctx->fn;
+  ir_insn *in, *skip = NULL;
+  bc_fixup *fix;
+  bc_insn *code;
+  long rel;
+  U32 i;
+  int status = 0;
+
+  ctx->code.size = ctx->consts.size = ctx->strs.size = ctx->fixups.size = 0;
+  ctx->nbranches = 0;
+
+  for (i = 0; i < fn->blocks.size; ++i)
+    {
+      ctx->block_pc[i] = ctx->code.size;
+      for (in = ir_block_get (fn, i)->head; in; in = in->next)
+        if (in != skip && _gen_insn (ctx, in, i + 1, &skip))
+          return 1;
+    }
+
+  for (i = 0; i < ctx->fixups.size; ++i)
+    {
+      fix = dageti (&ctx->fixups, i);
+      code = dageti (&ctx->code, fix->pc);
+      if (fix->branch == UINT32_MAX)
+        {
+          code->b = ctx->block_pc[fix->target] & 0xffff;
+          code->c = ctx->block_pc[fix->target] >> 16;
+          continue;
+        }
+      rel = (long)ctx->block_pc[fix->target] - fix->pc;
+      if (rel < INT16_MIN || rel > INT16_MAX)
+        {
+          ctx->no_fuse[fix->branch] = 1;
+          status = 2;
+        }
+      code->c = (U16)(S16)rel;
+    }
+
+  return status;
+}
+
+static int
+_gen_insn (bc_gen_ctx *ctx, ir_insn *in, U32 next, ir_insn **skip)
+{
+  ir_func *fn = ctx->fn;
+  ir_insn *br;
+  U32 dst = in->dst, reg, t, f, i, branch, cmp;
+  U8 real;
+  S16 k;
+  S64 bits;
+  U16 op;
+  _P__p_hdr hdr;
+  char *s;
+
+  /* Write straight into the variable a temporary is only copied to. */
+  if (dst != IR_NONE && ctx->uses[dst] == 1 && in->next
+      && in->next->op == IR_MOV && in->next->a == dst
+      && ir_vreg_get (fn, in->next->dst)->type == ir_vreg_get (fn, dst)->type)
+    {
+      dst = in->next->dst;
+      *skip = in->next;
+    }
+
+  real = in->type == IR_REAL;
+  switch (in->op)
+    {
+    case IR_NOP:
+      break;
+    case IR_CONST:
+      if (ir_vreg_get (fn, in->dst)->name == NULL
+          && ctx->uses[in->dst] == ctx->folded[in->dst])
+        break;
+      if (in->type == IR_STR)
+        {
+          /* A literal after its header, 8 aligned. */
+          s = aralloc (&ctx->p->ar, in->imm.s->size + 1);
+          hdr.len = strnlen (s, unescape (s, in->imm.s->data,
+                                          in->imm.s->size));
+          s[hdr.len] = '\0';
+          hdr.cap = 0;
+          while (ctx->strs.size % 8)
+            daappend (&ctx->strs, "");
+          for (i = 0; i < sizeof (hdr); ++i)
+            daappend (&ctx->strs, (char *)&hdr + i);
+          _emit_wide (ctx, BC_LOADS, dst, ctx->strs.size);
+          for (i = 0; i <= hdr.len; ++i)
+            daappend (&ctx->strs, &s[i]);
+          arfree (s);
+        }
+      else if (!real && in->imm.i >= INT32_MIN && in->imm.i <= INT32_MAX)
+        _emit_wide (ctx, BC_LOADI, dst, (U32)in->imm.i);
+      else
+        {
+          if (real)
+            memcpy (&bits, &in->imm.f, sizeof (bits));
+          else
+            bits = in->imm.i;
+          _emit_wide (ctx, BC_LOADK, dst, ctx->consts.size);
+          daappend (&ctx->consts, &bits);
+        }
+      break;
+    case IR_MOV:
+      if (dst != in->a)
+        _emit (ctx, BC_MOV, dst, in->a, 0);
+      break;
+    case IR_ADD:
+    case IR_SUB:
+    case IR_MUL:
+    case IR_DIV:
+    case IR_MOD:
+      if (_addk (ctx, in, &reg, &k))
+        _emit (ctx, BC_ADDK_I, dst, reg, (U16)k);
+      else if (!(op = real ? _bc_real[in->op] : _bc_int[in->op]))
+        {
+          fprintf (stderr, "Error: Real modulo is not supported.\n");
+          return 1;
+        }
+      else
+        _emit (ctx, op, dst, in->a, in->b);
+      break;
+    case IR_NEG:
+      _emit (ctx, real ? BC_NEG_F : BC_NEG_I, dst, in->a, 0);
+      break;
+    case IR_NOT:
+      _emit (ctx, BC_NOT, dst, in->a, 0);
+      break;
+    case IR_ITOF:
+      _emit (ctx, BC_ITOF, dst, in->a, 0);
+      break;
+    case IR_LOAD:
+      _emit (ctx, BC_LOAD, dst, in->a, in->b);
+      break;
+    case IR_STORE:
+      _emit (ctx, BC_STORE, in->a, in->b, in->args[0]);
+      break;
+    case IR_LT:
+    case IR_LE:
+    case IR_GT:
+    case IR_GE:
+    case IR_EQ:
+    case IR_NE:
+      real = ir_vreg_get (fn, in->a)->type == IR_REAL;
+      br = in->next;
+      if (!br || br->op != IR_BR || br->a != in->dst
+          || ctx->uses[in->dst] != 1)
+        {
+          _emit (ctx, real ? _bc_real[in->op] : _bc_int[in->op], dst, in->a,
+                 in->b);
+          break;
+        }
+
+      /* Compare and branch. */
+      branch = ctx->nbranches++;
+      *skip = br;
+      if (ctx->no_fuse[branch])
+        {
+          _emit (ctx, real ? _bc_real[in->op] : _bc_int[in->op], in->dst,
+                 in->a, in->b);
+          return _gen_insn (ctx, br, next, skip);
+        }
+
+      t = br->t->rpo;
+      f = br->f->rpo;
+      cmp = in->op;
+      if (t == next && !real)
+        {
+          cmp = _negate[cmp];
+          t = f;
+          f = next;
+        }
+      op = (real ? BC_BLT_F : BC_BLT_I) + (cmp - IR_LT);
+      _emit_jump (ctx, op, in->a, in->b, t, branch);
+      if (f != next)
+        _emit_jump (ctx, BC_JMP, 0, 0, f, UINT32_MAX);
+      break;
+    case IR_CALL:
+      /* A result goes to A, the arguments follow it. */
+      op = _bc_call[in->callee];
+      if (in->dst != IR_NONE)
+        _emit (ctx, op, dst, in->args[0], in->nargs > 1 ? in->args[1] : 0);
+      else
+        _emit (ctx, op, in->args[0], in->nargs > 1 ? in->args[1] : 0,
+               in->nargs > 2 ? in->args[2] : 0);
+      break;
+    case IR_JMP:
+      if (in->t->rpo != next)
+        _emit_jump (ctx, BC_JMP, 0, 0, in->t->rpo, UINT32_MAX);
+      break;
+    case IR_BR:
+      if (in->t->rpo == next)
+        _emit_jump (ctx, BC_JF, in->a, 0, in->f->rpo, UINT32_MAX);
+      else
+        {
+          _emit_jump (ctx, BC_JT, in->a, 0, in->t->rpo, UINT32_MAX);
+          if (in->f->rpo != next)
+            _emit_jump (ctx, BC_JMP, 0, 0, in->f->rpo, UINT32_MAX);
+        }
+      break;
+    case IR_RET:
+      _emit (ctx, BC_HALT, 0, 0, 0);
+      break;
+    default:
+      fprintf (stderr, "Error: Unexpected \"%s\" in bytecode.\n",
+               ir_op_name (in->op));
+      return 1;
+    }
+
+  return 0;
+}
+
+static bc_insn *
+_emit (bc_gen_ctx *ctx, U16 op, U32 a, U32 b, U32 c)
+{
+  bc_insn in = { op, a, b, c };
+
+  daappend (&ctx->code, &in);
+  return dageti (&ctx->code, ctx->code.size - 1);
+}
+
+static void
+_emit_wide (bc_gen_ctx *ctx, U16 op, U32 a, U32 w)
+{
+  _emit (ctx, op, a, w & 0xffff, w >> 16);
+}
+
+static void
+_emit_jump (bc_gen_ctx *ctx, U16 op, U32 a, U32 b, U32 target, U32 branch)
+{
+  bc_fixup fix = { ctx->code.size, target, branch };
+
+  daappend (&ctx->fixups, &fix);
+  _emit (ctx, op, a, b, 0);
+}
+
+static U32
+_addk (bc_gen_ctx *ctx, ir_insn *in, U32 *reg, S16 *k)
+{
+  ir_insn *def;
+  U32 i, v;
+  long imm;
+
+  if ((in->op != IR_ADD && in->op != IR_SUB) || in->type != IR_INT)
+    return 0;
+
+  for (i = 0; i < (in->op == IR_ADD ? 2 : 1); ++i)
+    {
+      v = i ? in->a : in->b;
+      def = ctx->def[v];
+      if (!def || def->op != IR_CONST || def->type != IR_INT
+          || ir_vreg_get (ctx->fn, v)->name)
+        continue;
+      imm = in->op == IR_SUB ? -def->imm.i : def->imm.i;
+      if (imm < INT16_MIN || imm > INT16_MAX)
+        continue;
+      *reg = i ? in->b : in->a;
+      *k = imm;
+      return v;
+    }
+  return 0;
+}
+
+static void
+_count_use (U32 *use, void *arg)
+{
+  ++((U32 *)arg)[*use];
+}
+
+int
+bc_verify (const bc_prog *p)
+{
+  const bc_insn *in;
+  const char *o, *k;
+  U32 pc, i, opnd;
+  S64 to;
+
+  if (p->ncode == 0
+      || (p->code[p->ncode - 1].op != BC_HALT
+          && p->code[p->ncode - 1].op != BC_JMP))
+    {
+      fprintf (stderr, "Error: Bytecode does not end in halt or jmp.\n");
+      return 1;
+    }
+  if (p->strs_size && p->strs[p->strs_size - 1] != '\0')
+    {
+      fprintf (stderr, "Error: Unterminated bytecode string table.\n");
+      return 1;
+    }
+  for (i = 0; i < p->nregs; ++i)
+    if (p->kinds[i] >= BC_KIND_COUNT)
+      {
+        fprintf (stderr, "Error: Bad kind of bytecode register %u.\n", i);
+        return 1;
+      }
+
+  for (pc = 0; pc < p->ncode; ++pc)
+    {
+      in = &p->code[pc];
+      if (in->op >= BC_OP_COUNT)
+        {
+          fprintf (stderr, "Error: Bad opcode %u at %u in bytecode.\n",
+                   in->op, pc);
+          return 1;
+        }
+
+      o = _bc_ops[in->op].opnds;
+      k = _bc_ops[in->op].kinds;
+      for (i = 0; o[i]; ++i)
+        {
+          opnd = i == 0 ? in->a : i == 1 ? in->b : in->c;
+          if (o[i] == 'r'
+              && (opnd >= p->nregs || !_kind_ok (k[i], p->kinds[opnd])
+                  || (k[i] == '*' && p->kinds[opnd] != p->kinds[in->a])))
+            break;
+          if (o[i] == 'j')
+            {
+              to = (S64)pc + (S16)in->c;
+              if (to < 0 || to >= p->ncode)
+                break;
+            }
+          if (o[i] == 'w')
+            {
+              opnd = BC_WIDE (in);
+              if ((in->op == BC_LOADK && opnd >= p->nconsts)
+                  || (in->op == BC_LOADS && !_str_ok (p, opnd))
+                  || ((in->op == BC_JMP || in->op == BC_JT || in->op == BC_JF)
+                      && opnd >= p->ncode))
+                break;
+            }
+        }
+      if (o[i])
+        {
+          fprintf (stderr, "Error: Bad operand of %s at %u in bytecode.\n",
+                   _bc_ops[in->op].name, pc);
+          return 1;
+        }
+    }
+
+  return 0;
+}
+
+static int
+_str_ok (const bc_prog *p, U32 off)
+{
+  _P__p_hdr hdr;
+
+  if (off % 8 || off < sizeof (hdr) || off >= p->strs_size)
+    return 0;
+  memcpy (&hdr, p->strs + off - sizeof (hdr), sizeof (hdr));
+  return hdr.cap == 0 && hdr.len < p->strs_size - off
+         && strnlen (p->strs + off, hdr.len + 1) == hdr.len;
+}
+
+static int
+_kind_ok (char c, U8 kind)
+{
+  switch (c)
+    {
+    case 'i':
+      return kind == BC_KIND_INT;
+    case 'f':
+      return kind == BC_KIND_REAL;
+    case 's':
+      return kind == BC_KIND_STR;
+    case 'a':
+      return kind == BC_KIND_ARRAY;
+    case 'n':
+      return kind == BC_KIND_INT || kind == BC_KIND_REAL;
+    default:
+      return c == '*';
+    }
+}
+
+const char *
+bc_op_name (U16 op)
+{
+  return op < BC_OP_COUNT ? _bc_ops[op].name : "?";
+}
+
+void
+bc_dump (bc_prog *p, FILE *out)
+{
+  const bc_insn *in;
+  const char *o, *c;
+  U32 pc, i;
+
+  for (pc = 0; pc < p->ncode; ++pc)
+    {
+      in = &p->code[pc];
+      o = in->op < BC_OP_COUNT ? _bc_ops[in->op].opnds : "";
+      fprintf (out, o[0] ? "%5u  %-8s" : "%5u  %s", pc, bc_op_name (in->op));
+      for (i = 0; o[i]; ++i)
+        {
+          fprintf (out, i ? ", " : " ");
+          if (o[i] == 'r')
+            fprintf (out, "r%u", i == 0 ? in->a : i == 1 ? in->b : in->c);
+          else if (o[i] == 'w')
+            fprintf (out, "%u", BC_WIDE (in));
+          else if (o[i] == 'k')
+            fprintf (out, "%d", (S16)in->c);
+          else
+            fprintf (out, "%d", (int)pc + (S16)in->c);
+        }
+      if (in->op == BC_LOADS)
+        {
+          fprintf (out, "  ; \"");
+          for (c = p->strs + BC_WIDE (in); *c; ++c)
+            if (*c == '\n')
+              fprintf (out, "\\n");
+            else if (*c == '"' || *c == '\\')
+              fprintf (out, "\\%c", *c);
+            else if (isprint ((unsigned char)*c))
+              fputc (*c, out);
+            else
+              fprintf (out, "\\x%02x", (unsigned char)*c);
+          fprintf (out, "\"");
+        }
+      fprintf (out, "\n");
+    }
+}
+
+void
+bc_fold (bc_prog *p)
+{
+  if (p->map)
+    munmap (p->map, p->map_size);
+  arfold (&p->ar);
+}
@@ -0,0 +1,145 @@
+#ifndef BC_H
+#define BC_H
+
+#include <stdio.h>
+
+#include "ir.h"
+
+/* Register bytecode.  Every instruction names up to three registers A, B
+   and C, or A and a 32-bit operand in B (low half) and C (high half).
+   Opcodes are typed: _I on integers and booleans, _F on reals. */
+enum bc_op
+{
+  BC_HALT = 0,
+  BC_MOV,   /* a = b */
+  BC_LOADI, /* a = (S32) bc */
+  BC_LOADK, /* a = consts[bc] */
+  BC_LOADS, /* a = strs + bc */
+  BC_ADD_I, /* a = b + c */
+  BC_SUB_I,
+  BC_MUL_I,
+  BC_DIV_I,
+  BC_MOD_I,
+  BC_ADDK_I, /* a = b + (S16) c */
+  BC_NEG_I,  /* a = -b */
+  BC_NOT,    /* a = !b */
+  BC_ADD_F,
+  BC_SUB_F,
+  BC_MUL_F,
+  BC_DIV_F,
+  BC_NEG_F,
+  BC_ITOF, /* a = (double) b */
+  BC_LT_I, /* a = b < c */
+  BC_LE_I,
+  BC_GT_I,
+  BC_GE_I,
+  BC_EQ_I,
+  BC_NE_I,
+  BC_LT_F,
+  BC_LE_F,
+  BC_GT_F,
+  BC_GE_F,
+  BC_EQ_F,
+  BC_NE_F,
+  BC_JMP, /* goto bc */
+  BC_JT,  /* if a goto bc */
+  BC_JF,  /* if !a goto bc */
+  BC_BLT_I, /* if a < b goto pc + (S16) c, compare and branch */
+  BC_BLE_I,
+  BC_BGT_I,
+  BC_BGE_I,
+  BC_BEQ_I,
+  BC_BNE_I,
+  BC_BLT_F,
+  BC_BLE_F,
+  BC_BGT_F,
+  BC_BGE_F,
+  BC_BEQ_F,
+  BC_BNE_F,
+  BC_WRITE_I, /* write a */
+  BC_WRITE_F,
+  BC_WRITE_S,
+  BC_WRITE_IW, /* write a in b columns */
+  BC_WRITE_FW,
+  BC_WRITE_FX, /* write a in b columns with c decimals */
+  BC_WRITE_SW,
+  BC_LEN_S, /* a = length (b) */
+  BC_CAT_S, /* a = b + c */
+  BC_DROP_S, /* a = b without its first c characters */
+  BC_TAKE_S, /* a = the first c characters of b */
+  BC_CMP_S, /* a = -1, 0 or 1 as b is below, equal to or above c */
+  BC_DUP_S, /* a = a copy of b */
+  BC_FREE_S, /* free a */
+  BC_APP_S, /* a = b + c, using up b */
+  BC_ARRAY, /* a = b zeroed elements */
+  BC_BOUNDS, /* report index a out of b elements and exit */
+  BC_LOAD,  /* a = b[c] */
+  BC_STORE, /* a[b] = c */
+  BC_OP_COUNT
+};
+
+/* What a register holds for the whole program.  Booleans are integers,
+   arrays point to their elements. */
+enum bc_kind
+{
+  BC_KIND_INT = 0,
+  BC_KIND_REAL,
+  BC_KIND_STR,
+  BC_KIND_ARRAY,
+  BC_KIND_COUNT
+};
+
+#define BC_MAX_REGS 0xffff
+
+typedef struct bc_insn
+{
+  U16 op;
+  U16 a, b, c;
+} bc_insn;
+
+/* The 32-bit operand of IN. */
+#define BC_WIDE(in) ((U32)(in)->b | (U32)(in)->c << 16)
+
+/* A program ready to run.  The arrays may live in the arena or point
+   into a mapped file. */
+typedef struct bc_prog
+{
+  arena ar;
+  const bc_insn *code;
+  U32 ncode;
+  const S64 *consts; /* Integers, and reals by their bits. */
+  U32 nconsts;
+  const char *strs; /* Literals as the runtime has them, each NUL
+                       terminated after a header of its length, see
+                       runtime/libpascal.h.  Escapes are resolved. */
+  U32 strs_size;
+  U32 nregs;
+  const U8 *kinds; /* enum bc_kind of each register. */
+  void *map; /* Mapped file the arrays point into, see pbc.h. */
+  U64 map_size;
+} bc_prog;
+
+/* Generate bytecode for FN, which must be out of SSA form.  IR vreg N
+   becomes register N.  Returns 1 on input the bytecode can't express. */
+int bc_gen (bc_prog *p, ir_func *fn);
+
+/* Check that every instruction of P is known, names registers below
+   nregs of the kinds its opcode works on, loads constants and strings
+   that exist, and only jumps inside the code, which must end in halt or
+   jmp.  The VM trusts all of this.  Array indexes are not checked: the
+   program does that itself with bounds instructions, so a program that
+   leaves them out, or reads an array register before setting it, can
+   still crash the VM.  Neither is that a string is freed once and not
+   used after.  Returns 1 with a message when P is malformed. */
+int bc_verify (const bc_prog *p);
+
+/* Mnemonic of OP. */
+const char *bc_op_name (U16 op);
+
+/* Print the program in textual form. */
+void bc_dump (bc_prog *p, FILE *out);
+
+/* Free the program, or unmap the file it was loaded from. */
+void bc_fold (bc_prog *p);
+
+#endif /* not BC_H */
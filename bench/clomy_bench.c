@@ -0,0 +1,361 @@
+/* Microbenchmarks for clomy.h containers.
+
+   Every case is run CLOMY_BENCH_REPEAT times and the fastest run is
+   reported, which keeps the numbers stable enough to compare two builds.
+
+   Usage: clomy_bench [--json] [FILTER]
+
+   Only cases whose name contains FILTER are run. */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define CLOMY_IMPLEMENTATION
+#include "../clomy.h"
+
+#ifndef CLOMY_BENCH_REPEAT
+#define CLOMY_BENCH_REPEAT 7
+#endif /* not CLOMY_BENCH_REPEAT */
+
+typedef struct
+{
+  const char *name;
+  U32 param;
+  /* Run the case once and return the number of operations performed. */
+  U64 (*run) (U32 param);
+} bench_case;
+
+/* Keeps results alive so the compiler can't drop the measured work. */
+static volatile U64 _sink;
+
+static double
+_now_ns (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+// [ Arena ] {{{
+static U64
+_bench_aralloc (U32 size)
+{
+  arena ar = { 0 };
+  U32 i;
+
+  for (i = 0; i < 5000; ++i)
+    _sink += (size_t)aralloc (&ar, size);
+
+  arfold (&ar);
+  return i;
+}
+
+static U64
+_bench_aralloc_arfree_lifo (U32 size)
+{
+  arena ar = { 0 };
+  void *ptrs[64];
+  U32 i, j;
+
+  for (i = 0; i < 2000; ++i)
+    {
+      for (j = 0; j < 64; ++j)
+        ptrs[j] = aralloc (&ar, size);
+      for (j = 64; j > 0; --j)
+        arfree (ptrs[j - 1]);
+    }
+
+  arfold (&ar);
+  return (U64)i * 64 * 2;
+}
+
+static U64
+_bench_aralloc_arfree_mixed (U32 count)
+{
+  static const U32 sizes[] = { 8, 24, 40, 120, 16, 300, 64, 1000 };
+  arena ar = { 0 };
+  void *ptrs[256] = { 0 };
+  U32 i, j;
+
+  for (i = 0; i < count; ++i)
+    ptrs[i % 256] = aralloc (&ar, sizes[i % 8]);
+
+  /* Free every other block, then refill the holes with different sizes. */
+  for (j = 0; j < 256 && j < count; j += 2)
+    arfree (ptrs[j]);
+  for (j = 0; j < 256 && j < count; j += 2)
+    ptrs[j] = aralloc (&ar, sizes[(j + 3) % 8]);
+
+  _sink += (size_t)ptrs[0];
+  arfold (&ar);
+  return count + (count < 256 ? count : 256);
+}
+// }}}
+// [ Dynamic array ] {{{
+static U64
+_bench_daappend (U32 n)
+{
+  arena ar = { 0 };
+  da arr = { 0 };
+  U32 i;
+
+  dainit (&arr, &ar, sizeof (U32), 8);
+  for (i = 0; i < n; ++i)
+    daappend (&arr, &i);
+
+  _sink += arr.size;
+  arfold (&ar);
+  return n;
+}
+
+static U64
+_bench_dapush (U32 n)
+{
+  arena ar = { 0 };
+  da arr = { 0 };
+  U32 i;
+
+  dainit (&arr, &ar, sizeof (U32), 8);
+  for (i = 0; i < n; ++i)
+    dapush (&arr, &i);
+
+  _sink += arr.size;
+  arfold (&ar);
+  return n;
+}
+
+static U64
+_bench_dapop (U32 n)
+{
+  arena ar = { 0 };
+  da arr = { 0 };
+  U32 i;
+
+  dainit (&arr, &ar, sizeof (U32), n);
+  for (i = 0; i < n; ++i)
+    daappend (&arr, &i);
+
+  for (i = 0; i < n; ++i)
+    _sink += *(U32 *)dapop (&arr);
+
+  arfold (&ar);
+  return (U64)n * 2;
+}
+
+static U64
+_bench_dainsert_mid (U32 n)
+{
+  arena ar = { 0 };
+  da arr = { 0 };
+  U32 i;
+
+  dainit (&arr, &ar, sizeof (U32), 8);
+  for (i = 0; i < n; ++i)
+    dainsert (&arr, &i, arr.size / 2);
+
+  _sink += arr.size;
+  arfold (&ar);
+  return n;
+}
+// }}}
+// [ Hash table ] {{{
+#define BENCH_HT_CAPACITY 256
+
+/* PARAM is the load factor in percent. */
+static U64
+_bench_htput_htget (U32 param)
+{
+  arena ar = { 0 };
+  ht table;
+  U32 i, n = BENCH_HT_CAPACITY * param / 100;
+
+  htinit (&table, &ar, BENCH_HT_CAPACITY, sizeof (U32));
+  for (i = 0; i < n; ++i)
+    htput (&table, (int)(i * 2654435761u), &i);
+  for (i = 0; i < n; ++i)
+    _sink += *(U32 *)htget (&table, (int)(i * 2654435761u));
+
+  arfold (&ar);
+  return (U64)n * 2;
+}
+
+static U64
+_bench_stput_stget (U32 param)
+{
+  arena ar = { 0 };
+  ht table;
+  char keys[BENCH_HT_CAPACITY * 4][16];
+  U32 i, n = BENCH_HT_CAPACITY * param / 100;
+
+  for (i = 0; i < n; ++i)
+    sprintf (keys[i], "ident_%u", i);
+
+  htinit (&table, &ar, BENCH_HT_CAPACITY, sizeof (U32));
+  for (i = 0; i < n; ++i)
+    stput (&table, keys[i], &i);
+  for (i = 0; i < n; ++i)
+    _sink += *(U32 *)stget (&table, keys[i]);
+
+  arfold (&ar);
+  return (U64)n * 2;
+}
+// }}}
+// [ String builder ] {{{
+/* PARAM is the length of the built string. */
+static U64
+_bench_sbappend (U32 param)
+{
+  arena ar = { 0 };
+  stringbuilder sb = { 0 };
+  U32 i, rounds = 50000 / param;
+
+  sbinit (&sb, &ar);
+  for (i = 0; i < rounds; ++i)
+    {
+      U32 len = 0;
+      while (len < param)
+        {
+          sbappend (&sb, "token ");
+          len += 6;
+        }
+      sbreset (&sb);
+    }
+
+  arfold (&ar);
+  return (U64)rounds * ((param + 5) / 6);
+}
+
+static U64
+_bench_sbappendch (U32 param)
+{
+  arena ar = { 0 };
+  stringbuilder sb = { 0 };
+  U32 i, j, rounds = 50000 / param;
+
+  sbinit (&sb, &ar);
+  for (i = 0; i < rounds; ++i)
+    {
+      for (j = 0; j < param; ++j)
+        sbappendch (&sb, 'a' + j % 26);
+      sbreset (&sb);
+    }
+
+  arfold (&ar);
+  return (U64)rounds * param;
+}
+
+static U64
+_bench_sbflush (U32 param)
+{
+  arena ar = { 0 };
+  stringbuilder sb = { 0 };
+  string *str;
+  char piece[65];
+  U32 i, j, rounds = 50000 / param + 1;
+
+  /* The builder is refilled from 64 byte pieces, a few appends next to a
+     flush touching every byte. */
+  for (j = 0; j < 64; ++j)
+    piece[j] = 'a' + j % 26;
+  piece[64] = '\0';
+
+  sbinit (&sb, &ar);
+  for (i = 0; i < rounds; ++i)
+    {
+      for (j = 0; j < param; j += 64)
+        sbappend (&sb, piece);
+      str = sbflush (&sb);
+      _sink += str->size;
+      arfree (str->data);
+      arfree (str);
+    }
+
+  arfold (&ar);
+  return rounds;
+}
+// }}}
+
+static const bench_case cases[] = {
+  { "aralloc", 16, _bench_aralloc },
+  { "aralloc", 256, _bench_aralloc },
+  { "aralloc_arfree_lifo", 32, _bench_aralloc_arfree_lifo },
+  { "aralloc_arfree_mixed", 2048, _bench_aralloc_arfree_mixed },
+  { "daappend", 100000, _bench_daappend },
+  { "dapush", 2000, _bench_dapush },
+  { "dapop", 2000, _bench_dapop },
+  { "dainsert_mid", 2000, _bench_dainsert_mid },
+  { "htput_htget_lf", 50, _bench_htput_htget },
+  { "htput_htget_lf", 100, _bench_htput_htget },
+  { "htput_htget_lf", 200, _bench_htput_htget },
+  { "htput_htget_lf", 400, _bench_htput_htget },
+  { "stput_stget_lf", 50, _bench_stput_stget },
+  { "stput_stget_lf", 100, _bench_stput_stget },
+  { "stput_stget_lf", 200, _bench_stput_stget },
+  { "stput_stget_lf", 400, _bench_stput_stget },
+  { "sbappend", 64, _bench_sbappend },
+  { "sbappend", 1024, _bench_sbappend },
+  { "sbappend", 8192, _bench_sbappend },
+  { "sbappendch", 64, _bench_sbappendch },
+  { "sbappendch", 8192, _bench_sbappendch },
+  { "sbflush", 64, _bench_sbflush },
+  { "sbflush", 1024, _bench_sbflush },
+  { "sbflush", 8192, _bench_sbflush },
+};
+
+int
+main (int argc, char **argv)
+{
+  const char *filter = NULL;
+  U8 json = 0, first = 1;
+  U32 i, r;
+  int a;
+
+  for (a = 1; a < argc; ++a)
+    {
+      if (strcmp (argv[a], "--json") == 0)
+        json = 1;
+      else
+        filter = argv[a];
+    }
+
+  if (json)
+    printf ("[\n");
+
+  for (i = 0; i < sizeof (cases) / sizeof (cases[0]); ++i)
+    {
+      double best = 0, start, ns;
+      U64 ops = 0;
+
+      if (filter && !strstr (cases[i].name, filter))
+        continue;
+
+      for (r = 0; r < CLOMY_BENCH_REPEAT; ++r)
+        {
+          start = _now_ns ();
+          ops = cases[i].run (cases[i].param);
+          ns = _now_ns () - start;
+          if (r == 0 || ns < best)
+            best = ns;
+        }
+
+      if (json)
+        printf ("%s  {\"name\": \"%s\", \"param\": %u, \"ops\": %llu, "
+                "\"ns_per_op\": %.2f}",
+                first ? "" : ",\n", cases[i].name, cases[i].param,
+                (unsigned long long)ops, best / ops);
+      else
+        printf ("%-24s %8u %12llu ops %10.2f ns/op\n", cases[i].name,
+                cases[i].param, (unsigned long long)ops, best / ops);
+      first = 0;
+    }
+
+  if (json)
+    printf ("\n]\n");
+
+  return 0;
+}
+
+// vim:fdm=marker:
@@ -0,0 +1,133 @@
+#include <errno.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "cc.h"
+
+extern char **environ;
+
+/* Split STR on whitespace and append the words to ARGV. */
+static int _split_args (arena *ar, const char *str, char **argv, int argc);
+
+int
+cc_spawn (cc_job *job, const char *lang, const char *output, U8 opt,
+          const char *runtime)
+{
+  posix_spawn_file_actions_t actions;
+  char *argv[CC_MAX_ARGS];
+  char optflag[4];
+  const char *env;
+  int argc = 0, fds[2], err;
+
+  env = getenv ("CC");
+  argc = _split_args (&job->ar, env && *env ? env : "cc", argv, argc);
+
+  snprintf (optflag, sizeof (optflag), "-O%d", opt > 3 ? 3 : opt);
+  argv[argc++] = optflag;
+
+  env = getenv ("CFLAGS");
+  if (env)
+    argc = _split_args (&job->ar, env, argv, argc);
+
+  if (argc + 9 > CC_MAX_ARGS)
+    {
+      fprintf (stderr, "Error: Too many CC/CFLAGS arguments.\n");
+      arfold (&job->ar);
+      return 1;
+    }
+
+  argv[argc++] = "-o";
+  argv[argc++] = (char *)output;
+  argv[argc++] = "-x";
+  argv[argc++] = (char *)lang;
+  argv[argc++] = "-";
+  if (runtime)
+    {
+      argv[argc++] = "-x";
+      argv[argc++] = "none";
+      argv[argc++] = (char *)runtime;
+    }
+  argv[argc] = NULL;
+
+  if (pipe (fds) < 0)
+    {
+      fprintf (stderr, "Error: Failed to create pipe.\n");
+      arfold (&job->ar);
+      return 1;
+    }
+
+  posix_spawn_file_actions_init (&actions);
+  posix_spawn_file_actions_adddup2 (&actions, fds[0], 0);
+  posix_spawn_file_actions_addclose (&actions, fds[0]);
+  posix_spawn_file_actions_addclose (&actions, fds[1]);
+
+  err = posix_spawnp (&job->pid, argv[0], &actions, NULL, argv, environ);
+  posix_spawn_file_actions_destroy (&actions);
+  close (fds[0]);
+
+  if (err)
+    {
+      fprintf (stderr, "Error: Failed to run \"%s\": %s\n", argv[0],
+               strerror (err));
+      close (fds[1]);
+      arfold (&job->ar);
+      return 1;
+    }
+
+  job->fd = fds[1];
+  return 0;
+}
+
+int
+cc_wait (cc_job *job)
+{
+  int status;
+
+  if (job->fd >= 0)
+    close (job->fd);
+  job->fd = -1;
+
+  while (waitpid (job->pid, &status, 0) < 0)
+    {
+      if (errno != EINTR)
+        {
+          arfold (&job->ar);
+          return 1;
+        }
+    }
+
+  arfold (&job->ar);
+
+  if (WIFEXITED (status))
+    return WEXITSTATUS (status);
+  return 1;
+}
+
+static int
+_split_args (arena *ar, const char *str, char **argv, int argc)
+{
+  const char *start;
+  U32 len;
+
+  while (*str && argc < CC_MAX_ARGS - 1)
+    {
+      while (*str == ' ' || *str == '\t' || *str == '\n')
+        ++str;
+      if (!*str)
+        break;
+
+      start = str;
+      while (*str && *str != ' ' && *str != '\t' && *str != '\n')
+        ++str;
+
+      len = str - start;
+      argv[argc] = aralloc (ar, len + 1);
+      memcpy (argv[argc], start, len);
+      argv[argc][len] = '\0';
+      ++argc;
+    }
+
+  return argc;
+}
@@ -0,0 +1,30 @@
+#ifndef CC_H
+#define CC_H
+
+#include <sys/types.h>
+
+#include "clomy.h"
+
+/* Most arguments passed to the C compiler, including CC and CFLAGS words. */
+#define CC_MAX_ARGS 128
+
+/* A running C compiler reading its input from FD. */
+typedef struct cc_job
+{
+  arena ar;
+  pid_t pid;
+  int fd;
+} cc_job;
+
+/* Start the C compiler ($CC, default "cc") on source in language LANG
+   ("c" or "assembler") to be written to JOB->fd.  The result is linked
+   with RUNTIME (may be NULL) into OUTPUT at optimization level OPT, with
+   $CFLAGS appended.  Returns 1 if the compiler could not be started. */
+int cc_spawn (cc_job *job, const char *lang, const char *output, U8 opt,
+              const char *runtime);
+
+/* Close the input pipe and wait for the compiler.  Returns its exit
+   status, or 1 if it did not exit normally. */
+int cc_wait (cc_job *job);
+
+#endif /* not CC_H */
@@ -8,6 +8,16 @@
      3. Hash table
      4. String builder
 
+   To count arena usage (see clomy_arstats_print):
+     #define CLOMY_ARENA_STATS
+
+   Threads:
+     Containers are not locked.  Each arena must be used by one thread at a
+     time; clomy_arthread returns an arena private to the calling thread and
+     clomy_arhandoff moves all chunks of one arena into another so results
+     can be passed to a different thread.  Hash tables draw their seed from a
+     thread-local generator and never touch the global rand() state.
+
    To use this library:
      #define CLOMY_IMPLEMENTATION
      #include "clomy.h"
@@ -35,6 +45,19 @@
 #define CLOMY_ALLOC_MAGIC 0x00636E6B
 #endif /* not CLOMY_ALLOC_MAGIC */
 
+#ifndef CLOMY_THREAD_LOCAL
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L                  \
+    && !defined(__STDC_NO_THREADS__)
+#define CLOMY_THREAD_LOCAL _Thread_local
+#elif defined(__GNUC__)
+#define CLOMY_THREAD_LOCAL __thread
+#else
+/* Without it the per-thread arena and seed would be shared by every
+   thread. */
+#error "clomy.h needs thread-local storage, define CLOMY_THREAD_LOCAL."
+#endif
+#endif /* not CLOMY_THREAD_LOCAL */
+
 #ifndef CLOMY_NULL
 #define CLOMY_NULL ((void *)0)
 #endif /* CLOMY_NULL */
@@ -71,6 +94,9 @@ struct clomy_archunk
   U32 capacity;
   clomy_arfree_block *free_list;
   struct clomy_archunk *next;
+#ifdef CLOMY_ARENA_STATS
+  struct clomy_arena *owner;
+#endif /* CLOMY_ARENA_STATS */
   U8 data[];
 };
 typedef struct clomy_archunk clomy_archunk;
@@ -83,9 +109,36 @@ struct clomy_aralloc_hdr
 };
 typedef struct clomy_aralloc_hdr clomy_aralloc_hdr;
 
+#ifdef CLOMY_ARENA_STATS
+/* Size classes are powers of two from 8 bytes up to 4 KiB, plus one class
+   for anything larger. */
+#define CLOMY_ARSTATS_CLASSES 11
+
+struct clomy_arstats
+{
+  U64 requested;
+  U64 reserved;
+  U64 overhead;
+  U64 in_use;
+  U64 peak;
+  U64 allocs;
+  U64 frees;
+  U32 chunks;
+  U32 size_class[CLOMY_ARSTATS_CLASSES];
+};
+typedef struct clomy_arstats clomy_arstats;
+
+#define CLOMY_ARSTAT(call) call
+#else
+#define CLOMY_ARSTAT(call)
+#endif /* CLOMY_ARENA_STATS */
+
 struct clomy_arena
 {
   clomy_archunk *head, *tail;
+#ifdef CLOMY_ARENA_STATS
+  clomy_arstats stats;
+#endif /* CLOMY_ARENA_STATS */
 };
 typedef struct clomy_arena clomy_arena;
 
@@ -112,6 +165,26 @@ void clomy_arfold (clomy_arena *ar);
 /* Print arena debug info. */
 void clomy_ardebug (clomy_arena *ar);
 
+/* Get the arena private to the calling thread. */
+clomy_arena *clomy_arthread (void);
+
+/* Free the arena private to the calling thread. */
+void clomy_arthread_fold (void);
+
+/* Move every chunk of SRC to the end of DST, leaving SRC empty. */
+void clomy_arhandoff (clomy_arena *dst, clomy_arena *src);
+
+#ifdef CLOMY_ARENA_STATS
+void _clomy_arstat_chunk (clomy_arena *ar, clomy_archunk *cnk);
+
+void _clomy_arstat_alloc (clomy_arena *ar, U32 requested, U32 used);
+
+void _clomy_arstat_free (clomy_arena *ar, U32 used);
+
+/* Print usage counters of arena labelled NAME to OUT. */
+void clomy_arstats_print (clomy_arena *ar, const char *name, FILE *out);
+#endif /* CLOMY_ARENA_STATS */
+
 /*----------------------------------------------------------------------*/
 
 struct clomy_da
@@ -189,6 +262,8 @@ struct clomy_ht
 };
 typedef struct clomy_ht clomy_ht;
 
+U32 _clomy_seed (void *salt);
+
 U32 _clomy_hash_int (clomy_ht *ht, U32 x);
 
 U32 _clomy_hash_str (clomy_ht *ht, char *x);
@@ -307,6 +382,10 @@ void clomy_sbfold (clomy_stringbuilder *sb);
 #define arfree clomy_arfree
 #define arfold clomy_arfold
 #define ardebug clomy_ardebug
+#define arthread clomy_arthread
+#define arthread_fold clomy_arthread_fold
+#define arhandoff clomy_arhandoff
+#define arstats_print clomy_arstats_print
 
 #define da clomy_da
 #define dainit clomy_dainit
@@ -365,6 +444,9 @@ _clomy_newarchunk (U32 size)
   cnk->capacity = size;
   cnk->next = CLOMY_NULL;
   cnk->free_list = CLOMY_NULL;
+#ifdef CLOMY_ARENA_STATS
+  cnk->owner = CLOMY_NULL;
+#endif /* CLOMY_ARENA_STATS */
 
   return cnk;
 }
@@ -442,6 +524,9 @@ clomy_aralloc (clomy_arena *ar, U32 size)
   clomy_arfree_block *free_blk, *prev_free, *rem;
   U32 cnk_size;
   const U32 hdr_size = CLOMY_ALIGN_UP (sizeof (clomy_aralloc_hdr), 8);
+#ifdef CLOMY_ARENA_STATS
+  const U32 requested = size;
+#endif /* CLOMY_ARENA_STATS */
 
   size = CLOMY_ALIGN_UP (size, 8);
 
@@ -453,6 +538,7 @@ clomy_aralloc (clomy_arena *ar, U32 size)
         return CLOMY_NULL;
 
       ar->tail = ar->head;
+      CLOMY_ARSTAT (_clomy_arstat_chunk (ar, ar->head));
     }
 
   /* Trying first-fit exising chunk. */
@@ -479,6 +565,7 @@ clomy_aralloc (clomy_arena *ar, U32 size)
           hdr->size = size;
           hdr->magic = CLOMY_ALLOC_MAGIC;
 
+          CLOMY_ARSTAT (_clomy_arstat_alloc (ar, requested, cnk_size));
           return (void *)((char *)hdr + hdr_size);
         }
 
@@ -490,15 +577,18 @@ clomy_aralloc (clomy_arena *ar, U32 size)
           hdr->magic = CLOMY_ALLOC_MAGIC;
 
           cnk->size += cnk_size;
+          CLOMY_ARSTAT (_clomy_arstat_alloc (ar, requested, cnk_size));
           return (void *)((char *)hdr + hdr_size);
         }
 
       cnk = cnk->next;
     }
 
-  /* Allocate new memory. */
-  cnk_size = cnk_size > CLOMY_ARENA_CAPACITY ? cnk_size : CLOMY_ARENA_CAPACITY;
-  cnk = _clomy_newarchunk (cnk_size);
+  /* Allocate new memory, the rest of the chunk is left for the next
+     allocations. */
+  cnk = _clomy_newarchunk (cnk_size > CLOMY_ARENA_CAPACITY
+                               ? cnk_size
+                               : CLOMY_ARENA_CAPACITY);
   if (!cnk)
     return CLOMY_NULL;
 
@@ -506,12 +596,14 @@ clomy_aralloc (clomy_arena *ar, U32 size)
 
   ar->tail->next = cnk;
   ar->tail = cnk;
+  CLOMY_ARSTAT (_clomy_arstat_chunk (ar, cnk));
 
   hdr = (clomy_aralloc_hdr *)cnk->data;
   hdr->cnk = cnk;
   hdr->size = size;
   hdr->magic = CLOMY_ALLOC_MAGIC;
 
+  CLOMY_ARSTAT (_clomy_arstat_alloc (ar, requested, cnk_size));
   return (void *)((char *)hdr + hdr_size);
 }
 
@@ -532,6 +624,7 @@ clomy_arfree (void *value)
 
   cnk = hdr->cnk;
   /* cnk->size -= hdr->size + hdr_size; */
+  CLOMY_ARSTAT (_clomy_arstat_free (cnk->owner, hdr->size + hdr_size));
 
   hdr->magic = 0;
 
@@ -586,12 +679,152 @@ clomy_ardebug (clomy_arena *ar)
   printf ("----------------------------------------\n");
 }
 
+static CLOMY_THREAD_LOCAL clomy_arena _clomy_thread_arena;
+
+clomy_arena *
+clomy_arthread (void)
+{
+  return &_clomy_thread_arena;
+}
+
+void
+clomy_arthread_fold (void)
+{
+  clomy_arfold (&_clomy_thread_arena);
+}
+
+void
+clomy_arhandoff (clomy_arena *dst, clomy_arena *src)
+{
+  if (!src->head || dst == src)
+    return;
+
+#ifdef CLOMY_ARENA_STATS
+  {
+    clomy_archunk *cnk;
+    U32 i;
+
+    for (cnk = src->head; cnk; cnk = cnk->next)
+      cnk->owner = dst;
+
+    dst->stats.requested += src->stats.requested;
+    dst->stats.reserved += src->stats.reserved;
+    dst->stats.overhead += src->stats.overhead;
+    dst->stats.in_use += src->stats.in_use;
+    dst->stats.allocs += src->stats.allocs;
+    dst->stats.frees += src->stats.frees;
+    dst->stats.chunks += src->stats.chunks;
+    if (dst->stats.in_use > dst->stats.peak)
+      dst->stats.peak = dst->stats.in_use;
+    for (i = 0; i < CLOMY_ARSTATS_CLASSES; ++i)
+      dst->stats.size_class[i] += src->stats.size_class[i];
+
+    memset (&src->stats, 0, sizeof (src->stats));
+  }
+#endif /* CLOMY_ARENA_STATS */
+
+  /* Chunks never move, so allocation headers pointing at them stay valid. */
+  if (dst->tail)
+    dst->tail->next = src->head;
+  else
+    dst->head = src->head;
+  dst->tail = src->tail;
+
+  src->head = CLOMY_NULL;
+  src->tail = CLOMY_NULL;
+}
+
+#ifdef CLOMY_ARENA_STATS
+void
+_clomy_arstat_chunk (clomy_arena *ar, clomy_archunk *cnk)
+{
+  cnk->owner = ar;
+  ar->stats.reserved += sizeof (clomy_archunk) + cnk->capacity;
+  ar->stats.overhead += sizeof (clomy_archunk);
+  ++ar->stats.chunks;
+}
+
+void
+_clomy_arstat_alloc (clomy_arena *ar, U32 requested, U32 used)
+{
+  U32 cls = 0, limit = 8;
+
+  while (limit < requested && cls < CLOMY_ARSTATS_CLASSES - 1)
+    {
+      limit <<= 1;
+      ++cls;
+    }
+
+  ar->stats.requested += requested;
+  ar->stats.overhead += used - requested;
+  ar->stats.in_use += used;
+  if (ar->stats.in_use > ar->stats.peak)
+    ar->stats.peak = ar->stats.in_use;
+  ++ar->stats.allocs;
+  ++ar->stats.size_class[cls];
+}
+
+void
+_clomy_arstat_free (clomy_arena *ar, U32 used)
+{
+  if (!ar)
+    return;
+
+  ar->stats.in_use -= used;
+  ++ar->stats.frees;
+}
+
+void
+clomy_arstats_print (clomy_arena *ar, const char *name, FILE *out)
+{
+  const clomy_arstats *st = &ar->stats;
+  clomy_archunk *cnk;
+  clomy_arfree_block *blk;
+  U64 free_blocks = 0, free_bytes = 0, tail_bytes = 0;
+  U32 i, limit = 8;
+
+  for (cnk = ar->head; cnk; cnk = cnk->next)
+    {
+      tail_bytes += cnk->capacity - cnk->size;
+      for (blk = cnk->free_list; blk; blk = blk->next)
+        {
+          ++free_blocks;
+          free_bytes += blk->size;
+        }
+    }
+
+  fprintf (out, "[arena %s]\n", name);
+  fprintf (out, "  requested  %llu\n", (unsigned long long)st->requested);
+  fprintf (out, "  reserved   %llu\n", (unsigned long long)st->reserved);
+  fprintf (out, "  overhead   %llu\n", (unsigned long long)st->overhead);
+  fprintf (out, "  in_use     %llu\n", (unsigned long long)st->in_use);
+  fprintf (out, "  peak       %llu\n", (unsigned long long)st->peak);
+  fprintf (out, "  allocs     %llu\n", (unsigned long long)st->allocs);
+  fprintf (out, "  frees      %llu\n", (unsigned long long)st->frees);
+  fprintf (out, "  chunks     %u\n", st->chunks);
+  fprintf (out, "  free_list  %llu blocks, %llu bytes\n",
+           (unsigned long long)free_blocks, (unsigned long long)free_bytes);
+  fprintf (out, "  unused     %llu\n", (unsigned long long)tail_bytes);
+
+  for (i = 0; i < CLOMY_ARSTATS_CLASSES; ++i, limit <<= 1)
+    {
+      if (!st->size_class[i])
+        continue;
+      if (i == CLOMY_ARSTATS_CLASSES - 1)
+        fprintf (out, "  size >%-5u %u\n", limit >> 1, st->size_class[i]);
+      else
+        fprintf (out, "  size <=%-4u %u\n", limit, st->size_class[i]);
+    }
+}
+#endif /* CLOMY_ARENA_STATS */
+
 /*----------------------------------------------------------------------*/
 
 int
 clomy_dainit (clomy_da *da, clomy_arena *ar, U32 data_size, U32 capacity)
 {
   da->ar = ar;
+  capacity = CLOMY_ALIGN_UP (capacity ? capacity : 1, 8);
 
   if (ar)
     da->data = clomy_aralloc (ar, data_size * capacity);
@@ -603,7 +836,7 @@ clomy_dainit (clomy_da *da, clomy_arena *ar, U32 data_size, U32 capacity)
 
   da->data_size = data_size;
   da->size = 0;
-  da->capacity = CLOMY_ALIGN_UP (capacity, 8);
+  da->capacity = capacity;
 
   return 0;
 }
@@ -740,6 +973,27 @@ clomy_dafold (clomy_da *da)
 
 /*----------------------------------------------------------------------*/
 
+static CLOMY_THREAD_LOCAL U64 _clomy_seed_state;
+
+U32
+_clomy_seed (void *salt)
+{
+  U64 z;
+
+  if (!_clomy_seed_state)
+    _clomy_seed_state = (U64)time (NULL) ^ (U64)clock ()
+                        ^ (U64)(size_t)&_clomy_seed_state;
+
+  /* splitmix64 step, salted with the caller's address. */
+  _clomy_seed_state += 0x9E3779B97F4A7C15ULL ^ (U64)(size_t)salt;
+  z = _clomy_seed_state;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  z ^= z >> 31;
+
+  return (U32)z | 1;
+}
+
 U32
 _clomy_hash_int (clomy_ht *ht, U32 x)
 {
@@ -767,8 +1021,7 @@ clomy_htinit (clomy_ht *ht, clomy_arena *ar, U32 capacity, U32 dsize)
   capacity = CLOMY_ALIGN_UP (capacity, 8);
   size = capacity * sizeof (clomy_htdata *);
 
-  srand ((unsigned)time (NULL));
-  ht->a = ((U32)rand () << 1) | 1;
+  ht->a = _clomy_seed (ht);
 
   ht->ar = ar;
   ht->data_size = dsize;
@@ -923,15 +1176,14 @@ clomy_htdel (clomy_ht *ht, int key)
         {
           if (prev)
             prev->next = ptr->next;
+          else
+            ht->data[i] = ptr->next;
 
           if (ht->ar)
             arfree (ptr);
           else
             free (ptr);
 
-          if (!prev)
-            ht->data[i] = ptr->next;
-
           --ht->size;
           break;
         }
@@ -955,6 +1207,8 @@ clomy_stdel (clomy_ht *ht, char *key)
         {
           if (prev)
             prev->next = ptr->next;
+          else
+            ht->data[i] = ptr->next;
 
           if (ht->ar)
             {
@@ -967,9 +1221,6 @@ clomy_stdel (clomy_ht *ht, char *key)
               free (ptr);
             }
 
-          if (!prev)
-            ht->data[i] = CLOMY_NULL;
-
           --ht->size;
           break;
         }
@@ -1072,6 +1323,7 @@ clomy_stringcpy (clomy_arena *ar, clomy_string *s)
 {
   string *str = clomy_aralloc (ar, sizeof (clomy_string));
   str->data = clomy_aralloc (ar, s->size + 1);
+  str->size = s->size;
   strcpy (str->data, s->data);
   return str;
 }
@@ -1199,7 +1451,7 @@ clomy_sbinsert (clomy_stringbuilder *sb, char *val, U32 i)
       if (!cnk)
         return 1;
 
-      strncpy (cnk->data, val, len);
+      memcpy (cnk->data, val, len);
       cnk->size = len;
       cnk->next = ptr->next;
 
@@ -1215,7 +1467,7 @@ clomy_sbinsert (clomy_stringbuilder *sb, char *val, U32 i)
       if (!cnk)
         return 1;
 
-      strncpy (cnk->data, &val[offset], len - offset);
+      memcpy (cnk->data, &val[offset], len - offset);
       cnk->size = len - offset;
       cnk->next = ptr->next;
       ptr->next = cnk;
@@ -1225,12 +1477,12 @@ clomy_sbinsert (clomy_stringbuilder *sb, char *val, U32 i)
       if (!cnk)
         return 1;
 
-      strncpy (cnk->data, &((char *)prev->data)[index], offset);
+      memcpy (cnk->data, &((char *)prev->data)[index], offset);
       cnk->size = offset;
       cnk->next = ptr->next;
       ptr->next = cnk;
 
-      strncpy (&((char *)prev->data)[index], val, offset);
+      memcpy (&((char *)prev->data)[index], val, offset);
       sb->size += len;
     }
 
@@ -1247,7 +1499,7 @@ clomy_sbpush (clomy_stringbuilder *sb, char *val)
   if (!cnk)
     return 1;
 
-  strncpy (cnk->data, val, len);
+  memcpy (cnk->data, val, len);
 
   cnk->size = len;
   cnk->next = sb->head;
@@ -1,19 +1,160 @@
 #include "clomy_test.h"
 #include "codegen.h"
+#include "utils.h"
 
 static void _ident_prefix (cg *ctx);
 static void _parse_exp (cg *ctx, ast_node *ptr);
 static void _cc_parse (cg *ctx, ast_node *ptr);
 static void _load_libpas (cg *ctx);
 
-string *
-codegen (cg *ctx, ast_node *root)
+/* Element of array index DATA, checked unless range.c proved it in
+   bounds. */
+static void _cc_index (cg *ctx, ast_data_index *data);
+
+/* Emit operator OP as spelled in C. */
+static void _put_op (cg *ctx, U8 op);
+
+/* C precedence of expression PTR, higher binds tighter. */
+static int _c_prec (ast_node *ptr);
+
+/* Emit operand PTR of an operator of precedence PREC, in parentheses
+   where C would group it otherwise.  RIGHT is set unless PTR is the
+   left operand. */
+static void _cc_operand (cg *ctx, ast_node *ptr, int prec, int right);
+
+/* Check if expression PTR is emitted starting with a minus sign, from a
+   negative literal or unary minus at the left end. */
+static int _leads_with_sign (ast_node *ptr);
+
+/* Emit string expression PTR as a const _P__str pointer. */
+static void _str_exp (cg *ctx, ast_node *ptr);
+
+/* Emit string literal LIT as a literal and its length. */
+static void _str_lit (cg *ctx, string *lit);
+
+/* Check if evaluating PTR makes string temporaries, which the statement
+   releases with _P__str_reset first. */
+static int _str_temps (ast_node *ptr);
+
+/* Emit assignment to a string variable.  s := s + x appends in place. */
+static void _cc_str_assign (cg *ctx, ast_data_var_assign *data);
+
+/* Emit the condition of an if or while. */
+static void _cc_cond (cg *ctx, ast_node *cond);
+
+/* Emit a FOR loop as a counted C loop over its control variable, the
+   initial and final values read once, in that order, into _P__from and
+   _P__to.  The test after the body stops on the final value without
+   stepping past it, so a final value of maxint does not overflow.  The
+   body cannot assign the variable, so cc sees the trip count and can
+   unroll and vectorize. */
+static void _cc_for (cg *ctx, ast_data_for *data);
+
+/* Where _cc_declare puts a variable. */
+enum cg_scope
+{
+  CG_FILE,   /* File scope, seen by the routines. */
+  CG_MAIN,   /* Local to main. */
+  CG_ROUTINE /* Local to a routine, zero on every call. */
+};
+
+/* Check if VAR is an array, not a string. */
+static int _is_array (ast_data_var_declare *var);
+
+/* Emit the C type of scalars of AST DATATYPE. */
+static void _put_type (cg *ctx, U16 datatype);
+
+/* Declare variable VAR in SCOPE. */
+static void _cc_declare (cg *ctx, ast_data_var_declare *var,
+                         enum cg_scope scope);
+
+/* Declare the program variables met so far in SCOPE. */
+static void _cc_declare_pending (cg *ctx, enum cg_scope scope);
+
+/* Emit routine DATA as a static C function.  var parameters are
+   pointers, string value parameters are copied on entry. */
+static void _cc_routine (cg *ctx, ast_data_routine *data);
+
+/* Check if any statement of PTR releases string temporaries. */
+static int _resets (ast_node *ptr);
+
+/* Emit a call of a declared routine, without the ;. */
+static void _cc_call (cg *ctx, ast_data_funcall *data);
+
+/* The value of a write argument, with or without a field width. */
+static ast_node *_write_value (ast_node *arg);
+
+/* Width of a string literal written with a constant one, folded into
+   the format as spaces.  0 for plain literals, -1 for anything else. */
+static long _write_literal (ast_node *arg);
+
+/* Append LEN bytes of TEXT after PAD spaces to FMT at N, % doubled.
+   Returns the new length. */
+static U32 _write_text (char *fmt, U32 n, const char *text, U32 len,
+                        long pad);
+
+/* Write a width or number of decimals into a format: the constant, or *
+   when it comes from an argument.  Returns the length. */
+static U32 _write_field (char *out, ast_node *field);
+
+/* The argument for FIELD when _write_field wrote a *. */
+static void _cc_write_field (cg *ctx, ast_node *field);
+
+/* Emit write/writeln as a single _P__p_write call, literals merged into
+   its format. */
+static void _cc_write (cg *ctx, ast_data_funcall *data, U8 ln);
+
+/* Longest constant width a string literal is padded to in the format,
+   wider ones are left to the runtime. */
+#define CG_MAX_PAD 256
+
+/* Bytes of known output codegen_output puts in each string literal. */
+#define CG_OUTPUT_LINE 64
+
+/* runtime/libpascal.c, embedded at build time. */
+extern const char libpas_src[];
+extern const U32 libpas_src_len;
+
+/* runtime/libpascal.h, the same. */
+extern const char libpas_hdr[];
+extern const U32 libpas_hdr_len;
+
+int
+codegen (cg *ctx, ast_node *root, sink *out)
 {
-  dainit (&ctx->var_declares, &ctx->ar, 32, sizeof (ast_node *));
-  sbinit (&ctx->sb, &ctx->ar);
+  ctx->out = out;
+  dainit (&ctx->var_declares, &ctx->ar, sizeof (ast_node *), 32);
   _load_libpas (ctx);
   _cc_parse (ctx, root);
-  return sbflush (&ctx->sb);
+  return out->failed;
+}
+
+int
+codegen_output (cg *ctx, string *text, sink *out)
+{
+  char *buf = aralloc (&ctx->ar, 4 * CG_OUTPUT_LINE);
+  U32 i, n;
+
+  /* The whole output goes out in a single write, looping only when it
+     comes back short. */
+  ctx->out = out;
+  sink_puts (out, "#include <unistd.h>\n"
+                  "static const char _P__out[]=\"\"\n");
+  for (i = 0; i < text->size; i += n)
+    {
+      n = text->size - i < CG_OUTPUT_LINE ? text->size - i : CG_OUTPUT_LINE;
+      sink_putch (out, '"');
+      sink_write (out, buf, escape (buf, text->data + i, n));
+      sink_puts (out, "\"\n");
+    }
+  sink_puts (out, ";\n"
+                  "int main(void){\n"
+                  "const char*p=_P__out;size_t n=sizeof(_P__out)-1;ssize_t w;\n"
+                  "while(n>0&&(w=write(1,p,n))>0){p+=w;n-=w;}\n"
+                  "return 0;\n"
+                  "}\n");
+  arfree (buf);
+  return out->failed;
 }
 
 void
@@ -26,45 +167,159 @@ codegen_fold (cg *ctx)
 void
 _ident_prefix (cg *ctx)
 {
-  sbappend (&ctx->sb, "_P");
+  sink_puts (ctx->out, "_P");
 }
 
 void
 _parse_exp (cg *ctx, ast_node *ptr)
 {
   char buf[32];
+  ast_data_var_declare *var;
   ast_data_op *op_data;
+  ast_data_funcall *fun_data;
+  int ref;
 
   switch (ptr->type)
     {
     case AST_VAR_DECLARE:
+      var = ptr->data;
+      /* var parameters are pointers, but arrays are already. */
+      ref = (var->flags & AST_VAR_REF) && !_is_array (var);
+      sink_puts (ctx->out, ref ? "(*" : "");
       _ident_prefix (ctx);
-      sbappend (&ctx->sb, ((ast_data_var_declare *)ptr->data)->name->data);
+      sink_puts (ctx->out, var->name->data);
+      sink_puts (ctx->out, ref ? ")" : "");
       break;
     case AST_STRLIT:
-      sbappendch (&ctx->sb, '"');
-      sbappend (&ctx->sb, ((string *)ptr->data)->data);
-      sbappendch (&ctx->sb, '"');
+      sink_putch (ctx->out, '"');
+      sink_puts (ctx->out, ((string *)ptr->data)->data);
+      sink_putch (ctx->out, '"');
       break;
     case AST_INTLIT:
       sprintf (buf, "%ld", *((long *)ptr->data));
-      sbappend (&ctx->sb, buf);
+      sink_puts (ctx->out, buf);
       break;
     case AST_BOOL:
       sprintf (buf, "%d", *((U16 *)ptr->data));
-      sbappend (&ctx->sb, buf);
+      sink_puts (ctx->out, buf);
       break;
     case AST_FLOATLIT:
-      sprintf (buf, "%f", *((double *)ptr->data));
-      sbappend (&ctx->sb, buf);
+      /* Enough digits to read back the same double, and still a double
+         constant when it has no fraction. */
+      sprintf (buf, "%.17g", *((double *)ptr->data));
+      if (!strpbrk (buf, ".e"))
+        strcat (buf, ".0");
+      sink_puts (ctx->out, buf);
       break;
     case AST_OP:
       op_data = ptr->data;
+      if (op_data->left && ast_is_compare (op_data->op)
+          && ast_exp_type (op_data->left) == AST_STRLIT)
+        {
+          sink_puts (ctx->out, "(_P__str_cmp(");
+          _str_exp (ctx, op_data->left);
+          sink_putch (ctx->out, ',');
+          _str_exp (ctx, op_data->right);
+          sink_putch (ctx->out, ')');
+          _put_op (ctx, op_data->op);
+          sink_puts (ctx->out, "0)");
+          break;
+        }
       if (op_data->left)
-        _parse_exp (ctx, op_data->left);
-      sbappendch (&ctx->sb, op_data->op);
-      if (op_data->right)
-        _parse_exp (ctx, op_data->right);
+        _cc_operand (ctx, op_data->left, _c_prec (ptr), 0);
+      _put_op (ctx, op_data->op);
+      if (op_data->op == AST_OP_SHL || op_data->op == AST_OP_SHR)
+        {
+          sprintf (buf, "%d", ast_log2 (op_data->right));
+          sink_puts (ctx->out, buf);
+          break;
+        }
+      if (op_data->op == AST_OP_AND)
+        {
+          sprintf (buf, "%ld",
+                   *(long *)((ast_node *)op_data->right)->data - 1);
+          sink_puts (ctx->out, buf);
+          break;
+        }
+      _cc_operand (ctx, op_data->right, _c_prec (ptr), 1);
+      break;
+    case AST_FUNCALL:
+      fun_data = ptr->data;
+      if (fun_data->routine)
+        {
+          _cc_call (ctx, fun_data);
+          break;
+        }
+      /* length, the only builtin with a number as its value. */
+      sink_puts (ctx->out, "(long)(");
+      _str_exp (ctx, fun_data->args_head);
+      sink_puts (ctx->out, ")->len");
+      break;
+    case AST_INDEX:
+      _cc_index (ctx, ptr->data);
+      break;
+    default:
+      CLOMY_FAIL ("Unreachable.");
+      break;
+    }
+}
+
+void
+_cc_index (cg *ctx, ast_data_index *data)
+{
+  char buf[32];
+
+  _parse_exp (ctx, data->var);
+  if (!data->check)
+    {
+      sink_puts (ctx->out, "[(");
+      _parse_exp (ctx, data->index);
+      sink_puts (ctx->out, ")]");
+      return;
+    }
+  sink_puts (ctx->out, "[_P__p_index(");
+  _parse_exp (ctx, data->index);
+  sprintf (buf, ",%ld)]",
+           (long)((ast_data_var_declare *)data->var->data)->arsize);
+  sink_puts (ctx->out, buf);
+}
+
+void
+_str_exp (cg *ctx, ast_node *ptr)
+{
+  ast_data_op *op_data;
+  ast_node *arg;
+
+  switch (ptr->type)
+    {
+    case AST_VAR_DECLARE:
+      sink_putch (ctx->out, '&');
+      _parse_exp (ctx, ptr);
+      break;
+    case AST_STRLIT:
+      sink_puts (ctx->out, "_P__str_lit(");
+      _str_lit (ctx, ptr->data);
+      sink_putch (ctx->out, ')');
+      break;
+    case AST_OP:
+      /* +, the only operator with a string as its value. */
+      op_data = ptr->data;
+      sink_puts (ctx->out, "_P__str_cat(");
+      _str_exp (ctx, op_data->left);
+      sink_putch (ctx->out, ',');
+      _str_exp (ctx, op_data->right);
+      sink_putch (ctx->out, ')');
+      break;
+    case AST_FUNCALL:
+      /* copy (s, index, count) */
+      arg = ((ast_data_funcall *)ptr->data)->args_head;
+      sink_puts (ctx->out, "_P__str_copy(");
+      _str_exp (ctx, arg);
+      sink_puts (ctx->out, ",(long)(");
+      _parse_exp (ctx, arg->next);
+      sink_puts (ctx->out, "),(long)(");
+      _parse_exp (ctx, arg->next->next);
+      sink_puts (ctx->out, "))");
       break;
     default:
       CLOMY_FAIL ("Unreachable.");
@@ -72,6 +327,149 @@ _parse_exp (cg *ctx, ast_node *ptr)
     }
 }
 
+void
+_str_lit (cg *ctx, string *lit)
+{
+  char *text = aralloc (&ctx->ar, lit->size + 1), buf[32];
+  U32 len = strnlen (text, unescape (text, lit->data, lit->size));
+
+  sink_putch (ctx->out, '"');
+  sink_puts (ctx->out, lit->data);
+  sprintf (buf, "\",%u", len);
+  sink_puts (ctx->out, buf);
+  arfree (text);
+}
+
+int
+_str_temps (ast_node *ptr)
+{
+  ast_data_op *op_data;
+  ast_data_funcall *fun_data;
+  ast_node *arg;
+
+  switch (ptr->type)
+    {
+    case AST_STRLIT:
+      return 1;
+    case AST_OP:
+      op_data = ptr->data;
+      if (op_data->op == '+' && ast_exp_type (ptr) == AST_STRLIT)
+        return 1;
+      return (op_data->left && _str_temps (op_data->left))
+             || _str_temps (op_data->right);
+    case AST_FUNCALL:
+      fun_data = ptr->data;
+      if (!fun_data->routine && !streq (fun_data->name->data, "length"))
+        return 1;
+      for (arg = fun_data->args_head; arg; arg = arg->next)
+        if (_str_temps (arg))
+          return 1;
+      return 0;
+    case AST_INDEX:
+      return _str_temps (((ast_data_index *)ptr->data)->index);
+    default:
+      return 0;
+    }
+}
+
+int
+_c_prec (ast_node *ptr)
+{
+  ast_data_op *op_data;
+
+  if (ptr->type != AST_OP)
+    return 15;
+  op_data = ptr->data;
+  if (!op_data->left)
+    return 14;
+  if (ast_is_compare (op_data->op)
+      && ast_exp_type (op_data->left) == AST_STRLIT)
+    return 15;
+  switch (op_data->op)
+    {
+    case '*':
+    case '/':
+    case '%':
+      return 13;
+    case '+':
+    case '-':
+      return 12;
+    case AST_OP_SHL:
+    case AST_OP_SHR:
+      return 11;
+    case '=':
+    case (U8)TOKEN_NEQ:
+      return 9;
+    case AST_OP_AND:
+      return 8;
+    default:
+      return 10;
+    }
+}
+
+void
+_cc_operand (cg *ctx, ast_node *ptr, int prec, int right)
+{
+  int wrap = _c_prec (ptr) < prec;
+
+  /* A right operand starting with a sign would paste into -- or ++. */
+  if (right)
+    wrap = wrap || _c_prec (ptr) <= prec || _c_prec (ptr) == 14
+           || _leads_with_sign (ptr);
+  if (wrap)
+    sink_putch (ctx->out, '(');
+  _parse_exp (ctx, ptr);
+  if (wrap)
+    sink_putch (ctx->out, ')');
+}
+
+int
+_leads_with_sign (ast_node *ptr)
+{
+  ast_data_op *op_data;
+
+  /* String compares start with a call. */
+  while (ptr->type == AST_OP && _c_prec (ptr) != 15)
+    {
+      op_data = ptr->data;
+      if (!op_data->left)
+        return op_data->op == '-';
+      ptr = op_data->left;
+    }
+  return (ptr->type == AST_INTLIT && *(long *)ptr->data < 0)
+         || (ptr->type == AST_FLOATLIT
+             && __builtin_signbit (*(double *)ptr->data));
+}
+
+void
+_put_op (cg *ctx, U8 op)
+{
+  switch (op)
+    {
+    case AST_OP_SHL:
+      sink_puts (ctx->out, "<<");
+      break;
+    case AST_OP_SHR:
+      sink_puts (ctx->out, ">>");
+      break;
+    case '=':
+      sink_puts (ctx->out, "==");
+      break;
+    case (U8)TOKEN_NEQ:
+      sink_puts (ctx->out, "!=");
+      break;
+    case (U8)TOKEN_LEQ:
+      sink_puts (ctx->out, "<=");
+      break;
+    case (U8)TOKEN_GEQ:
+      sink_puts (ctx->out, ">=");
+      break;
+    default:
+      sink_putch (ctx->out, op);
+      break;
+    }
+}
+
 void
 _cc_parse (cg *ctx, ast_node *ptr)
 {
@@ -82,7 +480,6 @@ _cc_parse (cg *ctx, ast_node *ptr)
   ast_data_block *blk_data;
   ast_data_while *while_data;
   ast_data_funcall *fun_data;
-  char buf[32];
   int i;
 
   while (ptr)
@@ -93,167 +490,111 @@ _cc_parse (cg *ctx, ast_node *ptr)
           break;
         case AST_WHILE:
           while_data = ptr->data;
-          sbappend (&ctx->sb, "while(");
-          _parse_exp (ctx, while_data->cond);
-          sbappendch (&ctx->sb, ')');
+          sink_puts (ctx->out, "while");
+          _cc_cond (ctx, while_data->cond);
           if (while_data->next)
             _cc_parse (ctx, while_data->next);
           break;
+        case AST_FOR:
+          _cc_for (ctx, ptr->data);
+          break;
         case AST_COND:
           cond_data = ptr->data;
-          sbappend (&ctx->sb, "if(");
-          _parse_exp (ctx, cond_data->cond);
-          sbappendch (&ctx->sb, ')');
+          sink_puts (ctx->out, "if");
+          _cc_cond (ctx, cond_data->cond);
           if (cond_data->yes)
             _cc_parse (ctx, cond_data->yes);
           if (cond_data->no)
             {
-              sbappend (&ctx->sb, "else ");
+              sink_puts (ctx->out, "else ");
               _cc_parse (ctx, cond_data->no);
             }
           break;
         case AST_BLOCK:
           blk_data = ptr->data;
-          sbappend (&ctx->sb, "{\n");
+          sink_puts (ctx->out, "{\n");
           _cc_parse (ctx, blk_data->next);
-          sbappend (&ctx->sb, "\n}");
+          sink_puts (ctx->out, "\n}");
           break;
         case AST_MAIN_BLOCK:
           blk_data = ptr->data;
-          sbappend (&ctx->sb, "int main() {\n");
-
-          for (i = ctx->var_declares.size - 1; i >= 0; --i)
-            {
-              arg = *(ast_node **)dageti (&ctx->var_declares, i);
-              var = arg->data;
-
-              switch (var->datatype)
-                {
-                case AST_INTLIT:
-                  sbappend (&ctx->sb, "long");
-                  break;
-                case AST_FLOATLIT:
-                  sbappend (&ctx->sb, "double");
-                  break;
-                case AST_STRLIT:
-                  sbappend (&ctx->sb, "char");
-                  break;
-                case AST_BOOL:
-                  sbappend (&ctx->sb, "unsigned int");
-                  break;
-                default:
-                  continue;
-                }
-
-              sbappendch (&ctx->sb, ' ');
-              _ident_prefix (ctx);
-              sbappend (&ctx->sb, var->name->data);
-              if (var->arsize > 0)
-                {
-                  sprintf (buf, "%ld", var->arsize);
-                  sbappendch (&ctx->sb, '[');
-                  sbappend (&ctx->sb, buf);
-                  sbappendch (&ctx->sb, ']');
-                }
-
-              sbappend (&ctx->sb, ";\n");
-            }
-
+          sink_puts (ctx->out, "int main() {\n");
+          _cc_declare_pending (ctx, CG_MAIN);
           _cc_parse (ctx, blk_data->next);
-          sbappend (&ctx->sb, "return 0;\n");
-          sbappend (&ctx->sb, "}\n");
+          sink_puts (ctx->out, "return 0;\n");
+          sink_puts (ctx->out, "}\n");
           break;
         case AST_VAR_DECLARE:
           dapush (&ctx->var_declares, &ptr);
           break;
+        case AST_ROUTINE:
+          /* Routines see the variables declared before them. */
+          _cc_declare_pending (ctx, CG_FILE);
+          _cc_routine (ctx, ptr->data);
+          break;
         case AST_VAR_ASSIGN:
           va_data = ptr->data;
           var = va_data->var->data;
 
           if (var->datatype == AST_STRLIT)
             {
-              sbappend (&ctx->sb, "strcpy(");
-              _ident_prefix (ctx);
-              sbappend (&ctx->sb, var->name->data);
-              sbappendch (&ctx->sb, ',');
-              _parse_exp (ctx, va_data->value);
-              sbappend (&ctx->sb, ");\n");
+              _cc_str_assign (ctx, va_data);
             }
           else
             {
-              _ident_prefix (ctx);
-              sbappend (&ctx->sb, var->name->data);
-              sbappendch (&ctx->sb, '=');
+              i = _str_temps (va_data->value)
+                  || (va_data->index && _str_temps (va_data->index));
+              if (i)
+                sink_puts (ctx->out, "{_P__str_reset();\n");
+              if (va_data->index)
+                _cc_index (ctx, va_data->index->data);
+              else
+                _parse_exp (ctx, va_data->var);
+              sink_putch (ctx->out, '=');
               _parse_exp (ctx, va_data->value);
-              sbappend (&ctx->sb, ";\n");
+              sink_puts (ctx->out, ";\n");
+              if (i)
+                sink_puts (ctx->out, "}\n");
             }
 
           break;
         case AST_FUNCALL:
           fun_data = ptr->data;
 
-          /* Handle writeln */
-          int is_writeln = strcmp (fun_data->name->data, "writeln");
-          int is_write = strcmp (fun_data->name->data, "write");
-
-          if (is_writeln == 0 || is_write == 0)
+          if (streq (fun_data->name->data, "writeln"))
             {
-              sbappend (&ctx->sb, "{\n");
-              arg = fun_data->args_head;
-              while (arg)
-                {
-                  _ident_prefix (ctx);
-
-                  int dtype = arg->type;
-                  if (dtype == AST_VAR_DECLARE)
-                    {
-                      dtype = ((ast_data_var_declare *)arg->data)->datatype;
-                    }
-
-                  switch (dtype)
-                    {
-                    case AST_STRLIT:
-                      sbappend (&ctx->sb, "__p_write_str(");
-                      break;
-                    case AST_INTLIT:
-                      sbappend (&ctx->sb, "__p_write_int(");
-                      break;
-                    case AST_FLOATLIT:
-                      sbappend (&ctx->sb, "__p_write_real(");
-                      break;
-                    default:
-                      printf ("[INFO] arg->type=%d\n", arg->type);
-                      CLOMY_FAIL ("Unreachable.");
-                      break;
-                    }
-
-                  _parse_exp (ctx, arg);
-                  sbappend (&ctx->sb, ");\n");
-
-                  arg = arg->next;
-                }
-
-              if (is_writeln == 0)
-                {
-                  _ident_prefix (ctx);
-                  sbappend (&ctx->sb, "__p_write_str(\"\\n\");\n");
-                }
-              sbappend (&ctx->sb, "}\n");
+              _cc_write (ctx, fun_data, 1);
+            }
+          else if (streq (fun_data->name->data, "write"))
+            {
+              _cc_write (ctx, fun_data, 0);
+            }
+          else if (fun_data->routine)
+            {
+              for (i = 0, arg = fun_data->args_head; arg && !i;
+                   arg = arg->next)
+                i = _str_temps (arg);
+              if (i)
+                sink_puts (ctx->out, "{_P__str_reset();\n");
+              _cc_call (ctx, fun_data);
+              sink_puts (ctx->out, ";\n");
+              if (i)
+                sink_puts (ctx->out, "}\n");
             }
           else
             {
               _ident_prefix (ctx);
-              sbappend (&ctx->sb, fun_data->name->data);
-              sbappendch (&ctx->sb, '(');
+              sink_puts (ctx->out, fun_data->name->data);
+              sink_putch (ctx->out, '(');
               arg = fun_data->args_head;
               while (arg)
                 {
                   _parse_exp (ctx, arg);
                   if (arg->next)
-                    sbappendch (&ctx->sb, ',');
+                    sink_putch (ctx->out, ',');
                   arg = arg->next;
                 }
-              sbappend (&ctx->sb, ");\n");
+              sink_puts (ctx->out, ");\n");
             }
           break;
         default:
@@ -266,20 +607,537 @@ _cc_parse (cg *ctx, ast_node *ptr)
 }
 
 void
-_load_libpas (cg *ctx)
+_cc_str_assign (cg *ctx, ast_data_var_assign *data)
+{
+  ast_node *value = data->value;
+  ast_data_op *op_data;
+  const char *fn = "_P__str_assign(&";
+  int reset;
+
+  if (value->type == AST_STRLIT)
+    {
+      sink_puts (ctx->out, "_P__str_set(&");
+      _parse_exp (ctx, data->var);
+      sink_putch (ctx->out, ',');
+      _str_lit (ctx, value->data);
+      sink_puts (ctx->out, ");\n");
+      return;
+    }
+
+  op_data = value->type == AST_OP ? value->data : NULL;
+  if (op_data && op_data->op == '+' && op_data->left
+      && ((ast_node *)op_data->left)->type == AST_VAR_DECLARE
+      && ((ast_node *)op_data->left)->data == data->var->data)
+    {
+      fn = "_P__str_append(&";
+      value = op_data->right;
+    }
+
+  if ((reset = _str_temps (value)))
+    sink_puts (ctx->out, "{_P__str_reset();\n");
+  sink_puts (ctx->out, fn);
+  _parse_exp (ctx, data->var);
+  sink_putch (ctx->out, ',');
+  _str_exp (ctx, value);
+  sink_puts (ctx->out, ");\n");
+  if (reset)
+    sink_puts (ctx->out, "}\n");
+}
+
+void
+_cc_cond (cg *ctx, ast_node *cond)
+{
+  int reset = _str_temps (cond);
+
+  sink_puts (ctx->out, reset ? "((_P__str_reset()," : "(");
+  _parse_exp (ctx, cond);
+  sink_puts (ctx->out, reset ? "))" : ")");
+}
+
+void
+_cc_for (cg *ctx, ast_data_for *data)
+{
+  int reset = _str_temps (data->from) || _str_temps (data->to);
+
+  sink_puts (ctx->out, reset ? "{_P__str_reset();\nlong _P__from="
+                             : "{long _P__from=");
+  _parse_exp (ctx, data->from);
+  sink_puts (ctx->out, ";\nlong _P__to=");
+  _parse_exp (ctx, data->to);
+  sink_puts (ctx->out, data->down ? ";\nif(_P__from>=_P__to){\n"
+                                  : ";\nif(_P__from<=_P__to){\n");
+  if (ctx->flags & CG_FLAG_UNROLL)
+    sink_puts (ctx->out, "#pragma GCC unroll 4\n");
+  sink_puts (ctx->out, "for(");
+  _parse_exp (ctx, data->var);
+  sink_puts (ctx->out, "=_P__from;1;");
+  sink_puts (ctx->out, data->down ? "--" : "++");
+  _parse_exp (ctx, data->var);
+  sink_puts (ctx->out, "){\n");
+  _cc_parse (ctx, data->body);
+  sink_puts (ctx->out, "if(");
+  _parse_exp (ctx, data->var);
+  sink_puts (ctx->out, data->down ? "<=_P__to)break;}}}\n"
+                                  : ">=_P__to)break;}}}\n");
+}
+
+int
+_is_array (ast_data_var_declare *var)
+{
+  return var->arsize > 0 && var->datatype != AST_STRLIT;
+}
+
+void
+_put_type (cg *ctx, U16 datatype)
+{
+  switch (datatype)
+    {
+    case AST_INTLIT:
+      sink_puts (ctx->out, "long");
+      break;
+    case AST_FLOATLIT:
+      sink_puts (ctx->out, "double");
+      break;
+    case AST_BOOL:
+      sink_puts (ctx->out, "unsigned int");
+      break;
+    default:
+      CLOMY_FAIL ("Unreachable.");
+      break;
+    }
+}
+
+void
+_cc_declare (cg *ctx, ast_data_var_declare *var, enum cg_scope scope)
 {
-  FILE *file;
-  char ch;
+  char buf[32];
+
+  /* Arrays start out zeroed, like the other backends. */
+  if (scope == CG_FILE || (scope == CG_MAIN && _is_array (var)))
+    sink_puts (ctx->out, "static ");
 
-  file = fopen ("runtime/libpascal.c", "r");
-  if (!file)
+  if (var->datatype == AST_STRLIT)
     {
-      fprintf (stderr, "Error: Failed to open libpascal.\n");
+      /* Strings grow as needed, whatever size was declared. */
+      sink_puts (ctx->out, "_P__str ");
+      _ident_prefix (ctx);
+      sink_puts (ctx->out, var->name->data);
+      sink_puts (ctx->out, "={0};\n");
       return;
     }
 
-  while ((ch = fgetc (file)) != EOF)
-    sbappendch (&ctx->sb, ch);
+  _put_type (ctx, var->datatype);
+  sink_putch (ctx->out, ' ');
+  _ident_prefix (ctx);
+  sink_puts (ctx->out, var->name->data);
+  if (_is_array (var))
+    {
+      sprintf (buf, "[%ld]", var->arsize);
+      sink_puts (ctx->out, buf);
+    }
+  else if (scope != CG_FILE)
+    {
+      /* Every variable starts out as zero, statics already are. */
+      sink_puts (ctx->out, "=0");
+    }
+  sink_puts (ctx->out, ";\n");
+}
+
+void
+_cc_declare_pending (cg *ctx, enum cg_scope scope)
+{
+  ast_node *node;
+  U32 i;
+
+  /* The last one met is first. */
+  for (i = ctx->var_declares.size; i > 0; --i)
+    {
+      node = *(ast_node **)dageti (&ctx->var_declares, i - 1);
+      _cc_declare (ctx, node->data, scope);
+    }
+  ctx->var_declares.size = 0;
+}
+
+void
+_cc_routine (cg *ctx, ast_data_routine *data)
+{
+  ast_data_var_declare *var;
+  ast_node *p;
+  int scope = _resets (data->body);
+
+  sink_puts (ctx->out, "static ");
+  if (data->result)
+    _put_type (ctx, ((ast_data_var_declare *)data->result->data)->datatype);
+  else
+    sink_puts (ctx->out, "void");
+  sink_putch (ctx->out, ' ');
+  _ident_prefix (ctx);
+  sink_puts (ctx->out, data->name->data);
+  sink_putch (ctx->out, '(');
+  if (!data->params)
+    sink_puts (ctx->out, "void");
+  for (p = data->params; p; p = p->next)
+    {
+      var = p->data;
+      if (var->datatype == AST_STRLIT)
+        sink_puts (ctx->out, (var->flags & AST_VAR_REF)
+                                 ? "_P__str *_P"
+                                 : "const _P__str *_P__arg_");
+      else
+        {
+          _put_type (ctx, var->datatype);
+          sink_puts (ctx->out, (var->flags & AST_VAR_REF) ? " *_P" : " _P");
+        }
+      sink_puts (ctx->out, var->name->data);
+      if (p->next)
+        sink_putch (ctx->out, ',');
+    }
+  sink_puts (ctx->out, "){\n");
+
+  if (data->result)
+    _cc_declare (ctx, data->result->data, CG_ROUTINE);
+  for (p = data->params; p; p = p->next)
+    {
+      var = p->data;
+      if (var->datatype != AST_STRLIT || (var->flags & AST_VAR_REF))
+        continue;
+      _cc_declare (ctx, var, CG_ROUTINE);
+      sink_puts (ctx->out, "_P__str_assign(&_P");
+      sink_puts (ctx->out, var->name->data);
+      sink_puts (ctx->out, ",_P__arg_");
+      sink_puts (ctx->out, var->name->data);
+      sink_puts (ctx->out, ");\n");
+    }
+  for (p = data->locals; p; p = p->next)
+    _cc_declare (ctx, p->data, CG_ROUTINE);
+
+  /* Keep the string temporaries of the callers. */
+  if (scope)
+    sink_puts (ctx->out, "_P__str_scope _P__scope;\n"
+                         "_P__str_enter(&_P__scope);\n");
+
+  _cc_parse (ctx, ((ast_data_block *)data->body->data)->next);
+
+  if (scope)
+    sink_puts (ctx->out, "_P__str_leave(&_P__scope);\n");
+
+  /* Free the buffers of the strings of this call. */
+  for (p = data->params; p; p = p->next)
+    {
+      var = p->data;
+      if (var->datatype == AST_STRLIT && !(var->flags & AST_VAR_REF))
+        {
+          sink_puts (ctx->out, "_P__str_set(&_P");
+          sink_puts (ctx->out, var->name->data);
+          sink_puts (ctx->out, ",\"\",0);\n");
+        }
+    }
+  for (p = data->locals; p; p = p->next)
+    {
+      var = p->data;
+      if (var->datatype == AST_STRLIT)
+        {
+          sink_puts (ctx->out, "_P__str_set(&_P");
+          sink_puts (ctx->out, var->name->data);
+          sink_puts (ctx->out, ",\"\",0);\n");
+        }
+    }
+
+  if (data->result)
+    sink_puts (ctx->out, "return _P__result;\n");
+  sink_puts (ctx->out, "}\n");
+}
+
+int
+_resets (ast_node *ptr)
+{
+  ast_data_var_assign *va_data;
+  ast_data_cond *cond_data;
+  ast_data_for *for_data;
+  ast_data_write_arg *wa;
+  ast_node *arg;
 
-  fclose (file);
+  for (; ptr; ptr = ptr->next)
+    {
+      switch (ptr->type)
+        {
+        case AST_BLOCK:
+          if (_resets (((ast_data_block *)ptr->data)->next))
+            return 1;
+          break;
+        case AST_VAR_ASSIGN:
+          va_data = ptr->data;
+          if (_str_temps (va_data->value)
+              || (va_data->index && _str_temps (va_data->index)))
+            return 1;
+          break;
+        case AST_COND:
+          cond_data = ptr->data;
+          if (_str_temps (cond_data->cond) || _resets (cond_data->yes)
+              || _resets (cond_data->no))
+            return 1;
+          break;
+        case AST_WHILE:
+          if (_str_temps (((ast_data_while *)ptr->data)->cond)
+              || _resets (((ast_data_while *)ptr->data)->next))
+            return 1;
+          break;
+        case AST_FOR:
+          for_data = ptr->data;
+          if (_str_temps (for_data->from) || _str_temps (for_data->to)
+              || _resets (for_data->body))
+            return 1;
+          break;
+        case AST_FUNCALL:
+          for (arg = ((ast_data_funcall *)ptr->data)->args_head; arg;
+               arg = arg->next)
+            {
+              if (arg->type != AST_WRITE_ARG)
+                {
+                  if (_str_temps (arg))
+                    return 1;
+                  continue;
+                }
+              wa = arg->data;
+              if (_str_temps (wa->value) || _str_temps (wa->width)
+                  || (wa->decimals && _str_temps (wa->decimals)))
+                return 1;
+            }
+          break;
+        default:
+          break;
+        }
+    }
+  return 0;
+}
+
+void
+_cc_call (cg *ctx, ast_data_funcall *data)
+{
+  ast_data_var_declare *param;
+  ast_node *arg, *p;
+
+  _ident_prefix (ctx);
+  sink_puts (ctx->out, data->name->data);
+  sink_putch (ctx->out, '(');
+  p = ((ast_data_routine *)data->routine->data)->params;
+  for (arg = data->args_head; arg; arg = arg->next, p = p->next)
+    {
+      param = p->data;
+      if (!(param->flags & AST_VAR_REF) && param->datatype == AST_STRLIT)
+        _str_exp (ctx, arg);
+      else
+        {
+          if ((param->flags & AST_VAR_REF) && !_is_array (param))
+            sink_putch (ctx->out, '&');
+          _parse_exp (ctx, arg);
+        }
+      if (arg->next)
+        sink_putch (ctx->out, ',');
+    }
+  sink_putch (ctx->out, ')');
+}
+
+void
+_cc_write (cg *ctx, ast_data_funcall *data, U8 ln)
+{
+  ast_node *arg, *value;
+  ast_data_write_arg *wa;
+  char *fmt, *text, buf[32];
+  long width;
+  U32 size = ln + 1, n = 0, len;
+  int reset = 0;
+
+  for (arg = data->args_head; arg; arg = arg->next)
+    {
+      value = _write_value (arg);
+      size += value->type == AST_STRLIT ? 2 * ((string *)value->data)->size
+                                        : 2;
+      if (arg->type == AST_WRITE_ARG)
+        size += _write_literal (arg) > 0 ? (U32)_write_literal (arg)
+                                         : 2 * sizeof (buf);
+      if (_write_literal (arg) < 0)
+        {
+          wa = arg->type == AST_WRITE_ARG ? arg->data : NULL;
+          reset |= (value->type != AST_STRLIT && _str_temps (value))
+                   || (wa && _str_temps (wa->width))
+                   || (wa && wa->decimals && _str_temps (wa->decimals));
+        }
+    }
+  fmt = aralloc (&ctx->ar, size);
+
+  /* Literal text with % doubled, and %i, %r or %s for each value.  Widths
+     known here are written into the format and padded literals become
+     text, the rest are taken from arguments with *. */
+  for (arg = data->args_head; arg; arg = arg->next)
+    {
+      value = _write_value (arg);
+      if ((width = _write_literal (arg)) >= 0)
+        {
+          text = fmt + n + width + ((string *)value->data)->size;
+          len = unescape (text, ((string *)value->data)->data,
+                          ((string *)value->data)->size);
+          len = strnlen (text, len);
+          n = _write_text (fmt, n, text, len, width - (long)len);
+          continue;
+        }
+
+      fmt[n++] = '%';
+      if (arg->type == AST_WRITE_ARG)
+        {
+          wa = arg->data;
+          n += _write_field (fmt + n, wa->width);
+          if (wa->decimals && ast_exp_type (value) == AST_FLOATLIT)
+            {
+              fmt[n++] = '.';
+              n += _write_field (fmt + n, wa->decimals);
+            }
+        }
+      switch (ast_exp_type (value))
+        {
+        case AST_INTLIT:
+        case AST_BOOL:
+          fmt[n++] = 'i';
+          break;
+        case AST_FLOATLIT:
+          fmt[n++] = 'r';
+          break;
+        case AST_STRLIT:
+          fmt[n++] = value->type == AST_STRLIT ? 's' : 'S';
+          break;
+        default:
+          printf ("[INFO] arg->type=%d\n", value->type);
+          CLOMY_FAIL ("Unreachable.");
+          break;
+        }
+    }
+  if (ln)
+    fmt[n++] = '\n';
+
+  if (n == 0)
+    {
+      arfree (fmt);
+      return;
+    }
+
+  text = aralloc (&ctx->ar, 4 * n);
+  if (reset)
+    sink_puts (ctx->out, "{_P__str_reset();\n");
+  _ident_prefix (ctx);
+  sink_puts (ctx->out, "__p_write(\"");
+  sink_write (ctx->out, text, escape (text, fmt, n));
+  sprintf (buf, "\",%u", n);
+  sink_puts (ctx->out, buf);
+
+  for (arg = data->args_head; arg; arg = arg->next)
+    {
+      value = _write_value (arg);
+      if (_write_literal (arg) >= 0)
+        continue;
+      if (arg->type == AST_WRITE_ARG)
+        {
+          wa = arg->data;
+          _cc_write_field (ctx, wa->width);
+          if (wa->decimals && ast_exp_type (value) == AST_FLOATLIT)
+            _cc_write_field (ctx, wa->decimals);
+        }
+      switch (ast_exp_type (value))
+        {
+        case AST_INTLIT:
+        case AST_BOOL:
+          sink_puts (ctx->out, ",(long)(");
+          break;
+        case AST_FLOATLIT:
+          sink_puts (ctx->out, ",(double)(");
+          break;
+        default:
+          sink_putch (ctx->out, ',');
+          if (value->type != AST_STRLIT)
+            {
+              _str_exp (ctx, value);
+              continue;
+            }
+          sink_putch (ctx->out, '(');
+          break;
+        }
+      _parse_exp (ctx, value);
+      sink_putch (ctx->out, ')');
+    }
+  sink_puts (ctx->out, ");\n");
+  if (reset)
+    sink_puts (ctx->out, "}\n");
+
+  arfree (text);
+  arfree (fmt);
+}
+
+U32
+_write_text (char *fmt, U32 n, const char *text, U32 len, long pad)
+{
+  U32 i;
+
+  for (; pad > 0; --pad)
+    fmt[n++] = ' ';
+  for (i = 0; i < len; ++i)
+    {
+      if (text[i] == '%')
+        fmt[n++] = '%';
+      fmt[n++] = text[i];
+    }
+  return n;
+}
+
+U32
+_write_field (char *out, ast_node *field)
+{
+  if (field->type != AST_INTLIT || *(long *)field->data < 0)
+    {
+      *out = '*';
+      return 1;
+    }
+  return sprintf (out, "%ld", *(long *)field->data);
+}
+
+void
+_cc_write_field (cg *ctx, ast_node *field)
+{
+  if (field->type == AST_INTLIT && *(long *)field->data >= 0)
+    return;
+  sink_puts (ctx->out, ",(long)(");
+  _parse_exp (ctx, field);
+  sink_putch (ctx->out, ')');
+}
+
+ast_node *
+_write_value (ast_node *arg)
+{
+  if (arg->type == AST_WRITE_ARG)
+    return ((ast_data_write_arg *)arg->data)->value;
+  return arg;
+}
+
+long
+_write_literal (ast_node *arg)
+{
+  ast_data_write_arg *wa;
+  long width;
+
+  if (arg->type == AST_STRLIT)
+    return 0;
+  if (arg->type != AST_WRITE_ARG)
+    return -1;
+  wa = arg->data;
+  if (wa->value->type != AST_STRLIT || wa->width->type != AST_INTLIT)
+    return -1;
+  width = *(long *)wa->width->data;
+  return width >= 0 && width <= CG_MAX_PAD ? width : -1;
+}
+
+void
+_load_libpas (cg *ctx)
+{
+  if (ctx->flags & CG_FLAG_LINK_RUNTIME)
+    sink_write (ctx->out, libpas_hdr, libpas_hdr_len);
+  else
+    sink_write (ctx->out, libpas_src, libpas_src_len);
 }
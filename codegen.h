@@ -2,23 +2,44 @@
 #define CODEGEN_H
 
 #include "ast.h"
+#include "sink.h"
+
+/* Codegen flags. */
+#define CG_FLAG_LINK_RUNTIME (1 << 0)
+#define CG_FLAG_UNROLL (1 << 1) /* Ask cc to unroll FOR loops. */
+#define CG_FLAG_KNOWN_OUTPUT (1 << 2) /* Output known, see codegen_output. */
 
 enum cg_target
 {
   TARGET_AST = 0,
   TARGET_IR,
-  TARGET_C
+  TARGET_C,
+  TARGET_ASM,
+  TARGET_JIT,
+  TARGET_RUN,
+  TARGET_PBC
 };
 
 struct cg
 {
   arena ar;
-  stringbuilder sb;
+  sink *out;
   da var_declares;
+  U8 flags;
 };
 typedef struct cg cg;
 
-string *codegen (cg *ctx, ast_node *root);
+/* Generate C code for ROOT into OUT.  Returns 1 if writing failed.
+
+   With CG_FLAG_LINK_RUNTIME runtime/libpascal.h is pasted in front of the
+   program and the result must be linked with libpascal.a, otherwise the
+   whole runtime source is. */
+int codegen (cg *ctx, ast_node *root, sink *out);
+
+/* Generate into OUT a C program that writes TEXT and exits, for a program
+   whose output is known at compile time, see peval.h.  Returns 1 if
+   writing failed. */
+int codegen_output (cg *ctx, string *text, sink *out);
 
 void codegen_fold (cg *ctx);
 
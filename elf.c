@@ -0,0 +1,368 @@
+#include <elf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "elf.h"
+#include "utils.h"
+
+#define ELF_PAGE 0x1000
+#define ELF_ALIGN(v, a) (((v) + (a) - 1) & ~(U64)((a) - 1))
+
+typedef struct
+{
+  const U8 *rt;
+  U32 rt_len;
+  Elf64_Shdr *sh;
+  U32 nsh;
+  Elf64_Sym *syms;
+  U32 nsyms;
+  const char *names;
+  U64 *addr; /* Load address of every runtime section, 0 if not loaded. */
+  U64 *off;  /* Its file offset in the executable. */
+  U64 code_addr, code_off, data_addr;
+  U8 *image;
+} elf_ctx;
+
+/* Check that the runtime object is what we can link and find its symbol
+   table. */
+static int _parse (elf_ctx *ctx);
+
+/* Check if runtime section I goes into the executable. */
+static U8 _loaded (Elf64_Shdr *sh);
+
+/* Find defined global symbol NAME of the runtime. */
+static Elf64_Sym *_lookup (elf_ctx *ctx, const char *name);
+
+/* Address of runtime symbol SYM, main being the program. */
+static int _sym_addr (elf_ctx *ctx, Elf64_Sym *sym, U64 *out);
+
+/* Apply the relocations of runtime section RELA. */
+static int _relocate (elf_ctx *ctx, Elf64_Shdr *rela);
+
+/* Store V of SIZE bytes at P, checking that it fits when SIGNED or
+   zero-extended.  Returns 1 if it doesn't. */
+static int _store (U8 *p, S64 v, U8 size, U8 is_signed);
+
+int
+elf_write (const char *path, enc_image *img, const U8 *rt, U32 rt_len)
+{
+  elf_ctx ctx = { 0 };
+  Elf64_Ehdr eh = { 0 };
+  Elf64_Phdr ph[3] = { 0 };
+  Elf64_Shdr *sh;
+  Elf64_Sym *sym;
+  enc_reloc *rel;
+  arena ar = { 0 };
+  sink out;
+  U64 off, text_size, data_off, data_size, data_mem, entry, target;
+  U32 i, nph = 2;
+  U8 has_data = 0;
+  int fd, status = 1;
+
+  ctx.rt = rt;
+  ctx.rt_len = rt_len;
+  if (_parse (&ctx))
+    {
+      fprintf (stderr, "Error: The embedded runtime is not an x86-64 ELF "
+                       "object.\n");
+      return 1;
+    }
+
+  ctx.addr = aralloc (&ar, ctx.nsh * sizeof (U64));
+  ctx.off = aralloc (&ar, ctx.nsh * sizeof (U64));
+  memset (ctx.addr, 0, ctx.nsh * sizeof (U64));
+  memset (ctx.off, 0, ctx.nsh * sizeof (U64));
+  for (i = 0; i < ctx.nsh; ++i)
+    if (_loaded (&ctx.sh[i]) && (ctx.sh[i].sh_flags & SHF_WRITE))
+      has_data = 1;
+  nph += has_data;
+
+  /* Text segment: headers, runtime code and constants, program code and
+     strings. */
+  off = sizeof (Elf64_Ehdr) + nph * sizeof (Elf64_Phdr);
+  for (i = 0; i < ctx.nsh; ++i)
+    {
+      sh = &ctx.sh[i];
+      if (!_loaded (sh) || (sh->sh_flags & SHF_WRITE))
+        continue;
+      off = ELF_ALIGN (off, sh->sh_addralign ? sh->sh_addralign : 1);
+      ctx.off[i] = off;
+      ctx.addr[i] = ELF_BASE + off;
+      off += sh->sh_size;
+    }
+  ctx.code_off = off = ELF_ALIGN (off, 16);
+  ctx.code_addr = ELF_BASE + off;
+  off += img->code.size;
+  /* The headers of the literals are read as words. */
+  off = ELF_ALIGN (off, 8);
+  ctx.data_addr = ELF_BASE + off;
+  off += img->data.size;
+  text_size = off;
+
+  /* Data segment starts a page further so it never shares one with text,
+     initialized data first. */
+  data_off = off;
+  data_size = data_mem = 0;
+  for (i = 0; i < 2 * ctx.nsh; ++i)
+    {
+      sh = &ctx.sh[i % ctx.nsh];
+      if (!_loaded (sh) || !(sh->sh_flags & SHF_WRITE)
+          || (sh->sh_type == SHT_NOBITS) != (i >= ctx.nsh))
+        continue;
+      data_mem = ELF_ALIGN (data_mem, sh->sh_addralign ? sh->sh_addralign
+                                                       : 1);
+      ctx.off[i % ctx.nsh] = data_off + data_mem;
+      ctx.addr[i % ctx.nsh] = ELF_BASE + ELF_PAGE + data_off + data_mem;
+      data_mem += sh->sh_size;
+      if (sh->sh_type != SHT_NOBITS)
+        data_size = data_mem;
+    }
+
+  ctx.image = aralloc (&ar, data_off + data_size);
+  memset (ctx.image, 0, data_off + data_size);
+  for (i = 0; i < ctx.nsh; ++i)
+    if (_loaded (&ctx.sh[i]) && ctx.sh[i].sh_type != SHT_NOBITS)
+      memcpy (ctx.image + ctx.off[i], rt + ctx.sh[i].sh_offset,
+              ctx.sh[i].sh_size);
+  memcpy (ctx.image + ctx.code_off, img->code.buf, img->code.size);
+  memcpy (ctx.image + (ctx.data_addr - ELF_BASE), img->data.buf,
+          img->data.size);
+
+  for (i = 0; i < ctx.nsh; ++i)
+    if (ctx.sh[i].sh_type == SHT_RELA && ctx.sh[i].sh_info < ctx.nsh
+        && ctx.addr[ctx.sh[i].sh_info] && _relocate (&ctx, &ctx.sh[i]))
+      goto done;
+
+  for (i = 0; i < img->relocs.size; ++i)
+    {
+      rel = dageti (&img->relocs, i);
+      if (rel->kind == ENC_RELOC_STR)
+        target = ctx.data_addr + *(U32 *)dageti (&img->strs, rel->index);
+      else
+        {
+          sym = _lookup (&ctx, ir_runtime_names[rel->index]);
+          if (!sym || _sym_addr (&ctx, sym, &target))
+            {
+              fprintf (stderr, "Error: The runtime has no \"%s\".\n",
+                       ir_runtime_names[rel->index]);
+              goto done;
+            }
+        }
+      if (_store (ctx.image + ctx.code_off + rel->offset,
+                  target - (ctx.code_addr + rel->offset + 4), 4, 1))
+        goto done;
+    }
+
+  sym = _lookup (&ctx, "_start");
+  if (!sym || _sym_addr (&ctx, sym, &entry))
+    {
+      fprintf (stderr, "Error: The runtime has no _start.\n");
+      goto done;
+    }
+
+  memcpy (eh.e_ident, ELFMAG, SELFMAG);
+  eh.e_ident[EI_CLASS] = ELFCLASS64;
+  eh.e_ident[EI_DATA] = ELFDATA2LSB;
+  eh.e_ident[EI_VERSION] = EV_CURRENT;
+  eh.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+  eh.e_type = ET_EXEC;
+  eh.e_machine = EM_X86_64;
+  eh.e_version = EV_CURRENT;
+  eh.e_entry = entry;
+  eh.e_phoff = sizeof (Elf64_Ehdr);
+  eh.e_ehsize = sizeof (Elf64_Ehdr);
+  eh.e_phentsize = sizeof (Elf64_Phdr);
+  eh.e_phnum = nph;
+
+  ph[0].p_type = PT_LOAD;
+  ph[0].p_flags = PF_R | PF_X;
+  ph[0].p_vaddr = ph[0].p_paddr = ELF_BASE;
+  ph[0].p_filesz = ph[0].p_memsz = text_size;
+  ph[0].p_align = ELF_PAGE;
+  ph[1].p_type = PT_GNU_STACK;
+  ph[1].p_flags = PF_R | PF_W;
+  if (has_data)
+    {
+      ph[2].p_type = PT_LOAD;
+      ph[2].p_flags = PF_R | PF_W;
+      ph[2].p_offset = data_off;
+      ph[2].p_vaddr = ph[2].p_paddr = ELF_BASE + ELF_PAGE + data_off;
+      ph[2].p_filesz = data_size;
+      ph[2].p_memsz = data_mem;
+      ph[2].p_align = ELF_PAGE;
+    }
+  memcpy (ctx.image, &eh, sizeof (eh));
+  memcpy (ctx.image + sizeof (eh), ph, nph * sizeof (Elf64_Phdr));
+
+  /* A running copy of the old file would make writing fail. */
+  if (unlink (path) < 0 && errno != ENOENT)
+    {
+      fprintf (stderr, "Error: Failed to replace \"%s\".\n", path);
+      goto done;
+    }
+  fd = open (path, O_WRONLY | O_CREAT | O_TRUNC, 0777);
+  if (fd < 0 || sink_open_fd (&out, fd, SINK_CAPACITY))
+    {
+      fprintf (stderr, "Error: Failed to open \"%s\".\n", path);
+      if (fd >= 0)
+        close (fd);
+      goto done;
+    }
+  sink_write (&out, (char *)ctx.image, data_off + data_size);
+  status = sink_fold (&out);
+  if (close (fd) < 0)
+    status = 1;
+  if (status)
+    fprintf (stderr, "Error: Failed to write \"%s\".\n", path);
+
+done:
+  arfold (&ar);
+  return status;
+}
+
+static int
+_parse (elf_ctx *ctx)
+{
+  const Elf64_Ehdr *eh = (const Elf64_Ehdr *)ctx->rt;
+  U32 i;
+
+  if (ctx->rt_len < sizeof (Elf64_Ehdr)
+      || memcmp (eh->e_ident, ELFMAG, SELFMAG)
+      || eh->e_ident[EI_CLASS] != ELFCLASS64 || eh->e_type != ET_REL
+      || eh->e_machine != EM_X86_64
+      || eh->e_shentsize != sizeof (Elf64_Shdr)
+      || eh->e_shoff + eh->e_shnum * sizeof (Elf64_Shdr) > ctx->rt_len)
+    return 1;
+
+  ctx->sh = (Elf64_Shdr *)(ctx->rt + eh->e_shoff);
+  ctx->nsh = eh->e_shnum;
+  for (i = 0; i < ctx->nsh; ++i)
+    {
+      if (ctx->sh[i].sh_type != SHT_NOBITS
+          && ctx->sh[i].sh_offset + ctx->sh[i].sh_size > ctx->rt_len)
+        return 1;
+      if (ctx->sh[i].sh_type == SHT_SYMTAB && ctx->sh[i].sh_link < ctx->nsh)
+        {
+          ctx->syms = (Elf64_Sym *)(ctx->rt + ctx->sh[i].sh_offset);
+          ctx->nsyms = ctx->sh[i].sh_size / sizeof (Elf64_Sym);
+          ctx->names
+              = (const char *)ctx->rt + ctx->sh[ctx->sh[i].sh_link].sh_offset;
+        }
+    }
+
+  return ctx->syms ? 0 : 1;
+}
+
+static U8
+_loaded (Elf64_Shdr *sh)
+{
+  return (sh->sh_flags & SHF_ALLOC) && sh->sh_type != SHT_NOTE;
+}
+
+static Elf64_Sym *
+_lookup (elf_ctx *ctx, const char *name)
+{
+  Elf64_Sym *sym;
+  U32 i;
+
+  for (i = 0; i < ctx->nsyms; ++i)
+    {
+      sym = &ctx->syms[i];
+      if (ELF64_ST_BIND (sym->st_info) == STB_GLOBAL
+          && sym->st_shndx != SHN_UNDEF
+          && streq (ctx->names + sym->st_name, name))
+        return sym;
+    }
+  return NULL;
+}
+
+static int
+_sym_addr (elf_ctx *ctx, Elf64_Sym *sym, U64 *out)
+{
+  if (sym->st_shndx == SHN_UNDEF)
+    {
+      if (!streq (ctx->names + sym->st_name, "main"))
+        {
+          fprintf (stderr, "Error: Undefined symbol \"%s\" in the runtime.\n",
+                   ctx->names + sym->st_name);
+          return 1;
+        }
+      *out = ctx->code_addr;
+    }
+  else if (sym->st_shndx == SHN_ABS)
+    *out = sym->st_value;
+  else if (sym->st_shndx < ctx->nsh && ctx->addr[sym->st_shndx])
+    *out = ctx->addr[sym->st_shndx] + sym->st_value;
+  else
+    {
+      fprintf (stderr, "Error: Symbol \"%s\" of the runtime is in a section "
+                       "that isn't linked.\n",
+               ctx->names + sym->st_name);
+      return 1;
+    }
+  return 0;
+}
+
+static int
+_relocate (elf_ctx *ctx, Elf64_Shdr *rela)
+{
+  Elf64_Rela *r = (Elf64_Rela *)(ctx->rt + rela->sh_offset);
+  U32 i, n = rela->sh_size / sizeof (Elf64_Rela), t = rela->sh_info;
+  U64 s, p;
+  U8 *at;
+  int err;
+
+  for (i = 0; i < n; ++i, ++r)
+    {
+      if (ELF64_R_SYM (r->r_info) >= ctx->nsyms
+          || _sym_addr (ctx, &ctx->syms[ELF64_R_SYM (r->r_info)], &s))
+        return 1;
+      p = ctx->addr[t] + r->r_offset;
+      at = ctx->image + ctx->off[t] + r->r_offset;
+
+      switch (ELF64_R_TYPE (r->r_info))
+        {
+        case R_X86_64_64:
+          err = _store (at, s + r->r_addend, 8, 1);
+          break;
+        case R_X86_64_PC32:
+        case R_X86_64_PLT32:
+          err = _store (at, s + r->r_addend - p, 4, 1);
+          break;
+        case R_X86_64_32:
+          err = _store (at, s + r->r_addend, 4, 0);
+          break;
+        case R_X86_64_32S:
+          err = _store (at, s + r->r_addend, 4, 1);
+          break;
+        default:
+          fprintf (stderr, "Error: Unsupported relocation type %lu in the "
+                           "runtime.\n",
+                   (unsigned long)ELF64_R_TYPE (r->r_info));
+          return 1;
+        }
+      if (err)
+        return 1;
+    }
+
+  return 0;
+}
+
+static int
+_store (U8 *p, S64 v, U8 size, U8 is_signed)
+{
+  U8 i;
+
+  if (size == 4
+      && (is_signed ? v < INT32_MIN || v > INT32_MAX : v < 0 || v > UINT32_MAX))
+    {
+      fprintf (stderr, "Error: Relocation out of range.\n");
+      return 1;
+    }
+  for (i = 0; i < size; ++i)
+    p[i] = (U8)(v >> (i * 8));
+  return 0;
+}
@@ -0,0 +1,15 @@
+#ifndef ELF_H
+#define ELF_H
+
+#include "enc.h"
+
+/* Where the executable is loaded. */
+#define ELF_BASE 0x400000
+
+/* Write IMG as a static x86-64 Linux executable to PATH, linked with the
+   relocatable runtime object RT of RT_LEN bytes.  RT provides _start,
+   calls main, the entry of IMG, and defines the functions IMG calls.
+   Returns 1 on failure. */
+int elf_write (const char *path, enc_image *img, const U8 *rt, U32 rt_len);
+
+#endif /* not ELF_H */
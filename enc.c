@@ -0,0 +1,420 @@
+#include <stdint.h>
+#include <stdio.h>
+
+#include "enc.h"
+#include "runtime/libpascal.h"
+#include "utils.h"
+
+/* A jump whose displacement is patched once every block has its offset. */
+typedef struct
+{
+  U32 offset; /* Of the displacement. */
+  U32 target; /* Block number. */
+  U32 jump;   /* Number of the jump, indexes long_jump. */
+  U8 size;    /* Of the displacement, 1 or 4. */
+} enc_fixup;
+
+typedef struct
+{
+  enc_image *img;
+  sink *out;
+  U32 *block_off;
+  U8 *long_jump; /* Jumps that don't reach with 8 bits. */
+  U32 njumps;
+  da fixups; /* enc_fixup */
+} enc_ctx;
+
+/* Opcode and ModRM.reg extension of the two operand integer ALU
+   operations, the r/m, reg form.  Adding 2 to the opcode gives the reg,
+   r/m one. */
+static const U8 _alu[X86_OP_COUNT][2] = {
+  [X86_ADD] = { 0x01, 0 }, [X86_OR] = { 0x09, 1 },  [X86_AND] = { 0x21, 4 },
+  [X86_SUB] = { 0x29, 5 }, [X86_XOR] = { 0x31, 6 }, [X86_CMP] = { 0x39, 7 },
+};
+
+/* Second opcode byte of the scalar double operations after F2 0F. */
+static const U8 _sse[X86_OP_COUNT] = {
+  [X86_ADDSD] = 0x58,
+  [X86_MULSD] = 0x59,
+  [X86_SUBSD] = 0x5c,
+  [X86_DIVSD] = 0x5e,
+};
+
+/* Encode IN at the end of CTX->out.  Returns 1 on an operand combination
+   the instruction doesn't have. */
+static int _insn (enc_ctx *ctx, x86_insn *in);
+
+/* Emit [PREFIX] [REX] OPCODE ModRM [SIB] [disp] with REG in ModRM.reg,
+   either a register or an opcode extension, and RM a register or memory
+   operand.  OPCODE is one or two bytes, W sets REX.W and BYTE_REG forces
+   a REX prefix so registers 4 to 7 mean spl to dil. */
+static void _modrm (enc_ctx *ctx, U8 prefix, U8 w, U8 byte_reg, U32 opcode,
+                    U32 reg, x86_opnd *rm);
+
+static void _imm (sink *out, long v, U8 size);
+
+/* Hardware number of register REG. */
+#define ENC_NUM(reg) (X86_IS_XMM (reg) ? (reg) - X86_XMM0 : (reg))
+#define ENC_FITS8(v) ((v) >= INT8_MIN && (v) <= INT8_MAX)
+#define ENC_FITS32(v) ((v) >= INT32_MIN && (v) <= INT32_MAX)
+
+int
+enc_emit (enc_image *img, x86_func *xf)
+{
+  enc_ctx ctx = { 0 };
+  enc_fixup *fix;
+  x86_block *bb;
+  x86_insn *in;
+  string *str;
+  long disp;
+  _P__p_hdr hdr = { 0, 0 };
+  U32 i, off, len;
+  U8 again;
+  int status = 1;
+
+  if (sink_open_mem (&img->code, 1024) || sink_open_mem (&img->data, 256)
+      || dainit (&img->strs, &img->ar, sizeof (U32), 16)
+      || dainit (&img->relocs, &img->ar, sizeof (enc_reloc), 16)
+      || dainit (&ctx.fixups, &img->ar, sizeof (enc_fixup), 16))
+    return 1;
+
+  ctx.img = img;
+  ctx.out = &img->code;
+  ctx.block_off = aralloc (&img->ar, xf->blocks.size * sizeof (U32));
+  for (i = 0; i < xf->blocks.size; ++i)
+    for (in = x86_block_get (xf, i)->head; in; in = in->next)
+      ctx.njumps += in->op == X86_JMP || in->op == X86_JCC;
+  ctx.long_jump = aralloc (&img->ar, ctx.njumps + 1);
+  memset (ctx.long_jump, 0, ctx.njumps + 1);
+
+  /* Start with every jump short and redo the whole function while some
+     don't reach, jumps only ever grow so this settles. */
+  do
+    {
+      img->code.size = 0;
+      img->relocs.size = 0;
+      ctx.fixups.size = 0;
+      ctx.njumps = 0;
+      for (i = 0; i < xf->blocks.size; ++i)
+        {
+          bb = x86_block_get (xf, i);
+          ctx.block_off[i] = img->code.size;
+          for (in = bb->head; in; in = in->next)
+            if (_insn (&ctx, in))
+              {
+                fprintf (stderr, "Error: Can't encode instruction %d.\n",
+                         in->op);
+                goto done;
+              }
+        }
+
+      again = 0;
+      for (i = 0; i < ctx.fixups.size; ++i)
+        {
+          fix = dageti (&ctx.fixups, i);
+          disp = (long)ctx.block_off[fix->target] - (fix->offset + fix->size);
+          if (fix->size == 1 && !ENC_FITS8 (disp))
+            {
+              ctx.long_jump[fix->jump] = 1;
+              again = 1;
+            }
+          else if (!again)
+            memcpy (img->code.buf + fix->offset, &disp, fix->size);
+        }
+    }
+  while (again);
+
+  /* Literals follow their header, 8 aligned. */
+  for (i = 0; i < xf->strs.size; ++i)
+    {
+      str = *(string **)dageti (&xf->strs, i);
+      while (img->data.size % 8)
+        sink_putch (&img->data, '\0');
+      sink_write (&img->data, (char *)&hdr, sizeof (hdr));
+      off = img->data.size;
+      daappend (&img->strs, &off);
+      sink_write (&img->data, str->data, str->size + 1);
+      if (img->data.failed)
+        break;
+      len = unescape (img->data.buf + off, str->data, str->size);
+      hdr.len = strnlen (img->data.buf + off, len);
+      hdr.cap = 0;
+      memcpy (img->data.buf + off - sizeof (hdr), &hdr, sizeof (hdr));
+      img->data.buf[off + hdr.len] = '\0';
+      img->data.size = off + hdr.len + 1;
+    }
+
+  status = img->code.failed || img->data.failed;
+
+done:
+  arfree (ctx.long_jump);
+  arfree (ctx.block_off);
+  dafold (&ctx.fixups);
+  return status;
+}
+
+static int
+_insn (enc_ctx *ctx, x86_insn *in)
+{
+  sink *out = ctx->out;
+  x86_opnd *dst = &in->dst, *src = &in->src;
+  enc_fixup fix;
+  enc_reloc rel;
+  U32 r;
+
+  switch (in->op)
+    {
+    case X86_MOV:
+      if (src->kind == X86_IMM && dst->kind == X86_REG)
+        {
+          r = ENC_NUM (dst->reg);
+          if (src->imm >= 0 && src->imm <= UINT32_MAX)
+            {
+              /* mov r32, imm32 zero extends. */
+              if (r >= 8)
+                sink_putch (out, 0x41);
+              sink_putch (out, 0xb8 + (r & 7));
+              _imm (out, src->imm, 4);
+            }
+          else if (ENC_FITS32 (src->imm))
+            {
+              _modrm (ctx, 0, 1, 0, 0xc7, 0, dst);
+              _imm (out, src->imm, 4);
+            }
+          else
+            {
+              sink_putch (out, 0x48 | (r >= 8));
+              sink_putch (out, 0xb8 + (r & 7));
+              _imm (out, src->imm, 8);
+            }
+        }
+      else if (src->kind == X86_IMM && ENC_FITS32 (src->imm))
+        {
+          _modrm (ctx, 0, 1, 0, 0xc7, 0, dst);
+          _imm (out, src->imm, 4);
+        }
+      else if (dst->kind == X86_REG)
+        _modrm (ctx, 0, 1, 0, 0x8b, dst->reg, src);
+      else if (src->kind == X86_REG)
+        _modrm (ctx, 0, 1, 0, 0x89, src->reg, dst);
+      else
+        return 1;
+      break;
+    case X86_LEA:
+      if (dst->kind != X86_REG)
+        return 1;
+      _modrm (ctx, 0, 1, 0, 0x8d, dst->reg, src);
+      break;
+    case X86_ADD:
+    case X86_SUB:
+    case X86_AND:
+    case X86_OR:
+    case X86_XOR:
+    case X86_CMP:
+      if (src->kind == X86_IMM && ENC_FITS8 (src->imm))
+        {
+          _modrm (ctx, 0, 1, 0, 0x83, _alu[in->op][1], dst);
+          _imm (out, src->imm, 1);
+        }
+      else if (src->kind == X86_IMM && ENC_FITS32 (src->imm))
+        {
+          _modrm (ctx, 0, 1, 0, 0x81, _alu[in->op][1], dst);
+          _imm (out, src->imm, 4);
+        }
+      else if (src->kind == X86_REG)
+        _modrm (ctx, 0, 1, 0, _alu[in->op][0], src->reg, dst);
+      else if (dst->kind == X86_REG && src->kind == X86_MEM)
+        _modrm (ctx, 0, 1, 0, _alu[in->op][0] + 2, dst->reg, src);
+      else
+        return 1;
+      break;
+    case X86_IMUL:
+      if (dst->kind != X86_REG)
+        return 1;
+      if (src->kind == X86_IMM && ENC_FITS8 (src->imm))
+        {
+          _modrm (ctx, 0, 1, 0, 0x6b, dst->reg, dst);
+          _imm (out, src->imm, 1);
+        }
+      else if (src->kind == X86_IMM && ENC_FITS32 (src->imm))
+        {
+          _modrm (ctx, 0, 1, 0, 0x69, dst->reg, dst);
+          _imm (out, src->imm, 4);
+        }
+      else if (src->kind == X86_REG || src->kind == X86_MEM)
+        _modrm (ctx, 0, 1, 0, 0x0faf, dst->reg, src);
+      else
+        return 1;
+      break;
+    case X86_NEG:
+      _modrm (ctx, 0, 1, 0, 0xf7, 3, dst);
+      break;
+    case X86_IDIV:
+      _modrm (ctx, 0, 1, 0, 0xf7, 7, dst);
+      break;
+    case X86_CQO:
+      sink_putch (out, 0x48);
+      sink_putch (out, 0x99);
+      break;
+    case X86_SETCC:
+      if (dst->kind != X86_REG)
+        return 1;
+      _modrm (ctx, 0, 0, 1, 0x0f90 + in->cc, 0, dst);
+      _modrm (ctx, 0, 1, 0, 0x0fb6, dst->reg, dst);
+      break;
+    case X86_JMP:
+    case X86_JCC:
+      fix.target = dst->imm;
+      fix.jump = ctx->njumps++;
+      fix.size = ctx->long_jump[fix.jump] ? 4 : 1;
+      if (fix.size == 1)
+        sink_putch (out, in->op == X86_JMP ? 0xeb : 0x70 + in->cc);
+      else if (in->op == X86_JMP)
+        sink_putch (out, 0xe9);
+      else
+        {
+          sink_putch (out, 0x0f);
+          sink_putch (out, 0x80 + in->cc);
+        }
+      fix.offset = out->size;
+      _imm (out, 0, fix.size);
+      daappend (&ctx->fixups, &fix);
+      break;
+    case X86_CALL:
+      sink_putch (out, 0xe8);
+      rel.offset = out->size;
+      rel.index = dst->imm;
+      rel.kind = ENC_RELOC_CALL;
+      daappend (&ctx->img->relocs, &rel);
+      _imm (out, 0, 4);
+      break;
+    case X86_RET:
+      sink_putch (out, 0xc3);
+      break;
+    case X86_PUSH:
+    case X86_POP:
+      if (dst->reg >= 8)
+        sink_putch (out, 0x41);
+      sink_putch (out, (in->op == X86_PUSH ? 0x50 : 0x58) + (dst->reg & 7));
+      break;
+    case X86_MOVSD:
+      if (dst->kind == X86_REG && src->kind == X86_REG)
+        _modrm (ctx, 0x66, 0, 0, 0x0f28, dst->reg, src); /* movapd */
+      else if (dst->kind == X86_REG)
+        _modrm (ctx, 0xf2, 0, 0, 0x0f10, dst->reg, src);
+      else if (src->kind == X86_REG)
+        _modrm (ctx, 0xf2, 0, 0, 0x0f11, src->reg, dst);
+      else
+        return 1;
+      break;
+    case X86_MOVQ:
+      if (dst->kind == X86_REG && X86_IS_XMM (dst->reg))
+        {
+          if (src->kind == X86_REG && !X86_IS_XMM (src->reg))
+            _modrm (ctx, 0x66, 1, 0, 0x0f6e, dst->reg, src);
+          else
+            _modrm (ctx, 0xf3, 0, 0, 0x0f7e, dst->reg, src);
+        }
+      else if (src->kind == X86_REG && X86_IS_XMM (src->reg))
+        {
+          if (dst->kind == X86_REG)
+            _modrm (ctx, 0x66, 1, 0, 0x0f7e, src->reg, dst);
+          else
+            _modrm (ctx, 0x66, 0, 0, 0x0fd6, src->reg, dst);
+        }
+      else if (dst->kind == X86_REG)
+        _modrm (ctx, 0, 1, 0, 0x8b, dst->reg, src);
+      else if (src->kind == X86_REG)
+        _modrm (ctx, 0, 1, 0, 0x89, src->reg, dst);
+      else
+        return 1;
+      break;
+    case X86_ADDSD:
+    case X86_SUBSD:
+    case X86_MULSD:
+    case X86_DIVSD:
+      _modrm (ctx, 0xf2, 0, 0, 0x0f00 | _sse[in->op], dst->reg, src);
+      break;
+    case X86_UCOMISD:
+      _modrm (ctx, 0x66, 0, 0, 0x0f2e, dst->reg, src);
+      break;
+    case X86_CVTSI2SD:
+      _modrm (ctx, 0xf2, 1, 0, 0x0f2a, dst->reg, src);
+      break;
+    default:
+      return 1;
+    }
+
+  return 0;
+}
+
+static void
+_modrm (enc_ctx *ctx, U8 prefix, U8 w, U8 byte_reg, U32 opcode, U32 reg,
+        x86_opnd *rm)
+{
+  sink *out = ctx->out;
+  enc_reloc rel;
+  U32 r = ENC_NUM (reg), base = ENC_NUM (rm->reg);
+  U8 rex = 0x40 | (w << 3) | ((r & 8) >> 1), mod;
+
+  if (rm->kind == X86_REG || rm->kind == X86_MEM)
+    rex |= (base & 8) >> 3;
+  if (rm->kind == X86_REG && byte_reg && base >= 4)
+    byte_reg = 1;
+  else
+    byte_reg = 0;
+
+  if (prefix)
+    sink_putch (out, prefix);
+  if (rex != 0x40 || byte_reg)
+    sink_putch (out, rex);
+  if (opcode > 0xff)
+    sink_putch (out, opcode >> 8);
+  sink_putch (out, opcode);
+
+  switch (rm->kind)
+    {
+    case X86_REG:
+      sink_putch (out, 0xc0 | (r & 7) << 3 | (base & 7));
+      break;
+    case X86_MEM:
+      if (rm->imm == 0 && (base & 7) != X86_RBP)
+        mod = 0;
+      else if (ENC_FITS8 (rm->imm))
+        mod = 1;
+      else
+        mod = 2;
+      sink_putch (out, mod << 6 | (r & 7) << 3 | (base & 7));
+      if ((base & 7) == X86_RSP)
+        sink_putch (out, 0x24);
+      if (mod)
+        _imm (out, rm->imm, mod == 1 ? 1 : 4);
+      break;
+    case X86_STR:
+      /* RIP relative. */
+      sink_putch (out, (r & 7) << 3 | 5);
+      rel.offset = out->size;
+      rel.index = rm->imm;
+      rel.kind = ENC_RELOC_STR;
+      daappend (&ctx->img->relocs, &rel);
+      _imm (out, 0, 4);
+      break;
+    }
+}
+
+static void
+_imm (sink *out, long v, U8 size)
+{
+  U8 i;
+
+  for (i = 0; i < size; ++i)
+    sink_putch (out, (U8)(v >> (i * 8)));
+}
+
+void
+enc_fold (enc_image *img)
+{
+  sink_fold (&img->code);
+  sink_fold (&img->data);
+  arfold (&img->ar);
+}
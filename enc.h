@@ -0,0 +1,40 @@
+#ifndef ENC_H
+#define ENC_H
+
+#include "sink.h"
+#include "x86.h"
+
+enum enc_reloc_kind
+{
+  ENC_RELOC_CALL = 0, /* Runtime function, enum ir_runtime index. */
+  ENC_RELOC_STR       /* String constant number index. */
+};
+
+/* 32-bit field at OFFSET in the code to be filled with the distance from
+   its end to the target. */
+typedef struct enc_reloc
+{
+  U32 offset;
+  U32 index;
+  U8 kind;
+} enc_reloc;
+
+/* Position independent machine code of a function, entered at offset 0,
+   and the data it refers to. */
+typedef struct enc_image
+{
+  arena ar;
+  sink code;
+  sink data;   /* Literals after their header, escapes resolved. */
+  da strs;     /* U32 offset of every string in DATA */
+  da relocs;   /* enc_reloc */
+} enc_image;
+
+/* Encode XF, which must have been through x86_finish, into IMG.  Jumps
+   get the short form wherever it reaches.  Returns 1 on failure. */
+int enc_emit (enc_image *img, x86_func *xf);
+
+/* Free the image. */
+void enc_fold (enc_image *img);
+
+#endif /* not ENC_H */
@@ -0,0 +1,790 @@
+#include <stdio.h>
+
+#include "inline.h"
+
+typedef struct
+{
+  arena *ar;
+  ast_node *routine;    /* Routine being rewritten, NULL in the program. */
+  ast_node *decls;      /* Fresh variables of the program. */
+  ast_node **decls_end; /* Where the next one is linked. */
+  U32 budget;
+  U32 room;  /* Nodes the program may still grow by. */
+  U8 full;   /* A call was kept for want of room. */
+  U32 count; /* Fresh variables made so far, numbering their names. */
+} inliner;
+
+/* A variable of the routine being inlined and the node it becomes. */
+typedef struct
+{
+  void *from;
+  ast_node *to;
+} inline_map;
+
+/* Statements to run before the one being rewritten. */
+typedef struct
+{
+  ast_node *head;
+  ast_node *tail;
+} inline_pre;
+
+/* Rewrite the statements of list PTR.  Returns the new head. */
+static ast_node *_stmts (inliner *ic, ast_node *ptr);
+
+/* Rewrite statement S.  Returns S, or a block of its calls inlined and
+   S. */
+static ast_node *_stmt (inliner *ic, ast_node *s);
+
+/* Rewrite expression EXP, appending the inlined calls to PRE.  Returns
+   the expression to use in place of EXP. */
+static ast_node *_exp (inliner *ic, inline_pre *pre, ast_node *exp);
+
+/* Rewrite the arguments of call DATA. */
+static void _args (inliner *ic, inline_pre *pre, ast_data_funcall *data);
+
+/* Append the body of the routine called by DATA to PRE.  Returns the
+   variable holding the result of a function, NULL for a procedure. */
+static ast_node *_inline (inliner *ic, inline_pre *pre,
+                          ast_data_funcall *data);
+
+/* Whether the call DATA is inlined, taking the room its copy needs. */
+static U8 _inlinable (inliner *ic, ast_data_funcall *data);
+
+/* Number of nodes of NODE, adding the routines it calls to CALLS when
+   not NULL. */
+static U32 _size (ast_node *node, da *calls);
+
+/* Same for the statements of list PTR. */
+static U32 _size_list (ast_node *ptr, da *calls);
+
+/* Whether statement list PTR assigns variable VAR or passes it to a var
+   parameter. */
+static U8 _assigns (ast_node *ptr, ast_data_var_declare *var);
+
+/* Copy of expression or statement NODE, the variables of MAP replaced. */
+static ast_node *_clone (inliner *ic, da *map, ast_node *node);
+
+/* Copy of statement list PTR. */
+static ast_node *_clone_list (inliner *ic, da *map, ast_node *ptr);
+
+/* Whether ROUTINE is in CALLS. */
+static U8 _called (da *calls, ast_node *routine);
+
+/* Node the variable VAR becomes, NULL when kept. */
+static ast_node *_lookup (da *map, void *var);
+
+/* Declare a fresh variable of the type of LIKE, named after NAME. */
+static ast_node *_fresh (inliner *ic, ast_data_var_declare *like,
+                         string *name);
+
+/* New node of TYPE holding DATA. */
+static ast_node *_node (inliner *ic, enum ast_type type, void *data);
+
+/* New use of variable declaration VAR. */
+static ast_node *_use (inliner *ic, ast_node *var);
+
+/* New statement VAR := VALUE. */
+static ast_node *_assign (inliner *ic, ast_node *var, ast_node *value);
+
+/* Zero of the type of VAR, what every variable starts out as. */
+static ast_node *_zero (inliner *ic, ast_data_var_declare *var);
+
+/* Append statement S to PRE. */
+static void _pre_append (inline_pre *pre, ast_node *s);
+
+int
+inline_calls (ast *ctx, U32 budget)
+{
+  inliner ic = { 0 };
+  ast_node *ptr, **link;
+  ast_data_routine *data;
+  da routines, calls;
+  U32 i;
+
+  if (budget == 0)
+    return 0;
+
+  ic.ar = &ctx->ar;
+  ic.budget = budget;
+  ic.room = INLINE_LIMIT;
+  ic.decls_end = &ic.decls;
+
+  /* A routine only calls itself and those before it, each is inlined
+     into the later ones as it is after its own calls are. */
+  for (ptr = ctx->root; ptr; ptr = ptr->next)
+    {
+      if (ptr->type == AST_ROUTINE)
+        {
+          ic.routine = ptr;
+          data = ptr->data;
+          data->body = _stmt (&ic, data->body);
+        }
+      else if (ptr->type == AST_MAIN_BLOCK)
+        {
+          ic.routine = NULL;
+          ((ast_data_block *)ptr->data)->next
+              = _stmts (&ic, ((ast_data_block *)ptr->data)->next);
+        }
+    }
+
+  /* Fresh variables of the program go last, locals of main in C. */
+  for (link = &ctx->root; *link; link = &(*link)->next)
+    if ((*link)->type == AST_MAIN_BLOCK)
+      {
+        *ic.decls_end = *link;
+        *link = ic.decls ? ic.decls : *link;
+        break;
+      }
+
+  /* Keep the routines still called from main, or from a kept routine
+     after them. */
+  dainit (&routines, ic.ar, sizeof (ast_node *), 16);
+  dainit (&calls, ic.ar, sizeof (ast_node *), 16);
+  for (ptr = ctx->root; ptr; ptr = ptr->next)
+    {
+      if (ptr->type == AST_ROUTINE)
+        dapush (&routines, &ptr);
+      else if (ptr->type == AST_MAIN_BLOCK)
+        _size (ptr, &calls);
+    }
+  /* Index 0 is the last routine. */
+  for (i = 0; i < routines.size; ++i)
+    {
+      ptr = *(ast_node **)dageti (&routines, i);
+      if (_called (&calls, ptr))
+        _size (((ast_data_routine *)ptr->data)->body, &calls);
+    }
+
+  for (link = &ctx->root; *link;)
+    {
+      if ((*link)->type == AST_ROUTINE && !_called (&calls, *link))
+        *link = (*link)->next;
+      else
+        link = &(*link)->next;
+    }
+  return ic.full;
+}
+
+// [ Statements ] {{{
+ast_node *
+_stmts (inliner *ic, ast_node *ptr)
+{
+  ast_node *head = NULL, **link = &head, *next, *s;
+
+  for (; ptr; ptr = next)
+    {
+      next = ptr->next;
+      s = _stmt (ic, ptr);
+      s->next = NULL;
+      *link = s;
+      link = &s->next;
+    }
+  return head;
+}
+
+ast_node *
+_stmt (inliner *ic, ast_node *s)
+{
+  inline_pre pre = { 0 }, again = { 0 };
+  ast_data_var_assign *va_data;
+  ast_data_funcall *fun_data;
+  ast_data_cond *cond_data;
+  ast_data_while *while_data;
+  ast_data_for *for_data;
+  ast_data_index *index;
+  ast_data_block *block;
+
+  switch (s->type)
+    {
+    case AST_BLOCK:
+      block = s->data;
+      block->next = _stmts (ic, block->next);
+      return s;
+    case AST_VAR_ASSIGN:
+      va_data = s->data;
+      if (va_data->index)
+        {
+          index = va_data->index->data;
+          index->index = _exp (ic, &pre, index->index);
+        }
+      va_data->value = _exp (ic, &pre, va_data->value);
+      break;
+    case AST_COND:
+      cond_data = s->data;
+      cond_data->cond = _exp (ic, &pre, cond_data->cond);
+      cond_data->yes = _stmt (ic, cond_data->yes);
+      if (cond_data->no)
+        cond_data->no = _stmt (ic, cond_data->no);
+      break;
+    case AST_WHILE:
+      while_data = s->data;
+      while_data->cond = _exp (ic, &pre, while_data->cond);
+      while_data->next = _stmt (ic, while_data->next);
+      if (!pre.head)
+        break;
+      /* The condition is evaluated again after every trip. */
+      _pre_append (&again, while_data->next);
+      _pre_append (&again, _clone_list (ic, NULL, pre.head));
+      block = aralloc (ic->ar, sizeof (ast_data_block));
+      block->next = again.head;
+      while_data->next = _node (ic, AST_BLOCK, block);
+      break;
+    case AST_FOR:
+      for_data = s->data;
+      for_data->from = _exp (ic, &pre, for_data->from);
+      for_data->to = _exp (ic, &pre, for_data->to);
+      for_data->body = _stmt (ic, for_data->body);
+      break;
+    case AST_FUNCALL:
+      fun_data = s->data;
+      _args (ic, &pre, fun_data);
+      if (_inlinable (ic, fun_data))
+        {
+          _inline (ic, &pre, fun_data);
+          s = NULL;
+        }
+      break;
+    default:
+      break;
+    }
+
+  if (!pre.head)
+    return s;
+  if (s)
+    {
+      s->next = NULL;
+      _pre_append (&pre, s);
+    }
+  block = aralloc (ic->ar, sizeof (ast_data_block));
+  block->next = pre.head;
+  return _node (ic, AST_BLOCK, block);
+}
+// }}}
+// [ Expressions ] {{{
+ast_node *
+_exp (inliner *ic, inline_pre *pre, ast_node *exp)
+{
+  ast_data_write_arg *wa;
+  ast_data_index *index;
+  ast_data_op *op_data;
+
+  switch (exp->type)
+    {
+    case AST_OP:
+      op_data = exp->data;
+      if (op_data->left)
+        op_data->left = _exp (ic, pre, op_data->left);
+      op_data->right = _exp (ic, pre, op_data->right);
+      break;
+    case AST_INDEX:
+      index = exp->data;
+      index->index = _exp (ic, pre, index->index);
+      break;
+    case AST_WRITE_ARG:
+      wa = exp->data;
+      wa->value = _exp (ic, pre, wa->value);
+      wa->width = _exp (ic, pre, wa->width);
+      if (wa->decimals)
+        wa->decimals = _exp (ic, pre, wa->decimals);
+      break;
+    case AST_FUNCALL:
+      _args (ic, pre, exp->data);
+      if (_inlinable (ic, exp->data))
+        return _inline (ic, pre, exp->data);
+      break;
+    default:
+      break;
+    }
+  return exp;
+}
+
+void
+_args (inliner *ic, inline_pre *pre, ast_data_funcall *data)
+{
+  ast_node **link, *next;
+
+  for (link = &data->args_head; *link; link = &(*link)->next)
+    {
+      next = (*link)->next;
+      *link = _exp (ic, pre, *link);
+      (*link)->next = next;
+    }
+}
+// }}}
+// [ Inlining ] {{{
+U8
+_inlinable (inliner *ic, ast_data_funcall *data)
+{
+  ast_data_routine *routine;
+  U32 size;
+
+  if (!data->routine)
+    return 0;
+  routine = data->routine->data;
+  if (routine->recursive)
+    return 0;
+  size = _size (routine->body, NULL);
+  if (size > ic->budget)
+    return 0;
+  if (size > ic->room)
+    {
+      ic->full = 1;
+      return 0;
+    }
+  ic->room -= size;
+  return 1;
+}
+
+ast_node *
+_inline (inliner *ic, inline_pre *pre, ast_data_funcall *data)
+{
+  ast_data_routine *routine = data->routine->data;
+  ast_data_var_declare *var;
+  ast_data_index *index, *actual;
+  ast_node *param, *arg, *to, *fresh, *result = NULL;
+  inline_map m;
+  da map;
+
+  dainit (&map, ic->ar, sizeof (inline_map), 8);
+
+  for (param = routine->params, arg = data->args_head; param;
+       param = param->next, arg = arg->next)
+    {
+      var = param->data;
+      if ((var->flags & AST_VAR_REF) && arg->type == AST_INDEX)
+        {
+          /* The element is chosen once, at the call. */
+          actual = arg->data;
+          fresh = _fresh (ic, var, var->name);
+          ((ast_data_var_declare *)fresh->data)->datatype = AST_INTLIT;
+          ((ast_data_var_declare *)fresh->data)->arsize = 0;
+          _pre_append (pre, _assign (ic, fresh, actual->index));
+          index = aralloc (ic->ar, sizeof (ast_data_index));
+          index->var = actual->var;
+          index->index = _use (ic, fresh);
+          index->check = actual->check;
+          to = _node (ic, AST_INDEX, index);
+        }
+      else if (var->flags & AST_VAR_REF)
+        {
+          to = arg;
+        }
+      else if ((arg->type == AST_INTLIT || arg->type == AST_FLOATLIT
+                || arg->type == AST_BOOL || arg->type == AST_STRLIT)
+               && arg->type == var->datatype
+               && !_assigns (routine->body, var))
+        {
+          /* A constant the body only reads is used as it is. */
+          to = arg;
+        }
+      else
+        {
+          to = _fresh (ic, var, var->name);
+          _pre_append (pre, _assign (ic, to, arg));
+        }
+      m.from = var;
+      m.to = to;
+      dapush (&map, &m);
+    }
+
+  /* Locals and the result start out as zero on every call. */
+  for (param = routine->locals; param; param = param->next)
+    {
+      m.from = param->data;
+      m.to = _fresh (ic, param->data, ((ast_data_var_declare *)m.from)->name);
+      _pre_append (pre, _assign (ic, m.to, _zero (ic, m.from)));
+      dapush (&map, &m);
+    }
+  if (routine->result)
+    {
+      m.from = routine->result->data;
+      m.to = result = _fresh (ic, m.from, routine->name);
+      _pre_append (pre, _assign (ic, m.to, _zero (ic, m.from)));
+      dapush (&map, &m);
+    }
+
+  _pre_append (pre, _clone (ic, &map, routine->body));
+  return result ? _use (ic, result) : NULL;
+}
+// }}}
+// [ Walks ] {{{
+U32
+_size (ast_node *node, da *calls)
+{
+  ast_data_var_assign *va_data;
+  ast_data_funcall *fun_data;
+  ast_data_write_arg *wa;
+  ast_data_cond *cond_data;
+  ast_data_for *for_data;
+  ast_data_op *op_data;
+  U32 n = 1;
+
+  switch (node->type)
+    {
+    case AST_MAIN_BLOCK:
+    case AST_BLOCK:
+      n += _size_list (((ast_data_block *)node->data)->next, calls);
+      break;
+    case AST_VAR_ASSIGN:
+      va_data = node->data;
+      if (va_data->index)
+        n += _size (va_data->index, calls);
+      n += _size (va_data->value, calls);
+      break;
+    case AST_COND:
+      cond_data = node->data;
+      n += _size (cond_data->cond, calls) + _size (cond_data->yes, calls);
+      if (cond_data->no)
+        n += _size (cond_data->no, calls);
+      break;
+    case AST_WHILE:
+      n += _size (((ast_data_while *)node->data)->cond, calls);
+      n += _size (((ast_data_while *)node->data)->next, calls);
+      break;
+    case AST_FOR:
+      for_data = node->data;
+      n += _size (for_data->from, calls) + _size (for_data->to, calls)
+           + _size (for_data->body, calls);
+      break;
+    case AST_FUNCALL:
+      fun_data = node->data;
+      if (fun_data->routine && calls
+          && !_called (calls, fun_data->routine))
+        dapush (calls, &fun_data->routine);
+      for (node = fun_data->args_head; node; node = node->next)
+        n += _size (node, calls);
+      break;
+    case AST_WRITE_ARG:
+      wa = node->data;
+      n += _size (wa->value, calls) + _size (wa->width, calls);
+      if (wa->decimals)
+        n += _size (wa->decimals, calls);
+      break;
+    case AST_OP:
+      op_data = node->data;
+      if (op_data->left)
+        n += _size (op_data->left, calls);
+      n += _size (op_data->right, calls);
+      break;
+    case AST_INDEX:
+      n += _size (((ast_data_index *)node->data)->index, calls);
+      break;
+    default:
+      break;
+    }
+  return n;
+}
+
+U32
+_size_list (ast_node *ptr, da *calls)
+{
+  U32 n = 0;
+
+  for (; ptr; ptr = ptr->next)
+    n += _size (ptr, calls);
+  return n;
+}
+
+U8
+_assigns (ast_node *ptr, ast_data_var_declare *var)
+{
+  ast_data_routine *routine;
+  ast_data_funcall *fun_data;
+  ast_data_cond *cond_data;
+  ast_node *param, *arg;
+
+  for (; ptr; ptr = ptr->next)
+    {
+      switch (ptr->type)
+        {
+        case AST_BLOCK:
+          if (_assigns (((ast_data_block *)ptr->data)->next, var))
+            return 1;
+          break;
+        case AST_VAR_ASSIGN:
+          if (((ast_data_var_assign *)ptr->data)->var->data == var)
+            return 1;
+          break;
+        case AST_COND:
+          cond_data = ptr->data;
+          if (_assigns (cond_data->yes, var)
+              || (cond_data->no && _assigns (cond_data->no, var)))
+            return 1;
+          break;
+        case AST_WHILE:
+          if (_assigns (((ast_data_while *)ptr->data)->next, var))
+            return 1;
+          break;
+        case AST_FOR:
+          if (((ast_data_for *)ptr->data)->var->data == var
+              || _assigns (((ast_data_for *)ptr->data)->body, var))
+            return 1;
+          break;
+        case AST_FUNCALL:
+          fun_data = ptr->data;
+          if (!fun_data->routine)
+            break;
+          routine = fun_data->routine->data;
+          for (param = routine->params, arg = fun_data->args_head; param;
+               param = param->next, arg = arg->next)
+            if ((((ast_data_var_declare *)param->data)->flags & AST_VAR_REF)
+                && arg->type == AST_VAR_DECLARE && arg->data == var)
+              return 1;
+          break;
+        default:
+          break;
+        }
+    }
+  return 0;
+}
+// }}}
+// [ Copies ] {{{
+ast_node *
+_clone (inliner *ic, da *map, ast_node *node)
+{
+  ast_data_var_assign *va_data, *va_copy;
+  ast_data_funcall *fun_data, *fun_copy;
+  ast_data_write_arg *wa, *wa_copy;
+  ast_data_cond *cond_data, *cond_copy;
+  ast_data_while *while_data, *while_copy;
+  ast_data_for *for_data, *for_copy;
+  ast_data_index *index, *index_copy;
+  ast_data_op *op_data, *op_copy;
+  ast_data_block *block;
+  ast_node *to, **link, *arg;
+
+  switch (node->type)
+    {
+    case AST_VAR_DECLARE:
+      to = _lookup (map, node->data);
+      if (to)
+        return _clone (ic, NULL, to);
+      return _node (ic, AST_VAR_DECLARE, node->data);
+    case AST_BLOCK:
+      block = aralloc (ic->ar, sizeof (ast_data_block));
+      block->next = _clone_list (ic, map, ((ast_data_block *)node->data)->next);
+      return _node (ic, AST_BLOCK, block);
+    case AST_VAR_ASSIGN:
+      va_data = node->data;
+      va_copy = aralloc (ic->ar, sizeof (ast_data_var_assign));
+      va_copy->var = _clone (ic, map, va_data->var);
+      va_copy->index = va_data->index ? _clone (ic, map, va_data->index) : NULL;
+      va_copy->value = _clone (ic, map, va_data->value);
+      /* A var parameter bound to an array element. */
+      if (va_copy->var->type == AST_INDEX)
+        {
+          va_copy->index = va_copy->var;
+          va_copy->var = ((ast_data_index *)va_copy->index->data)->var;
+        }
+      return _node (ic, AST_VAR_ASSIGN, va_copy);
+    case AST_COND:
+      cond_data = node->data;
+      cond_copy = aralloc (ic->ar, sizeof (ast_data_cond));
+      cond_copy->cond = _clone (ic, map, cond_data->cond);
+      cond_copy->yes = _clone (ic, map, cond_data->yes);
+      cond_copy->no = cond_data->no ? _clone (ic, map, cond_data->no) : NULL;
+      return _node (ic, AST_COND, cond_copy);
+    case AST_WHILE:
+      while_data = node->data;
+      while_copy = aralloc (ic->ar, sizeof (ast_data_while));
+      while_copy->cond = _clone (ic, map, while_data->cond);
+      while_copy->next = _clone (ic, map, while_data->next);
+      return _node (ic, AST_WHILE, while_copy);
+    case AST_FOR:
+      for_data = node->data;
+      for_copy = aralloc (ic->ar, sizeof (ast_data_for));
+      *for_copy = *for_data;
+      for_copy->var = _clone (ic, map, for_data->var);
+      for_copy->from = _clone (ic, map, for_data->from);
+      for_copy->to = _clone (ic, map, for_data->to);
+      for_copy->body = _clone (ic, map, for_data->body);
+      return _node (ic, AST_FOR, for_copy);
+    case AST_FUNCALL:
+      fun_data = node->data;
+      fun_copy = aralloc (ic->ar, sizeof (ast_data_funcall));
+      *fun_copy = *fun_data;
+      link = &fun_copy->args_head;
+      for (arg = fun_data->args_head; arg; arg = arg->next)
+        {
+          *link = _clone (ic, map, arg);
+          link = &(*link)->next;
+        }
+      *link = NULL;
+      return _node (ic, AST_FUNCALL, fun_copy);
+    case AST_WRITE_ARG:
+      wa = node->data;
+      wa_copy = aralloc (ic->ar, sizeof (ast_data_write_arg));
+      wa_copy->value = _clone (ic, map, wa->value);
+      wa_copy->width = _clone (ic, map, wa->width);
+      wa_copy->decimals = wa->decimals ? _clone (ic, map, wa->decimals) : NULL;
+      return _node (ic, AST_WRITE_ARG, wa_copy);
+    case AST_OP:
+      op_data = node->data;
+      op_copy = aralloc (ic->ar, sizeof (ast_data_op));
+      op_copy->op = op_data->op;
+      op_copy->left = op_data->left ? _clone (ic, map, op_data->left) : NULL;
+      op_copy->right = _clone (ic, map, op_data->right);
+      return _node (ic, AST_OP, op_copy);
+    case AST_INDEX:
+      index = node->data;
+      index_copy = aralloc (ic->ar, sizeof (ast_data_index));
+      index_copy->var = _clone (ic, map, index->var);
+      index_copy->index = _clone (ic, map, index->index);
+      index_copy->check = index->check;
+      return _node (ic, AST_INDEX, index_copy);
+    default:
+      /* Literals, never changed in place. */
+      return _node (ic, node->type, node->data);
+    }
+}
+
+ast_node *
+_clone_list (inliner *ic, da *map, ast_node *ptr)
+{
+  ast_node *head = NULL, **link = &head;
+
+  for (; ptr; ptr = ptr->next)
+    {
+      *link = _clone (ic, map, ptr);
+      link = &(*link)->next;
+    }
+  return head;
+}
+
+U8
+_called (da *calls, ast_node *routine)
+{
+  U32 i;
+
+  for (i = 0; i < calls->size; ++i)
+    if (*(ast_node **)dageti (calls, i) == routine)
+      return 1;
+  return 0;
+}
+
+ast_node *
+_lookup (da *map, void *var)
+{
+  inline_map *m;
+  U32 i;
+
+  if (!map)
+    return NULL;
+  for (i = 0; i < map->size; ++i)
+    {
+      m = dageti (map, i);
+      if (m->from == var)
+        return m->to;
+    }
+  return NULL;
+}
+// }}}
+// [ Nodes ] {{{
+ast_node *
+_fresh (inliner *ic, ast_data_var_declare *like, string *name)
+{
+  ast_data_var_declare *var = aralloc (ic->ar, sizeof (ast_data_var_declare));
+  ast_node *new = _node (ic, AST_VAR_DECLARE, var);
+  ast_data_routine *routine;
+  stringbuilder sb = { 0 };
+  ast_node **link;
+  char buf[16];
+
+  sprintf (buf, "_%u", ++ic->count);
+  sbinit (&sb, ic->ar);
+  sbappend (&sb, "__");
+  sbappend (&sb, name->data);
+  sbappend (&sb, buf);
+  var->name = sbflush (&sb);
+  var->datatype = like->datatype;
+  var->arsize = like->arsize;
+
+  if (ic->routine)
+    {
+      var->flags = AST_VAR_LOCAL;
+      routine = ic->routine->data;
+      for (link = &routine->locals; *link; link = &(*link)->next)
+        ;
+      *link = new;
+    }
+  else
+    {
+      var->flags = 0;
+      *ic->decls_end = new;
+      ic->decls_end = &new->next;
+    }
+  return new;
+}
+
+ast_node *
+_node (inliner *ic, enum ast_type type, void *data)
+{
+  ast_node *new = aralloc (ic->ar, sizeof (ast_node));
+
+  new->type = type;
+  new->next = NULL;
+  new->data = data;
+  return new;
+}
+
+ast_node *
+_use (inliner *ic, ast_node *var)
+{
+  return _node (ic, AST_VAR_DECLARE, var->data);
+}
+
+ast_node *
+_assign (inliner *ic, ast_node *var, ast_node *value)
+{
+  ast_data_var_assign *data = aralloc (ic->ar, sizeof (ast_data_var_assign));
+
+  data->var = var;
+  data->index = NULL;
+  data->value = value;
+  return _node (ic, AST_VAR_ASSIGN, data);
+}
+
+ast_node *
+_zero (inliner *ic, ast_data_var_declare *var)
+{
+  string *str;
+  long *i;
+  double *f;
+  U16 *b;
+
+  switch (var->datatype)
+    {
+    case AST_FLOATLIT:
+      f = aralloc (ic->ar, sizeof (double));
+      *f = 0.0;
+      return _node (ic, AST_FLOATLIT, f);
+    case AST_BOOL:
+      b = aralloc (ic->ar, sizeof (U16));
+      *b = 0;
+      return _node (ic, AST_BOOL, b);
+    case AST_STRLIT:
+      str = aralloc (ic->ar, sizeof (string));
+      str->data = aralloc (ic->ar, 1);
+      str->data[0] = '\0';
+      str->size = 0;
+      return _node (ic, AST_STRLIT, str);
+    default:
+      i = aralloc (ic->ar, sizeof (long));
+      *i = 0;
+      return _node (ic, AST_INTLIT, i);
+    }
+}
+
+void
+_pre_append (inline_pre *pre, ast_node *s)
+{
+  if (!pre->head)
+    pre->head = s;
+  else
+    pre->tail->next = s;
+  for (pre->tail = s; pre->tail->next; pre->tail = pre->tail->next)
+    ;
+}
+// }}}
+
+// vim:fdm=marker:
@@ -0,0 +1,33 @@
+#ifndef INLINE_H
+#define INLINE_H
+
+#include "ast.h"
+
+/* Replace every call of a routine of program CTX->root that is not
+   recursive and whose body has at most BUDGET nodes by a copy of that
+   body, and drop the routines left without calls.
+
+   Value parameters, locals and results become fresh variables, named
+   "__NAME_N" so that no program can use them; var parameters read and
+   write the caller's variable directly.  Function calls in expressions
+   are evaluated into their result before the statement holding them, a
+   while condition again at the end of every trip.
+
+   The copies add at most INLINE_LIMIT nodes to the program, the calls
+   past that are kept.  Returns 1 when some were, 0 otherwise. */
+int inline_calls (ast *ctx, U32 budget);
+
+/* Budget of inline_calls for optimization level OPT, 0 inlines
+   nothing. */
+#define INLINE_BUDGET(opt)                                                    \
+  ((opt) == 0 ? 0 : (opt) == 1 ? 24 : (opt) == 2 ? 64 : 160)
+
+/* Budget to inline everything but recursion, for the backends lowering
+   a single function. */
+#define INLINE_ALL ((U32)-1)
+
+/* Nodes inlining may add to a program, a routine calling the one before
+   it twice doubles with each level. */
+#define INLINE_LIMIT 65536
+
+#endif /* not INLINE_H */
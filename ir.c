@@ -0,0 +1,1403 @@
+#include "ir.h"
+#include "utils.h"
+
+/* Longest constant width a string literal is padded to while lowering,
+   wider ones are left to the runtime. */
+#define IR_MAX_PAD 256
+
+typedef struct
+{
+  ir_func *fn;
+  ir_block *bb;
+  ht vars;
+} ir_lower_ctx;
+
+const char *const ir_runtime_names[IR_RT_COUNT] = {
+  [IR_RT_WRITE_INT] = "_P__p_write_int",
+  [IR_RT_WRITE_REAL] = "_P__p_write_real",
+  [IR_RT_WRITE_STR] = "_P__p_write_str",
+  [IR_RT_WRITE_INT_W] = "_P__p_write_int_w",
+  [IR_RT_WRITE_REAL_W] = "_P__p_write_real_w",
+  [IR_RT_WRITE_FIXED] = "_P__p_write_fixed",
+  [IR_RT_WRITE_STR_W] = "_P__p_write_str_w",
+  [IR_RT_LENGTH] = "_P__p_length",
+  [IR_RT_CONCAT] = "_P__p_concat",
+  [IR_RT_DROP] = "_P__p_drop",
+  [IR_RT_TAKE] = "_P__p_take",
+  [IR_RT_DUP] = "_P__p_dup",
+  [IR_RT_FREE] = "_P__p_free",
+  [IR_RT_APPEND] = "_P__p_append",
+  [IR_RT_COMPARE] = "_P__p_compare",
+  [IR_RT_ARRAY] = "_P__p_array",
+  [IR_RT_BOUNDS] = "_P__p_bounds",
+};
+
+/* Mnemonic and number of a/b operands of each op. */
+static const struct
+{
+  const char *name;
+  U8 nsrc;
+} _ir_ops[IR_OP_COUNT] = {
+  [IR_NOP] = { "nop", 0 },   [IR_CONST] = { "const", 0 },
+  [IR_MOV] = { "mov", 1 },   [IR_ADD] = { "add", 2 },
+  [IR_SUB] = { "sub", 2 },   [IR_MUL] = { "mul", 2 },
+  [IR_DIV] = { "div", 2 },   [IR_MOD] = { "mod", 2 },
+  [IR_NEG] = { "neg", 1 },   [IR_NOT] = { "not", 1 },
+  [IR_LT] = { "lt", 2 },     [IR_LE] = { "le", 2 },
+  [IR_GT] = { "gt", 2 },     [IR_GE] = { "ge", 2 },
+  [IR_EQ] = { "eq", 2 },     [IR_NE] = { "ne", 2 },
+  [IR_ITOF] = { "itof", 1 }, [IR_LOAD] = { "load", 2 },
+  [IR_STORE] = { "store", 2 }, [IR_CALL] = { "call", 0 },
+  [IR_PHI] = { "phi", 0 },   [IR_JMP] = { "jmp", 0 },
+  [IR_BR] = { "br", 1 },     [IR_RET] = { "ret", 0 },
+};
+
+static const char *const _ir_type_names[]
+    = { [IR_VOID] = "void", [IR_INT] = "int", [IR_REAL] = "real",
+        [IR_BOOL] = "bool", [IR_STR] = "str", [IR_PTR] = "ptr" };
+
+/* Lower statement list starting at PTR. */
+static int _lower_stmts (ir_lower_ctx *ctx, ast_node *ptr);
+
+/* Lower expression and return the vreg holding its value. */
+static U32 _lower_exp (ir_lower_ctx *ctx, ast_node *ptr);
+
+/* Lower write/writeln call. */
+static int _lower_write (ir_lower_ctx *ctx, ast_data_funcall *data, U8 ln);
+
+/* Write the LEN bytes of TEXT, escapes resolved, and reset LEN.  Nothing
+   is written when LEN is 0. */
+static void _write_text (ir_lower_ctx *ctx, const char *text, U32 *len);
+
+/* Call runtime function CALLEE with the NARGS vregs in ARGS. */
+static ir_insn *_call (ir_lower_ctx *ctx, U8 callee, U8 nargs,
+                       const U32 *args);
+
+/* Call runtime function CALLEE for a result of TYPE.  Returns its vreg. */
+static U32 _call_value (ir_lower_ctx *ctx, U8 callee, U8 type, U8 nargs,
+                        const U32 *args);
+
+/* Lower a call of a builtin function in an expression. */
+static U32 _lower_builtin (ir_lower_ctx *ctx, ast_data_funcall *data);
+
+/* Report call DATA of a routine left by the inliner.  Returns 1. */
+static int _not_inlined (ast_data_funcall *data);
+
+/* Report bounds of the for loop over VAR that are not integers.  Returns
+   1. */
+static int _bad_bounds (ast_data_var_declare *var);
+
+/* Lower the index of array element DATA, branching to a bounds error
+   unless it was proven in range.  Returns the index vreg and sets BASE
+   to the array. */
+static U32 _lower_index (ir_lower_ctx *ctx, ast_data_index *data, U32 *base);
+
+/* Lower FOR loop DATA: the initial and final values are copied in that
+   order before the loop, which is entered when they are in order.  The
+   end of the body leaves on reaching the final value and steps the
+   control variable by one otherwise, never past it. */
+static int _lower_for (ir_lower_ctx *ctx, ast_data_for *data);
+
+/* Lower string operator OP of DATA on A and B. */
+static U32 _lower_str_op (ir_lower_ctx *ctx, ast_data_op *data, U8 op,
+                          U32 a, U32 b);
+
+/* Lower assigning string expression VALUE to variable VAR, held in DST.
+   A variable owns its string: the old one is freed, another variable
+   or a literal is copied first, and VAR := VAR + X appends in place. */
+static int _lower_str_assign (ir_lower_ctx *ctx, ast_data_var_declare *var,
+                              U32 dst, ast_node *value);
+
+/* Free string V after its last use when expression EXP made it, rather
+   than reading a variable or literal. */
+static void _free_temp (ir_lower_ctx *ctx, ast_node *exp, U32 v);
+
+/* Width of a string literal written with a constant one, padded at
+   compile time.  0 for plain literals, -1 for anything else. */
+static long _literal_width (ast_node *arg);
+
+/* Convert V to TYPE if needed. */
+static U32 _coerce (ir_lower_ctx *ctx, U32 v, U8 type);
+
+/* Emit constant string STR into a new vreg. */
+static U32 _const_str (ir_lower_ctx *ctx, char *str);
+
+/* Map AST datatype to IR type. */
+static U8 _ir_type_of (U16 datatype);
+
+/* Map AST operator to IR op. */
+static U8 _ir_op_of (U8 op);
+
+/* Visit BB and its successors, appending BB to ORDER after them. */
+static void _postorder (ir_block *bb, da *order, U8 *seen);
+
+/* Print vreg I. */
+static void _dump_vreg (ir_func *fn, U32 i, FILE *out);
+
+int
+ir_init (ir_func *fn)
+{
+  ir_vreg none = { 0 };
+
+  fn->next_block_id = 0;
+  if (dainit (&fn->blocks, &fn->ar, sizeof (ir_block *), 16)
+      || dainit (&fn->vregs, &fn->ar, sizeof (ir_vreg), 64))
+    return 1;
+
+  /* Reserve IR_NONE. */
+  return daappend (&fn->vregs, &none);
+}
+
+U32
+ir_new_vreg (ir_func *fn, U8 type, string *name)
+{
+  ir_vreg v;
+
+  v.name = name;
+  v.type = type;
+  v.base = fn->vregs.size;
+  daappend (&fn->vregs, &v);
+
+  return v.base;
+}
+
+ir_vreg *
+ir_vreg_get (ir_func *fn, U32 i)
+{
+  return dageti (&fn->vregs, i);
+}
+
+ir_block *
+ir_new_block (ir_func *fn)
+{
+  ir_block *bb = aralloc (&fn->ar, sizeof (ir_block));
+
+  memset (bb, 0, sizeof (ir_block));
+  bb->id = fn->next_block_id++;
+  dainit (&bb->preds, &fn->ar, sizeof (ir_block *), 4);
+  dainit (&bb->succs, &fn->ar, sizeof (ir_block *), 2);
+  daappend (&fn->blocks, &bb);
+
+  return bb;
+}
+
+ir_block *
+ir_block_get (ir_func *fn, U32 i)
+{
+  return *(ir_block **)dageti (&fn->blocks, i);
+}
+
+static ir_insn *
+_ir_new_insn (ir_func *fn, U8 op)
+{
+  ir_insn *in = aralloc (&fn->ar, sizeof (ir_insn));
+
+  memset (in, 0, sizeof (ir_insn));
+  in->op = op;
+  return in;
+}
+
+ir_insn *
+ir_append (ir_func *fn, ir_block *bb, U8 op)
+{
+  ir_insn *in = _ir_new_insn (fn, op);
+
+  in->block = bb;
+  in->prev = bb->tail;
+  if (bb->tail)
+    bb->tail->next = in;
+  else
+    bb->head = in;
+  bb->tail = in;
+
+  return in;
+}
+
+ir_insn *
+ir_insert_before (ir_func *fn, ir_insn *pos, U8 op)
+{
+  ir_insn *in = _ir_new_insn (fn, op);
+
+  ir_move_before (in, pos);
+  return in;
+}
+
+void
+ir_remove (ir_insn *in)
+{
+  if (in->prev)
+    in->prev->next = in->next;
+  else
+    in->block->head = in->next;
+
+  if (in->next)
+    in->next->prev = in->prev;
+  else
+    in->block->tail = in->prev;
+
+  in->prev = in->next = NULL;
+}
+
+void
+ir_move_before (ir_insn *in, ir_insn *pos)
+{
+  in->block = pos->block;
+  in->next = pos;
+  in->prev = pos->prev;
+  if (pos->prev)
+    pos->prev->next = in;
+  else
+    pos->block->head = in;
+  pos->prev = in;
+}
+
+U8
+ir_op_nsrc (U8 op)
+{
+  return _ir_ops[op].nsrc;
+}
+
+const char *
+ir_op_name (U8 op)
+{
+  return _ir_ops[op].name;
+}
+
+U8
+ir_is_terminator (U8 op)
+{
+  return op == IR_JMP || op == IR_BR || op == IR_RET;
+}
+
+U8
+ir_has_side_effects (ir_insn *in)
+{
+  return in->op == IR_CALL || in->op == IR_STORE
+         || ir_is_terminator (in->op);
+}
+
+void
+ir_for_each_use (ir_insn *in, void (*fn) (U32 *use, void *arg), void *arg)
+{
+  U32 i;
+
+  if (_ir_ops[in->op].nsrc > 0 && in->a != IR_NONE)
+    fn (&in->a, arg);
+  if (_ir_ops[in->op].nsrc > 1 && in->b != IR_NONE)
+    fn (&in->b, arg);
+
+  if (in->op == IR_CALL || in->op == IR_PHI || in->op == IR_STORE)
+    for (i = 0; i < in->nargs; ++i)
+      if (in->args[i] != IR_NONE)
+        fn (&in->args[i], arg);
+}
+
+// [ Lowering ] {{{
+int
+ir_lower (ir_func *fn, ast_node *root)
+{
+  ir_lower_ctx ctx = { 0 };
+  ast_data_var_declare *var;
+  ir_insn *in;
+  U32 v, c;
+  int err = 0;
+
+  ctx.fn = fn;
+  htinit (&ctx.vars, &fn->ar, 64, sizeof (U32));
+  ctx.bb = ir_new_block (fn);
+
+  for (; root && !err; root = root->next)
+    {
+      switch (root->type)
+        {
+        case AST_PROGNAME:
+          break;
+        case AST_VAR_DECLARE:
+          var = root->data;
+          if (var->arsize > 0 && var->datatype != AST_STRLIT)
+            {
+              /* Arrays come zeroed from the runtime. */
+              in = ir_append (fn, ctx.bb, IR_CONST);
+              in->type = IR_INT;
+              in->imm.i = var->arsize;
+              in->dst = ir_new_vreg (fn, IR_INT, NULL);
+              v = _call_value (&ctx, IR_RT_ARRAY, IR_PTR, 1, &in->dst);
+              stput (&ctx.vars, var->name->data, &v);
+              break;
+            }
+
+          v = ir_new_vreg (fn, _ir_type_of (var->datatype), var->name);
+          stput (&ctx.vars, var->name->data, &v);
+
+          /* Every variable starts out defined, as zero. */
+          if (var->datatype == AST_STRLIT)
+            {
+              c = _const_str (&ctx, "");
+              in = ir_append (fn, ctx.bb, IR_MOV);
+              in->a = c;
+            }
+          else
+            {
+              in = ir_append (fn, ctx.bb, IR_CONST);
+              in->imm.i = 0;
+              if (var->datatype == AST_FLOATLIT)
+                in->imm.f = 0.0;
+            }
+          in->dst = v;
+          in->type = _ir_type_of (var->datatype);
+          break;
+        case AST_ROUTINE:
+          /* Only reached through the calls, inlined before. */
+          break;
+        case AST_MAIN_BLOCK:
+          err = _lower_stmts (&ctx, ((ast_data_block *)root->data)->next);
+          break;
+        default:
+          fprintf (stderr, "Error: Unexpected top-level node %d in IR.\n",
+                   root->type);
+          err = 1;
+          break;
+        }
+    }
+
+  ir_append (fn, ctx.bb, IR_RET);
+  ir_build_cfg (fn);
+
+  return err;
+}
+
+static int
+_lower_stmts (ir_lower_ctx *ctx, ast_node *ptr)
+{
+  ast_data_var_assign *va_data;
+  ast_data_var_declare *var;
+  ast_data_cond *cond_data;
+  ast_data_while *while_data;
+  ast_data_funcall *fun_data;
+  ir_block *yes, *no, *join, *head;
+  ir_insn *in;
+  U32 v, dst, idx;
+
+  for (; ptr; ptr = ptr->next)
+    {
+      switch (ptr->type)
+        {
+        case AST_BLOCK:
+          if (_lower_stmts (ctx, ((ast_data_block *)ptr->data)->next))
+            return 1;
+          break;
+        case AST_VAR_ASSIGN:
+          va_data = ptr->data;
+          var = va_data->var->data;
+          if (va_data->index)
+            {
+              if (!(idx = _lower_index (ctx, va_data->index->data, &dst)))
+                return 1;
+              if (!(v = _lower_exp (ctx, va_data->value)))
+                return 1;
+              v = _coerce (ctx, v, _ir_type_of (var->datatype));
+              in = ir_append (ctx->fn, ctx->bb, IR_STORE);
+              in->a = dst;
+              in->b = idx;
+              in->type = _ir_type_of (var->datatype);
+              in->nargs = 1;
+              in->args = aralloc (&ctx->fn->ar, sizeof (U32));
+              in->args[0] = v;
+              break;
+            }
+          dst = *(U32 *)stget (&ctx->vars, var->name->data);
+          if (ir_vreg_get (ctx->fn, dst)->type == IR_STR)
+            {
+              if (_lower_str_assign (ctx, var, dst, va_data->value))
+                return 1;
+              break;
+            }
+
+          v = _lower_exp (ctx, va_data->value);
+          if (!v)
+            return 1;
+          v = _coerce (ctx, v, ir_vreg_get (ctx->fn, dst)->type);
+
+          /* Retarget a fresh temporary instead of copying it. */
+          in = ctx->bb->tail;
+          if (in && in->dst == v && !ir_vreg_get (ctx->fn, v)->name
+              && ir_vreg_get (ctx->fn, v)->type
+                     == ir_vreg_get (ctx->fn, dst)->type)
+            {
+              in->dst = dst;
+            }
+          else
+            {
+              in = ir_append (ctx->fn, ctx->bb, IR_MOV);
+              in->dst = dst;
+              in->a = v;
+              in->type = ir_vreg_get (ctx->fn, dst)->type;
+            }
+          break;
+        case AST_COND:
+          cond_data = ptr->data;
+          v = _lower_exp (ctx, cond_data->cond);
+          if (!v)
+            return 1;
+
+          yes = ir_new_block (ctx->fn);
+          no = NULL;
+          if (cond_data->no)
+            no = ir_new_block (ctx->fn);
+          join = ir_new_block (ctx->fn);
+
+          in = ir_append (ctx->fn, ctx->bb, IR_BR);
+          in->a = v;
+          in->t = yes;
+          in->f = no ? no : join;
+
+          ctx->bb = yes;
+          if (_lower_stmts (ctx, cond_data->yes))
+            return 1;
+          ir_append (ctx->fn, ctx->bb, IR_JMP)->t = join;
+
+          if (no)
+            {
+              ctx->bb = no;
+              if (_lower_stmts (ctx, cond_data->no))
+                return 1;
+              ir_append (ctx->fn, ctx->bb, IR_JMP)->t = join;
+            }
+
+          ctx->bb = join;
+          break;
+        case AST_WHILE:
+          while_data = ptr->data;
+          head = ir_new_block (ctx->fn);
+          ir_append (ctx->fn, ctx->bb, IR_JMP)->t = head;
+
+          ctx->bb = head;
+          v = _lower_exp (ctx, while_data->cond);
+          if (!v)
+            return 1;
+
+          yes = ir_new_block (ctx->fn);
+          join = ir_new_block (ctx->fn);
+          in = ir_append (ctx->fn, ctx->bb, IR_BR);
+          in->a = v;
+          in->t = yes;
+          in->f = join;
+
+          ctx->bb = yes;
+          if (_lower_stmts (ctx, while_data->next))
+            return 1;
+          ir_append (ctx->fn, ctx->bb, IR_JMP)->t = head;
+
+          ctx->bb = join;
+          break;
+        case AST_FOR:
+          if (_lower_for (ctx, ptr->data))
+            return 1;
+          break;
+        case AST_FUNCALL:
+          fun_data = ptr->data;
+          if (fun_data->routine)
+            return _not_inlined (fun_data);
+          if (streq (fun_data->name->data, "writeln"))
+            {
+              if (_lower_write (ctx, fun_data, 1))
+                return 1;
+            }
+          else if (streq (fun_data->name->data, "write"))
+            {
+              if (_lower_write (ctx, fun_data, 0))
+                return 1;
+            }
+          else
+            {
+              fprintf (stderr, "Error: Unknown procedure \"%s\".\n",
+                       fun_data->name->data);
+              return 1;
+            }
+          break;
+        default:
+          fprintf (stderr, "Error: Unexpected statement %d in IR.\n",
+                   ptr->type);
+          return 1;
+        }
+    }
+
+  return 0;
+}
+
+static int
+_lower_write (ir_lower_ctx *ctx, ast_data_funcall *data, U8 ln)
+{
+  ast_node *arg, *value;
+  ast_data_write_arg *wa;
+  string *lit;
+  char *text;
+  long width;
+  U32 args[3], size = ln, n = 0, len, i;
+  U8 callee, nargs;
+
+  /* Runs of literals, the newline and constant padding included, are
+     written by one call. */
+  for (arg = data->args_head; arg; arg = arg->next)
+    if ((width = _literal_width (arg)) >= 0)
+      {
+        value = arg->type == AST_WRITE_ARG
+                    ? ((ast_data_write_arg *)arg->data)->value
+                    : arg;
+        size += ((string *)value->data)->size + width;
+      }
+  text = aralloc (&ctx->fn->ar, size + 1);
+
+  for (arg = data->args_head; arg; arg = arg->next)
+    {
+      wa = arg->type == AST_WRITE_ARG ? arg->data : NULL;
+      value = wa ? wa->value : arg;
+
+      if ((width = _literal_width (arg)) >= 0)
+        {
+          lit = value->data;
+          len = strnlen (text + n, unescape (text + n, lit->data, lit->size));
+          if (width > (long)len)
+            {
+              memmove (text + n + width - len, text + n, len);
+              memset (text + n, ' ', width - len);
+              len = width;
+            }
+          n += len;
+          continue;
+        }
+      _write_text (ctx, text, &n);
+
+      args[0] = _lower_exp (ctx, value);
+      if (!args[0])
+        return 1;
+      nargs = 1;
+      if (wa)
+        {
+          args[nargs++] = _lower_exp (ctx, wa->width);
+          if (wa->decimals
+              && ir_vreg_get (ctx->fn, args[0])->type == IR_REAL)
+            args[nargs++] = _lower_exp (ctx, wa->decimals);
+          for (i = 1; i < nargs; ++i)
+            {
+              if (!args[i])
+                return 1;
+              if (ir_vreg_get (ctx->fn, args[i])->type != IR_INT)
+                {
+                  fprintf (stderr, "Error: Field width of \"%s\" must be "
+                                   "an integer.\n",
+                           data->name->data);
+                  return 1;
+                }
+            }
+        }
+
+      switch (ir_vreg_get (ctx->fn, args[0])->type)
+        {
+        case IR_REAL:
+          callee = nargs == 3   ? IR_RT_WRITE_FIXED
+                   : nargs == 2 ? IR_RT_WRITE_REAL_W
+                                : IR_RT_WRITE_REAL;
+          break;
+        case IR_STR:
+          callee = nargs == 2 ? IR_RT_WRITE_STR_W : IR_RT_WRITE_STR;
+          break;
+        default:
+          callee = nargs == 2 ? IR_RT_WRITE_INT_W : IR_RT_WRITE_INT;
+          break;
+        }
+      _call (ctx, callee, nargs, args);
+      _free_temp (ctx, value, args[0]);
+    }
+
+  if (ln)
+    text[n++] = '\n';
+  _write_text (ctx, text, &n);
+
+  arfree (text);
+  return 0;
+}
+
+static void
+_write_text (ir_lower_ctx *ctx, const char *text, U32 *len)
+{
+  char *lit;
+  U32 v;
+
+  if (*len == 0)
+    return;
+
+  lit = aralloc (&ctx->fn->ar, 4 * *len + 1);
+  lit[escape (lit, text, *len)] = '\0';
+  v = _const_str (ctx, lit);
+  _call (ctx, IR_RT_WRITE_STR, 1, &v);
+  arfree (lit);
+  *len = 0;
+}
+
+static ir_insn *
+_call (ir_lower_ctx *ctx, U8 callee, U8 nargs, const U32 *args)
+{
+  ir_insn *in = ir_append (ctx->fn, ctx->bb, IR_CALL);
+
+  in->callee = callee;
+  in->nargs = nargs;
+  in->args = aralloc (&ctx->fn->ar, nargs * sizeof (U32));
+  memcpy (in->args, args, nargs * sizeof (U32));
+  return in;
+}
+
+static U32
+_call_value (ir_lower_ctx *ctx, U8 callee, U8 type, U8 nargs,
+             const U32 *args)
+{
+  ir_insn *in = _call (ctx, callee, nargs, args);
+
+  in->type = type;
+  in->dst = ir_new_vreg (ctx->fn, type, NULL);
+  return in->dst;
+}
+
+static U32
+_lower_builtin (ir_lower_ctx *ctx, ast_data_funcall *data)
+{
+  ast_node *arg;
+  ir_insn *in;
+  U32 args[3], n = 0, one, s, v;
+
+  for (arg = data->args_head; arg && n < 3; arg = arg->next)
+    if (!(args[n++] = _lower_exp (ctx, arg)))
+      return IR_NONE;
+
+  if (ir_vreg_get (ctx->fn, args[0])->type != IR_STR
+      || (n == 3
+          && (ir_vreg_get (ctx->fn, args[1])->type != IR_INT
+              || ir_vreg_get (ctx->fn, args[2])->type != IR_INT)))
+    {
+      fprintf (stderr, "Error: Bad arguments to \"%s\".\n",
+               data->name->data);
+      return IR_NONE;
+    }
+
+  if (streq (data->name->data, "length"))
+    {
+      v = _call_value (ctx, IR_RT_LENGTH, IR_INT, 1, args);
+      _free_temp (ctx, data->args_head, args[0]);
+      return v;
+    }
+
+  /* copy (s, index, count) takes COUNT characters of S without its first
+     INDEX - 1. */
+  in = ir_append (ctx->fn, ctx->bb, IR_CONST);
+  in->type = IR_INT;
+  in->imm.i = 1;
+  in->dst = one = ir_new_vreg (ctx->fn, IR_INT, NULL);
+  in = ir_append (ctx->fn, ctx->bb, IR_SUB);
+  in->a = args[1];
+  in->b = one;
+  in->type = IR_INT;
+  in->dst = args[1] = ir_new_vreg (ctx->fn, IR_INT, NULL);
+  s = _call_value (ctx, IR_RT_DROP, IR_STR, 2, args);
+  _free_temp (ctx, data->args_head, args[0]);
+  args[0] = s;
+  args[1] = args[2];
+  v = _call_value (ctx, IR_RT_TAKE, IR_STR, 2, args);
+  _call (ctx, IR_RT_FREE, 1, &s);
+  return v;
+}
+
+static int
+_not_inlined (ast_data_funcall *data)
+{
+  fprintf (stderr,
+           "Error: Call of \"%s\" was not inlined, recursive routines "
+           "need the C backend.\n",
+           data->name->data);
+  return 1;
+}
+
+static int
+_bad_bounds (ast_data_var_declare *var)
+{
+  fprintf (stderr,
+           "Error: Bounds of for loop over \"%s\" are not integers.\n",
+           var->name->data);
+  return 1;
+}
+
+static U32
+_lower_index (ir_lower_ctx *ctx, ast_data_index *data, U32 *base)
+{
+  ast_data_var_declare *var = data->var->data;
+  ir_block *fail, *ok;
+  ir_insn *in;
+  U32 idx, bound[2], i;
+
+  *base = *(U32 *)stget (&ctx->vars, var->name->data);
+  idx = _lower_exp (ctx, data->index);
+  if (!idx)
+    return IR_NONE;
+  if (ir_vreg_get (ctx->fn, idx)->type != IR_INT)
+    {
+      fprintf (stderr, "Error: Index of array \"%s\" is not an integer.\n",
+               var->name->data);
+      return IR_NONE;
+    }
+  if (!data->check)
+    return idx;
+
+  /* Out of bounds when idx < 0 or idx >= size. */
+  for (i = 0; i < 2; ++i)
+    {
+      in = ir_append (ctx->fn, ctx->bb, IR_CONST);
+      in->type = IR_INT;
+      in->imm.i = i ? (long)var->arsize : 0;
+      in->dst = bound[i] = ir_new_vreg (ctx->fn, IR_INT, NULL);
+    }
+
+  fail = ir_new_block (ctx->fn);
+  for (i = 0; i < 2; ++i)
+    {
+      in = ir_append (ctx->fn, ctx->bb, i ? IR_GE : IR_LT);
+      in->a = idx;
+      in->b = bound[i];
+      in->type = IR_BOOL;
+      in->dst = ir_new_vreg (ctx->fn, IR_BOOL, NULL);
+
+      ok = ir_new_block (ctx->fn);
+      in = ir_append (ctx->fn, ctx->bb, IR_BR);
+      in->a = in->prev->dst;
+      in->t = fail;
+      in->f = ok;
+      ctx->bb = ok;
+    }
+
+  /* The runtime exits, the return only ends the block. */
+  ok = ctx->bb;
+  ctx->bb = fail;
+  bound[0] = idx;
+  _call (ctx, IR_RT_BOUNDS, 2, bound);
+  ir_append (ctx->fn, ctx->bb, IR_RET);
+  ctx->bb = ok;
+
+  return idx;
+}
+
+static int
+_lower_for (ir_lower_ctx *ctx, ast_data_for *data)
+{
+  ast_data_var_declare *var = data->var->data;
+  ir_block *enter, *body, *step, *exit;
+  ir_insn *in;
+  U32 i, from, to, one;
+
+  i = *(U32 *)stget (&ctx->vars, var->name->data);
+  if (!(from = _lower_exp (ctx, data->from)))
+    return 1;
+  if (ir_vreg_get (ctx->fn, from)->type != IR_INT)
+    return _bad_bounds (var);
+  /* The final value may assign the variables of the initial one, and the
+     body those of either. */
+  in = ir_append (ctx->fn, ctx->bb, IR_MOV);
+  in->dst = ir_new_vreg (ctx->fn, IR_INT, NULL);
+  in->a = from;
+  in->type = IR_INT;
+  from = in->dst;
+  if (!(to = _lower_exp (ctx, data->to)))
+    return 1;
+  if (ir_vreg_get (ctx->fn, to)->type != IR_INT)
+    return _bad_bounds (var);
+  in = ir_append (ctx->fn, ctx->bb, IR_MOV);
+  in->dst = ir_new_vreg (ctx->fn, IR_INT, NULL);
+  in->a = to;
+  in->type = IR_INT;
+  to = in->dst;
+
+  enter = ir_new_block (ctx->fn);
+  body = ir_new_block (ctx->fn);
+  step = ir_new_block (ctx->fn);
+  exit = ir_new_block (ctx->fn);
+  in = ir_append (ctx->fn, ctx->bb, data->down ? IR_GE : IR_LE);
+  in->a = from;
+  in->b = to;
+  in->type = IR_BOOL;
+  in->dst = ir_new_vreg (ctx->fn, IR_BOOL, NULL);
+  in = ir_append (ctx->fn, ctx->bb, IR_BR);
+  in->a = in->prev->dst;
+  in->t = enter;
+  in->f = exit;
+
+  ctx->bb = enter;
+  in = ir_append (ctx->fn, ctx->bb, IR_MOV);
+  in->dst = i;
+  in->a = from;
+  in->type = IR_INT;
+  ir_append (ctx->fn, ctx->bb, IR_JMP)->t = body;
+
+  ctx->bb = body;
+  if (_lower_stmts (ctx, data->body))
+    return 1;
+  in = ir_append (ctx->fn, ctx->bb, data->down ? IR_LE : IR_GE);
+  in->a = i;
+  in->b = to;
+  in->type = IR_BOOL;
+  in->dst = ir_new_vreg (ctx->fn, IR_BOOL, NULL);
+  in = ir_append (ctx->fn, ctx->bb, IR_BR);
+  in->a = in->prev->dst;
+  in->t = exit;
+  in->f = step;
+
+  ctx->bb = step;
+  in = ir_append (ctx->fn, ctx->bb, IR_CONST);
+  in->type = IR_INT;
+  in->imm.i = 1;
+  in->dst = one = ir_new_vreg (ctx->fn, IR_INT, NULL);
+  in = ir_append (ctx->fn, ctx->bb, data->down ? IR_SUB : IR_ADD);
+  in->dst = i;
+  in->a = i;
+  in->b = one;
+  in->type = IR_INT;
+  ir_append (ctx->fn, ctx->bb, IR_JMP)->t = body;
+
+  ctx->bb = exit;
+  return 0;
+}
+
+static U32
+_lower_str_op (ir_lower_ctx *ctx, ast_data_op *data, U8 op, U32 a, U32 b)
+{
+  ir_insn *in;
+  U32 args[2] = { a, b }, zero, v;
+
+  if (ir_vreg_get (ctx->fn, a)->type != IR_STR
+      || ir_vreg_get (ctx->fn, b)->type != IR_STR
+      || (op != IR_ADD && !(op >= IR_LT && op <= IR_NE)))
+    {
+      fprintf (stderr, "Error: Bad operands of string operator.\n");
+      return IR_NONE;
+    }
+  v = _call_value (ctx, op == IR_ADD ? IR_RT_CONCAT : IR_RT_COMPARE,
+                   op == IR_ADD ? IR_STR : IR_INT, 2, args);
+  _free_temp (ctx, data->left, a);
+  _free_temp (ctx, data->right, b);
+  if (op == IR_ADD)
+    return v;
+
+  /* Compare the result of _P__p_compare with 0. */
+  in = ir_append (ctx->fn, ctx->bb, IR_CONST);
+  in->type = IR_INT;
+  in->imm.i = 0;
+  in->dst = zero = ir_new_vreg (ctx->fn, IR_INT, NULL);
+  in = ir_append (ctx->fn, ctx->bb, op);
+  in->a = v;
+  in->b = zero;
+  in->type = IR_BOOL;
+  in->dst = ir_new_vreg (ctx->fn, IR_BOOL, NULL);
+  return in->dst;
+}
+
+static int
+_lower_str_assign (ir_lower_ctx *ctx, ast_data_var_declare *var, U32 dst,
+                   ast_node *value)
+{
+  ast_data_op *op_data = value->data;
+  ast_node *left = NULL;
+  ir_insn *in;
+  U32 args[2];
+
+  if (value->type == AST_OP && op_data->op == '+')
+    left = op_data->left;
+  if (left && left->type == AST_VAR_DECLARE && left->data == var)
+    {
+      args[0] = dst;
+      if (!(args[1] = _lower_exp (ctx, op_data->right)))
+        return 1;
+      if (ir_vreg_get (ctx->fn, args[1])->type != IR_STR)
+        {
+          fprintf (stderr, "Error: Bad operands of string operator.\n");
+          return 1;
+        }
+      in = _call (ctx, IR_RT_APPEND, 2, args);
+      in->type = IR_STR;
+      in->dst = dst;
+      _free_temp (ctx, op_data->right, args[1]);
+      return 0;
+    }
+
+  if (!(args[0] = _lower_exp (ctx, value)))
+    return 1;
+  if (ir_vreg_get (ctx->fn, args[0])->type != IR_STR)
+    {
+      fprintf (stderr, "Error: Assigning a non-string to \"%s\".\n",
+               var->name->data);
+      return 1;
+    }
+  if (value->type != AST_OP && value->type != AST_FUNCALL)
+    args[0] = _call_value (ctx, IR_RT_DUP, IR_STR, 1, args);
+  _call (ctx, IR_RT_FREE, 1, &dst);
+  in = ir_append (ctx->fn, ctx->bb, IR_MOV);
+  in->dst = dst;
+  in->a = args[0];
+  in->type = IR_STR;
+  return 0;
+}
+
+static void
+_free_temp (ir_lower_ctx *ctx, ast_node *exp, U32 v)
+{
+  if (ir_vreg_get (ctx->fn, v)->type == IR_STR
+      && (exp->type == AST_OP || exp->type == AST_FUNCALL))
+    _call (ctx, IR_RT_FREE, 1, &v);
+}
+
+static long
+_literal_width (ast_node *arg)
+{
+  ast_data_write_arg *wa;
+  long width;
+
+  if (arg->type == AST_STRLIT)
+    return 0;
+  if (arg->type != AST_WRITE_ARG)
+    return -1;
+  wa = arg->data;
+  if (wa->value->type != AST_STRLIT || wa->width->type != AST_INTLIT)
+    return -1;
+  width = *(long *)wa->width->data;
+  return width >= 0 && width <= IR_MAX_PAD ? width : -1;
+}
+
+static U32
+_lower_exp (ir_lower_ctx *ctx, ast_node *ptr)
+{
+  ast_data_var_declare *var;
+  ast_data_op *op_data;
+  ir_insn *in;
+  U32 a = IR_NONE, b, *slot;
+  U8 op, ta, tb;
+
+  switch (ptr->type)
+    {
+    case AST_VAR_DECLARE:
+      var = ptr->data;
+      slot = stget (&ctx->vars, var->name->data);
+      if (!slot)
+        {
+          fprintf (stderr, "Error: Unknown variable \"%s\".\n",
+                   var->name->data);
+          return IR_NONE;
+        }
+      return *slot;
+    case AST_INDEX:
+      if (!(b = _lower_index (ctx, ptr->data, &a)))
+        return IR_NONE;
+      var = ((ast_data_index *)ptr->data)->var->data;
+      in = ir_append (ctx->fn, ctx->bb, IR_LOAD);
+      in->a = a;
+      in->b = b;
+      in->type = _ir_type_of (var->datatype);
+      in->dst = ir_new_vreg (ctx->fn, in->type, NULL);
+      return in->dst;
+    case AST_STRLIT:
+      return _const_str (ctx, ((string *)ptr->data)->data);
+    case AST_INTLIT:
+    case AST_BOOL:
+    case AST_FLOATLIT:
+      in = ir_append (ctx->fn, ctx->bb, IR_CONST);
+      if (ptr->type == AST_INTLIT)
+        {
+          in->type = IR_INT;
+          in->imm.i = *(long *)ptr->data;
+        }
+      else if (ptr->type == AST_BOOL)
+        {
+          in->type = IR_BOOL;
+          in->imm.i = *(U16 *)ptr->data;
+        }
+      else
+        {
+          in->type = IR_REAL;
+          in->imm.f = *(double *)ptr->data;
+        }
+      in->dst = ir_new_vreg (ctx->fn, in->type, NULL);
+      return in->dst;
+    case AST_OP:
+      op_data = ptr->data;
+      op = _ir_op_of (op_data->op);
+      if (op == IR_NOP)
+        {
+          fprintf (stderr, "Error: Unknown operator '%c' in IR.\n",
+                   op_data->op);
+          return IR_NONE;
+        }
+
+      if (op_data->left)
+        {
+          a = _lower_exp (ctx, op_data->left);
+          if (!a)
+            return IR_NONE;
+        }
+      b = _lower_exp (ctx, op_data->right);
+      if (!b)
+        return IR_NONE;
+
+      if (!a)
+        {
+          /* Unary operator. */
+          in = ir_append (ctx->fn, ctx->bb, op == IR_SUB ? IR_NEG : op);
+          in->a = b;
+          in->type = op == IR_NOT ? IR_BOOL : ir_vreg_get (ctx->fn, b)->type;
+          in->dst = ir_new_vreg (ctx->fn, in->type, NULL);
+          return in->dst;
+        }
+
+      ta = ir_vreg_get (ctx->fn, a)->type;
+      tb = ir_vreg_get (ctx->fn, b)->type;
+      if (ta == IR_STR || tb == IR_STR)
+        return _lower_str_op (ctx, op_data, op, a, b);
+      if (ta == IR_REAL || tb == IR_REAL)
+        {
+          a = _coerce (ctx, a, IR_REAL);
+          b = _coerce (ctx, b, IR_REAL);
+          ta = IR_REAL;
+        }
+      else
+        {
+          ta = IR_INT;
+        }
+
+      in = ir_append (ctx->fn, ctx->bb, op);
+      in->a = a;
+      in->b = b;
+      in->type = op >= IR_LT && op <= IR_NE ? IR_BOOL : ta;
+      in->dst = ir_new_vreg (ctx->fn, in->type, NULL);
+      return in->dst;
+    case AST_FUNCALL:
+      if (((ast_data_funcall *)ptr->data)->routine)
+        {
+          _not_inlined (ptr->data);
+          return IR_NONE;
+        }
+      return _lower_builtin (ctx, ptr->data);
+    default:
+      fprintf (stderr, "Error: Unexpected expression %d in IR.\n",
+               ptr->type);
+      return IR_NONE;
+    }
+}
+
+static U32
+_coerce (ir_lower_ctx *ctx, U32 v, U8 type)
+{
+  ir_insn *in;
+
+  if (type != IR_REAL || ir_vreg_get (ctx->fn, v)->type == IR_REAL)
+    return v;
+
+  in = ir_append (ctx->fn, ctx->bb, IR_ITOF);
+  in->a = v;
+  in->type = IR_REAL;
+  in->dst = ir_new_vreg (ctx->fn, IR_REAL, NULL);
+  return in->dst;
+}
+
+static U32
+_const_str (ir_lower_ctx *ctx, char *str)
+{
+  ir_insn *in = ir_append (ctx->fn, ctx->bb, IR_CONST);
+  string *s = aralloc (&ctx->fn->ar, sizeof (string));
+
+  s->size = strlen (str);
+  s->data = aralloc (&ctx->fn->ar, s->size + 1);
+  memcpy (s->data, str, s->size + 1);
+
+  in->type = IR_STR;
+  in->imm.s = s;
+  in->dst = ir_new_vreg (ctx->fn, IR_STR, NULL);
+  return in->dst;
+}
+
+static U8
+_ir_type_of (U16 datatype)
+{
+  switch (datatype)
+    {
+    case AST_FLOATLIT:
+      return IR_REAL;
+    case AST_STRLIT:
+      return IR_STR;
+    case AST_BOOL:
+      return IR_BOOL;
+    default:
+      return IR_INT;
+    }
+}
+
+static U8
+_ir_op_of (U8 op)
+{
+  switch (op)
+    {
+    case '+':
+      return IR_ADD;
+    case '-':
+      return IR_SUB;
+    case '*':
+    /* The IR has no shifts, it keeps the power of two as it was. */
+    case AST_OP_SHL:
+      return IR_MUL;
+    case '/':
+    case AST_OP_SHR:
+      return IR_DIV;
+    case '%':
+    case AST_OP_AND:
+      return IR_MOD;
+    case '!':
+      return IR_NOT;
+    case '<':
+      return IR_LT;
+    case '>':
+      return IR_GT;
+    case '=':
+      return IR_EQ;
+    case (U8)TOKEN_LEQ:
+      return IR_LE;
+    case (U8)TOKEN_GEQ:
+      return IR_GE;
+    case (U8)TOKEN_NEQ:
+      return IR_NE;
+    default:
+      return IR_NOP;
+    }
+}
+// }}}
+// [ Control-flow graph ] {{{
+void
+ir_build_cfg (ir_func *fn)
+{
+  ir_block *bb, *succ, ***old_preds;
+  ir_insn *in;
+  da order;
+  U32 i, j, k, *nold, *args;
+  U8 *seen;
+
+  /* Normalize branches and compute successors. */
+  for (i = 0; i < fn->blocks.size; ++i)
+    {
+      bb = ir_block_get (fn, i);
+      bb->succs.size = 0;
+
+      in = bb->tail;
+      if (in && in->op == IR_BR && in->t == in->f)
+        {
+          in->op = IR_JMP;
+          in->a = IR_NONE;
+        }
+
+      if (in && (in->op == IR_JMP || in->op == IR_BR))
+        daappend (&bb->succs, &in->t);
+      if (in && in->op == IR_BR)
+        daappend (&bb->succs, &in->f);
+    }
+
+  seen = aralloc (&fn->ar, fn->next_block_id);
+  memset (seen, 0, fn->next_block_id);
+  dainit (&order, &fn->ar, sizeof (ir_block *), fn->blocks.size);
+  _postorder (ir_block_get (fn, 0), &order, seen);
+
+  /* Lay blocks out in reverse post-order, dropping unreachable ones. */
+  fn->blocks.size = 0;
+  for (i = order.size; i > 0; --i)
+    {
+      bb = *(ir_block **)dageti (&order, i - 1);
+      bb->rpo = fn->blocks.size;
+      daappend (&fn->blocks, &bb);
+    }
+  dafold (&order);
+
+  /* Rebuild predecessors, keeping PHI operands matched to them. */
+  old_preds = aralloc (&fn->ar, fn->blocks.size * sizeof (ir_block **));
+  nold = aralloc (&fn->ar, fn->blocks.size * sizeof (U32));
+  for (i = 0; i < fn->blocks.size; ++i)
+    {
+      bb = ir_block_get (fn, i);
+      nold[i] = bb->preds.size;
+      old_preds[i] = aralloc (&fn->ar, (nold[i] + 1) * sizeof (ir_block *));
+      memcpy (old_preds[i], bb->preds.data, nold[i] * sizeof (ir_block *));
+      bb->preds.size = 0;
+    }
+
+  for (i = 0; i < fn->blocks.size; ++i)
+    {
+      bb = ir_block_get (fn, i);
+      for (j = 0; j < bb->succs.size; ++j)
+        {
+          succ = *(ir_block **)dageti (&bb->succs, j);
+          daappend (&succ->preds, &bb);
+        }
+    }
+
+  for (i = 0; i < fn->blocks.size; ++i)
+    {
+      bb = ir_block_get (fn, i);
+      for (in = bb->head; in && in->op == IR_PHI; in = in->next)
+        {
+          args = aralloc (&fn->ar, (bb->preds.size + 1) * sizeof (U32));
+          for (j = 0; j < bb->preds.size; ++j)
+            {
+              args[j] = IR_NONE;
+              for (k = 0; k < nold[i] && k < in->nargs; ++k)
+                if (old_preds[i][k] == *(ir_block **)dageti (&bb->preds, j))
+                  args[j] = in->args[k];
+            }
+          arfree (in->args);
+          in->args = args;
+          in->nargs = bb->preds.size;
+        }
+    }
+
+  for (i = 0; i < fn->blocks.size; ++i)
+    arfree (old_preds[i]);
+  arfree (old_preds);
+  arfree (nold);
+  arfree (seen);
+}
+
+static void
+_postorder (ir_block *bb, da *order, U8 *seen)
+{
+  U32 i;
+
+  if (seen[bb->id])
+    return;
+  seen[bb->id] = 1;
+
+  /* Visit the last successor first so the first one is laid out next. */
+  for (i = bb->succs.size; i > 0; --i)
+    _postorder (*(ir_block **)dageti (&bb->succs, i - 1), order, seen);
+
+  daappend (order, &bb);
+}
+// }}}
+// [ Dump ] {{{
+void
+ir_dump (ir_func *fn, FILE *out)
+{
+  ir_block *bb;
+  ir_insn *in;
+  U32 i, j;
+
+  fprintf (out, "function main\n");
+  for (i = 0; i < fn->blocks.size; ++i)
+    {
+      bb = ir_block_get (fn, i);
+      fprintf (out, "bb%u:", bb->id);
+      if (bb->preds.size > 0)
+        {
+          fprintf (out, "%*s; preds", 12 - (bb->id > 9) - (bb->id > 99), "");
+          for (j = 0; j < bb->preds.size; ++j)
+            fprintf (out, " bb%u", (*(ir_block **)dageti (&bb->preds, j))->id);
+        }
+      fprintf (out, "\n");
+
+      for (in = bb->head; in; in = in->next)
+        {
+          fprintf (out, "  ");
+          if (in->dst != IR_NONE)
+            {
+              _dump_vreg (fn, in->dst, out);
+              fprintf (out, ":%s = ", _ir_type_names[in->type]);
+            }
+          fprintf (out, "%s", _ir_ops[in->op].name);
+
+          switch (in->op)
+            {
+            case IR_CONST:
+              if (in->type == IR_REAL)
+                fprintf (out, " %g", in->imm.f);
+              else if (in->type == IR_STR)
+                fprintf (out, " \"%s\"", in->imm.s->data);
+              else
+                fprintf (out, " %ld", in->imm.i);
+              break;
+            case IR_CALL:
+              fprintf (out, " %s(", ir_runtime_names[in->callee]);
+              for (j = 0; j < in->nargs; ++j)
+                {
+                  if (j)
+                    fprintf (out, ", ");
+                  _dump_vreg (fn, in->args[j], out);
+                }
+              fprintf (out, ")");
+              break;
+            case IR_PHI:
+              for (j = 0; j < in->nargs; ++j)
+                {
+                  fprintf (out, "%s[", j ? ", " : " ");
+                  _dump_vreg (fn, in->args[j], out);
+                  fprintf (out, ", bb%u]",
+                           (*(ir_block **)dageti (&bb->preds, j))->id);
+                }
+              break;
+            case IR_STORE:
+              fprintf (out, " ");
+              _dump_vreg (fn, in->a, out);
+              fprintf (out, ", ");
+              _dump_vreg (fn, in->b, out);
+              fprintf (out, ", ");
+              _dump_vreg (fn, in->args[0], out);
+              break;
+            case IR_JMP:
+              fprintf (out, " bb%u", in->t->id);
+              break;
+            case IR_BR:
+              fprintf (out, " ");
+              _dump_vreg (fn, in->a, out);
+              fprintf (out, ", bb%u, bb%u", in->t->id, in->f->id);
+              break;
+            default:
+              if (_ir_ops[in->op].nsrc > 0)
+                {
+                  fprintf (out, " ");
+                  _dump_vreg (fn, in->a, out);
+                }
+              if (_ir_ops[in->op].nsrc > 1)
+                {
+                  fprintf (out, ", ");
+                  _dump_vreg (fn, in->b, out);
+                }
+              break;
+            }
+          fprintf (out, "\n");
+        }
+    }
+}
+
+static void
+_dump_vreg (ir_func *fn, U32 i, FILE *out)
+{
+  ir_vreg *v;
+
+  if (i == IR_NONE)
+    {
+      fprintf (out, "undef");
+      return;
+    }
+
+  v = ir_vreg_get (fn, i);
+  if (!v->name)
+    fprintf (out, "%%%u", i);
+  else if (v->base == i)
+    fprintf (out, "%%%s", v->name->data);
+  else
+    fprintf (out, "%%%s.%u", v->name->data, i);
+}
+// }}}
+
+void
+ir_fold (ir_func *fn)
+{
+  arfold (&fn->ar);
+}
+
+// vim:fdm=marker:
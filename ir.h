@@ -0,0 +1,178 @@
+#ifndef IR_H
+#define IR_H
+
+#include "ast.h"
+
+/* Vreg 0 means "no operand". */
+#define IR_NONE 0
+
+enum ir_type
+{
+  IR_VOID = 0,
+  IR_INT,
+  IR_REAL,
+  IR_BOOL,
+  IR_STR,
+  IR_PTR /* array of 8 byte elements */
+};
+
+enum ir_op
+{
+  IR_NOP = 0,
+  IR_CONST, /* dst = imm */
+  IR_MOV,   /* dst = a */
+  IR_ADD,   /* dst = a + b */
+  IR_SUB,
+  IR_MUL,
+  IR_DIV,
+  IR_MOD,
+  IR_NEG, /* dst = -a */
+  IR_NOT, /* dst = !a */
+  IR_LT,  /* dst = a < b, compared as the type of a */
+  IR_LE,
+  IR_GT,
+  IR_GE,
+  IR_EQ,
+  IR_NE,
+  IR_ITOF, /* dst = (real)a */
+  IR_LOAD,  /* dst = a[b] */
+  IR_STORE, /* a[b] = args[0] */
+  IR_CALL, /* dst = callee (args), dst may be IR_NONE */
+  IR_PHI,  /* dst = args[i] when coming from the i-th predecessor */
+  IR_JMP,  /* goto t */
+  IR_BR,   /* if a goto t else goto f */
+  IR_RET,
+  IR_OP_COUNT
+};
+
+/* Runtime functions a call may target, see runtime/libpascal.h. */
+enum ir_runtime
+{
+  IR_RT_WRITE_INT = 0,
+  IR_RT_WRITE_REAL,
+  IR_RT_WRITE_STR,
+  IR_RT_WRITE_INT_W, /* value, width */
+  IR_RT_WRITE_REAL_W,
+  IR_RT_WRITE_FIXED, /* value, width, decimals */
+  IR_RT_WRITE_STR_W,
+  IR_RT_LENGTH, /* int = length (str) */
+  IR_RT_CONCAT, /* str = a + b */
+  IR_RT_DROP,   /* str = s without its first n characters */
+  IR_RT_TAKE,   /* str = the first n characters of s */
+  IR_RT_DUP,    /* str = a copy of s that its holder owns */
+  IR_RT_FREE,   /* free s, a string made by one of the above */
+  IR_RT_APPEND, /* str = s + t, using up s */
+  IR_RT_COMPARE, /* int = -1, 0 or 1 as a is below, equal to or above b */
+  IR_RT_ARRAY,   /* ptr = n zeroed elements */
+  IR_RT_BOUNDS,  /* report index i out of n elements and exit */
+  IR_RT_COUNT
+};
+
+typedef struct ir_vreg
+{
+  string *name; /* Pascal variable, NULL for temporaries. */
+  U32 base;     /* Vreg this one is an SSA version of, or itself. */
+  U8 type;
+} ir_vreg;
+
+/* IR_STR constants hold the literal as written in the source, so C escape
+   sequences such as "\n" are still escaped. */
+typedef struct ir_insn
+{
+  struct ir_insn *prev, *next;
+  struct ir_block *block;
+  U32 dst, a, b;
+  union
+  {
+    long i;
+    double f;
+    string *s;
+  } imm;
+  U32 *args;
+  U32 nargs;
+  U16 callee;
+  U8 op;
+  U8 type;
+  struct ir_block *t, *f;
+} ir_insn;
+
+typedef struct ir_block
+{
+  U32 id;
+  ir_insn *head, *tail;
+  da preds; /* ir_block * */
+  da succs; /* ir_block * */
+  struct ir_block *idom;
+  U32 rpo;
+  U32 loop_depth;
+} ir_block;
+
+typedef struct ir_func
+{
+  arena ar;
+  da blocks; /* ir_block *, entry first */
+  da vregs;  /* ir_vreg, index is the vreg number */
+  U32 next_block_id;
+  U8 ssa;
+} ir_func;
+
+/* Names of enum ir_runtime entries as linked symbols. */
+extern const char *const ir_runtime_names[IR_RT_COUNT];
+
+/* Initialize empty function. */
+int ir_init (ir_func *fn);
+
+/* Lower the program ROOT into FN.  Returns 1 on unsupported input. */
+int ir_lower (ir_func *fn, ast_node *root);
+
+/* Create new vreg of TYPE, NAME may be NULL. */
+U32 ir_new_vreg (ir_func *fn, U8 type, string *name);
+
+/* Get vreg I. */
+ir_vreg *ir_vreg_get (ir_func *fn, U32 i);
+
+/* Create new empty basic block at the end of FN. */
+ir_block *ir_new_block (ir_func *fn);
+
+/* Get Ith basic block. */
+ir_block *ir_block_get (ir_func *fn, U32 i);
+
+/* Append instruction OP to the end of BB. */
+ir_insn *ir_append (ir_func *fn, ir_block *bb, U8 op);
+
+/* Insert instruction OP before POS. */
+ir_insn *ir_insert_before (ir_func *fn, ir_insn *pos, U8 op);
+
+/* Unlink instruction from its block. */
+void ir_remove (ir_insn *in);
+
+/* Move unlinked instruction IN in front of POS. */
+void ir_move_before (ir_insn *in, ir_insn *pos);
+
+/* Rebuild predecessor and successor lists from the terminators, drop
+   unreachable blocks and number the rest in reverse post-order. */
+void ir_build_cfg (ir_func *fn);
+
+/* Number of a/b operands OP reads. */
+U8 ir_op_nsrc (U8 op);
+
+/* Mnemonic of OP. */
+const char *ir_op_name (U8 op);
+
+/* Check if OP ends a basic block. */
+U8 ir_is_terminator (U8 op);
+
+/* Check if instruction has effects beyond writing its destination. */
+U8 ir_has_side_effects (ir_insn *in);
+
+/* Call FN on every vreg read by IN. */
+void ir_for_each_use (ir_insn *in, void (*fn) (U32 *use, void *arg),
+                      void *arg);
+
+/* Print FN in textual form. */
+void ir_dump (ir_func *fn, FILE *out);
+
+/* Free the function. */
+void ir_fold (ir_func *fn);
+
+#endif /* not IR_H */
@@ -0,0 +1,93 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "jit.h"
+#include "runtime/libpascal.h"
+
+/* jmp *0(%rip) followed by the target address. */
+#define JIT_STUB_SIZE 16
+
+static void *const _runtime[IR_RT_COUNT] = {
+  [IR_RT_WRITE_INT] = (void *)_P__p_write_int,
+  [IR_RT_WRITE_REAL] = (void *)_P__p_write_real,
+  [IR_RT_WRITE_STR] = (void *)_P__p_write_str,
+  [IR_RT_WRITE_INT_W] = (void *)_P__p_write_int_w,
+  [IR_RT_WRITE_REAL_W] = (void *)_P__p_write_real_w,
+  [IR_RT_WRITE_FIXED] = (void *)_P__p_write_fixed,
+  [IR_RT_WRITE_STR_W] = (void *)_P__p_write_str_w,
+  [IR_RT_LENGTH] = (void *)_P__p_length,
+  [IR_RT_CONCAT] = (void *)_P__p_concat,
+  [IR_RT_DROP] = (void *)_P__p_drop,
+  [IR_RT_TAKE] = (void *)_P__p_take,
+  [IR_RT_DUP] = (void *)_P__p_dup,
+  [IR_RT_FREE] = (void *)_P__p_free,
+  [IR_RT_APPEND] = (void *)_P__p_append,
+  [IR_RT_COMPARE] = (void *)_P__p_compare,
+  [IR_RT_ARRAY] = (void *)_P__p_array,
+  [IR_RT_BOUNDS] = (void *)_P__p_bounds,
+};
+
+int
+jit_run (enc_image *img, int *status)
+{
+  U8 *mem, *stub;
+  enc_reloc *rel;
+  long page = sysconf (_SC_PAGESIZE), target;
+  S32 disp;
+  U64 addr;
+  U32 i, stubs, data, size;
+  int (*entry) (void);
+
+  /* The code is nowhere near mpas, so calls go through a stub per runtime
+     function holding its address.  Strings follow the stubs. */
+  stubs = (img->code.size + 15) & ~15u;
+  data = stubs + IR_RT_COUNT * JIT_STUB_SIZE;
+  size = (data + img->data.size + page - 1) & ~(page - 1);
+
+  mem = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+              -1, 0);
+  if (mem == MAP_FAILED)
+    {
+      fprintf (stderr, "Error: Failed to map memory for the program.\n");
+      return 1;
+    }
+
+  memcpy (mem, img->code.buf, img->code.size);
+  memcpy (mem + data, img->data.buf, img->data.size);
+  for (i = 0; i < IR_RT_COUNT; ++i)
+    {
+      stub = mem + stubs + i * JIT_STUB_SIZE;
+      stub[0] = 0xff;
+      stub[1] = 0x25;
+      memset (stub + 2, 0, 4);
+      addr = (uintptr_t)_runtime[i];
+      memcpy (stub + 6, &addr, sizeof (addr));
+    }
+
+  for (i = 0; i < img->relocs.size; ++i)
+    {
+      rel = dageti (&img->relocs, i);
+      if (rel->kind == ENC_RELOC_CALL)
+        target = stubs + rel->index * JIT_STUB_SIZE;
+      else
+        target = data + *(U32 *)dageti (&img->strs, rel->index);
+      disp = target - (rel->offset + 4);
+      memcpy (mem + rel->offset, &disp, 4);
+    }
+
+  if (mprotect (mem, size, PROT_READ | PROT_EXEC))
+    {
+      fprintf (stderr, "Error: Failed to make the program executable.\n");
+      munmap (mem, size);
+      return 1;
+    }
+
+  entry = (int (*) (void))(uintptr_t)mem;
+  *status = entry ();
+  _P__p_flush ();
+
+  munmap (mem, size);
+  return 0;
+}
@@ -0,0 +1,12 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include "enc.h"
+
+/* Load IMG into executable memory, bind its runtime calls to the
+   libpascal functions linked into mpas and run it.  The program writes to
+   our stdout, which is flushed before returning.  Its exit status goes to
+   STATUS.  Returns 1 if it could not be run. */
+int jit_run (enc_image *img, int *status);
+
+#endif /* not JIT_H */
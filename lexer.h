@@ -37,6 +37,8 @@
             return TOKEN_DO;                                                  \
           else if (streq (ctx->str->data, "var"))                           \
             return TOKEN_VAR;                                               \
+          else if (streq (ctx->str->data, "const"))                           \
+            return TOKEN_CONST;                                               \
           else if (streq (ctx->str->data, "begin"))                           \
             return TOKEN_BEGIN;                                               \
           else if (streq (ctx->str->data, "end"))                             \
@@ -45,6 +47,16 @@
             return TOKEN_WHILE;                                               \
           else if (streq (ctx->str->data, "if"))                              \
             return TOKEN_IF;                                                  \
+          else if (streq (ctx->str->data, "for"))                             \
+            return TOKEN_FOR;                                                 \
+          else if (streq (ctx->str->data, "to"))                              \
+            return TOKEN_TO;                                                  \
+          else if (streq (ctx->str->data, "downto"))                          \
+            return TOKEN_DOWNTO;                                              \
+          else if (streq (ctx->str->data, "procedure"))                       \
+            return TOKEN_PROCEDURE;                                           \
+          else if (streq (ctx->str->data, "function"))                        \
+            return TOKEN_FUNCTION;                                            \
           return TOKEN_IDENTF;                                                \
         }                                                                     \
       sbreset (&ctx->sb);                                                     \
@@ -84,7 +96,13 @@ enum lex_token
   TOKEN_BEGIN,
   TOKEN_BLOCK_END,
   TOKEN_WHILE,
-  TOKEN_IF
+  TOKEN_IF,
+  TOKEN_FOR,
+  TOKEN_TO,
+  TOKEN_DOWNTO,
+  TOKEN_PROCEDURE,
+  TOKEN_FUNCTION,
+  TOKEN_CONST
 };
 
 /* Initialize the lexer. */
@@ -1,87 +1,194 @@
+#include <signal.h>
 #include <stdio.h>
+#include <unistd.h>
 
 #define CLOMY_IMPLEMENTATION
 #include "clomy.h"
 
+#include "asm.h"
+#include "bc.h"
+#include "cc.h"
 #include "codegen.h"
+#include "elf.h"
+#include "enc.h"
+#include "inline.h"
+#include "ir.h"
+#include "jit.h"
+#include "opt.h"
+#include "pbc.h"
+#include "peval.h"
+#include "range.h"
+#include "regalloc.h"
+#include "simplify.h"
+#include "vm.h"
+#include "x86.h"
 
-int compiler_main (char *path, U8 debug, U8 target);
+typedef struct
+{
+  char *path;
+  char *output;
+  U8 target;
+  U8 opt;
+  U8 debug;
+  U8 print_asm;
+  U8 eval; /* Run the program at compile time if it finishes there. */
+} mpas_opts;
+
+/* Runtime object linked into -t asm executables, see runtime/crt.c. */
+extern const char libpas_crt[];
+extern const U32 libpas_crt_len;
+
+int compiler_main (mpas_opts *opts);
+
+int compile_asm (mpas_opts *opts, ast_node *root);
+
+int compile_run (mpas_opts *opts, ast_node *root);
+
+int run_pbc (mpas_opts *opts);
+
+int find_runtime (char *path, U32 size);
 
 void usage (char *prog);
 
 int
 main (int argc, char **argv)
 {
+  mpas_opts opts = { 0 };
   int i;
-  U8 rtarget = 0, target = TARGET_C, debug = 0;
+  U8 rtarget = 0, routput = 0;
+
+  opts.target = TARGET_C;
+  opts.output = "a.out";
 
-  if (argc > 1)
+  for (i = 1; i < argc; ++i)
     {
-      for (i = 0; i < argc; ++i)
+      if (rtarget)
         {
-          if (rtarget)
+          if (strcmp (argv[i], "ast") == 0)
             {
-              if (strcmp (argv[i], "ast") == 0)
-                {
-                  target = TARGET_AST;
-                }
-              else if (strcmp (argv[i], "c") == 0)
-                {
-                  target = TARGET_C;
-                }
-              else
-                {
-                  printf ("Error: Unknown target \"%s\".\n", argv[i]);
-                  usage (argv[0]);
-                  return 1;
-                }
-              rtarget = 0;
+              opts.target = TARGET_AST;
+            }
+          else if (strcmp (argv[i], "ir") == 0)
+            {
+              opts.target = TARGET_IR;
+            }
+          else if (strcmp (argv[i], "c") == 0)
+            {
+              opts.target = TARGET_C;
+            }
+          else if (strcmp (argv[i], "asm") == 0)
+            {
+              opts.target = TARGET_ASM;
             }
-          else if (argv[i][0] == '-')
+          else if (strcmp (argv[i], "jit") == 0)
             {
-              switch (argv[i][1])
+              opts.target = TARGET_JIT;
+            }
+          else if (strcmp (argv[i], "run") == 0)
+            {
+              opts.target = TARGET_RUN;
+            }
+          else if (strcmp (argv[i], "pbc") == 0)
+            {
+              opts.target = TARGET_PBC;
+            }
+          else
+            {
+              printf ("Error: Unknown target \"%s\".\n", argv[i]);
+              usage (argv[0]);
+              return 1;
+            }
+          rtarget = 0;
+        }
+      else if (routput)
+        {
+          opts.output = argv[i];
+          routput = 0;
+        }
+      else if (argv[i][0] == '-')
+        {
+          switch (argv[i][1])
+            {
+            case 't':
+              rtarget = 1;
+              break;
+            case 'o':
+              routput = 1;
+              break;
+            case 'd':
+              opts.debug = 1;
+              break;
+            case 'S':
+              opts.print_asm = 1;
+              break;
+            case 'e':
+              opts.eval = 1;
+              break;
+            case 'O':
+              if (argv[i][2] < '0' || argv[i][2] > '3' || argv[i][3])
                 {
-                case 't':
-                  rtarget = 1;
-                  break;
-                case 'd':
-                  debug = 1;
-                  break;
-                default:
-                  printf ("Error: Unknown flag \"-%c\".\n", argv[i][1]);
+                  printf ("Error: Unknown optimization level \"%s\".\n",
+                          argv[i]);
                   usage (argv[0]);
                   return 1;
                 }
+              opts.opt = argv[i][2] - '0';
+              break;
+            default:
+              printf ("Error: Unknown flag \"-%c\".\n", argv[i][1]);
+              usage (argv[0]);
+              return 1;
             }
         }
+      else
+        {
+          opts.path = argv[i];
+        }
+    }
 
-      return compiler_main (argv[1], debug, target);
+  if (rtarget || routput)
+    {
+      fprintf (stderr, "Error: Missing argument for \"%s\".\n", argv[i - 1]);
+      usage (argv[0]);
+      return 1;
     }
-  else
+
+  if (!opts.path)
     {
       fprintf (stderr, "Error: No FILE path provided.\n");
       usage (argv[0]);
       return 1;
     }
 
-  return 0;
+  /* Bytecode written by -t pbc is run as it is. */
+  if (pbc_is_file (opts.path))
+    return run_pbc (&opts);
+
+  /* A C compiler that exits early must not kill us through the pipe. */
+  signal (SIGPIPE, SIG_IGN);
+
+  return compiler_main (&opts);
 }
 
 int
-compiler_main (char *path, U8 debug, U8 target)
+compiler_main (mpas_opts *opts)
 {
   lex lexer = { 0 };
   ast tree = { 0 };
   cg cgctx = { 0 };
+  cc_job job = { 0 };
+  ir_func fn = { 0 };
+  peval pe = { 0 };
   ast_node *root;
-  string *code;
-  FILE *f;
+  sink out;
+  char runtime[4096];
+  int status = 0;
 
-  if (lex_init (&lexer, path) == 1)
+  if (lex_init (&lexer, opts->path) == 1)
     return 1;
 
   tree.lexer = &lexer;
-  if (debug)
+  if (opts->debug)
     tree.flags |= AST_FLAG_DEBUG;
 
   if (ast_init (&tree) == 1)
@@ -96,32 +203,265 @@ compiler_main (char *path, U8 debug, U8 target)
       return 1;
     }
 
-  if (target == TARGET_AST)
+  /* The other backends lower main alone, the C one keeps the routines
+     that are too big to copy. */
+  if (opts->target == TARGET_C || opts->target == TARGET_AST)
+    inline_calls (&tree, INLINE_BUDGET (opts->opt));
+  else if (inline_calls (&tree, INLINE_ALL))
+    {
+      fprintf (stderr,
+               "Error: Inlining the routines grows the program by over %u "
+               "AST nodes, use the C backend.\n",
+               INLINE_LIMIT);
+      ast_fold (&tree);
+      lex_fold (&lexer);
+      return 1;
+    }
+
+  /* Fold the expressions left after inlining, then drop the bounds
+     checks of array indexes that are always in range. */
+  if (opts->opt > 0)
+    {
+      simplify (&tree);
+      range_check (root);
+    }
+
+  if (opts->target == TARGET_AST)
     {
       ast_print_tree (tree.root, "\n");
       printf ("\n;; vi: ft=lisp\n");
     }
+  else if (opts->target == TARGET_IR)
+    {
+      if (ir_init (&fn) || ir_lower (&fn, root))
+        status = 1;
+      else
+        {
+          opt_run (&fn, opts->opt);
+          ir_dump (&fn, stdout);
+        }
+#ifdef CLOMY_ARENA_STATS
+      arstats_print (&fn.ar, "ir", stderr);
+#endif /* CLOMY_ARENA_STATS */
+      ir_fold (&fn);
+    }
+  else if (opts->target == TARGET_ASM || opts->target == TARGET_JIT)
+    {
+      status = compile_asm (opts, root);
+    }
+  else if (opts->target == TARGET_RUN || opts->target == TARGET_PBC)
+    {
+      status = compile_run (opts, root);
+    }
   else
     {
-      code = codegen (&cgctx, root);
+      /* A program that gets to its end within the budget is replaced by
+         what it wrote. */
+      if (opts->eval && peval_run (&pe, root, PEVAL_STEPS) == 0)
+        cgctx.flags |= CG_FLAG_KNOWN_OUTPUT;
+      else if (find_runtime (runtime, sizeof (runtime)) == 0)
+        cgctx.flags |= CG_FLAG_LINK_RUNTIME;
+      if (opts->opt >= 3)
+        cgctx.flags |= CG_FLAG_UNROLL;
 
-      f = fopen ("a.c", "w");
-      fprintf (f, "%s", code->data);
-      fclose (f);
+      if (cc_spawn (&job, "c", opts->output, opts->opt,
+                    (cgctx.flags & CG_FLAG_LINK_RUNTIME) ? runtime : NULL))
+        {
+          peval_fold (&pe);
+          ast_fold (&tree);
+          lex_fold (&lexer);
+          return 1;
+        }
+      /* The compiler waits on its input until the pipe is closed. */
+      if (sink_open_fd (&out, job.fd, SINK_CAPACITY))
+        {
+          cc_wait (&job);
+          peval_fold (&pe);
+          ast_fold (&tree);
+          lex_fold (&lexer);
+          return 1;
+        }
 
-      system ("cc a.c");
+      if (cgctx.flags & CG_FLAG_KNOWN_OUTPUT)
+        codegen_output (&cgctx, &pe.out, &out);
+      else
+        codegen (&cgctx, root, &out);
+      if (sink_fold (&out))
+        {
+          fprintf (stderr, "Error: Failed to write to the C compiler.\n");
+          status = 1;
+        }
+
+      if (cc_wait (&job))
+        status = 1;
+#ifdef CLOMY_ARENA_STATS
+      arstats_print (&cgctx.ar, "cg", stderr);
+#endif /* CLOMY_ARENA_STATS */
       codegen_fold (&cgctx);
+      peval_fold (&pe);
     }
+#ifdef CLOMY_ARENA_STATS
+  arstats_print (&lexer.ar, "lexer", stderr);
+  arstats_print (&tree.ar, "ast", stderr);
+#endif /* CLOMY_ARENA_STATS */
   ast_fold (&tree);
   lex_fold (&lexer);
 
-  return 0;
+  return status;
+}
+
+int
+compile_asm (mpas_opts *opts, ast_node *root)
+{
+  ir_func fn = { 0 };
+  x86_func xf = { 0 };
+  enc_image img = { 0 };
+  sink out;
+  int status = 1, ret;
+
+  if (ir_init (&fn) || ir_lower (&fn, root))
+    goto done;
+  opt_run (&fn, opts->opt);
+  opt_leave_ssa (&fn);
+  opt_loops (&fn);
+
+  if (x86_select (&xf, &fn))
+    goto done;
+  regalloc (&xf);
+  x86_finish (&xf);
+
+  if (opts->print_asm)
+    {
+      if (sink_open_fd (&out, STDOUT_FILENO, SINK_CAPACITY))
+        goto done;
+      asm_emit (&xf, &out);
+      status = sink_fold (&out);
+      goto done;
+    }
+
+  if (enc_emit (&img, &xf))
+    goto done;
+  if (opts->target == TARGET_JIT)
+    {
+      if (jit_run (&img, &ret) == 0)
+        status = ret;
+    }
+  else
+    status = elf_write (opts->output, &img, (const U8 *)libpas_crt,
+                        libpas_crt_len);
+
+done:
+#ifdef CLOMY_ARENA_STATS
+  arstats_print (&fn.ar, "ir", stderr);
+  arstats_print (&xf.ar, "x86", stderr);
+  arstats_print (&img.ar, "enc", stderr);
+#endif /* CLOMY_ARENA_STATS */
+  enc_fold (&img);
+  x86_fold (&xf);
+  ir_fold (&fn);
+  return status;
+}
+
+int
+compile_run (mpas_opts *opts, ast_node *root)
+{
+  ir_func fn = { 0 };
+  bc_prog prog = { 0 };
+  int status = 1;
+
+  if (ir_init (&fn) || ir_lower (&fn, root))
+    goto done;
+  opt_run (&fn, opts->opt);
+  opt_leave_ssa (&fn);
+
+  if (bc_gen (&prog, &fn))
+    goto done;
+
+  if (opts->print_asm)
+    {
+      bc_dump (&prog, stdout);
+      status = 0;
+    }
+  else if (opts->target == TARGET_PBC)
+    status = pbc_write (opts->output, &prog);
+  else
+    status = vm_run (&prog);
+
+done:
+#ifdef CLOMY_ARENA_STATS
+  arstats_print (&fn.ar, "ir", stderr);
+  arstats_print (&prog.ar, "bc", stderr);
+#endif /* CLOMY_ARENA_STATS */
+  bc_fold (&prog);
+  ir_fold (&fn);
+  return status;
+}
+
+int
+run_pbc (mpas_opts *opts)
+{
+  bc_prog prog = { 0 };
+  int status = 1;
+
+  if (pbc_load (&prog, opts->path) == 0)
+    {
+      if (opts->print_asm)
+        {
+          bc_dump (&prog, stdout);
+          status = 0;
+        }
+      else
+        status = vm_run (&prog);
+    }
+
+  bc_fold (&prog);
+  return status;
+}
+
+int
+find_runtime (char *path, U32 size)
+{
+  char *env, *slash;
+  int len;
+
+  env = getenv ("MPAS_RUNTIME");
+  if (env)
+    {
+      snprintf (path, size, "%s", env);
+      return access (path, R_OK) == 0 ? 0 : 1;
+    }
+
+  /* Look next to the mpas binary. */
+  len = readlink ("/proc/self/exe", path, size - 1);
+  if (len <= 0)
+    return 1;
+  path[len] = '\0';
+
+  slash = strrchr (path, '/');
+  if (!slash)
+    return 1;
+  *slash = '\0';
+
+  if (strlen (path) + sizeof ("/runtime/libpascal.a") > size)
+    return 1;
+  strcat (path, "/runtime/libpascal.a");
+
+  return access (path, R_OK) == 0 ? 0 : 1;
 }
 
 void
 usage (char *prog)
 {
   fprintf (stderr, "Usage: %s [FILE] [FLAGS]\n", prog);
-  fprintf (stderr, "    -t     target (ast, ir, c)\n");
+  fprintf (stderr, "    -t     target (ast, ir, c, asm, jit, run, pbc)\n");
+  fprintf (stderr, "    -o     output file (default a.out)\n");
+  fprintf (stderr, "    -O0-3  optimization level (default -O0)\n");
+  fprintf (stderr, "    -S     print assembly or bytecode instead of running "
+                   "(asm, jit, run)\n");
+  fprintf (stderr, "    -e     emit just the output of a program that "
+                   "finishes at compile time (c)\n");
   fprintf (stderr, "    -d     show debug\n");
+  fprintf (stderr, "A FILE written by -t pbc is run by the bytecode VM.\n");
+  fprintf (stderr, "The C compiler is $CC (default cc), given $CFLAGS.  The "
+                   "asm target writes executables without it.\n");
 }
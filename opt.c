@@ -0,0 +1,1539 @@
+#include <limits.h>
+
+#include "opt.h"
+#include "utils.h"
+
+#define OPT_BLOCK(fn, i) ir_block_get ((fn), (i))
+#define OPT_PRED(bb, i) (*(ir_block **)dageti (&(bb)->preds, (i)))
+#define OPT_SUCC(bb, i) (*(ir_block **)dageti (&(bb)->succs, (i)))
+
+enum opt_lattice
+{
+  OPT_TOP = 0,
+  OPT_CONST,
+  OPT_BOTTOM
+};
+
+typedef union
+{
+  long i;
+  double f;
+  string *s;
+} opt_value;
+
+/* Children of every block in the dominator tree, indexed by rpo. */
+typedef struct
+{
+  U32 *start;
+  ir_block **kids;
+} opt_domtree;
+
+typedef struct
+{
+  ir_func *fn;
+  U32 nvars; /* Vregs below this existed before SSA construction. */
+  U32 *cur;  /* Current SSA version of each variable. */
+  da undo;   /* U32 pairs of variable and its previous version. */
+  opt_domtree dt;
+} opt_rename_ctx;
+
+typedef struct
+{
+  ir_func *fn;
+  U8 *state;
+  opt_value *val;
+  U8 *block_exec; /* Indexed by rpo. */
+  U8 *edge_exec;  /* Indexed by rpo * 2 + successor. */
+  da flow;        /* U32 edges */
+  da ssa;         /* U32 vregs */
+  U32 *use_start;
+  ir_insn **uses;
+} opt_sccp_ctx;
+
+typedef struct
+{
+  ir_insn **slots;
+  U32 mask;
+  U32 *repl;
+  da undo; /* U32 slots filled in the current scope. */
+  opt_domtree dt;
+} opt_gvn_ctx;
+
+/* Walk up the dominator tree from A and B until they meet. */
+static ir_block *_intersect (ir_block *a, ir_block *b);
+
+/* Check if A dominates B. */
+static U8 _dominates (ir_block *a, ir_block *b);
+
+/* Collect dominator tree children. */
+static void _domtree_build (ir_func *fn, opt_domtree *dt);
+static void _domtree_fold (opt_domtree *dt);
+
+/* Map every vreg to its defining instruction.  Only exact in SSA form. */
+static ir_insn **_def_map (ir_func *fn);
+
+/* Index of P in the predecessors of S. */
+static U32 _pred_index (ir_block *s, ir_block *p);
+
+/* Make the terminator of P jump to TO instead of FROM. */
+static void _retarget (ir_block *p, ir_block *from, ir_block *to);
+
+/* Mark the blocks of the natural loop headed by H with STAMP. */
+static void _natural_loop (ir_func *fn, ir_block *h, U32 *mark, U32 stamp);
+
+/* Check if IN computes a value from its operands only. */
+static U8 _is_pure (ir_insn *in);
+
+/* Evaluate pure OP on constant operands, returns 1 if it can't be folded
+   without changing the behavior of the program. */
+static int _fold (U8 op, U8 optype, opt_value a, opt_value b,
+                  opt_value *out);
+
+/* Follow replacement chain of V. */
+static U32 _find (U32 *repl, U32 v);
+
+/* Rewrite every operand through REPL. */
+static void _apply_repl (ir_func *fn, U32 *repl);
+
+/* Emit copies DST[i] = SRC[i] as if done at once, before POS. */
+static void _parallel_copy (ir_func *fn, ir_insn *pos, U32 *dst, U32 *src,
+                            U32 n);
+
+static void _rename (opt_rename_ctx *ctx, ir_block *bb);
+static void _sccp_visit (opt_sccp_ctx *ctx, ir_insn *in);
+static void _gvn_block (ir_func *fn, opt_gvn_ctx *ctx, ir_block *bb);
+
+void
+opt_run (ir_func *fn, U8 level)
+{
+  U8 round, rounds = level >= 3 ? 2 : 1;
+
+  if (level == 0)
+    return;
+
+  opt_simplify_cfg (fn);
+  opt_build_ssa (fn);
+  for (round = 0; round < rounds; ++round)
+    {
+      opt_sccp (fn);
+      opt_copy_prop (fn);
+      if (level >= 2)
+        {
+          opt_gvn (fn);
+          opt_licm (fn);
+        }
+      opt_dce (fn);
+      opt_simplify_cfg (fn);
+      opt_copy_prop (fn);
+    }
+}
+
+// [ Control-flow graph ] {{{
+void
+opt_simplify_cfg (ir_func *fn)
+{
+  ir_block *bb, *succ, *p, *s;
+  ir_insn *in;
+  U32 i, j, k;
+  U8 changed = 1;
+
+  while (changed)
+    {
+      changed = 0;
+      for (i = 0; i < fn->blocks.size && !changed; ++i)
+        {
+          bb = OPT_BLOCK (fn, i);
+          if (!bb->tail || bb->tail->op != IR_JMP)
+            continue;
+          succ = bb->tail->t;
+
+          /* Merge a block into its only predecessor. */
+          if (succ != bb && succ->preds.size == 1 && succ->rpo != 0)
+            {
+              ir_remove (bb->tail);
+              for (in = succ->head; in; in = in->next)
+                {
+                  in->block = bb;
+                  if (in->op == IR_PHI)
+                    {
+                      in->op = IR_MOV;
+                      in->a = in->args[0];
+                      in->args = NULL;
+                      in->nargs = 0;
+                    }
+                }
+              if (bb->tail)
+                bb->tail->next = succ->head;
+              else
+                bb->head = succ->head;
+              succ->head->prev = bb->tail;
+              bb->tail = succ->tail;
+              succ->head = succ->tail = NULL;
+
+              for (j = 0; j < succ->succs.size; ++j)
+                {
+                  s = OPT_SUCC (succ, j);
+                  for (k = 0; k < s->preds.size; ++k)
+                    if (OPT_PRED (s, k) == succ)
+                      *(ir_block **)dageti (&s->preds, k) = bb;
+                }
+              succ->preds.size = 0;
+              changed = 1;
+              break;
+            }
+
+          /* Bypass a block holding nothing but the jump. */
+          if (i == 0 || bb->head != bb->tail || succ == bb)
+            continue;
+          if (succ->head->op != IR_PHI)
+            {
+              for (j = 0; j < bb->preds.size; ++j)
+                _retarget (OPT_PRED (bb, j), bb, succ);
+              changed = bb->preds.size > 0;
+            }
+          else if (bb->preds.size == 1)
+            {
+              p = OPT_PRED (bb, 0);
+              if (_pred_index (succ, p) != succ->preds.size)
+                continue;
+              _retarget (p, bb, succ);
+              k = _pred_index (succ, bb);
+              *(ir_block **)dageti (&succ->preds, k) = p;
+              changed = 1;
+            }
+        }
+
+      if (changed)
+        ir_build_cfg (fn);
+    }
+}
+
+static U32
+_pred_index (ir_block *s, ir_block *p)
+{
+  U32 i;
+
+  for (i = 0; i < s->preds.size; ++i)
+    if (OPT_PRED (s, i) == p)
+      return i;
+  return i;
+}
+
+static void
+_retarget (ir_block *p, ir_block *from, ir_block *to)
+{
+  ir_insn *t = p->tail;
+
+  if (t->t == from)
+    t->t = to;
+  if (t->op == IR_BR && t->f == from)
+    t->f = to;
+}
+
+void
+opt_dominators (ir_func *fn)
+{
+  ir_block *bb, *entry = OPT_BLOCK (fn, 0), *p, *idom;
+  U32 i, j;
+  U8 changed = 1;
+
+  /* Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm".
+     Blocks are already in reverse post-order. */
+  for (i = 0; i < fn->blocks.size; ++i)
+    OPT_BLOCK (fn, i)->idom = NULL;
+  entry->idom = entry;
+
+  while (changed)
+    {
+      changed = 0;
+      for (i = 1; i < fn->blocks.size; ++i)
+        {
+          bb = OPT_BLOCK (fn, i);
+          idom = NULL;
+          for (j = 0; j < bb->preds.size; ++j)
+            {
+              p = OPT_PRED (bb, j);
+              if (!p->idom)
+                continue;
+              idom = idom ? _intersect (p, idom) : p;
+            }
+          if (idom != bb->idom)
+            {
+              bb->idom = idom;
+              changed = 1;
+            }
+        }
+    }
+
+  entry->idom = NULL;
+}
+
+static ir_block *
+_intersect (ir_block *a, ir_block *b)
+{
+  while (a != b)
+    {
+      while (a->rpo > b->rpo)
+        a = a->idom;
+      while (b->rpo > a->rpo)
+        b = b->idom;
+    }
+  return a;
+}
+
+static U8
+_dominates (ir_block *a, ir_block *b)
+{
+  for (; b; b = b->idom)
+    if (b == a)
+      return 1;
+  return 0;
+}
+
+static void
+_domtree_build (ir_func *fn, opt_domtree *dt)
+{
+  ir_block *bb;
+  U32 i, n = fn->blocks.size, *fill;
+
+  dt->start = aralloc (&fn->ar, (n + 1) * sizeof (U32));
+  dt->kids = aralloc (&fn->ar, (n + 1) * sizeof (ir_block *));
+  fill = aralloc (&fn->ar, (n + 1) * sizeof (U32));
+  memset (dt->start, 0, (n + 1) * sizeof (U32));
+
+  for (i = 1; i < n; ++i)
+    ++dt->start[OPT_BLOCK (fn, i)->idom->rpo + 1];
+  for (i = 0; i < n; ++i)
+    dt->start[i + 1] += dt->start[i];
+
+  memcpy (fill, dt->start, (n + 1) * sizeof (U32));
+  for (i = 1; i < n; ++i)
+    {
+      bb = OPT_BLOCK (fn, i);
+      dt->kids[fill[bb->idom->rpo]++] = bb;
+    }
+  arfree (fill);
+}
+
+static void
+_domtree_fold (opt_domtree *dt)
+{
+  arfree (dt->start);
+  arfree (dt->kids);
+}
+
+void
+opt_loops (ir_func *fn)
+{
+  ir_block *bb, *p;
+  U32 i, j, k, *mark;
+  U32 n = fn->blocks.size;
+
+  opt_dominators (fn);
+  mark = aralloc (&fn->ar, n * sizeof (U32));
+  memset (mark, 0, n * sizeof (U32));
+
+  for (i = 0; i < n; ++i)
+    OPT_BLOCK (fn, i)->loop_depth = 0;
+
+  for (i = 0; i < n; ++i)
+    {
+      bb = OPT_BLOCK (fn, i);
+      for (j = 0; j < bb->preds.size; ++j)
+        {
+          p = OPT_PRED (bb, j);
+          if (_dominates (bb, p))
+            break;
+        }
+      if (j == bb->preds.size)
+        continue;
+
+      _natural_loop (fn, bb, mark, i + 1);
+      for (k = 0; k < n; ++k)
+        if (mark[k] == i + 1)
+          ++OPT_BLOCK (fn, k)->loop_depth;
+    }
+
+  arfree (mark);
+}
+
+static void
+_natural_loop (ir_func *fn, ir_block *h, U32 *mark, U32 stamp)
+{
+  ir_block *bb, *p;
+  da work;
+  U32 i;
+
+  dainit (&work, &fn->ar, sizeof (ir_block *), 8);
+  mark[h->rpo] = stamp;
+  for (i = 0; i < h->preds.size; ++i)
+    {
+      p = OPT_PRED (h, i);
+      if (_dominates (h, p) && mark[p->rpo] != stamp)
+        {
+          mark[p->rpo] = stamp;
+          daappend (&work, &p);
+        }
+    }
+
+  while (work.size)
+    {
+      bb = *(ir_block **)dageti (&work, --work.size);
+      for (i = 0; i < bb->preds.size; ++i)
+        {
+          p = OPT_PRED (bb, i);
+          if (mark[p->rpo] != stamp)
+            {
+              mark[p->rpo] = stamp;
+              daappend (&work, &p);
+            }
+        }
+    }
+
+  dafold (&work);
+}
+// }}}
+// [ SSA construction ] {{{
+void
+opt_build_ssa (ir_func *fn)
+{
+  opt_rename_ctx ctx;
+  ir_block *bb, *p, *runner, *d, **last;
+  ir_insn *in;
+  ir_vreg *vr;
+  da *df, work;
+  U32 i, j, v, n = fn->blocks.size, nv = fn->vregs.size;
+  U32 *has_phi, *queued, *def_start, *fill;
+  ir_block **defs;
+
+  if (fn->ssa)
+    return;
+  opt_dominators (fn);
+
+  /* Dominance frontiers. */
+  df = aralloc (&fn->ar, n * sizeof (da));
+  for (i = 0; i < n; ++i)
+    dainit (&df[i], &fn->ar, sizeof (ir_block *), 2);
+  for (i = 0; i < n; ++i)
+    {
+      bb = OPT_BLOCK (fn, i);
+      if (bb->preds.size < 2)
+        continue;
+      for (j = 0; j < bb->preds.size; ++j)
+        {
+          p = OPT_PRED (bb, j);
+          for (runner = p; runner && runner != bb->idom;
+               runner = runner->idom)
+            {
+              last = df[runner->rpo].size
+                         ? dageti (&df[runner->rpo], df[runner->rpo].size - 1)
+                         : NULL;
+              if (!last || *last != bb)
+                daappend (&df[runner->rpo], &bb);
+            }
+        }
+    }
+
+  /* Blocks assigning each variable. */
+  def_start = aralloc (&fn->ar, (nv + 1) * sizeof (U32));
+  fill = aralloc (&fn->ar, (nv + 1) * sizeof (U32));
+  memset (def_start, 0, (nv + 1) * sizeof (U32));
+  for (i = 0; i < n; ++i)
+    for (in = OPT_BLOCK (fn, i)->head; in; in = in->next)
+      if (in->dst != IR_NONE && ir_vreg_get (fn, in->dst)->name)
+        ++def_start[in->dst + 1];
+  for (i = 0; i < nv; ++i)
+    def_start[i + 1] += def_start[i];
+  defs = aralloc (&fn->ar, (def_start[nv] + 1) * sizeof (ir_block *));
+  memcpy (fill, def_start, (nv + 1) * sizeof (U32));
+  for (i = 0; i < n; ++i)
+    {
+      bb = OPT_BLOCK (fn, i);
+      for (in = bb->head; in; in = in->next)
+        if (in->dst != IR_NONE && ir_vreg_get (fn, in->dst)->name)
+          defs[fill[in->dst]++] = bb;
+    }
+
+  /* Place PHIs on the iterated dominance frontier of every variable. */
+  has_phi = aralloc (&fn->ar, n * sizeof (U32));
+  queued = aralloc (&fn->ar, n * sizeof (U32));
+  memset (has_phi, 0, n * sizeof (U32));
+  memset (queued, 0, n * sizeof (U32));
+  dainit (&work, &fn->ar, sizeof (ir_block *), 8);
+  for (v = 1; v < nv; ++v)
+    {
+      vr = ir_vreg_get (fn, v);
+      if (!vr->name)
+        continue;
+
+      for (i = def_start[v]; i < def_start[v + 1]; ++i)
+        if (queued[defs[i]->rpo] != v)
+          {
+            queued[defs[i]->rpo] = v;
+            daappend (&work, &defs[i]);
+          }
+
+      while (work.size)
+        {
+          bb = *(ir_block **)dageti (&work, --work.size);
+          for (i = 0; i < df[bb->rpo].size; ++i)
+            {
+              d = *(ir_block **)dageti (&df[bb->rpo], i);
+              if (has_phi[d->rpo] == v)
+                continue;
+              has_phi[d->rpo] = v;
+
+              in = d->head ? ir_insert_before (fn, d->head, IR_PHI)
+                           : ir_append (fn, d, IR_PHI);
+              in->dst = v;
+              in->type = ir_vreg_get (fn, v)->type;
+              in->nargs = d->preds.size;
+              in->args = aralloc (&fn->ar, (in->nargs + 1) * sizeof (U32));
+              for (j = 0; j < in->nargs; ++j)
+                in->args[j] = v;
+
+              if (queued[d->rpo] != v)
+                {
+                  queued[d->rpo] = v;
+                  daappend (&work, &d);
+                }
+            }
+        }
+    }
+
+  dafold (&work);
+  for (i = 0; i < n; ++i)
+    dafold (&df[i]);
+  arfree (df);
+  arfree (def_start);
+  arfree (fill);
+  arfree (defs);
+  arfree (has_phi);
+  arfree (queued);
+
+  /* Rename along the dominator tree. */
+  ctx.fn = fn;
+  ctx.nvars = nv;
+  ctx.cur = aralloc (&fn->ar, nv * sizeof (U32));
+  memset (ctx.cur, 0, nv * sizeof (U32));
+  dainit (&ctx.undo, &fn->ar, 2 * sizeof (U32), 16);
+  _domtree_build (fn, &ctx.dt);
+  _rename (&ctx, OPT_BLOCK (fn, 0));
+  _domtree_fold (&ctx.dt);
+  dafold (&ctx.undo);
+  arfree (ctx.cur);
+
+  fn->ssa = 1;
+}
+
+static U8
+_is_var (opt_rename_ctx *ctx, U32 v)
+{
+  ir_vreg *vr;
+
+  if (v == IR_NONE || v >= ctx->nvars)
+    return 0;
+  vr = ir_vreg_get (ctx->fn, v);
+  return vr->name && vr->base == v;
+}
+
+static void
+_rename_use (U32 *use, void *arg)
+{
+  opt_rename_ctx *ctx = arg;
+
+  if (_is_var (ctx, *use))
+    *use = ctx->cur[*use];
+}
+
+static void
+_rename (opt_rename_ctx *ctx, ir_block *bb)
+{
+  ir_block *s;
+  ir_insn *in;
+  ir_vreg *vr;
+  string *name;
+  U32 mark = ctx->undo.size, pair[2], i, j, var;
+  U8 type;
+
+  for (in = bb->head; in; in = in->next)
+    {
+      if (in->op != IR_PHI)
+        ir_for_each_use (in, _rename_use, ctx);
+      if (!_is_var (ctx, in->dst))
+        continue;
+
+      var = in->dst;
+      vr = ir_vreg_get (ctx->fn, var);
+      name = vr->name;
+      type = vr->type;
+      in->dst = ir_new_vreg (ctx->fn, type, name);
+      ir_vreg_get (ctx->fn, in->dst)->base = var;
+
+      pair[0] = var;
+      pair[1] = ctx->cur[var];
+      daappend (&ctx->undo, pair);
+      ctx->cur[var] = in->dst;
+    }
+
+  for (i = 0; i < bb->succs.size; ++i)
+    {
+      s = OPT_SUCC (bb, i);
+      j = _pred_index (s, bb);
+      for (in = s->head; in && in->op == IR_PHI; in = in->next)
+        {
+          var = ir_vreg_get (ctx->fn, in->dst)->base;
+          if (var < ctx->nvars && in->args[j] == var)
+            in->args[j] = ctx->cur[var];
+        }
+    }
+
+  for (i = ctx->dt.start[bb->rpo]; i < ctx->dt.start[bb->rpo + 1]; ++i)
+    _rename (ctx, ctx->dt.kids[i]);
+
+  while (ctx->undo.size > mark)
+    {
+      U32 *top = dageti (&ctx->undo, --ctx->undo.size);
+      ctx->cur[top[0]] = top[1];
+    }
+}
+
+void
+opt_leave_ssa (ir_func *fn)
+{
+  ir_block *s, *p, *e;
+  ir_insn *in, *next;
+  U32 i, j, k, n = fn->blocks.size, nphi, *dst, *src;
+
+  if (!fn->ssa)
+    return;
+
+  /* Split critical edges into blocks with PHIs so the copies have a place
+     of their own. */
+  for (i = 0; i < n; ++i)
+    {
+      s = OPT_BLOCK (fn, i);
+      if (!s->head || s->head->op != IR_PHI || s->preds.size < 2)
+        continue;
+      for (j = 0; j < s->preds.size; ++j)
+        {
+          p = OPT_PRED (s, j);
+          if (p->succs.size < 2)
+            continue;
+          e = ir_new_block (fn);
+          ir_append (fn, e, IR_JMP)->t = s;
+          _retarget (p, s, e);
+          *(ir_block **)dageti (&s->preds, j) = e;
+        }
+    }
+  ir_build_cfg (fn);
+
+  for (i = 0; i < fn->blocks.size; ++i)
+    {
+      s = OPT_BLOCK (fn, i);
+      nphi = 0;
+      for (in = s->head; in && in->op == IR_PHI; in = in->next)
+        ++nphi;
+      if (!nphi)
+        continue;
+
+      dst = aralloc (&fn->ar, nphi * sizeof (U32));
+      src = aralloc (&fn->ar, nphi * sizeof (U32));
+      for (j = 0; j < s->preds.size; ++j)
+        {
+          p = OPT_PRED (s, j);
+          k = 0;
+          for (in = s->head; in && in->op == IR_PHI; in = in->next)
+            if (in->args[j] != IR_NONE)
+              {
+                dst[k] = in->dst;
+                src[k++] = in->args[j];
+              }
+          _parallel_copy (fn, p->tail, dst, src, k);
+        }
+      arfree (dst);
+      arfree (src);
+
+      for (in = s->head; in && in->op == IR_PHI; in = next)
+        {
+          next = in->next;
+          ir_remove (in);
+        }
+    }
+
+  fn->ssa = 0;
+}
+
+static void
+_parallel_copy (ir_func *fn, ir_insn *pos, U32 *dst, U32 *src, U32 n)
+{
+  ir_insn *in;
+  U32 i, j, left = n, tmp;
+  U8 *done = aralloc (&fn->ar, n + 1), blocked, progress;
+
+  memset (done, 0, n + 1);
+  while (left)
+    {
+      progress = 0;
+      for (i = 0; i < n; ++i)
+        {
+          if (done[i])
+            continue;
+          if (dst[i] == src[i])
+            {
+              done[i] = 1;
+              --left;
+              continue;
+            }
+
+          /* Don't clobber a value another copy still has to read. */
+          blocked = 0;
+          for (j = 0; j < n && !blocked; ++j)
+            blocked = j != i && !done[j] && src[j] == dst[i];
+          if (blocked)
+            continue;
+
+          in = ir_insert_before (fn, pos, IR_MOV);
+          in->dst = dst[i];
+          in->a = src[i];
+          in->type = ir_vreg_get (fn, dst[i])->type;
+          done[i] = 1;
+          --left;
+          progress = 1;
+        }
+
+      if (progress || !left)
+        continue;
+
+      /* Every pending copy is part of a cycle, break it with a temporary. */
+      for (i = 0; done[i]; ++i)
+        ;
+      in = ir_insert_before (fn, pos, IR_MOV);
+      in->type = ir_vreg_get (fn, dst[i])->type;
+      in->dst = tmp = ir_new_vreg (fn, in->type, NULL);
+      in->a = dst[i];
+      for (j = 0; j < n; ++j)
+        if (!done[j] && src[j] == dst[i])
+          src[j] = tmp;
+    }
+
+  arfree (done);
+}
+// }}}
+// [ Constant propagation ] {{{
+static void
+_count_use (U32 *use, void *arg)
+{
+  U32 *count = arg;
+  ++count[*use + 1];
+}
+
+typedef struct
+{
+  U32 *fill;
+  ir_insn **uses;
+  ir_insn *in;
+} opt_use_fill;
+
+static void
+_fill_use (U32 *use, void *arg)
+{
+  opt_use_fill *f = arg;
+  f->uses[f->fill[*use]++] = f->in;
+}
+
+static void
+_sccp_set (opt_sccp_ctx *ctx, U32 v, U8 state, opt_value val)
+{
+  if (v == IR_NONE || state <= ctx->state[v])
+    return;
+  ctx->state[v] = state;
+  ctx->val[v] = val;
+  daappend (&ctx->ssa, &v);
+}
+
+static void
+_sccp_edge (opt_sccp_ctx *ctx, ir_block *bb, U32 k)
+{
+  U32 e = bb->rpo * 2 + k;
+
+  if (!ctx->edge_exec[e])
+    daappend (&ctx->flow, &e);
+}
+
+static U8
+_same_value (U8 type, opt_value a, opt_value b)
+{
+  switch (type)
+    {
+    case IR_REAL:
+      return memcmp (&a.f, &b.f, sizeof (double)) == 0;
+    case IR_STR:
+      return a.s == b.s || strcmp (a.s->data, b.s->data) == 0;
+    default:
+      return a.i == b.i;
+    }
+}
+
+static void
+_sccp_visit (opt_sccp_ctx *ctx, ir_insn *in)
+{
+  ir_block *bb = in->block, *p;
+  opt_value val = { 0 }, a = { 0 }, b = { 0 };
+  U32 i, k;
+  U8 state = OPT_TOP, sa, sb, optype;
+
+  switch (in->op)
+    {
+    case IR_PHI:
+      for (i = 0; i < in->nargs && state != OPT_BOTTOM; ++i)
+        {
+          p = OPT_PRED (bb, i);
+          k = OPT_SUCC (p, 0) == bb ? 0 : 1;
+          if (!ctx->edge_exec[p->rpo * 2 + k] || in->args[i] == IR_NONE)
+            continue;
+          sa = ctx->state[in->args[i]];
+          if (sa == OPT_TOP)
+            continue;
+          if (sa == OPT_BOTTOM
+              || (state == OPT_CONST
+                  && !_same_value (in->type, val, ctx->val[in->args[i]])))
+            state = OPT_BOTTOM;
+          else
+            {
+              state = OPT_CONST;
+              val = ctx->val[in->args[i]];
+            }
+        }
+      _sccp_set (ctx, in->dst, state, val);
+      return;
+    case IR_JMP:
+      _sccp_edge (ctx, bb, 0);
+      return;
+    case IR_BR:
+      sa = ctx->state[in->a];
+      if (sa == OPT_CONST)
+        _sccp_edge (ctx, bb, ctx->val[in->a].i ? 0 : 1);
+      else if (sa == OPT_BOTTOM)
+        {
+          _sccp_edge (ctx, bb, 0);
+          _sccp_edge (ctx, bb, 1);
+        }
+      return;
+    case IR_CONST:
+      val.i = in->imm.i;
+      if (in->type == IR_REAL)
+        val.f = in->imm.f;
+      else if (in->type == IR_STR)
+        val.s = in->imm.s;
+      _sccp_set (ctx, in->dst, OPT_CONST, val);
+      return;
+    default:
+      break;
+    }
+
+  if (in->dst == IR_NONE)
+    return;
+  if (!_is_pure (in))
+    {
+      _sccp_set (ctx, in->dst, OPT_BOTTOM, val);
+      return;
+    }
+
+  sa = ctx->state[in->a];
+  sb = ir_op_nsrc (in->op) > 1 ? ctx->state[in->b] : OPT_CONST;
+  if (sa == OPT_BOTTOM || sb == OPT_BOTTOM)
+    {
+      _sccp_set (ctx, in->dst, OPT_BOTTOM, val);
+      return;
+    }
+  if (sa == OPT_TOP || sb == OPT_TOP)
+    return;
+
+  a = ctx->val[in->a];
+  if (ir_op_nsrc (in->op) > 1)
+    b = ctx->val[in->b];
+  optype = ir_vreg_get (ctx->fn, in->a)->type;
+  if (_fold (in->op, optype, a, b, &val))
+    _sccp_set (ctx, in->dst, OPT_BOTTOM, val);
+  else
+    _sccp_set (ctx, in->dst, OPT_CONST, val);
+}
+
+void
+opt_sccp (ir_func *fn)
+{
+  opt_sccp_ctx ctx;
+  opt_use_fill f;
+  ir_block *bb, *s;
+  ir_insn *in, *next, *c, *pos;
+  U32 i, e, v, n = fn->blocks.size, nv = fn->vregs.size;
+
+  ctx.fn = fn;
+  ctx.state = aralloc (&fn->ar, nv);
+  ctx.val = aralloc (&fn->ar, nv * sizeof (opt_value));
+  ctx.block_exec = aralloc (&fn->ar, n);
+  ctx.edge_exec = aralloc (&fn->ar, n * 2);
+  memset (ctx.state, OPT_TOP, nv);
+  memset (ctx.block_exec, 0, n);
+  memset (ctx.edge_exec, 0, n * 2);
+  dainit (&ctx.flow, &fn->ar, sizeof (U32), 16);
+  dainit (&ctx.ssa, &fn->ar, sizeof (U32), 64);
+
+  /* Uses of every vreg. */
+  ctx.use_start = aralloc (&fn->ar, (nv + 1) * sizeof (U32));
+  memset (ctx.use_start, 0, (nv + 1) * sizeof (U32));
+  for (i = 0; i < n; ++i)
+    for (in = OPT_BLOCK (fn, i)->head; in; in = in->next)
+      ir_for_each_use (in, _count_use, ctx.use_start);
+  for (i = 0; i < nv; ++i)
+    ctx.use_start[i + 1] += ctx.use_start[i];
+  ctx.uses = aralloc (&fn->ar, (ctx.use_start[nv] + 1) * sizeof (ir_insn *));
+  f.fill = aralloc (&fn->ar, (nv + 1) * sizeof (U32));
+  f.uses = ctx.uses;
+  memcpy (f.fill, ctx.use_start, (nv + 1) * sizeof (U32));
+  for (i = 0; i < n; ++i)
+    for (f.in = OPT_BLOCK (fn, i)->head; f.in; f.in = f.in->next)
+      ir_for_each_use (f.in, _fill_use, &f);
+  arfree (f.fill);
+
+  /* Wegman and Zadeck, "Constant Propagation with Conditional
+     Branches". */
+  bb = OPT_BLOCK (fn, 0);
+  ctx.block_exec[0] = 1;
+  for (in = bb->head; in; in = in->next)
+    _sccp_visit (&ctx, in);
+
+  while (ctx.flow.size || ctx.ssa.size)
+    {
+      while (ctx.flow.size)
+        {
+          e = *(U32 *)dageti (&ctx.flow, --ctx.flow.size);
+          if (ctx.edge_exec[e])
+            continue;
+          ctx.edge_exec[e] = 1;
+          s = OPT_SUCC (OPT_BLOCK (fn, e / 2), e % 2);
+          if (!ctx.block_exec[s->rpo])
+            {
+              ctx.block_exec[s->rpo] = 1;
+              for (in = s->head; in; in = in->next)
+                _sccp_visit (&ctx, in);
+            }
+          else
+            for (in = s->head; in && in->op == IR_PHI; in = in->next)
+              _sccp_visit (&ctx, in);
+        }
+
+      while (ctx.ssa.size)
+        {
+          v = *(U32 *)dageti (&ctx.ssa, --ctx.ssa.size);
+          for (i = ctx.use_start[v]; i < ctx.use_start[v + 1]; ++i)
+            if (ctx.block_exec[ctx.uses[i]->block->rpo])
+              _sccp_visit (&ctx, ctx.uses[i]);
+        }
+    }
+
+  /* Replace constant values and decided branches. */
+  for (i = 0; i < n; ++i)
+    {
+      bb = OPT_BLOCK (fn, i);
+      if (!ctx.block_exec[i])
+        continue;
+      for (pos = bb->head; pos && pos->op == IR_PHI; pos = pos->next)
+        ;
+      for (in = bb->head; in; in = next)
+        {
+          next = in->next;
+          if (in->op == IR_BR && ctx.state[in->a] == OPT_CONST)
+            {
+              in->op = IR_JMP;
+              in->t = ctx.val[in->a].i ? in->t : in->f;
+              in->f = NULL;
+              in->a = IR_NONE;
+              continue;
+            }
+          if (in->op == IR_CONST || in->dst == IR_NONE
+              || ctx.state[in->dst] != OPT_CONST)
+            continue;
+
+          c = ir_insert_before (fn, pos, IR_CONST);
+          c->dst = in->dst;
+          c->type = ir_vreg_get (fn, in->dst)->type;
+          c->imm.i = ctx.val[in->dst].i;
+          if (c->type == IR_REAL)
+            c->imm.f = ctx.val[in->dst].f;
+          else if (c->type == IR_STR)
+            c->imm.s = ctx.val[in->dst].s;
+          if (in == pos)
+            pos = next;
+          ir_remove (in);
+        }
+    }
+
+  dafold (&ctx.flow);
+  dafold (&ctx.ssa);
+  arfree (ctx.state);
+  arfree (ctx.val);
+  arfree (ctx.block_exec);
+  arfree (ctx.edge_exec);
+  arfree (ctx.use_start);
+  arfree (ctx.uses);
+
+  ir_build_cfg (fn);
+}
+
+static int
+_fold (U8 op, U8 optype, opt_value a, opt_value b, opt_value *out)
+{
+  out->i = 0;
+
+  if (optype == IR_STR)
+    {
+      if (op != IR_MOV)
+        return 1;
+      out->s = a.s;
+      return 0;
+    }
+
+  if (optype == IR_REAL)
+    {
+      switch (op)
+        {
+        case IR_MOV:
+          out->f = a.f;
+          return 0;
+        case IR_ADD:
+          out->f = a.f + b.f;
+          return 0;
+        case IR_SUB:
+          out->f = a.f - b.f;
+          return 0;
+        case IR_MUL:
+          out->f = a.f * b.f;
+          return 0;
+        case IR_DIV:
+          out->f = a.f / b.f;
+          return 0;
+        case IR_NEG:
+          out->f = -a.f;
+          return 0;
+        case IR_LT:
+          out->i = a.f < b.f;
+          return 0;
+        case IR_LE:
+          out->i = a.f <= b.f;
+          return 0;
+        case IR_GT:
+          out->i = a.f > b.f;
+          return 0;
+        case IR_GE:
+          out->i = a.f >= b.f;
+          return 0;
+        case IR_EQ:
+          out->i = a.f == b.f;
+          return 0;
+        case IR_NE:
+          out->i = a.f != b.f;
+          return 0;
+        default:
+          return 1;
+        }
+    }
+
+  /* Integers are 64 bit and wrap, division keeps its traps. */
+  switch (op)
+    {
+    case IR_MOV:
+      out->i = a.i;
+      break;
+    case IR_ADD:
+      out->i = (long)((unsigned long)a.i + (unsigned long)b.i);
+      break;
+    case IR_SUB:
+      out->i = (long)((unsigned long)a.i - (unsigned long)b.i);
+      break;
+    case IR_MUL:
+      out->i = (long)((unsigned long)a.i * (unsigned long)b.i);
+      break;
+    case IR_DIV:
+    case IR_MOD:
+      if (b.i == 0 || (b.i == -1 && a.i == LONG_MIN))
+        return 1;
+      out->i = op == IR_DIV ? a.i / b.i : a.i % b.i;
+      break;
+    case IR_NEG:
+      out->i = (long)(0 - (unsigned long)a.i);
+      break;
+    case IR_NOT:
+      out->i = !a.i;
+      break;
+    case IR_LT:
+      out->i = a.i < b.i;
+      break;
+    case IR_LE:
+      out->i = a.i <= b.i;
+      break;
+    case IR_GT:
+      out->i = a.i > b.i;
+      break;
+    case IR_GE:
+      out->i = a.i >= b.i;
+      break;
+    case IR_EQ:
+      out->i = a.i == b.i;
+      break;
+    case IR_NE:
+      out->i = a.i != b.i;
+      break;
+    case IR_ITOF:
+      out->f = (double)a.i;
+      break;
+    default:
+      return 1;
+    }
+
+  return 0;
+}
+// }}}
+// [ Copy propagation ] {{{
+static U32
+_find (U32 *repl, U32 v)
+{
+  while (repl[v] != v)
+    {
+      repl[v] = repl[repl[v]];
+      v = repl[v];
+    }
+  return v;
+}
+
+static void
+_repl_use (U32 *use, void *arg)
+{
+  *use = _find (arg, *use);
+}
+
+static void
+_apply_repl (ir_func *fn, U32 *repl)
+{
+  ir_block *bb;
+  ir_insn *in, *next;
+  U32 i;
+
+  for (i = 0; i < fn->blocks.size; ++i)
+    {
+      bb = OPT_BLOCK (fn, i);
+      for (in = bb->head; in; in = next)
+        {
+          next = in->next;
+          if (in->dst != IR_NONE && _find (repl, in->dst) != in->dst)
+            ir_remove (in);
+          else
+            ir_for_each_use (in, _repl_use, repl);
+        }
+    }
+}
+
+void
+opt_copy_prop (ir_func *fn)
+{
+  ir_block *bb;
+  ir_insn *in;
+  U32 i, j, v, x, self, nv = fn->vregs.size;
+  U32 *repl = aralloc (&fn->ar, nv * sizeof (U32));
+  U8 changed = 1;
+
+  for (i = 0; i < nv; ++i)
+    repl[i] = i;
+
+  while (changed)
+    {
+      changed = 0;
+      for (i = 0; i < fn->blocks.size; ++i)
+        {
+          bb = OPT_BLOCK (fn, i);
+          for (in = bb->head; in; in = in->next)
+            {
+              if (in->dst == IR_NONE || _find (repl, in->dst) != in->dst)
+                continue;
+
+              v = IR_NONE;
+              if (in->op == IR_MOV
+                  && ir_vreg_get (fn, in->a)->type
+                         == ir_vreg_get (fn, in->dst)->type)
+                v = _find (repl, in->a);
+              else if (in->op == IR_PHI)
+                {
+                  /* A PHI merging one value, besides itself, is a copy. */
+                  self = in->dst;
+                  for (j = 0; j < in->nargs; ++j)
+                    {
+                      x = _find (repl, in->args[j]);
+                      if (x == self || x == v)
+                        continue;
+                      if (v != IR_NONE || x == IR_NONE)
+                        break;
+                      v = x;
+                    }
+                  if (j < in->nargs)
+                    v = IR_NONE;
+                }
+
+              if (v != IR_NONE && v != in->dst)
+                {
+                  repl[in->dst] = v;
+                  changed = 1;
+                }
+            }
+        }
+    }
+
+  _apply_repl (fn, repl);
+  arfree (repl);
+}
+// }}}
+// [ Value numbering ] {{{
+static U8
+_is_pure (ir_insn *in)
+{
+  switch (in->op)
+    {
+    case IR_CONST:
+    case IR_MOV:
+    case IR_ADD:
+    case IR_SUB:
+    case IR_MUL:
+    case IR_DIV:
+    case IR_MOD:
+    case IR_NEG:
+    case IR_NOT:
+    case IR_LT:
+    case IR_LE:
+    case IR_GT:
+    case IR_GE:
+    case IR_EQ:
+    case IR_NE:
+    case IR_ITOF:
+      return 1;
+    default:
+      return 0;
+    }
+}
+
+static U32
+_gvn_hash (ir_insn *in)
+{
+  U64 h = (U64)in->op * 0x9E3779B97F4A7C15ull ^ in->type;
+  U32 i;
+
+  h = (h ^ in->a) * 0xBF58476D1CE4E5B9ull;
+  h = (h ^ in->b) * 0x94D049BB133111EBull;
+  if (in->op == IR_CONST && in->type == IR_STR)
+    for (i = 0; i < in->imm.s->size; ++i)
+      h = (h ^ (U8)in->imm.s->data[i]) * 0x100000001B3ull;
+  else if (in->op == IR_CONST)
+    h = (h ^ (U64)in->imm.i) * 0xBF58476D1CE4E5B9ull;
+
+  return (U32)(h ^ (h >> 31));
+}
+
+static U8
+_gvn_equal (ir_insn *x, ir_insn *y)
+{
+  opt_value a, b;
+
+  if (x->op != y->op || x->type != y->type || x->a != y->a || x->b != y->b)
+    return 0;
+  if (x->op != IR_CONST)
+    return 1;
+
+  a.i = x->imm.i;
+  b.i = y->imm.i;
+  if (x->type == IR_REAL)
+    {
+      a.f = x->imm.f;
+      b.f = y->imm.f;
+    }
+  else if (x->type == IR_STR)
+    {
+      a.s = x->imm.s;
+      b.s = y->imm.s;
+    }
+  return _same_value (x->type, a, b);
+}
+
+void
+opt_gvn (ir_func *fn)
+{
+  opt_gvn_ctx ctx;
+  ir_insn *in;
+  U32 i, count = 0, cap = 16, nv = fn->vregs.size;
+
+  for (i = 0; i < fn->blocks.size; ++i)
+    for (in = OPT_BLOCK (fn, i)->head; in; in = in->next)
+      ++count;
+  while (cap < count * 2)
+    cap <<= 1;
+
+  ctx.slots = aralloc (&fn->ar, cap * sizeof (ir_insn *));
+  memset (ctx.slots, 0, cap * sizeof (ir_insn *));
+  ctx.mask = cap - 1;
+  ctx.repl = aralloc (&fn->ar, nv * sizeof (U32));
+  for (i = 0; i < nv; ++i)
+    ctx.repl[i] = i;
+  dainit (&ctx.undo, &fn->ar, sizeof (U32), 64);
+
+  opt_dominators (fn);
+  _domtree_build (fn, &ctx.dt);
+  _gvn_block (fn, &ctx, OPT_BLOCK (fn, 0));
+  _domtree_fold (&ctx.dt);
+
+  /* PHI operands may come from blocks visited after the PHI. */
+  _apply_repl (fn, ctx.repl);
+
+  dafold (&ctx.undo);
+  arfree (ctx.slots);
+  arfree (ctx.repl);
+}
+
+static void
+_gvn_block (ir_func *fn, opt_gvn_ctx *ctx, ir_block *bb)
+{
+  ir_insn *in, *next, *other;
+  U32 mark = ctx->undo.size, slot, i, tmp;
+
+  for (in = bb->head; in; in = next)
+    {
+      next = in->next;
+      if (in->op == IR_PHI)
+        continue;
+      ir_for_each_use (in, _repl_use, ctx->repl);
+      if (!_is_pure (in) || in->op == IR_MOV || in->dst == IR_NONE)
+        continue;
+
+      /* Give commutative operations one canonical operand order. */
+      if ((in->op == IR_ADD || in->op == IR_MUL || in->op == IR_EQ
+           || in->op == IR_NE)
+          && in->a > in->b)
+        {
+          tmp = in->a;
+          in->a = in->b;
+          in->b = tmp;
+        }
+
+      for (slot = _gvn_hash (in) & ctx->mask; (other = ctx->slots[slot]);
+           slot = (slot + 1) & ctx->mask)
+        if (_gvn_equal (in, other))
+          break;
+
+      if (other)
+        {
+          ctx->repl[in->dst] = other->dst;
+          ir_remove (in);
+        }
+      else
+        {
+          ctx->slots[slot] = in;
+          daappend (&ctx->undo, &slot);
+        }
+    }
+
+  for (i = ctx->dt.start[bb->rpo]; i < ctx->dt.start[bb->rpo + 1]; ++i)
+    _gvn_block (fn, ctx, ctx->dt.kids[i]);
+
+  /* Leaving the scope, entries are removed in reverse order so the probe
+     sequences of older ones stay intact. */
+  while (ctx->undo.size > mark)
+    {
+      slot = *(U32 *)dageti (&ctx->undo, --ctx->undo.size);
+      ctx->slots[slot] = NULL;
+    }
+}
+// }}}
+// [ Loop-invariant code motion ] {{{
+void
+opt_licm (ir_func *fn)
+{
+  ir_block *h, *p, *pre, *bb;
+  ir_insn *in, *next, **def;
+  U32 i, j, k, n, outside, *mark;
+  U8 changed, invariant;
+
+  /* Give every loop a preheader: a block outside the loop that is the only
+     way into its header. */
+  opt_dominators (fn);
+  n = fn->blocks.size;
+  for (i = 0; i < n; ++i)
+    {
+      h = OPT_BLOCK (fn, i);
+      outside = 0;
+      p = NULL;
+      for (j = 0; j < h->preds.size; ++j)
+        if (!_dominates (h, OPT_PRED (h, j)))
+          {
+            ++outside;
+            p = OPT_PRED (h, j);
+          }
+      if (outside == h->preds.size || outside != 1 || p->succs.size == 1)
+        continue;
+
+      pre = ir_new_block (fn);
+      ir_append (fn, pre, IR_JMP)->t = h;
+      _retarget (p, h, pre);
+      *(ir_block **)dageti (&h->preds, _pred_index (h, p)) = pre;
+    }
+  ir_build_cfg (fn);
+  opt_dominators (fn);
+
+  n = fn->blocks.size;
+  mark = aralloc (&fn->ar, n * sizeof (U32));
+  memset (mark, 0, n * sizeof (U32));
+  def = _def_map (fn);
+
+  /* Inner loops come later in reverse post-order, so walking headers
+     backwards lets invariants bubble out through several levels. */
+  for (i = n; i > 0; --i)
+    {
+      h = OPT_BLOCK (fn, i - 1);
+      pre = NULL;
+      for (j = 0; j < h->preds.size; ++j)
+        {
+          p = OPT_PRED (h, j);
+          if (_dominates (h, p))
+            continue;
+          if (pre)
+            break;
+          pre = p;
+        }
+      if (!pre || j < h->preds.size || pre->succs.size != 1)
+        continue;
+      for (j = 0; j < h->preds.size; ++j)
+        if (_dominates (h, OPT_PRED (h, j)))
+          break;
+      if (j == h->preds.size)
+        continue;
+
+      _natural_loop (fn, h, mark, i);
+      changed = 1;
+      while (changed)
+        {
+          changed = 0;
+          for (k = h->rpo; k < n; ++k)
+            {
+              if (mark[k] != i)
+                continue;
+              bb = OPT_BLOCK (fn, k);
+              for (in = bb->head; in; in = next)
+                {
+                  next = in->next;
+                  /* Division may trap, so it stays where the program put
+                     it. */
+                  if (!_is_pure (in) || in->op == IR_DIV || in->op == IR_MOD
+                      || in->dst == IR_NONE)
+                    continue;
+
+                  invariant = 1;
+                  if (in->a && def[in->a] && mark[def[in->a]->block->rpo] == i)
+                    invariant = 0;
+                  if (ir_op_nsrc (in->op) > 1 && def[in->b]
+                      && mark[def[in->b]->block->rpo] == i)
+                    invariant = 0;
+                  if (!invariant)
+                    continue;
+
+                  ir_remove (in);
+                  ir_move_before (in, pre->tail);
+                  changed = 1;
+                }
+            }
+        }
+    }
+
+  arfree (def);
+  arfree (mark);
+}
+
+static ir_insn **
+_def_map (ir_func *fn)
+{
+  ir_insn **def, *in;
+  U32 i, nv = fn->vregs.size;
+
+  def = aralloc (&fn->ar, nv * sizeof (ir_insn *));
+  memset (def, 0, nv * sizeof (ir_insn *));
+  for (i = 0; i < fn->blocks.size; ++i)
+    for (in = OPT_BLOCK (fn, i)->head; in; in = in->next)
+      if (in->dst != IR_NONE)
+        def[in->dst] = in;
+
+  return def;
+}
+// }}}
+// [ Dead code elimination ] {{{
+typedef struct
+{
+  U8 *live;
+  ir_insn **def;
+  da *work;
+} opt_dce_ctx;
+
+static void
+_dce_mark (U32 *use, void *arg)
+{
+  opt_dce_ctx *ctx = arg;
+
+  if (*use == IR_NONE || ctx->live[*use])
+    return;
+  ctx->live[*use] = 1;
+  if (ctx->def[*use])
+    daappend (ctx->work, &ctx->def[*use]);
+}
+
+void
+opt_dce (ir_func *fn)
+{
+  opt_dce_ctx ctx;
+  ir_block *bb;
+  ir_insn *in, *next;
+  da work;
+  U32 i, nv = fn->vregs.size;
+
+  ctx.live = aralloc (&fn->ar, nv);
+  memset (ctx.live, 0, nv);
+  ctx.def = _def_map (fn);
+  ctx.work = &work;
+  dainit (&work, &fn->ar, sizeof (ir_insn *), 64);
+
+  /* Everything the side effects depend on is live, the rest is not.
+     Stores to a variable that are overwritten before being read had their
+     SSA versions left without uses, so they go as well. */
+  for (i = 0; i < fn->blocks.size; ++i)
+    for (in = OPT_BLOCK (fn, i)->head; in; in = in->next)
+      if (ir_has_side_effects (in) || ir_is_terminator (in->op))
+        ir_for_each_use (in, _dce_mark, &ctx);
+  while (work.size)
+    {
+      in = *(ir_insn **)dageti (&work, --work.size);
+      ir_for_each_use (in, _dce_mark, &ctx);
+    }
+
+  for (i = 0; i < fn->blocks.size; ++i)
+    {
+      bb = OPT_BLOCK (fn, i);
+      for (in = bb->head; in; in = next)
+        {
+          next = in->next;
+          if (ir_has_side_effects (in) || ir_is_terminator (in->op))
+            continue;
+          if (in->dst == IR_NONE || !ctx.live[in->dst])
+            ir_remove (in);
+        }
+    }
+
+  dafold (&work);
+  arfree (ctx.live);
+  arfree (ctx.def);
+}
+// }}}
+
+// vim:fdm=marker:
@@ -0,0 +1,47 @@
+#ifndef OPT_H
+#define OPT_H
+
+#include "ir.h"
+
+/* Run the passes enabled at optimization LEVEL (0-3) over FN.
+
+     -O0  nothing
+     -O1  SSA construction, sparse conditional constant propagation,
+          copy propagation, dead code elimination
+     -O2  -O1 plus global value numbering and loop-invariant code motion
+     -O3  -O2 with a second round of every pass
+
+   For LEVEL > 0 FN is left in SSA form. */
+void opt_run (ir_func *fn, U8 level);
+
+/* Merge and bypass trivial blocks. */
+void opt_simplify_cfg (ir_func *fn);
+
+/* Compute immediate dominators of every block. */
+void opt_dominators (ir_func *fn);
+
+/* Compute loop nesting depth of every block. */
+void opt_loops (ir_func *fn);
+
+/* Rewrite FN into SSA form, inserting PHI nodes. */
+void opt_build_ssa (ir_func *fn);
+
+/* Sparse conditional constant propagation. */
+void opt_sccp (ir_func *fn);
+
+/* Replace copies and redundant PHIs with their source. */
+void opt_copy_prop (ir_func *fn);
+
+/* Dominator based global value numbering. */
+void opt_gvn (ir_func *fn);
+
+/* Hoist loop-invariant computations into loop preheaders. */
+void opt_licm (ir_func *fn);
+
+/* Remove instructions whose results are never used. */
+void opt_dce (ir_func *fn);
+
+/* Replace PHI nodes with copies in the predecessors. */
+void opt_leave_ssa (ir_func *fn);
+
+#endif /* not OPT_H */
@@ -0,0 +1,176 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "pbc.h"
+#include "sink.h"
+
+#define PBC_ALIGN(v) (((v) + 7) & ~(U64)7)
+
+/* Write LEN bytes of DATA padded with zeros to the next multiple of 8. */
+static void _write_section (sink *out, const void *data, U64 len);
+
+/* Whether the section at OFF of COUNT items of SIZE bytes, aligned to
+   ALIGN, lies inside a file of FILE_SIZE bytes. */
+static int _section_ok (U64 off, U64 count, U64 size, U64 align,
+                        U64 file_size);
+
+int
+pbc_write (const char *path, const bc_prog *p)
+{
+  pbc_header h = { 0 };
+  sink out;
+  U64 size;
+  int fd, status;
+
+  memcpy (h.magic, PBC_MAGIC, sizeof (h.magic));
+  h.version = PBC_VERSION;
+  h.insn_size = sizeof (bc_insn);
+  h.nregs = p->nregs;
+  h.consts_off = PBC_ALIGN (sizeof (h));
+  h.nconsts = p->nconsts;
+  h.code_off = h.consts_off + p->nconsts * sizeof (S64);
+  h.ncode = p->ncode;
+  h.strs_off = h.code_off + PBC_ALIGN (p->ncode * sizeof (bc_insn));
+  h.strs_size = p->strs_size;
+  h.kinds_off = h.strs_off + PBC_ALIGN (p->strs_size);
+  size = h.kinds_off + PBC_ALIGN (p->nregs);
+  if (size > UINT32_MAX)
+    {
+      fprintf (stderr, "Error: Program too large for a bytecode file.\n");
+      return 1;
+    }
+  h.size = size;
+
+  /* A VM still running the old file has it mapped. */
+  if (unlink (path) < 0 && errno != ENOENT)
+    {
+      fprintf (stderr, "Error: Failed to replace \"%s\".\n", path);
+      return 1;
+    }
+  fd = open (path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (fd < 0 || sink_open_fd (&out, fd, SINK_CAPACITY))
+    {
+      fprintf (stderr, "Error: Failed to open \"%s\".\n", path);
+      if (fd >= 0)
+        close (fd);
+      return 1;
+    }
+
+  _write_section (&out, &h, sizeof (h));
+  _write_section (&out, p->consts, p->nconsts * sizeof (S64));
+  _write_section (&out, p->code, p->ncode * sizeof (bc_insn));
+  _write_section (&out, p->strs, p->strs_size);
+  _write_section (&out, p->kinds, p->nregs);
+  status = sink_fold (&out);
+  if (close (fd) < 0)
+    status = 1;
+  if (status)
+    fprintf (stderr, "Error: Failed to write \"%s\".\n", path);
+
+  return status;
+}
+
+int
+pbc_load (bc_prog *p, const char *path)
+{
+  const pbc_header *h;
+  struct stat st;
+  U8 *map;
+  int fd;
+
+  fd = open (path, O_RDONLY);
+  if (fd < 0 || fstat (fd, &st) < 0)
+    {
+      fprintf (stderr, "Error: Failed to open \"%s\".\n", path);
+      if (fd >= 0)
+        close (fd);
+      return 1;
+    }
+  if ((U64)st.st_size < sizeof (pbc_header))
+    {
+      fprintf (stderr, "Error: \"%s\" is truncated or corrupt.\n", path);
+      close (fd);
+      return 1;
+    }
+
+  map = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED)
+    {
+      fprintf (stderr, "Error: Failed to map \"%s\".\n", path);
+      return 1;
+    }
+  p->map = map;
+  p->map_size = st.st_size;
+
+  h = (const pbc_header *)map;
+  if (memcmp (h->magic, PBC_MAGIC, sizeof (h->magic)) != 0)
+    {
+      fprintf (stderr, "Error: \"%s\" is not a bytecode file.\n", path);
+      return 1;
+    }
+  if (h->version != PBC_VERSION || h->insn_size != sizeof (bc_insn))
+    {
+      fprintf (stderr, "Error: \"%s\" is bytecode version %u, expected %u.\n",
+               path, h->version, PBC_VERSION);
+      return 1;
+    }
+  if (h->size != (U64)st.st_size || h->nregs > BC_MAX_REGS
+      || !_section_ok (h->consts_off, h->nconsts, sizeof (S64), 8, h->size)
+      || !_section_ok (h->code_off, h->ncode, sizeof (bc_insn), 8, h->size)
+      || !_section_ok (h->strs_off, h->strs_size, 1, 8, h->size)
+      || !_section_ok (h->kinds_off, h->nregs, 1, 1, h->size))
+    {
+      fprintf (stderr, "Error: \"%s\" is truncated or corrupt.\n", path);
+      return 1;
+    }
+
+  p->consts = (const S64 *)(map + h->consts_off);
+  p->nconsts = h->nconsts;
+  p->code = (const bc_insn *)(map + h->code_off);
+  p->ncode = h->ncode;
+  p->strs = (const char *)(map + h->strs_off);
+  p->strs_size = h->strs_size;
+  p->nregs = h->nregs;
+  p->kinds = map + h->kinds_off;
+
+  return bc_verify (p);
+}
+
+int
+pbc_is_file (const char *path)
+{
+  char magic[4];
+  int fd, ok;
+
+  fd = open (path, O_RDONLY);
+  if (fd < 0)
+    return 0;
+  ok = read (fd, magic, sizeof (magic)) == sizeof (magic)
+       && memcmp (magic, PBC_MAGIC, sizeof (magic)) == 0;
+  close (fd);
+  return ok;
+}
+
+static void
+_write_section (sink *out, const void *data, U64 len)
+{
+  static const char zeros[8];
+
+  if (len)
+    sink_write (out, data, len);
+  if (len % 8)
+    sink_write (out, zeros, 8 - len % 8);
+}
+
+static int
+_section_ok (U64 off, U64 count, U64 size, U64 align, U64 file_size)
+{
+  return off % align == 0 && off <= file_size
+         && count <= (file_size - off) / size;
+}
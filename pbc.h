@@ -0,0 +1,41 @@
+#ifndef PBC_H
+#define PBC_H
+
+#include "bc.h"
+
+#define PBC_MAGIC "\x7fPBC"
+#define PBC_VERSION 3
+
+/* A .pbc file holds one bytecode program as the VM runs it.  The header
+   is followed by the sections it points to: the constant pool (S64), the
+   code (bc_insn), the string table and the kind of each register (U8),
+   each aligned to 8 bytes.  Numbers are in the byte order of the
+   machine, a file from the other order fails the version check. */
+typedef struct pbc_header
+{
+  char magic[4];
+  U16 version;
+  U16 insn_size; /* sizeof (bc_insn) */
+  U32 size;      /* Of the whole file. */
+  U32 nregs;
+  U32 consts_off;
+  U32 nconsts;
+  U32 code_off;
+  U32 ncode;
+  U32 strs_off;
+  U32 strs_size;
+  U32 kinds_off; /* nregs bytes. */
+} pbc_header;
+
+/* Write P to PATH.  Returns 1 on failure. */
+int pbc_write (const char *path, const bc_prog *p);
+
+/* Map PATH and point P into it, nothing is copied.  The program is
+   verified before it is returned, see bc_verify for what that leaves to
+   trust.  Free it with bc_fold.  Returns 1 on failure. */
+int pbc_load (bc_prog *p, const char *path);
+
+/* Whether PATH names a .pbc file. */
+int pbc_is_file (const char *path);
+
+#endif /* not PBC_H */
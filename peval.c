@@ -0,0 +1,830 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "peval.h"
+#include "utils.h"
+
+/* The number formatting of the runtimes, so that the output matches
+   theirs to the byte. */
+#include "runtime/format.c"
+
+/* Value of an expression, or what a variable holds. */
+typedef struct peval_value
+{
+  U16 type; /* AST_INTLIT, AST_FLOATLIT, AST_BOOL or AST_STRLIT. */
+  long i;   /* Integers and booleans. */
+  double f;
+  string s;               /* Never changed once made, so shared freely. */
+  struct peval_value *p; /* Elements of an array, or the variable a var
+                            parameter stands for. */
+} peval_value;
+
+/* Where variable VAR lives: slot SLOT of the globals, or of the frame of
+   the routine running when LOCAL is set. */
+typedef struct
+{
+  void *var;
+  U32 slot;
+  U8 local;
+} peval_slot;
+
+typedef struct
+{
+  peval *pe;
+  da slots; /* peval_slot of every variable, sorted by VAR. */
+  ht lits;  /* String literals with their escapes resolved, by text. */
+  peval_value *globals;
+  peval_value *frame;
+  char *out; /* Output so far, LEN of CAP bytes. */
+  U32 len, cap;
+  U32 steps, budget, depth;
+  U32 effects; /* Output and stores outside the running frame so far. */
+  U64 memory;  /* Bytes of strings, arrays and frames. */
+  U8 stop;    /* Set once the program cannot go on in here. */
+} peval_state;
+
+/* Number the variables of program ROOT, the globals and the locals of
+   each routine, into ST->slots. */
+static void _number (peval_state *st, ast_node *root);
+
+/* Run the statements of list PTR. */
+static void _stmts (peval_state *st, ast_node *ptr);
+
+/* Run statement S. */
+static void _stmt (peval_state *st, ast_node *s);
+
+/* Run the write or writeln DATA, LN set for writeln. */
+static void _write (peval_state *st, ast_data_funcall *data, U8 ln);
+
+/* Value of expression EXP. */
+static peval_value _eval (peval_state *st, ast_node *exp);
+
+/* Value of operator DATA. */
+static peval_value _op (peval_state *st, ast_data_op *data);
+
+/* Value of call DATA of a routine or builtin. */
+static peval_value _funcall (peval_state *st, ast_data_funcall *data);
+
+/* Run the routine called by DATA in a frame of its own.  Returns its
+   result, if a function. */
+static peval_value _call (peval_state *st, ast_data_funcall *data);
+
+/* Variable NODE, the one passed in when it is a var parameter. */
+static peval_value *_var (peval_state *st, ast_node *node);
+
+/* Element of array INDEX, NULL when out of bounds. */
+static peval_value *_element (peval_state *st, ast_data_index *index);
+
+/* Count a store to variable NODE when it outlives the running
+   frame. */
+static void _effect (peval_state *st, ast_node *node);
+
+/* Slot of variable VAR. */
+static peval_slot *_slot (peval_state *st, void *var);
+
+/* V stored in a variable of DATATYPE, as C converts it. */
+static peval_value _convert (peval_state *st, peval_value v, U16 datatype);
+
+/* Start variable VAR out as zero in CELL, with its elements when an
+   array. */
+static void _zero (peval_state *st, peval_value *cell,
+                   ast_data_var_declare *var);
+
+/* String literal LIT as the program sees it. */
+static string _lit (peval_state *st, string *lit);
+
+/* SIZE bytes counted against PEVAL_MEMORY, NULL when over it. */
+static void *_alloc (peval_state *st, U64 size);
+
+/* Count a step against the budget.  Returns whether the program may
+   go on. */
+static U8 _step (peval_state *st);
+
+/* Append N bytes of S to the output. */
+static void _put (peval_state *st, const char *s, U32 n);
+
+/* Append N spaces to the output, nothing when N is not positive. */
+static void _pad (peval_state *st, long n);
+
+int
+peval_run (peval *ctx, ast_node *root, U32 steps)
+{
+  peval_state st = { 0 };
+  ast_node *ptr;
+  peval_slot *slot;
+  U32 nglobals = 0;
+
+  st.pe = ctx;
+  st.budget = steps;
+  htinit (&st.lits, &ctx->ar, 64, sizeof (string));
+  _number (&st, root);
+
+  for (ptr = root; ptr; ptr = ptr->next)
+    nglobals += ptr->type == AST_VAR_DECLARE;
+  st.globals = _alloc (&st, (U64)(nglobals + 1) * sizeof (peval_value));
+  for (ptr = root; ptr && !st.stop; ptr = ptr->next)
+    {
+      if (ptr->type != AST_VAR_DECLARE)
+        continue;
+      slot = _slot (&st, ptr->data);
+      _zero (&st, st.globals + slot->slot, ptr->data);
+    }
+
+  for (ptr = root; ptr && !st.stop; ptr = ptr->next)
+    if (ptr->type == AST_MAIN_BLOCK)
+      _stmts (&st, ((ast_data_block *)ptr->data)->next);
+
+  if (st.stop)
+    return 1;
+  ctx->out.data = st.out ? st.out : "";
+  ctx->out.size = st.len;
+  return 0;
+}
+
+void
+peval_fold (peval *ctx)
+{
+  arfold (&ctx->ar);
+}
+
+// [ Variables ] {{{
+static int
+_slot_cmp (const void *a, const void *b)
+{
+  const peval_slot *x = a, *y = b;
+
+  return (x->var > y->var) - (x->var < y->var);
+}
+
+void
+_number (peval_state *st, ast_node *root)
+{
+  ast_data_routine *routine;
+  ast_node *ptr, *p;
+  peval_slot slot;
+  U32 globals = 0;
+
+  dainit (&st->slots, &st->pe->ar, sizeof (peval_slot), 64);
+  for (ptr = root; ptr; ptr = ptr->next)
+    {
+      if (ptr->type == AST_VAR_DECLARE)
+        {
+          slot.var = ptr->data;
+          slot.slot = globals++;
+          slot.local = 0;
+          daappend (&st->slots, &slot);
+        }
+      if (ptr->type != AST_ROUTINE)
+        continue;
+
+      /* Parameters, then locals, then the result. */
+      routine = ptr->data;
+      slot.slot = 0;
+      slot.local = 1;
+      for (p = routine->params; p; p = p->next, ++slot.slot)
+        {
+          slot.var = p->data;
+          daappend (&st->slots, &slot);
+        }
+      for (p = routine->locals; p; p = p->next, ++slot.slot)
+        {
+          slot.var = p->data;
+          daappend (&st->slots, &slot);
+        }
+      if (routine->result)
+        {
+          slot.var = routine->result->data;
+          daappend (&st->slots, &slot);
+        }
+    }
+  qsort (st->slots.data, st->slots.size, sizeof (peval_slot), _slot_cmp);
+}
+
+peval_slot *
+_slot (peval_state *st, void *var)
+{
+  peval_slot key = { var, 0, 0 };
+
+  return bsearch (&key, st->slots.data, st->slots.size, sizeof (peval_slot),
+                  _slot_cmp);
+}
+
+peval_value *
+_var (peval_state *st, ast_node *node)
+{
+  ast_data_var_declare *var = node->data;
+  peval_slot *slot = _slot (st, var);
+  peval_value *cell;
+
+  if (!slot)
+    {
+      st->stop = 1;
+      return NULL;
+    }
+  cell = (slot->local ? st->frame : st->globals) + slot->slot;
+  return (var->flags & AST_VAR_REF) ? cell->p : cell;
+}
+
+void
+_effect (peval_state *st, ast_node *node)
+{
+  ast_data_var_declare *var = node->data;
+
+  if (!(var->flags & AST_VAR_LOCAL) || (var->flags & AST_VAR_REF))
+    ++st->effects;
+}
+
+peval_value *
+_element (peval_state *st, ast_data_index *index)
+{
+  ast_data_var_declare *var = index->var->data;
+  peval_value *cell = _var (st, index->var);
+  peval_value i = _eval (st, index->index);
+
+  if (st->stop)
+    return NULL;
+  /* The program stops here with an error of its own. */
+  if (!cell->p || (unsigned long)i.i >= var->arsize)
+    {
+      st->stop = 1;
+      return NULL;
+    }
+  return cell->p + i.i;
+}
+
+peval_value
+_convert (peval_state *st, peval_value v, U16 datatype)
+{
+  if (datatype == AST_FLOATLIT && v.type != AST_FLOATLIT)
+    v.f = (double)v.i;
+  else if (datatype != AST_FLOATLIT && v.type == AST_FLOATLIT)
+    {
+      if (!(v.f > (double)LONG_MIN - 1 && v.f < (double)LONG_MAX))
+        st->stop = 1;
+      else
+        v.i = (long)v.f;
+    }
+  /* A boolean is an unsigned int in C. */
+  if (datatype == AST_BOOL)
+    v.i = (unsigned int)v.i;
+  v.type = datatype;
+  return v;
+}
+
+void
+_zero (peval_state *st, peval_value *cell, ast_data_var_declare *var)
+{
+  U32 i;
+
+  memset (cell, 0, sizeof (peval_value));
+  cell->type = var->datatype;
+  if (var->arsize == 0 || var->datatype == AST_STRLIT)
+    return;
+
+  cell->p = _alloc (st, (U64)var->arsize * sizeof (peval_value));
+  if (!cell->p)
+    return;
+  memset (cell->p, 0, var->arsize * sizeof (peval_value));
+  for (i = 0; i < var->arsize; ++i)
+    cell->p[i].type = var->datatype;
+}
+
+string
+_lit (peval_state *st, string *lit)
+{
+  string *found = stget (&st->lits, lit->data), s;
+
+  if (found)
+    return *found;
+  /* As the C compiler reads the literal, up to a NUL. */
+  s.data = aralloc (&st->pe->ar, lit->size + 1);
+  s.size = unescape (s.data, lit->data, lit->size);
+  s.size = strnlen (s.data, s.size);
+  stput (&st->lits, lit->data, &s);
+  return s;
+}
+
+void *
+_alloc (peval_state *st, U64 size)
+{
+  if (st->memory + size > PEVAL_MEMORY)
+    {
+      st->stop = 1;
+      return NULL;
+    }
+  st->memory += size;
+  return aralloc (&st->pe->ar, size ? size : 1);
+}
+// }}}
+// [ Statements ] {{{
+U8
+_step (peval_state *st)
+{
+  if (++st->steps > st->budget)
+    st->stop = 1;
+  return !st->stop;
+}
+
+void
+_stmts (peval_state *st, ast_node *ptr)
+{
+  for (; ptr && !st->stop; ptr = ptr->next)
+    _stmt (st, ptr);
+}
+
+void
+_stmt (peval_state *st, ast_node *s)
+{
+  ast_data_var_assign *va_data;
+  ast_data_funcall *fun_data;
+  ast_data_cond *cond_data;
+  ast_data_while *while_data;
+  ast_data_for *for_data;
+  peval_value *cell, v, to;
+  unsigned long step;
+
+  if (!_step (st))
+    return;
+
+  switch (s->type)
+    {
+    case AST_BLOCK:
+      _stmts (st, ((ast_data_block *)s->data)->next);
+      break;
+    case AST_VAR_ASSIGN:
+      va_data = s->data;
+      cell = va_data->index ? _element (st, va_data->index->data)
+                            : _var (st, va_data->var);
+      v = _eval (st, va_data->value);
+      if (st->stop)
+        break;
+      _effect (st, va_data->var);
+      *cell = _convert (
+          st, v, ((ast_data_var_declare *)va_data->var->data)->datatype);
+      break;
+    case AST_COND:
+      cond_data = s->data;
+      v = _eval (st, cond_data->cond);
+      if (st->stop)
+        break;
+      if (v.i)
+        _stmt (st, cond_data->yes);
+      else if (cond_data->no)
+        _stmt (st, cond_data->no);
+      break;
+    case AST_WHILE:
+      while_data = s->data;
+      for (;;)
+        {
+          v = _eval (st, while_data->cond);
+          if (st->stop || !v.i || !_step (st))
+            break;
+          _stmt (st, while_data->next);
+        }
+      break;
+    case AST_FOR:
+      /* The initial value first, and no step past the final one, as the
+         C loop. */
+      for_data = s->data;
+      v = _convert (st, _eval (st, for_data->from), AST_INTLIT);
+      to = _eval (st, for_data->to);
+      cell = _var (st, for_data->var);
+      if (st->stop || (for_data->down ? v.i < to.i : v.i > to.i))
+        break;
+      _effect (st, for_data->var);
+      *cell = v;
+      step = for_data->down ? -1UL : 1UL;
+      for (;;)
+        {
+          if (!_step (st))
+            break;
+          _stmt (st, for_data->body);
+          if (st->stop
+              || (for_data->down ? cell->i <= to.i : cell->i >= to.i))
+            break;
+          cell->i = (long)((unsigned long)cell->i + step);
+        }
+      break;
+    case AST_FUNCALL:
+      fun_data = s->data;
+      if (streq (fun_data->name->data, "writeln"))
+        _write (st, fun_data, 1);
+      else if (streq (fun_data->name->data, "write"))
+        _write (st, fun_data, 0);
+      else if (fun_data->routine)
+        _call (st, fun_data);
+      else
+        st->stop = 1;
+      break;
+    default:
+      st->stop = 1;
+      break;
+    }
+}
+
+void
+_write (peval_state *st, ast_data_funcall *data, U8 ln)
+{
+  char num[_P__FIXED_SIZE];
+  ast_data_write_arg *wa;
+  ast_node *arg, *value;
+  long width, decimals, zeros;
+  peval_value v;
+  unsigned n;
+
+  for (arg = data->args_head; arg && !st->stop; arg = arg->next)
+    {
+      wa = arg->type == AST_WRITE_ARG ? arg->data : NULL;
+      value = wa ? wa->value : arg;
+      width = 0;
+      decimals = -1;
+      if (wa)
+        width = _eval (st, wa->width).i;
+      /* Decimals only count for reals, the others never read them. */
+      if (wa && wa->decimals && ast_exp_type (value) == AST_FLOATLIT)
+        decimals = _eval (st, wa->decimals).i;
+      v = _eval (st, value);
+      if (st->stop)
+        break;
+
+      switch (v.type)
+        {
+        case AST_INTLIT:
+        case AST_BOOL:
+          n = _p_fmt_int (num, v.i);
+          _pad (st, width - (long)n);
+          _put (st, num, n);
+          break;
+        case AST_FLOATLIT:
+          if (decimals < 0)
+            {
+              n = _p_fmt_real (num, v.f);
+              _pad (st, width - (long)n);
+              _put (st, num, n);
+              break;
+            }
+          zeros = 0;
+          if (decimals > _P__MAX_DECIMALS)
+            {
+              zeros = decimals - _P__MAX_DECIMALS;
+              decimals = _P__MAX_DECIMALS;
+            }
+          n = _p_fmt_fixed (num, v.f, decimals);
+          if (v.f - v.f != 0) /* inf or nan */
+            zeros = 0;
+          _pad (st, width - (long)n - zeros);
+          _put (st, num, n);
+          for (; zeros > 0 && !st->stop; --zeros)
+            _put (st, "0", 1);
+          break;
+        default:
+          _pad (st, width - (long)v.s.size);
+          _put (st, v.s.data, v.s.size);
+          break;
+        }
+    }
+  if (ln)
+    _put (st, "\n", 1);
+}
+
+void
+_put (peval_state *st, const char *s, U32 n)
+{
+  char *grown;
+
+  if (st->stop || n == 0)
+    return;
+  if (st->len + n > PEVAL_OUTPUT)
+    {
+      st->stop = 1;
+      return;
+    }
+  if (st->len + n > st->cap)
+    {
+      st->cap = st->cap ? st->cap : 4096;
+      while (st->len + n > st->cap)
+        st->cap *= 2;
+      grown = aralloc (&st->pe->ar, st->cap);
+      if (st->out)
+        {
+          memcpy (grown, st->out, st->len);
+          arfree (st->out);
+        }
+      st->out = grown;
+    }
+  memcpy (st->out + st->len, s, n);
+  st->len += n;
+  ++st->effects;
+}
+
+void
+_pad (peval_state *st, long n)
+{
+  static const char spaces[] = "                                ";
+  U32 k;
+
+  while (n > 0 && !st->stop)
+    {
+      k = n < (long)sizeof (spaces) - 1 ? (U32)n : sizeof (spaces) - 1;
+      _put (st, spaces, k);
+      n -= k;
+    }
+}
+// }}}
+// [ Expressions ] {{{
+peval_value
+_eval (peval_state *st, ast_node *exp)
+{
+  peval_value v = { 0 }, *cell;
+
+  switch (exp->type)
+    {
+    case AST_INTLIT:
+      v.type = AST_INTLIT;
+      v.i = *(long *)exp->data;
+      break;
+    case AST_BOOL:
+      v.type = AST_BOOL;
+      v.i = *(U16 *)exp->data;
+      break;
+    case AST_FLOATLIT:
+      v.type = AST_FLOATLIT;
+      v.f = *(double *)exp->data;
+      break;
+    case AST_STRLIT:
+      v.type = AST_STRLIT;
+      v.s = _lit (st, exp->data);
+      break;
+    case AST_VAR_DECLARE:
+      cell = _var (st, exp);
+      if (cell)
+        v = *cell;
+      break;
+    case AST_INDEX:
+      cell = _element (st, exp->data);
+      if (cell)
+        v = *cell;
+      break;
+    case AST_FUNCALL:
+      v = _funcall (st, exp->data);
+      break;
+    case AST_OP:
+      v = _op (st, exp->data);
+      break;
+    default:
+      st->stop = 1;
+      break;
+    }
+  return v;
+}
+
+peval_value
+_op (peval_state *st, ast_data_op *data)
+{
+  peval_value a = { 0 }, b, v = { 0 };
+  unsigned long x, y;
+  double f, g;
+  int order;
+
+  if (data->left)
+    a = _eval (st, data->left);
+  b = _eval (st, data->right);
+  if (st->stop)
+    return v;
+
+  /* Arithmetic on booleans is unsigned int arithmetic in C, so is a
+     compare with anything but another boolean. */
+  if ((a.type == AST_BOOL || b.type == AST_BOOL) && data->op != '!'
+      && !(ast_is_compare (data->op) && a.type == b.type))
+    {
+      st->stop = 1;
+      return v;
+    }
+
+  if (!data->left)
+    {
+      v.type = data->op == '!' ? AST_BOOL : b.type;
+      if (data->op == '!')
+        v.i = b.type == AST_FLOATLIT ? !b.f : !b.i;
+      else if (b.type == AST_FLOATLIT)
+        v.f = -b.f;
+      else
+        v.i = (long)-(unsigned long)b.i;
+      return v;
+    }
+
+  if (a.type == AST_STRLIT)
+    {
+      if (data->op == '+')
+        {
+          v.type = AST_STRLIT;
+          v.s.size = a.s.size + b.s.size;
+          v.s.data = _alloc (st, v.s.size);
+          if (v.s.data)
+            {
+              memcpy (v.s.data, a.s.data, a.s.size);
+              memcpy (v.s.data + a.s.size, b.s.data, b.s.size);
+            }
+          return v;
+        }
+      order = memcmp (a.s.data, b.s.data,
+                      a.s.size < b.s.size ? a.s.size : b.s.size);
+      if (!order)
+        order = (a.s.size > b.s.size) - (a.s.size < b.s.size);
+    }
+  else if (a.type == AST_FLOATLIT || b.type == AST_FLOATLIT)
+    {
+      f = a.type == AST_FLOATLIT ? a.f : (double)a.i;
+      g = b.type == AST_FLOATLIT ? b.f : (double)b.i;
+      v.type = AST_FLOATLIT;
+      switch (data->op)
+        {
+        case '+':
+          v.f = f + g;
+          return v;
+        case '-':
+          v.f = f - g;
+          return v;
+        case '*':
+          v.f = f * g;
+          return v;
+        case '/':
+          v.f = f / g;
+          return v;
+        }
+      if (!ast_is_compare (data->op))
+        {
+          st->stop = 1;
+          return v;
+        }
+      /* No NaN compares equal or in order. */
+      if (f != f || g != g)
+        {
+          v.type = AST_BOOL;
+          v.i = data->op == (U8)TOKEN_NEQ;
+          return v;
+        }
+      order = (f > g) - (f < g);
+    }
+  else
+    {
+      /* Wrapping around, as everything but C at -O1 and up does. */
+      x = a.i;
+      y = b.i;
+      v.type = AST_INTLIT;
+      switch (data->op)
+        {
+        case '+':
+          v.i = (long)(x + y);
+          return v;
+        case '-':
+          v.i = (long)(x - y);
+          return v;
+        case '*':
+        case AST_OP_SHL:
+          v.i = (long)(x * y);
+          return v;
+        case '/':
+        case '%':
+        case AST_OP_SHR:
+        case AST_OP_AND:
+          /* The program dies of SIGFPE. */
+          if (b.i == 0 || (a.i == LONG_MIN && b.i == -1))
+            {
+              st->stop = 1;
+              return v;
+            }
+          v.i = data->op == '/' || data->op == AST_OP_SHR ? a.i / b.i
+                                                         : a.i % b.i;
+          return v;
+        }
+      order = (a.i > b.i) - (a.i < b.i);
+    }
+
+  v.type = AST_BOOL;
+  switch (data->op)
+    {
+    case '<':
+      v.i = order < 0;
+      break;
+    case '>':
+      v.i = order > 0;
+      break;
+    case '=':
+      v.i = order == 0;
+      break;
+    case (U8)TOKEN_LEQ:
+      v.i = order <= 0;
+      break;
+    case (U8)TOKEN_GEQ:
+      v.i = order >= 0;
+      break;
+    case (U8)TOKEN_NEQ:
+      v.i = order != 0;
+      break;
+    default:
+      st->stop = 1;
+      break;
+    }
+  return v;
+}
+
+peval_value
+_funcall (peval_state *st, ast_data_funcall *data)
+{
+  peval_value v = { 0 }, s, index, count;
+  unsigned long from, n;
+  U32 effects = st->effects;
+
+  /* C leaves the order of operands and arguments open, so a function
+     that writes or stores outside its frame is left for the program. */
+  if (data->routine)
+    {
+      v = _call (st, data);
+      if (st->effects != effects)
+        st->stop = 1;
+      return v;
+    }
+
+  s = _eval (st, data->args_head);
+  if (streq (data->name->data, "length"))
+    {
+      v.type = AST_INTLIT;
+      v.i = s.s.size;
+      return v;
+    }
+
+  /* copy (s, index, count), as _P__str_copy does it. */
+  index = _eval (st, data->args_head->next);
+  count = _eval (st, data->args_head->next->next);
+  if (st->stop)
+    return v;
+  from = index.i > 1 ? index.i - 1 : 0;
+  if (from > s.s.size || count.i <= 0)
+    from = n = 0;
+  else
+    n = (unsigned long)count.i < s.s.size - from ? (unsigned long)count.i
+                                                 : s.s.size - from;
+  v.type = AST_STRLIT;
+  v.s.data = s.s.data + from;
+  v.s.size = n;
+  return v;
+}
+
+peval_value
+_call (peval_state *st, ast_data_funcall *data)
+{
+  ast_data_routine *routine = data->routine->data;
+  ast_data_var_declare *param;
+  peval_value *frame, *saved, v = { 0 };
+  ast_node *arg, *p;
+  U32 n = routine->nparams + (routine->result != NULL);
+
+  for (p = routine->locals; p; p = p->next)
+    ++n;
+  if (!_step (st) || st->depth >= PEVAL_DEPTH)
+    {
+      st->stop = 1;
+      return v;
+    }
+  frame = _alloc (st, (U64)n * sizeof (peval_value));
+  if (!frame)
+    return v;
+  memset (frame, 0, n * sizeof (peval_value));
+
+  /* The arguments in the frame of the caller. */
+  for (arg = data->args_head, p = routine->params; arg && !st->stop;
+       arg = arg->next, p = p->next)
+    {
+      param = p->data;
+      if (!(param->flags & AST_VAR_REF))
+        frame[_slot (st, param)->slot]
+            = _convert (st, _eval (st, arg), param->datatype);
+      else if (arg->type == AST_INDEX)
+        frame[_slot (st, param)->slot].p = _element (st, arg->data);
+      else
+        frame[_slot (st, param)->slot].p = _var (st, arg);
+    }
+  for (p = routine->locals; p && !st->stop; p = p->next)
+    _zero (st, frame + _slot (st, p->data)->slot, p->data);
+  if (routine->result && !st->stop)
+    _zero (st, frame + _slot (st, routine->result->data)->slot,
+           routine->result->data);
+  if (st->stop)
+    return v;
+
+  saved = st->frame;
+  st->frame = frame;
+  ++st->depth;
+  _stmt (st, routine->body);
+  --st->depth;
+  st->frame = saved;
+
+  if (routine->result)
+    v = frame[_slot (st, routine->result->data)->slot];
+  return v;
+}
+// }}}
+
+// vim:fdm=marker:
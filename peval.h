@@ -0,0 +1,36 @@
+#ifndef PEVAL_H
+#define PEVAL_H
+
+#include "ast.h"
+
+/* Statements, loop trips and calls peval_run carries out before it
+   gives up. */
+#define PEVAL_STEPS (1 << 22)
+
+/* Most bytes of output it collects, and of strings, arrays and frames
+   it keeps. */
+#define PEVAL_OUTPUT (1 << 20)
+#define PEVAL_MEMORY (64 << 20)
+
+/* Deepest recursion it follows. */
+#define PEVAL_DEPTH 4096
+
+typedef struct
+{
+  arena ar;
+  string out; /* What the program wrote, once peval_run returned 0. */
+} peval;
+
+/* Run program ROOT in the compiler the way the C backend compiles it,
+   for at most STEPS steps.  Programs read no input, so one that gets to
+   its end writes the same every time it runs.
+
+   Returns 0 when it got there, its output in CTX->out.  Returns 1 when
+   it ran out of steps or memory, wrote too much, stopped on an index
+   out of bounds or a division by zero, or did arithmetic on booleans,
+   which C does in unsigned int; such programs are left to run. */
+int peval_run (peval *ctx, ast_node *root, U32 steps);
+
+void peval_fold (peval *ctx);
+
+#endif /* not PEVAL_H */
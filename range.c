@@ -0,0 +1,722 @@
+#include <limits.h>
+
+#include "range.h"
+
+/* Unbounded ends of a range. */
+#define RANGE_MIN LONG_MIN
+#define RANGE_MAX LONG_MAX
+
+/* Values an integer expression can take, LO > HI when none. */
+typedef struct
+{
+  long lo;
+  long hi;
+} range;
+
+typedef struct
+{
+  arena ar;
+  ht vars; /* U32 slot of every integer variable by name. */
+  U32 nvars;
+  U8 mark; /* Update the index checks, set on the last pass only. */
+} range_ctx;
+
+/* Allocate a state, a range for every variable. */
+static range *_state_new (range_ctx *ctx);
+
+/* Allocate a copy of state ST. */
+static range *_state_copy (range_ctx *ctx, range *st);
+
+/* Join state B into A. */
+static void _state_join (range_ctx *ctx, range *a, range *b);
+
+/* Whether every range of state A lies within B. */
+static U8 _state_within (range_ctx *ctx, range *a, range *b);
+
+/* Range of expression EXP in state ST. */
+static range _eval (range_ctx *ctx, range *st, ast_node *exp);
+
+/* Narrow ST to the states where condition COND is TRUTH. */
+static void _refine (range_ctx *ctx, range *st, ast_node *cond, U8 truth);
+
+/* Run statements PTR forward from state ST. */
+static void _stmts (range_ctx *ctx, range *st, ast_node *ptr);
+
+/* Whether NODE calls a routine, which may change any variable. */
+static U8 _calls (ast_node *node);
+
+/* Whether any statement of list PTR calls a routine. */
+static U8 _calls_list (ast_node *ptr);
+
+// [ Ranges ] {{{
+static const range _top = { RANGE_MIN, RANGE_MAX };
+
+static range
+_make (__int128 lo, __int128 hi)
+{
+  range r = _top;
+
+  if (lo > RANGE_MIN && lo < RANGE_MAX)
+    r.lo = lo;
+  if (hi > RANGE_MIN && hi < RANGE_MAX)
+    r.hi = hi;
+  /* Past the ends the program overflows, assume nothing. */
+  if (lo >= RANGE_MAX || hi <= RANGE_MIN)
+    return _top;
+  return r;
+}
+
+/* Forget everything about the variables of ST. */
+static void
+_havoc (range_ctx *ctx, range *st)
+{
+  U32 i;
+
+  for (i = 0; i < ctx->nvars; ++i)
+    st[i] = _top;
+}
+
+static U8
+_empty (range r)
+{
+  return r.lo > r.hi;
+}
+
+static range
+_neg (range a)
+{
+  range r;
+
+  r.lo = a.hi == RANGE_MAX ? RANGE_MIN : -a.hi;
+  r.hi = a.lo == RANGE_MIN ? RANGE_MAX : -a.lo;
+  return r;
+}
+
+static range
+_add (range a, range b)
+{
+  range r;
+
+  r = _make ((__int128)a.lo + b.lo, (__int128)a.hi + b.hi);
+  if (a.lo == RANGE_MIN || b.lo == RANGE_MIN)
+    r.lo = RANGE_MIN;
+  if (a.hi == RANGE_MAX || b.hi == RANGE_MAX)
+    r.hi = RANGE_MAX;
+  return r;
+}
+
+static range
+_mul (range a, range b)
+{
+  __int128 p[4], lo, hi;
+  U8 i;
+
+  if (a.lo == RANGE_MIN || a.hi == RANGE_MAX || b.lo == RANGE_MIN
+      || b.hi == RANGE_MAX)
+    return _top;
+
+  p[0] = (__int128)a.lo * b.lo;
+  p[1] = (__int128)a.lo * b.hi;
+  p[2] = (__int128)a.hi * b.lo;
+  p[3] = (__int128)a.hi * b.hi;
+  lo = hi = p[0];
+  for (i = 1; i < 4; ++i)
+    {
+      if (p[i] < lo)
+        lo = p[i];
+      if (p[i] > hi)
+        hi = p[i];
+    }
+  return _make (lo, hi);
+}
+
+/* A divided by constant C > 0, rounding towards zero. */
+static range
+_div (range a, long c)
+{
+  range r = a;
+
+  if (a.lo != RANGE_MIN)
+    r.lo = a.lo / c;
+  if (a.hi != RANGE_MAX)
+    r.hi = a.hi / c;
+  return r;
+}
+
+/* A mod constant C > 0, taking the sign of A. */
+static range
+_mod (range a, long c)
+{
+  range r;
+
+  r.lo = a.lo >= 0 ? 0 : -(c - 1);
+  r.hi = a.hi <= 0 ? 0 : c - 1;
+  if (a.lo >= 0 && a.hi < c)
+    r.hi = a.hi;
+  return r;
+}
+
+static range
+_join (range a, range b)
+{
+  if (_empty (a))
+    return b;
+  if (_empty (b))
+    return a;
+  if (b.lo < a.lo)
+    a.lo = b.lo;
+  if (b.hi > a.hi)
+    a.hi = b.hi;
+  return a;
+}
+// }}}
+// [ States ] {{{
+static range *
+_state_new (range_ctx *ctx)
+{
+  return aralloc (&ctx->ar, (ctx->nvars + 1) * sizeof (range));
+}
+
+static range *
+_state_copy (range_ctx *ctx, range *st)
+{
+  range *copy = _state_new (ctx);
+
+  memcpy (copy, st, ctx->nvars * sizeof (range));
+  return copy;
+}
+
+static void
+_state_join (range_ctx *ctx, range *a, range *b)
+{
+  U32 i;
+
+  for (i = 0; i < ctx->nvars; ++i)
+    a[i] = _join (a[i], b[i]);
+}
+
+static U8
+_state_within (range_ctx *ctx, range *a, range *b)
+{
+  U32 i;
+
+  for (i = 0; i < ctx->nvars; ++i)
+    {
+      if (_empty (a[i]))
+        continue;
+      if (a[i].lo < b[i].lo || a[i].hi > b[i].hi)
+        return 0;
+    }
+  return 1;
+}
+
+/* Push the ends of HEAD that NEXT moved past to infinity. */
+static void
+_state_widen (range_ctx *ctx, range *head, range *next)
+{
+  U32 i;
+
+  for (i = 0; i < ctx->nvars; ++i)
+    {
+      if (_empty (head[i]))
+        {
+          head[i] = next[i];
+          continue;
+        }
+      if (_empty (next[i]))
+        continue;
+      if (next[i].lo < head[i].lo)
+        head[i].lo = RANGE_MIN;
+      if (next[i].hi > head[i].hi)
+        head[i].hi = RANGE_MAX;
+    }
+}
+
+/* Slot of variable NODE, NULL unless it is an integer. */
+static U32 *
+_slot (range_ctx *ctx, ast_node *node)
+{
+  ast_data_var_declare *var;
+
+  if (node->type != AST_VAR_DECLARE)
+    return NULL;
+  var = node->data;
+  if (var->datatype != AST_INTLIT || var->arsize > 0)
+    return NULL;
+  return stget (&ctx->vars, var->name->data);
+}
+// }}}
+// [ Expressions ] {{{
+U8
+_calls (ast_node *node)
+{
+  ast_data_funcall *fun_data;
+  ast_data_write_arg *wa;
+  ast_data_op *op_data;
+  ast_node *arg;
+
+  switch (node->type)
+    {
+    case AST_INDEX:
+      return _calls (((ast_data_index *)node->data)->index);
+    case AST_OP:
+      op_data = node->data;
+      return (op_data->left && _calls (op_data->left))
+             || _calls (op_data->right);
+    case AST_WRITE_ARG:
+      wa = node->data;
+      return _calls (wa->value) || _calls (wa->width)
+             || (wa->decimals && _calls (wa->decimals));
+    case AST_FUNCALL:
+      fun_data = node->data;
+      if (fun_data->routine)
+        return 1;
+      for (arg = fun_data->args_head; arg; arg = arg->next)
+        if (_calls (arg))
+          return 1;
+      return 0;
+    case AST_BLOCK:
+      return _calls_list (((ast_data_block *)node->data)->next);
+    case AST_VAR_ASSIGN:
+      return (((ast_data_var_assign *)node->data)->index
+              && _calls (((ast_data_var_assign *)node->data)->index))
+             || _calls (((ast_data_var_assign *)node->data)->value);
+    case AST_COND:
+      return _calls (((ast_data_cond *)node->data)->cond)
+             || _calls (((ast_data_cond *)node->data)->yes)
+             || (((ast_data_cond *)node->data)->no
+                 && _calls (((ast_data_cond *)node->data)->no));
+    case AST_WHILE:
+      return _calls (((ast_data_while *)node->data)->cond)
+             || _calls (((ast_data_while *)node->data)->next);
+    case AST_FOR:
+      return _calls (((ast_data_for *)node->data)->from)
+             || _calls (((ast_data_for *)node->data)->to)
+             || _calls (((ast_data_for *)node->data)->body);
+    default:
+      return 0;
+    }
+}
+
+U8
+_calls_list (ast_node *ptr)
+{
+  for (; ptr; ptr = ptr->next)
+    if (_calls (ptr))
+      return 1;
+  return 0;
+}
+
+/* Range of element INDEX, deciding whether it needs a check. */
+static void
+_index (range_ctx *ctx, range *st, ast_data_index *index)
+{
+  ast_data_var_declare *var = index->var->data;
+  range r = _eval (ctx, st, index->index);
+
+  if (!ctx->mark)
+    return;
+  if (_empty (r) || (r.lo >= 0 && r.hi < (long)var->arsize))
+    index->check = 0;
+}
+
+static range
+_eval (range_ctx *ctx, range *st, ast_node *exp)
+{
+  ast_data_funcall *fun_data;
+  ast_data_op *op_data;
+  ast_node *arg;
+  range a, b, r = _top;
+  U32 *slot;
+
+  /* The routine runs somewhere among the operands, those read before it
+     are as unknown as those read after. */
+  if (exp->type != AST_VAR_DECLARE && _calls (exp))
+    _havoc (ctx, st);
+
+  switch (exp->type)
+    {
+    case AST_INTLIT:
+      r.lo = r.hi = *(long *)exp->data;
+      break;
+    case AST_VAR_DECLARE:
+      slot = _slot (ctx, exp);
+      if (slot)
+        r = st[*slot];
+      break;
+    case AST_INDEX:
+      _index (ctx, st, exp->data);
+      break;
+    case AST_FUNCALL:
+      fun_data = exp->data;
+      for (arg = fun_data->args_head; arg; arg = arg->next)
+        _eval (ctx, st, arg);
+      if (fun_data->routine)
+        _havoc (ctx, st);
+      else if (streq (fun_data->name->data, "length"))
+        r.lo = 0;
+      break;
+    case AST_OP:
+      op_data = exp->data;
+      b = _eval (ctx, st, op_data->right);
+      if (!op_data->left)
+        {
+          if (op_data->op == '-')
+            r = _neg (b);
+          break;
+        }
+      a = _eval (ctx, st, op_data->left);
+      if (_empty (a) || _empty (b))
+        {
+          r.lo = 1;
+          r.hi = 0;
+          break;
+        }
+      switch (op_data->op)
+        {
+        case '+':
+          r = _add (a, b);
+          break;
+        case '-':
+          r = _add (a, _neg (b));
+          break;
+        case '*':
+        case AST_OP_SHL:
+          r = _mul (a, b);
+          break;
+        case '/':
+        case AST_OP_SHR:
+          if (b.lo == b.hi && b.lo > 0)
+            r = _div (a, b.lo);
+          break;
+        case '%':
+        case AST_OP_AND:
+          if (b.lo == b.hi && b.lo > 0)
+            r = _mod (a, b.lo);
+          break;
+        }
+      /* Past zero a divide or mod by a power of two is a shift or a
+         mask, see ast.h. */
+      if (ctx->mark && a.lo >= 0 && ast_log2 (op_data->right))
+        {
+          if (op_data->op == '/')
+            op_data->op = AST_OP_SHR;
+          else if (op_data->op == '%')
+            op_data->op = AST_OP_AND;
+        }
+      break;
+    default:
+      break;
+    }
+
+  return r;
+}
+
+/* Apply X OP Y to the range of X, Y being in R. */
+static void
+_narrow (range *x, U8 op, range r)
+{
+  switch (op)
+    {
+    case '<':
+      if (r.hi > RANGE_MIN && r.hi < RANGE_MAX && r.hi - 1 < x->hi)
+        x->hi = r.hi - 1;
+      break;
+    case (U8)TOKEN_LEQ:
+      if (r.hi < x->hi)
+        x->hi = r.hi;
+      break;
+    case '>':
+      if (r.lo > RANGE_MIN && r.lo < RANGE_MAX && r.lo + 1 > x->lo)
+        x->lo = r.lo + 1;
+      break;
+    case (U8)TOKEN_GEQ:
+      if (r.lo > x->lo)
+        x->lo = r.lo;
+      break;
+    case '=':
+      if (r.lo > x->lo)
+        x->lo = r.lo;
+      if (r.hi < x->hi)
+        x->hi = r.hi;
+      break;
+    }
+}
+
+/* OP with its operands swapped. */
+static U8
+_mirror (U8 op)
+{
+  switch (op)
+    {
+    case '<':
+      return '>';
+    case '>':
+      return '<';
+    case (U8)TOKEN_LEQ:
+      return (U8)TOKEN_GEQ;
+    case (U8)TOKEN_GEQ:
+      return (U8)TOKEN_LEQ;
+    default:
+      return op;
+    }
+}
+
+/* The negation of OP. */
+static U8
+_negate (U8 op)
+{
+  switch (op)
+    {
+    case '<':
+      return (U8)TOKEN_GEQ;
+    case '>':
+      return (U8)TOKEN_LEQ;
+    case (U8)TOKEN_LEQ:
+      return '>';
+    case (U8)TOKEN_GEQ:
+      return '<';
+    case '=':
+      return (U8)TOKEN_NEQ;
+    case (U8)TOKEN_NEQ:
+      return '=';
+    default:
+      return op;
+    }
+}
+
+static void
+_refine (range_ctx *ctx, range *st, ast_node *cond, U8 truth)
+{
+  ast_data_op *op_data;
+  range a, b;
+  U32 *sa, *sb;
+  U8 op;
+
+  if (cond->type != AST_OP)
+    return;
+  op_data = cond->data;
+  if (!op_data->left)
+    {
+      if (op_data->op == '!')
+        _refine (ctx, st, op_data->right, !truth);
+      return;
+    }
+
+  op = truth ? op_data->op : _negate (op_data->op);
+  sa = _slot (ctx, op_data->left);
+  sb = _slot (ctx, op_data->right);
+  if (!sa && !sb)
+    return;
+
+  a = _eval (ctx, st, op_data->left);
+  b = _eval (ctx, st, op_data->right);
+  if (sa)
+    _narrow (&st[*sa], op, b);
+  if (sb)
+    _narrow (&st[*sb], _mirror (op), a);
+}
+// }}}
+// [ Statements ] {{{
+/* Start a trip of a loop: COND holds, or the FOR control variable SLOT
+   is somewhere in IN. */
+static void
+_enter (range_ctx *ctx, range *st, ast_node *cond, U32 *slot, range in)
+{
+  if (cond)
+    {
+      _eval (ctx, st, cond);
+      _refine (ctx, st, cond, 1);
+    }
+  else
+    {
+      st[*slot] = in;
+    }
+}
+
+static void
+_loop (range_ctx *ctx, range *st, ast_node *cond, ast_node *next,
+       U32 *slot, range in)
+{
+  range *head, *body;
+  U8 mark = ctx->mark;
+  U32 round;
+
+  /* Find ranges that hold at the head on every trip, without marking
+     the checks from states that are not final yet. */
+  ctx->mark = 0;
+  head = _state_copy (ctx, st);
+  for (round = 0;; ++round)
+    {
+      body = _state_copy (ctx, head);
+      _enter (ctx, body, cond, slot, in);
+      _stmts (ctx, body, next);
+      _state_join (ctx, body, st);
+      if (_state_within (ctx, body, head))
+        break;
+      if (round < RANGE_WIDEN)
+        _state_join (ctx, head, body);
+      else
+        _state_widen (ctx, head, body);
+    }
+
+  /* The ranges after one more trip still hold and are tighter where
+     widening went too far. */
+  head = body;
+
+  ctx->mark = mark;
+  body = _state_copy (ctx, head);
+  _enter (ctx, body, cond, slot, in);
+  _stmts (ctx, body, next);
+
+  memcpy (st, head, ctx->nvars * sizeof (range));
+  if (cond && _calls (cond))
+    _havoc (ctx, st);
+  if (cond)
+    _refine (ctx, st, cond, 0);
+}
+
+static void
+_for (range_ctx *ctx, range *st, ast_data_for *data)
+{
+  range from, to, in, before;
+  U32 *slot = _slot (ctx, data->var);
+
+  /* Both bounds are read once, before the first trip. */
+  if (_calls (data->from) || _calls (data->to))
+    _havoc (ctx, st);
+  from = _eval (ctx, st, data->from);
+  to = _eval (ctx, st, data->to);
+  in.lo = data->down ? to.lo : from.lo;
+  in.hi = data->down ? from.hi : to.hi;
+  /* A routine may move a global control variable back past FROM. */
+  if (_calls (data->body))
+    {
+      in.lo = data->down ? to.lo : RANGE_MIN;
+      in.hi = data->down ? RANGE_MAX : to.hi;
+    }
+  before = st[*slot];
+  if (_empty (in))
+    return;
+  _loop (ctx, st, NULL, data->body, slot, in);
+
+  /* Unchanged when the body never ran, TO otherwise, or past TO when a
+     routine moved it. */
+  if (_calls (data->body))
+    {
+      to.lo = data->down ? RANGE_MIN : to.lo;
+      to.hi = data->down ? to.hi : RANGE_MAX;
+    }
+  st[*slot] = _join (before, to);
+}
+
+static void
+_stmts (range_ctx *ctx, range *st, ast_node *ptr)
+{
+  ast_data_var_assign *va_data;
+  ast_data_write_arg *wa;
+  ast_data_cond *cond_data;
+  ast_node *arg;
+  range *no;
+  range r;
+  U32 *slot;
+
+  for (; ptr; ptr = ptr->next)
+    {
+      switch (ptr->type)
+        {
+        case AST_BLOCK:
+          _stmts (ctx, st, ((ast_data_block *)ptr->data)->next);
+          break;
+        case AST_VAR_ASSIGN:
+          va_data = ptr->data;
+          if (va_data->index && _calls (ptr))
+            _havoc (ctx, st);
+          if (va_data->index)
+            _index (ctx, st, va_data->index->data);
+          r = _eval (ctx, st, va_data->value);
+          slot = _slot (ctx, va_data->var);
+          if (slot && !va_data->index)
+            st[*slot] = r;
+          break;
+        case AST_COND:
+          cond_data = ptr->data;
+          _eval (ctx, st, cond_data->cond);
+          no = _state_copy (ctx, st);
+          _refine (ctx, st, cond_data->cond, 1);
+          _refine (ctx, no, cond_data->cond, 0);
+          _stmts (ctx, st, cond_data->yes);
+          if (cond_data->no)
+            _stmts (ctx, no, cond_data->no);
+          _state_join (ctx, st, no);
+          break;
+        case AST_WHILE:
+          _loop (ctx, st, ((ast_data_while *)ptr->data)->cond,
+                 ((ast_data_while *)ptr->data)->next, NULL, _top);
+          break;
+        case AST_FOR:
+          _for (ctx, st, ptr->data);
+          break;
+        case AST_FUNCALL:
+          if (_calls (ptr))
+            _havoc (ctx, st);
+          for (arg = ((ast_data_funcall *)ptr->data)->args_head; arg;
+               arg = arg->next)
+            {
+              if (arg->type != AST_WRITE_ARG)
+                {
+                  _eval (ctx, st, arg);
+                  continue;
+                }
+              wa = arg->data;
+              _eval (ctx, st, wa->value);
+              _eval (ctx, st, wa->width);
+              if (wa->decimals)
+                _eval (ctx, st, wa->decimals);
+            }
+          if (((ast_data_funcall *)ptr->data)->routine)
+            _havoc (ctx, st);
+          break;
+        default:
+          break;
+        }
+    }
+}
+// }}}
+
+void
+range_check (ast_node *root)
+{
+  range_ctx ctx = { 0 };
+  ast_data_var_declare *var;
+  ast_node *ptr;
+  range *st;
+  U32 i;
+
+  htinit (&ctx.vars, &ctx.ar, 64, sizeof (U32));
+  for (ptr = root; ptr; ptr = ptr->next)
+    {
+      if (ptr->type != AST_VAR_DECLARE)
+        continue;
+      var = ptr->data;
+      if (var->datatype == AST_INTLIT && var->arsize == 0)
+        {
+          stput (&ctx.vars, var->name->data, &ctx.nvars);
+          ++ctx.nvars;
+        }
+    }
+
+  /* Every variable starts out as zero. */
+  st = _state_new (&ctx);
+  for (i = 0; i < ctx.nvars; ++i)
+    st[i].lo = st[i].hi = 0;
+
+  ctx.mark = 1;
+  for (ptr = root; ptr; ptr = ptr->next)
+    if (ptr->type == AST_MAIN_BLOCK)
+      _stmts (&ctx, st, ((ast_data_block *)ptr->data)->next);
+
+  arfold (&ctx.ar);
+}
+
+// vim:fdm=marker:
@@ -0,0 +1,18 @@
+#ifndef RANGE_H
+#define RANGE_H
+
+#include "ast.h"
+
+/* Work out the values every integer variable can hold at each point of
+   the program ROOT and clear the check flag of the array indexes that
+   are in bounds whatever the input.  Divides and mods of values that
+   cannot be negative by a power of two become shifts and masks.
+
+   Loops are iterated until the ranges stop growing; a range that keeps
+   growing is widened to infinity after RANGE_WIDEN rounds and narrowed
+   again once. */
+void range_check (ast_node *root);
+
+#define RANGE_WIDEN 3
+
+#endif /* not RANGE_H */
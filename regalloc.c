@@ -0,0 +1,614 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "regalloc.h"
+#include "utils.h"
+
+#define RA_NONE UINT32_MAX
+
+/* Registers an instruction touches at most, a call clobbers 25. */
+#define RA_MAX_OPNDS 32
+
+/* Busy range of a machine register, positions inclusive. */
+typedef struct
+{
+  U32 start, end;
+} ra_range;
+
+/* Live interval of a virtual register.  Instruction K reads its operands at
+   position 2K and writes them at 2K + 1. */
+typedef struct
+{
+  U32 reg;
+  U32 start, end; /* RA_NONE start when never used. */
+  U32 hint;       /* Register to try first, virtual or not, or RA_NONE. */
+  double cost;    /* Uses and definitions weighted by loop depth. */
+  U8 xmm;
+} ra_interval;
+
+typedef struct
+{
+  x86_func *xf;
+  U32 nv;    /* Virtual registers. */
+  U32 words; /* Per live set. */
+  U64 *gen, *kill, *live_in, *live_out;
+  U32 *first; /* Position of the first instruction of every block and one
+                 past the last one at index blocks.size. */
+  ra_interval *iv;
+  da fixed[X86_VREG]; /* ra_range */
+} ra_ctx;
+
+static const U32 _gpr_pool[] = {
+  X86_RAX, X86_RCX, X86_RDX, X86_RSI, X86_RDI, X86_R8,
+  X86_R9,  X86_RBX, X86_R12, X86_R13, X86_R14, X86_R15,
+};
+
+/* Caller-saved registers, all of them clobbered by a call. */
+static const U32 _clobbered[] = {
+  X86_RAX, X86_RCX, X86_RDX, X86_RSI, X86_RDI, X86_R8, X86_R9, X86_R10,
+  X86_R11,
+};
+
+#define RA_CALLEE_SAVED                                                       \
+  ((1u << X86_RBX) | (1u << X86_R12) | (1u << X86_R13) | (1u << X86_R14)     \
+   | (1u << X86_R15))
+
+/* Registers IN reads into USE and writes into DEF, including the implicit
+   ones. */
+static void _operands (x86_insn *in, U32 *use, U32 *nuse, U32 *def,
+                       U32 *ndef);
+
+/* Compute live sets of every block. */
+static void _liveness (ra_ctx *ctx);
+
+/* Merge the two sides of copies between virtual registers that are never
+   live at the same time, dropping the copies.  Each register is merged at
+   most once per call.  Returns whether anything was merged, which leaves
+   the live sets stale. */
+static U8 _coalesce (ra_ctx *ctx);
+
+/* Check if IN copies a virtual register into another of its kind. */
+static U8 _is_copy (ra_ctx *ctx, x86_insn *in);
+
+/* Build intervals, busy ranges of machine registers and copy hints. */
+static void _intervals (ra_ctx *ctx);
+
+/* Check if machine register R is busy anywhere in START..END. */
+static U8 _busy (ra_ctx *ctx, U32 r, U32 start, U32 end);
+
+/* Pick a free register for IV, RA_NONE if there is none.  TAKEN has a bit
+   per register held by an active interval. */
+static U32 _pick (ra_ctx *ctx, ra_interval *iv, U32 taken);
+
+static void _spill (ra_ctx *ctx, ra_interval *iv);
+static int _by_start (const void *a, const void *b);
+
+#define RA_TEST(set, i) (((set)[(i) / 64] >> ((i) % 64)) & 1)
+#define RA_SET(set, i) ((set)[(i) / 64] |= 1ull << ((i) % 64))
+#define RA_CLEAR(set, i) ((set)[(i) / 64] &= ~(1ull << ((i) % 64)))
+
+void
+regalloc (x86_func *xf)
+{
+  ra_ctx ctx = { 0 };
+  ra_interval **order, *active[X86_VREG], *iv, *victim;
+  x86_vreg *v;
+  U32 i, j, n = 0, nactive = 0, r, taken;
+
+  ctx.xf = xf;
+  ctx.nv = xf->vregs.size;
+  ctx.words = (ctx.nv + 63) / 64;
+  if (!ctx.nv)
+    return;
+
+  ctx.gen = aralloc (&xf->ar, 4 * ctx.words * xf->blocks.size * sizeof (U64));
+  memset (ctx.gen, 0, 4 * ctx.words * xf->blocks.size * sizeof (U64));
+  ctx.kill = ctx.gen + ctx.words * xf->blocks.size;
+  ctx.live_in = ctx.kill + ctx.words * xf->blocks.size;
+  ctx.live_out = ctx.live_in + ctx.words * xf->blocks.size;
+  ctx.first = aralloc (&xf->ar, (xf->blocks.size + 1) * sizeof (U32));
+  ctx.iv = aralloc (&xf->ar, ctx.nv * sizeof (ra_interval));
+  for (r = 0; r < X86_VREG; ++r)
+    dainit (&ctx.fixed[r], &xf->ar, sizeof (ra_range), 8);
+
+  for (i = 0; i < ctx.nv; ++i)
+    {
+      iv = &ctx.iv[i];
+      iv->reg = X86_VREG + i;
+      iv->start = RA_NONE;
+      iv->end = 0;
+      iv->hint = RA_NONE;
+      iv->cost = 0;
+      iv->xmm = x86_vreg_get (xf, iv->reg)->xmm;
+    }
+
+  _liveness (&ctx);
+  while (_coalesce (&ctx))
+    {
+      memset (ctx.gen, 0, 4 * ctx.words * xf->blocks.size * sizeof (U64));
+      _liveness (&ctx);
+    }
+  _intervals (&ctx);
+
+  order = aralloc (&xf->ar, ctx.nv * sizeof (ra_interval *));
+  for (i = 0; i < ctx.nv; ++i)
+    if (ctx.iv[i].start != RA_NONE)
+      order[n++] = &ctx.iv[i];
+  qsort (order, n, sizeof (ra_interval *), _by_start);
+
+  for (i = 0; i < n; ++i)
+    {
+      iv = order[i];
+
+      /* Expire intervals that ended, they are sorted by end. */
+      for (j = 0; j < nactive && active[j]->end < iv->start; ++j)
+        ;
+      memmove (active, active + j, (nactive - j) * sizeof (ra_interval *));
+      nactive -= j;
+
+      taken = 0;
+      for (j = 0; j < nactive; ++j)
+        taken |= 1u << x86_vreg_get (xf, active[j]->reg)->loc;
+
+      r = _pick (&ctx, iv, taken);
+      if (r == RA_NONE)
+        {
+          /* Evict the cheapest active interval whose register IV could
+             use, unless IV itself is cheaper. */
+          victim = NULL;
+          for (j = 0; j < nactive; ++j)
+            {
+              v = x86_vreg_get (xf, active[j]->reg);
+              if (active[j]->xmm == iv->xmm
+                  && !_busy (&ctx, v->loc, iv->start, iv->end)
+                  && (!victim || active[j]->cost < victim->cost))
+                victim = active[j];
+            }
+          if (!victim || victim->cost >= iv->cost)
+            {
+              _spill (&ctx, iv);
+              continue;
+            }
+
+          r = x86_vreg_get (xf, victim->reg)->loc;
+          _spill (&ctx, victim);
+          for (j = 0; active[j] != victim; ++j)
+            ;
+          memmove (active + j, active + j + 1,
+                   (nactive - j - 1) * sizeof (ra_interval *));
+          --nactive;
+        }
+
+      x86_vreg_get (xf, iv->reg)->loc = r;
+      if (RA_CALLEE_SAVED & (1u << r))
+        xf->saved |= 1u << r;
+
+      for (j = nactive; j > 0 && active[j - 1]->end > iv->end; --j)
+        active[j] = active[j - 1];
+      active[j] = iv;
+      ++nactive;
+    }
+
+  arfree (order);
+  for (r = 0; r < X86_VREG; ++r)
+    dafold (&ctx.fixed[r]);
+  arfree (ctx.iv);
+  arfree (ctx.first);
+  arfree (ctx.gen);
+}
+
+static void
+_operands (x86_insn *in, U32 *use, U32 *nuse, U32 *def, U32 *ndef)
+{
+  U8 flags = x86_op_flags (in->op);
+  U32 i;
+
+  *nuse = *ndef = 0;
+  if (in->dst.kind == X86_REG)
+    {
+      if (flags & X86_F_READ_DST)
+        use[(*nuse)++] = in->dst.reg;
+      if (flags & X86_F_WRITE_DST)
+        def[(*ndef)++] = in->dst.reg;
+    }
+  else if (in->dst.kind == X86_MEM)
+    use[(*nuse)++] = in->dst.reg;
+  if (in->src.kind == X86_REG || in->src.kind == X86_MEM)
+    use[(*nuse)++] = in->src.reg;
+
+  switch (in->op)
+    {
+    case X86_CQO:
+      use[(*nuse)++] = X86_RAX;
+      def[(*ndef)++] = X86_RDX;
+      break;
+    case X86_IDIV:
+      use[(*nuse)++] = X86_RAX;
+      use[(*nuse)++] = X86_RDX;
+      def[(*ndef)++] = X86_RAX;
+      def[(*ndef)++] = X86_RDX;
+      break;
+    case X86_CALL:
+      /* Argument registers, a mask set by instruction selection. */
+      for (i = 0; i < X86_VREG; ++i)
+        if (in->src.imm & (1L << i))
+          use[(*nuse)++] = i;
+      for (i = 0; i < sizeof (_clobbered) / sizeof (*_clobbered); ++i)
+        def[(*ndef)++] = _clobbered[i];
+      for (i = X86_XMM0; i <= X86_XMM15; ++i)
+        def[(*ndef)++] = i;
+      break;
+    case X86_RET:
+      use[(*nuse)++] = X86_RAX;
+      break;
+    }
+}
+
+static void
+_liveness (ra_ctx *ctx)
+{
+  x86_func *xf = ctx->xf;
+  x86_block *bb;
+  x86_insn *in;
+  U64 *gen, *kill, *in_set, *out, *succ_in, word;
+  U32 use[RA_MAX_OPNDS], def[RA_MAX_OPNDS], nuse, ndef;
+  U32 i, j, w, r;
+  U8 changed;
+
+  for (i = 0; i < xf->blocks.size; ++i)
+    {
+      bb = x86_block_get (xf, i);
+      gen = ctx->gen + i * ctx->words;
+      kill = ctx->kill + i * ctx->words;
+      for (in = bb->head; in; in = in->next)
+        {
+          _operands (in, use, &nuse, def, &ndef);
+          for (j = 0; j < nuse; ++j)
+            {
+              r = use[j] - X86_VREG;
+              if (use[j] >= X86_VREG && !RA_TEST (kill, r))
+                RA_SET (gen, r);
+            }
+          for (j = 0; j < ndef; ++j)
+            if (def[j] >= X86_VREG)
+              RA_SET (kill, def[j] - X86_VREG);
+        }
+    }
+
+  do
+    {
+      changed = 0;
+      for (i = xf->blocks.size; i > 0; --i)
+        {
+          bb = x86_block_get (xf, i - 1);
+          gen = ctx->gen + (i - 1) * ctx->words;
+          kill = ctx->kill + (i - 1) * ctx->words;
+          in_set = ctx->live_in + (i - 1) * ctx->words;
+          out = ctx->live_out + (i - 1) * ctx->words;
+          for (j = 0; j < bb->nsucc; ++j)
+            {
+              succ_in = ctx->live_in + bb->succ[j] * ctx->words;
+              for (w = 0; w < ctx->words; ++w)
+                out[w] |= succ_in[w];
+            }
+          for (w = 0; w < ctx->words; ++w)
+            {
+              word = gen[w] | (out[w] & ~kill[w]);
+              if (word != in_set[w])
+                {
+                  in_set[w] = word;
+                  changed = 1;
+                }
+            }
+        }
+    }
+  while (changed);
+}
+
+static U8
+_coalesce (ra_ctx *ctx)
+{
+  x86_func *xf = ctx->xf;
+  x86_block *bb;
+  x86_insn *in, *next;
+  U64 *live;
+  U32 use[RA_MAX_OPNDS], def[RA_MAX_OPNDS], nuse, ndef;
+  U32 *pairs, *first, *list, *into, npairs = 0, i, j, k, a, b;
+  U8 *bad, merged = 0;
+
+  /* Every copy between two virtual registers of the same kind, a pair A, B
+     at 2K, 2K + 1. */
+  for (i = 0; i < xf->blocks.size; ++i)
+    for (in = x86_block_get (xf, i)->head; in; in = in->next)
+      npairs += _is_copy (ctx, in);
+  if (!npairs)
+    return 0;
+  pairs = aralloc (&xf->ar, 2 * npairs * sizeof (U32));
+  first = aralloc (&xf->ar, (ctx->nv + 1) * sizeof (U32));
+  list = aralloc (&xf->ar, 2 * npairs * sizeof (U32));
+  into = aralloc (&xf->ar, ctx->nv * sizeof (U32));
+  bad = aralloc (&xf->ar, npairs);
+  live = aralloc (&xf->ar, ctx->words * sizeof (U64));
+  memset (first, 0, (ctx->nv + 1) * sizeof (U32));
+  memset (bad, 0, npairs);
+
+  k = 0;
+  for (i = 0; i < xf->blocks.size; ++i)
+    for (in = x86_block_get (xf, i)->head; in; in = in->next)
+      if (_is_copy (ctx, in))
+        {
+          pairs[2 * k] = in->dst.reg - X86_VREG;
+          pairs[2 * k + 1] = in->src.reg - X86_VREG;
+          ++first[pairs[2 * k] + 1];
+          ++first[pairs[2 * k + 1] + 1];
+          ++k;
+        }
+
+  /* Pairs of register R are LIST[FIRST[R]] up to LIST[FIRST[R + 1]]. */
+  for (i = 0; i < ctx->nv; ++i)
+    first[i + 1] += first[i];
+  for (i = 0; i < ctx->nv; ++i)
+    into[i] = first[i];
+  for (k = 0; k < 2 * npairs; ++k)
+    list[into[pairs[k]]++] = k / 2;
+
+  /* A pair interferes when one side is written while the other is live,
+     except by a copy between them. */
+  for (i = 0; i < xf->blocks.size; ++i)
+    {
+      bb = x86_block_get (xf, i);
+      memcpy (live, ctx->live_out + i * ctx->words,
+              ctx->words * sizeof (U64));
+      for (in = bb->tail; in; in = in->prev)
+        {
+          _operands (in, use, &nuse, def, &ndef);
+          for (j = 0; j < ndef; ++j)
+            {
+              if (def[j] < X86_VREG)
+                continue;
+              a = def[j] - X86_VREG;
+              for (k = first[a]; k < first[a + 1]; ++k)
+                {
+                  b = pairs[2 * list[k]] == a ? pairs[2 * list[k] + 1]
+                                              : pairs[2 * list[k]];
+                  if (RA_TEST (live, b)
+                      && !(_is_copy (ctx, in)
+                           && in->src.reg == b + X86_VREG))
+                    bad[list[k]] = 1;
+                }
+            }
+          for (j = 0; j < ndef; ++j)
+            if (def[j] >= X86_VREG)
+              RA_CLEAR (live, def[j] - X86_VREG);
+          for (j = 0; j < nuse; ++j)
+            if (use[j] >= X86_VREG)
+              RA_SET (live, use[j] - X86_VREG);
+        }
+    }
+
+  /* Merge the higher register of each pair into the lower one, a register
+     at most once as the others' interference changed. */
+  for (i = 0; i < ctx->nv; ++i)
+    into[i] = RA_NONE;
+  memset (first, 0, ctx->nv * sizeof (U32));
+  for (k = 0; k < npairs; ++k)
+    {
+      a = pairs[2 * k] < pairs[2 * k + 1] ? pairs[2 * k] : pairs[2 * k + 1];
+      b = pairs[2 * k] ^ pairs[2 * k + 1] ^ a;
+      if (bad[k] || a == b || first[a] || first[b])
+        continue;
+      first[a] = first[b] = 1;
+      into[b] = a;
+      merged = 1;
+    }
+
+  for (i = 0; merged && i < xf->blocks.size; ++i)
+    {
+      bb = x86_block_get (xf, i);
+      for (in = bb->head; in; in = next)
+        {
+          next = in->next;
+          if ((in->dst.kind == X86_REG || in->dst.kind == X86_MEM)
+              && in->dst.reg >= X86_VREG
+              && into[in->dst.reg - X86_VREG] != RA_NONE)
+            in->dst.reg = into[in->dst.reg - X86_VREG] + X86_VREG;
+          if ((in->src.kind == X86_REG || in->src.kind == X86_MEM)
+              && in->src.reg >= X86_VREG
+              && into[in->src.reg - X86_VREG] != RA_NONE)
+            in->src.reg = into[in->src.reg - X86_VREG] + X86_VREG;
+          if ((in->op != X86_MOV && in->op != X86_MOVSD)
+              || in->dst.kind != X86_REG || in->src.kind != X86_REG
+              || in->dst.reg != in->src.reg)
+            continue;
+
+          if (in->prev)
+            in->prev->next = in->next;
+          else
+            bb->head = in->next;
+          if (in->next)
+            in->next->prev = in->prev;
+          else
+            bb->tail = in->prev;
+        }
+    }
+
+  arfree (live);
+  arfree (bad);
+  arfree (into);
+  arfree (list);
+  arfree (first);
+  arfree (pairs);
+  return merged;
+}
+
+U8
+_is_copy (ra_ctx *ctx, x86_insn *in)
+{
+  return (in->op == X86_MOV || in->op == X86_MOVSD) && in->dst.kind == X86_REG
+         && in->src.kind == X86_REG && in->dst.reg >= X86_VREG
+         && in->src.reg >= X86_VREG && in->dst.reg != in->src.reg
+         && ctx->iv[in->dst.reg - X86_VREG].xmm
+                == ctx->iv[in->src.reg - X86_VREG].xmm;
+}
+
+static void
+_intervals (ra_ctx *ctx)
+{
+  static const double weight[] = { 1, 10, 100, 1e3, 1e4, 1e5, 1e6 };
+  x86_func *xf = ctx->xf;
+  x86_block *bb;
+  x86_insn *in;
+  ra_interval *iv;
+  ra_range range;
+  U32 use[RA_MAX_OPNDS], def[RA_MAX_OPNDS], nuse, ndef;
+  U32 live_end[X86_VREG];
+  U32 i, j, k, r, pos = 0, bstart, bend, depth;
+  U64 *in_set, *out;
+
+  for (i = 0; i < xf->blocks.size; ++i)
+    {
+      ctx->first[i] = pos;
+      for (in = x86_block_get (xf, i)->head; in; in = in->next)
+        pos += 2;
+    }
+  ctx->first[i] = pos;
+
+  for (i = 0; i < xf->blocks.size; ++i)
+    {
+      bb = x86_block_get (xf, i);
+      bstart = ctx->first[i];
+      bend = ctx->first[i + 1] ? ctx->first[i + 1] - 1 : 0;
+      depth = bb->loop_depth < 6 ? bb->loop_depth : 6;
+      in_set = ctx->live_in + i * ctx->words;
+      out = ctx->live_out + i * ctx->words;
+
+      for (k = 0; k < ctx->nv; ++k)
+        {
+          iv = &ctx->iv[k];
+          if (RA_TEST (in_set, k) && bstart < iv->start)
+            iv->start = bstart;
+          if (RA_TEST (out, k) && bend > iv->end)
+            iv->end = bend;
+        }
+
+      for (in = bb->head, pos = bstart; in; in = in->next, pos += 2)
+        {
+          _operands (in, use, &nuse, def, &ndef);
+          for (j = 0; j < nuse + ndef; ++j)
+            {
+              r = j < nuse ? use[j] : def[j - nuse];
+              if (r < X86_VREG)
+                continue;
+              iv = &ctx->iv[r - X86_VREG];
+              if (pos + (j >= nuse) < iv->start)
+                iv->start = pos + (j >= nuse);
+              if (pos + (j >= nuse) > iv->end)
+                iv->end = pos + (j >= nuse);
+              iv->cost += weight[depth];
+            }
+
+          /* Copies would vanish if both sides got the same register. */
+          if ((in->op == X86_MOV || in->op == X86_MOVSD)
+              && in->dst.kind == X86_REG && in->src.kind == X86_REG)
+            {
+              if (in->dst.reg >= X86_VREG
+                  && ctx->iv[in->dst.reg - X86_VREG].hint == RA_NONE)
+                ctx->iv[in->dst.reg - X86_VREG].hint = in->src.reg;
+              if (in->src.reg >= X86_VREG
+                  && ctx->iv[in->src.reg - X86_VREG].hint == RA_NONE)
+                ctx->iv[in->src.reg - X86_VREG].hint = in->dst.reg;
+            }
+        }
+
+      /* Machine registers never live across blocks, walk backwards from a
+         use to the definition feeding it. */
+      for (r = 0; r < X86_VREG; ++r)
+        live_end[r] = RA_NONE;
+      pos = ctx->first[i + 1];
+      for (in = bb->tail; in; in = in->prev)
+        {
+          pos -= 2;
+          _operands (in, use, &nuse, def, &ndef);
+          for (j = 0; j < ndef; ++j)
+            {
+              r = def[j];
+              if (r >= X86_VREG)
+                continue;
+              range.start = pos + 1;
+              range.end = live_end[r] != RA_NONE ? live_end[r] : pos + 1;
+              daappend (&ctx->fixed[r], &range);
+              live_end[r] = RA_NONE;
+            }
+          for (j = 0; j < nuse; ++j)
+            if (use[j] < X86_VREG && live_end[use[j]] == RA_NONE)
+              live_end[use[j]] = pos;
+        }
+      for (r = 0; r < X86_VREG; ++r)
+        if (live_end[r] != RA_NONE)
+          {
+            range.start = bstart;
+            range.end = live_end[r];
+            daappend (&ctx->fixed[r], &range);
+          }
+    }
+}
+
+static U8
+_busy (ra_ctx *ctx, U32 r, U32 start, U32 end)
+{
+  ra_range *range;
+  U32 i;
+
+  for (i = 0; i < ctx->fixed[r].size; ++i)
+    {
+      range = dageti (&ctx->fixed[r], i);
+      if (range->start <= end && start <= range->end)
+        return 1;
+    }
+  return 0;
+}
+
+static U32
+_pick (ra_ctx *ctx, ra_interval *iv, U32 taken)
+{
+  U32 i, r, n, hint = iv->hint;
+
+  if (hint != RA_NONE && hint >= X86_VREG)
+    hint = x86_vreg_get (ctx->xf, hint)->loc;
+  if (hint < X86_VREG && !X86_IS_XMM (hint) == !iv->xmm
+      && hint != X86_RSP && hint != X86_RBP && hint != X86_SCRATCH_DST
+      && hint != X86_SCRATCH_SRC && hint != X86_XSCRATCH_DST
+      && hint != X86_XSCRATCH_SRC && !(taken & (1u << hint))
+      && !_busy (ctx, hint, iv->start, iv->end))
+    return hint;
+
+  n = iv->xmm ? 14 : sizeof (_gpr_pool) / sizeof (*_gpr_pool);
+  for (i = 0; i < n; ++i)
+    {
+      r = iv->xmm ? X86_XMM0 + i : _gpr_pool[i];
+      if (!(taken & (1u << r)) && !_busy (ctx, r, iv->start, iv->end))
+        return r;
+    }
+  return RA_NONE;
+}
+
+static void
+_spill (ra_ctx *ctx, ra_interval *iv)
+{
+  x86_vreg *v = x86_vreg_get (ctx->xf, iv->reg);
+
+  v->loc = X86_VREG;
+  v->slot = ctx->xf->slots++;
+}
+
+static int
+_by_start (const void *a, const void *b)
+{
+  const ra_interval *x = *(ra_interval *const *)a;
+  const ra_interval *y = *(ra_interval *const *)b;
+
+  if (x->start != y->start)
+    return x->start < y->start ? -1 : 1;
+  return x->reg < y->reg ? -1 : x->reg > y->reg;
+}
@@ -0,0 +1,13 @@
+#ifndef REGALLOC_H
+#define REGALLOC_H
+
+#include "x86.h"
+
+/* Assign registers to the virtual registers of XF by linear scan over
+   their live intervals.  Intervals crossing a runtime call only get
+   callee-saved registers, copies are coalesced where the intervals allow
+   and what doesn't fit is spilled to its own stack slot, cheapest first
+   with uses inside loops weighing more. */
+void regalloc (x86_func *xf);
+
+#endif /* not REGALLOC_H */
@@ -0,0 +1,449 @@
+/* crt.c - Pascal runtime for executables mpas links by itself.
+
+   The entry points of libpascal.c plus _start, written against raw Linux
+   system calls so the object links without libc.  Output is collected in
+   one buffer that is written out when full and at exit.  Built
+   freestanding and embedded into mpas, see the Makefile and elf.c. */
+
+#include "format.c"
+#include "libpascal.h"
+
+#define CRT_BUF_SIZE 65536
+
+/* Strings and arrays are allocated from mappings of at least this
+   size. */
+#define CRT_HEAP_CHUNK (1 << 20)
+
+/* Freed strings are kept for reuse by size class, the last one a whole
+   heap mapping. */
+#define CRT_CLASSES 16
+#define CRT_CLASS_SIZE(k) (32ul << (k))
+
+static char _buf[CRT_BUF_SIZE];
+static unsigned _len;
+
+/* Rest of the current heap mapping. */
+static char *_heap;
+static unsigned long _heap_left;
+
+/* Freed strings of each size class, linked through their first word. */
+static void *_free[CRT_CLASSES];
+
+int main (void);
+__attribute__ ((noreturn)) void _P__exit (int status);
+
+__asm__ (".text\n"
+         ".globl _start\n"
+         "_start:\n"
+         "\txorl %ebp, %ebp\n"
+         "\tandq $-16, %rsp\n"
+         "\tcall main\n"
+         "\tmovl %eax, %edi\n"
+         "\tcall _P__exit\n");
+
+static long
+_syscall3 (long n, long a, long b, long c)
+{
+  long ret;
+
+  __asm__ volatile ("syscall"
+                    : "=a"(ret)
+                    : "a"(n), "D"(a), "S"(b), "d"(c)
+                    : "rcx", "r11", "memory");
+  return ret;
+}
+
+static long
+_syscall6 (long n, long a, long b, long c, long d, long e, long f)
+{
+  register long r10 __asm__ ("r10") = d;
+  register long r8 __asm__ ("r8") = e;
+  register long r9 __asm__ ("r9") = f;
+  long ret;
+
+  __asm__ volatile ("syscall"
+                    : "=a"(ret)
+                    : "a"(n), "D"(a), "S"(b), "d"(c), "r"(r10), "r"(r8),
+                      "r"(r9)
+                    : "rcx", "r11", "memory");
+  return ret;
+}
+
+static void
+_flush (void)
+{
+  unsigned done = 0;
+  long n;
+
+  while (done < _len)
+    {
+      n = _syscall3 (1, 1, (long)(_buf + done), _len - done);
+      if (n == -4) /* EINTR */
+        continue;
+      if (n <= 0)
+        break;
+      done += n;
+    }
+  _len = 0;
+}
+
+static void
+_put (const char *s, unsigned long n)
+{
+  unsigned long room, i;
+
+  while (n)
+    {
+      if (_len == CRT_BUF_SIZE)
+        _flush ();
+      room = CRT_BUF_SIZE - _len < n ? CRT_BUF_SIZE - _len : n;
+      for (i = 0; i < room; ++i)
+        _buf[_len + i] = s[i];
+      _len += room;
+      s += room;
+      n -= room;
+    }
+}
+
+/* Room for N more bytes. */
+static char *
+_reserve (unsigned n)
+{
+  if (_len + n > CRT_BUF_SIZE)
+    _flush ();
+  return _buf + _len;
+}
+
+/* N spaces, nothing when N is not positive. */
+static void
+_pad (long n)
+{
+  static const char spaces[64] = "                                "
+                                 "                                ";
+
+  for (; n > 64; n -= 64)
+    _put (spaces, 64);
+  if (n > 0)
+    _put (spaces, n);
+}
+
+/* The N bytes formatted at the end of the buffer by _reserve, right
+   aligned in WIDTH columns. */
+static void
+_commit (unsigned n, long width)
+{
+  char num[_P__REAL_SIZE];
+  unsigned i;
+
+  if (width <= (long)n)
+    {
+      _len += n;
+      return;
+    }
+  for (i = 0; i < n; ++i)
+    num[i] = _buf[_len + i];
+  _pad (width - n);
+  _put (num, n);
+}
+
+void
+_P__exit (int status)
+{
+  _flush ();
+  _syscall3 (231, status, 0, 0); /* exit_group */
+  for (;;)
+    ;
+}
+
+void
+_P__p_write_int_w (long x, long width)
+{
+  _commit (_p_fmt_int (_reserve (_P__INT_SIZE), x), width);
+}
+
+void
+_P__p_write_int (long x)
+{
+  _len += _p_fmt_int (_reserve (_P__INT_SIZE), x);
+}
+
+void
+_P__p_write_real_w (double x, long width)
+{
+  _commit (_p_fmt_real (_reserve (_P__REAL_SIZE), x), width);
+}
+
+void
+_P__p_write_real (double x)
+{
+  _len += _p_fmt_real (_reserve (_P__REAL_SIZE), x);
+}
+
+void
+_P__p_write_fixed (double x, long width, long decimals)
+{
+  static char num[_P__FIXED_SIZE];
+  long zeros = 0;
+  unsigned n;
+
+  if (decimals < 0)
+    decimals = 0;
+  if (decimals > _P__MAX_DECIMALS)
+    {
+      zeros = decimals - _P__MAX_DECIMALS;
+      decimals = _P__MAX_DECIMALS;
+    }
+  n = _p_fmt_fixed (num, x, decimals);
+  if (x - x != 0) /* inf or nan */
+    zeros = 0;
+  _pad (width - n - zeros);
+  _put (num, n);
+  for (; zeros > 0; --zeros)
+    _put ("0", 1);
+}
+
+void
+_P__p_write_str_w (const char *s, long width)
+{
+  _pad (width - (long)_P__P_HDR (s)->len);
+  _put (s, _P__P_HDR (s)->len);
+}
+
+void
+_P__p_write_str (const char *s)
+{
+  _P__p_write_str_w (s, 0);
+}
+
+void
+_P__p_write_char (char c)
+{
+  _put (&c, 1);
+}
+
+// [ Strings ] {{{
+/* A mapping of SIZE bytes, a multiple of the page size. */
+static char *
+_map (unsigned long size)
+{
+  static const char msg[] = "Error: Out of memory.\n";
+  long p;
+
+  /* mmap (0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS) */
+  p = _syscall6 (9, 0, size, 3, 0x22, -1, 0);
+  if (p < 0 && p > -4096)
+    {
+      _flush ();
+      _syscall3 (1, 2, (long)msg, sizeof (msg) - 1);
+      _P__exit (1);
+    }
+  return (char *)p;
+}
+
+/* N bytes that are never freed, N a multiple of 8. */
+static char *
+_alloc (unsigned long n)
+{
+  unsigned long size;
+
+  if (n > _heap_left)
+    {
+      size = n > CRT_HEAP_CHUNK ? (n + 4095) & ~4095ul : CRT_HEAP_CHUNK;
+      _heap = _map (size);
+      _heap_left = size;
+    }
+  _heap += n;
+  _heap_left -= n;
+  return _heap - n;
+}
+
+/* A string of LEN bytes in a buffer of at least NEED, NEED > LEN.  The
+   buffer and its header take up a whole size class, or whole pages past
+   the largest one. */
+static char *
+_str_new (unsigned long len, unsigned long need)
+{
+  _P__p_hdr *h;
+  unsigned long size, k;
+
+  need += sizeof (_P__p_hdr);
+  for (k = 0; k < CRT_CLASSES && CRT_CLASS_SIZE (k) < need; ++k)
+    ;
+  if (k == CRT_CLASSES)
+    {
+      size = (need + 4095) & ~4095ul;
+      h = (_P__p_hdr *)_map (size);
+    }
+  else if (_free[k])
+    {
+      size = CRT_CLASS_SIZE (k);
+      h = _free[k];
+      _free[k] = *(void **)h;
+    }
+  else
+    {
+      size = CRT_CLASS_SIZE (k);
+      h = (_P__p_hdr *)_alloc (size);
+    }
+  h->len = len;
+  h->cap = size - sizeof (_P__p_hdr);
+  ((char *)(h + 1))[len] = '\0';
+  return (char *)(h + 1);
+}
+
+static void
+_copy (char *to, const char *from, unsigned long n)
+{
+  unsigned long i;
+
+  for (i = 0; i < n; ++i)
+    to[i] = from[i];
+}
+
+long
+_P__p_length (const char *s)
+{
+  return _P__P_HDR (s)->len;
+}
+
+const char *
+_P__p_concat (const char *a, const char *b)
+{
+  unsigned long na = _P__P_HDR (a)->len, nb = _P__P_HDR (b)->len;
+  char *r = _str_new (na + nb, na + nb + 1);
+
+  _copy (r, a, na);
+  _copy (r + na, b, nb);
+  return r;
+}
+
+const char *
+_P__p_drop (const char *s, long n)
+{
+  unsigned long len = _P__P_HDR (s)->len;
+  char *r;
+
+  if (n <= 0)
+    n = 0;
+  else if ((unsigned long)n > len)
+    n = len;
+  r = _str_new (len - n, len - n + 1);
+  _copy (r, s + n, len - n);
+  return r;
+}
+
+const char *
+_P__p_take (const char *s, long n)
+{
+  unsigned long len = _P__P_HDR (s)->len;
+  char *r;
+
+  if (n <= 0)
+    n = 0;
+  else if ((unsigned long)n > len)
+    n = len;
+  r = _str_new (n, n + 1);
+  _copy (r, s, n);
+  return r;
+}
+
+long
+_P__p_compare (const char *a, const char *b)
+{
+  const unsigned char *x = (const unsigned char *)a;
+  const unsigned char *y = (const unsigned char *)b;
+  unsigned long na = _P__P_HDR (a)->len, nb = _P__P_HDR (b)->len, i;
+
+  for (i = 0; i < na && i < nb; ++i)
+    if (x[i] != y[i])
+      return x[i] < y[i] ? -1 : 1;
+  return (na > nb) - (na < nb);
+}
+
+const char *
+_P__p_dup (const char *s)
+{
+  unsigned long len = _P__P_HDR (s)->len;
+  char *r;
+
+  if (_P__P_HDR (s)->cap == 0)
+    return s;
+  r = _str_new (len, len + 1);
+  _copy (r, s, len);
+  return r;
+}
+
+void
+_P__p_free (const char *s)
+{
+  _P__p_hdr *h = _P__P_HDR (s);
+  unsigned long size = h->cap + sizeof (_P__p_hdr), k;
+
+  if (h->cap == 0)
+    return;
+  if (size > CRT_CLASS_SIZE (CRT_CLASSES - 1))
+    {
+      _syscall3 (11, (long)h, size, 0); /* munmap */
+      return;
+    }
+  for (k = 0; CRT_CLASS_SIZE (k) < size; ++k)
+    ;
+  *(void **)h = _free[k];
+  _free[k] = h;
+}
+
+const char *
+_P__p_append (const char *s, const char *t)
+{
+  _P__p_hdr *h = _P__P_HDR (s);
+  unsigned long n = _P__P_HDR (t)->len, len = h->len + n;
+  char *r;
+
+  if (h->cap > len)
+    {
+      r = (char *)s;
+      _copy (r + h->len, t, n);
+      r[len] = '\0';
+      h->len = len;
+      return r;
+    }
+
+  /* Past the size classes the capacity has to double by itself. */
+  r = _str_new (len, h->cap * 2 > len + 1 ? h->cap * 2 : len + 1);
+  _copy (r, s, h->len);
+  _copy (r + h->len, t, n);
+  _P__p_free (s);
+  return r;
+}
+// }}}
+// [ Arrays ] {{{
+void *
+_P__p_array (long n)
+{
+  /* Fresh mappings are zeroed and nothing is ever freed. */
+  return _alloc (n > 0 ? n * 8 : 8);
+}
+
+void
+_P__p_bounds (long i, long n)
+{
+  static const char what[] = "Error: Index ", range[] = " out of bounds 0..";
+  char msg[2 * _P__INT_SIZE + 40];
+  unsigned len = 0, k;
+
+  for (k = 0; k < sizeof (what) - 1; ++k)
+    msg[len++] = what[k];
+  len += _p_fmt_int (msg + len, i);
+  for (k = 0; k < sizeof (range) - 1; ++k)
+    msg[len++] = range[k];
+  len += _p_fmt_int (msg + len, n - 1);
+  msg[len++] = '.';
+  msg[len++] = '\n';
+
+  _flush ();
+  _syscall3 (1, 2, (long)msg, len);
+  _P__exit (1);
+}
+// }}}
+
+// vim:fdm=marker:
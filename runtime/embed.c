@@ -0,0 +1,37 @@
+/* Turn stdin into a C array so it can be linked into mpas.
+
+   Usage: embed NAME < input > output.c
+
+   Defines "const char NAME[]" (NUL terminated) and
+   "const unsigned int NAME_len" (length without the NUL). */
+
+#include <stdio.h>
+
+int
+main (int argc, char **argv)
+{
+  unsigned long len = 0;
+  int ch;
+
+  if (argc != 2)
+    {
+      fprintf (stderr, "Usage: %s NAME < input > output.c\n", argv[0]);
+      return 1;
+    }
+
+  printf ("/* Generated by runtime/embed, do not edit. */\n\n");
+  printf ("const char %s[] = {", argv[1]);
+
+  while ((ch = getchar ()) != EOF)
+    {
+      if (len % 12 == 0)
+        printf ("\n ");
+      printf (" 0x%02x,", (unsigned char)ch);
+      ++len;
+    }
+
+  printf ("\n  0x00\n};\n\n");
+  printf ("const unsigned int %s_len = %lu;\n", argv[1], len);
+
+  return 0;
+}
@@ -0,0 +1,877 @@
+/* ----- format.c begin ----- */
+
+/* format.c - Number formatting for the Pascal runtimes.
+
+   Included by libpascal.c and crt.c, and pasted in front of libpascal.c
+   when the runtime source goes into a program, so it uses no library and
+   everything in it is static.
+
+   Reals are written as the shortest decimal that reads back as the same
+   double, laid out like printf's %g.  The digits come from Grisu3, and
+   from an exact big number search for the few values it can't decide.
+   Fixed output with a number of decimals is rounded half to even on the
+   exact value, like printf's %.*f, with 128-bit integers when the result
+   fits in 64 bits and big numbers otherwise. */
+
+#ifndef _P__FORMAT_C
+#define _P__FORMAT_C
+
+/* Enough for the exact value of any double scaled by a power of ten. */
+#define _P__BIG_WORDS 40
+
+/* Room for the output of _p_fmt_int and _p_fmt_real. */
+#define _P__INT_SIZE 20
+#define _P__REAL_SIZE 32
+
+/* Decimals past this many are always zero, _p_fmt_fixed takes no more. */
+#define _P__MAX_DECIMALS 1074
+
+/* Room for the output of _p_fmt_fixed. */
+#define _P__FIXED_SIZE (2 + 309 + 1 + _P__MAX_DECIMALS)
+
+/* Reals switch to an exponent from this many integer digits on. */
+#define _P__REAL_DIGITS 17
+
+typedef struct
+{
+  unsigned n;
+  unsigned w[_P__BIG_WORDS];
+} _p_big;
+
+/* F * 2^E. */
+typedef struct
+{
+  unsigned long long f;
+  int e;
+} _p_diyfp;
+
+/* Two digits for every value below 100. */
+static const char _p_digits2[201] = "00010203040506070809"
+                                    "10111213141516171819"
+                                    "20212223242526272829"
+                                    "30313233343536373839"
+                                    "40414243444546474849"
+                                    "50515253545556575859"
+                                    "60616263646566676869"
+                                    "70717273747576777879"
+                                    "80818283848586878889"
+                                    "90919293949596979899";
+
+static const unsigned long long _p_pow10[20] = {
+  1ull,
+  10ull,
+  100ull,
+  1000ull,
+  10000ull,
+  100000ull,
+  1000000ull,
+  10000000ull,
+  100000000ull,
+  1000000000ull,
+  10000000000ull,
+  100000000000ull,
+  1000000000000ull,
+  10000000000000ull,
+  100000000000000ull,
+  1000000000000000ull,
+  10000000000000000ull,
+  100000000000000000ull,
+  1000000000000000000ull,
+  10000000000000000000ull,
+};
+
+/* 10^K rounded to 64 significant bits as F * 2^E, for every eighth K
+   from -348 on. */
+static const struct
+{
+  unsigned long long f;
+  short e, k;
+} _p_cached_pow10[87] = {
+  { 0xfa8fd5a0081c0288ull, -1220, -348 },
+  { 0xbaaee17fa23ebf76ull, -1193, -340 },
+  { 0x8b16fb203055ac76ull, -1166, -332 },
+  { 0xcf42894a5dce35eaull, -1140, -324 },
+  { 0x9a6bb0aa55653b2dull, -1113, -316 },
+  { 0xe61acf033d1a45dfull, -1087, -308 },
+  { 0xab70fe17c79ac6caull, -1060, -300 },
+  { 0xff77b1fcbebcdc4full, -1034, -292 },
+  { 0xbe5691ef416bd60cull, -1007, -284 },
+  { 0x8dd01fad907ffc3cull, -980, -276 },
+  { 0xd3515c2831559a83ull, -954, -268 },
+  { 0x9d71ac8fada6c9b5ull, -927, -260 },
+  { 0xea9c227723ee8bcbull, -901, -252 },
+  { 0xaecc49914078536dull, -874, -244 },
+  { 0x823c12795db6ce57ull, -847, -236 },
+  { 0xc21094364dfb5637ull, -821, -228 },
+  { 0x9096ea6f3848984full, -794, -220 },
+  { 0xd77485cb25823ac7ull, -768, -212 },
+  { 0xa086cfcd97bf97f4ull, -741, -204 },
+  { 0xef340a98172aace5ull, -715, -196 },
+  { 0xb23867fb2a35b28eull, -688, -188 },
+  { 0x84c8d4dfd2c63f3bull, -661, -180 },
+  { 0xc5dd44271ad3cdbaull, -635, -172 },
+  { 0x936b9fcebb25c996ull, -608, -164 },
+  { 0xdbac6c247d62a584ull, -582, -156 },
+  { 0xa3ab66580d5fdaf6ull, -555, -148 },
+  { 0xf3e2f893dec3f126ull, -529, -140 },
+  { 0xb5b5ada8aaff80b8ull, -502, -132 },
+  { 0x87625f056c7c4a8bull, -475, -124 },
+  { 0xc9bcff6034c13053ull, -449, -116 },
+  { 0x964e858c91ba2655ull, -422, -108 },
+  { 0xdff9772470297ebdull, -396, -100 },
+  { 0xa6dfbd9fb8e5b88full, -369, -92 },
+  { 0xf8a95fcf88747d94ull, -343, -84 },
+  { 0xb94470938fa89bcfull, -316, -76 },
+  { 0x8a08f0f8bf0f156bull, -289, -68 },
+  { 0xcdb02555653131b6ull, -263, -60 },
+  { 0x993fe2c6d07b7facull, -236, -52 },
+  { 0xe45c10c42a2b3b06ull, -210, -44 },
+  { 0xaa242499697392d3ull, -183, -36 },
+  { 0xfd87b5f28300ca0eull, -157, -28 },
+  { 0xbce5086492111aebull, -130, -20 },
+  { 0x8cbccc096f5088ccull, -103, -12 },
+  { 0xd1b71758e219652cull, -77, -4 },
+  { 0x9c40000000000000ull, -50, 4 },
+  { 0xe8d4a51000000000ull, -24, 12 },
+  { 0xad78ebc5ac620000ull, 3, 20 },
+  { 0x813f3978f8940984ull, 30, 28 },
+  { 0xc097ce7bc90715b3ull, 56, 36 },
+  { 0x8f7e32ce7bea5c70ull, 83, 44 },
+  { 0xd5d238a4abe98068ull, 109, 52 },
+  { 0x9f4f2726179a2245ull, 136, 60 },
+  { 0xed63a231d4c4fb27ull, 162, 68 },
+  { 0xb0de65388cc8ada8ull, 189, 76 },
+  { 0x83c7088e1aab65dbull, 216, 84 },
+  { 0xc45d1df942711d9aull, 242, 92 },
+  { 0x924d692ca61be758ull, 269, 100 },
+  { 0xda01ee641a708deaull, 295, 108 },
+  { 0xa26da3999aef774aull, 322, 116 },
+  { 0xf209787bb47d6b85ull, 348, 124 },
+  { 0xb454e4a179dd1877ull, 375, 132 },
+  { 0x865b86925b9bc5c2ull, 402, 140 },
+  { 0xc83553c5c8965d3dull, 428, 148 },
+  { 0x952ab45cfa97a0b3ull, 455, 156 },
+  { 0xde469fbd99a05fe3ull, 481, 164 },
+  { 0xa59bc234db398c25ull, 508, 172 },
+  { 0xf6c69a72a3989f5cull, 534, 180 },
+  { 0xb7dcbf5354e9beceull, 561, 188 },
+  { 0x88fcf317f22241e2ull, 588, 196 },
+  { 0xcc20ce9bd35c78a5ull, 614, 204 },
+  { 0x98165af37b2153dfull, 641, 212 },
+  { 0xe2a0b5dc971f303aull, 667, 220 },
+  { 0xa8d9d1535ce3b396ull, 694, 228 },
+  { 0xfb9b7cd9a4a7443cull, 720, 236 },
+  { 0xbb764c4ca7a44410ull, 747, 244 },
+  { 0x8bab8eefb6409c1aull, 774, 252 },
+  { 0xd01fef10a657842cull, 800, 260 },
+  { 0x9b10a4e5e9913129ull, 827, 268 },
+  { 0xe7109bfba19c0c9dull, 853, 276 },
+  { 0xac2820d9623bf429ull, 880, 284 },
+  { 0x80444b5e7aa7cf85ull, 907, 292 },
+  { 0xbf21e44003acdd2dull, 933, 300 },
+  { 0x8e679c2f5e44ff8full, 960, 308 },
+  { 0xd433179d9c8cb841ull, 986, 316 },
+  { 0x9e19db92b4e31ba9ull, 1013, 324 },
+  { 0xeb96bf6ebadf77d9ull, 1039, 332 },
+  { 0xaf87023b9bf0ee6bull, 1066, 340 },
+};
+
+// [ Integers ] {{{
+/* Number of decimal digits of U. */
+static unsigned
+_p_ndigits (unsigned long long u)
+{
+  /* log10 (2) ~ 1233 / 4096 gives the count or one too many. */
+  unsigned t = (64 - __builtin_clzll (u | 1)) * 1233 >> 12;
+
+  return t + 1 - ((u | 1) < _p_pow10[t]);
+}
+
+/* Write the digits of U so that the last one is right before END. */
+static void
+_p_utoa (char *end, unsigned long long u)
+{
+  while (u >= 100)
+    {
+      end -= 2;
+      end[0] = _p_digits2[u % 100 * 2];
+      end[1] = _p_digits2[u % 100 * 2 + 1];
+      u /= 100;
+    }
+  if (u >= 10)
+    {
+      end[-2] = _p_digits2[u * 2];
+      end[-1] = _p_digits2[u * 2 + 1];
+    }
+  else
+    end[-1] = '0' + u;
+}
+
+/* Write X to OUT, returns the length. */
+static unsigned
+_p_fmt_int (char *out, long x)
+{
+  unsigned long long u = x < 0 ? -(unsigned long long)x
+                               : (unsigned long long)x;
+  unsigned n = _p_ndigits (u) + (x < 0);
+
+  _p_utoa (out + n, u);
+  if (x < 0)
+    out[0] = '-';
+  return n;
+}
+// }}}
+
+// [ Big numbers ] {{{
+static void
+_p_big_set (_p_big *b, unsigned long long v)
+{
+  b->n = 0;
+  while (v)
+    {
+      b->w[b->n++] = (unsigned)v;
+      v >>= 32;
+    }
+}
+
+static void
+_p_big_copy (_p_big *dst, const _p_big *src)
+{
+  unsigned i;
+
+  dst->n = src->n;
+  for (i = 0; i < src->n; ++i)
+    dst->w[i] = src->w[i];
+}
+
+static void
+_p_big_mul (_p_big *b, unsigned m)
+{
+  unsigned long long carry = 0;
+  unsigned i;
+
+  for (i = 0; i < b->n; ++i)
+    {
+      carry += (unsigned long long)b->w[i] * m;
+      b->w[i] = (unsigned)carry;
+      carry >>= 32;
+    }
+  if (carry)
+    b->w[b->n++] = (unsigned)carry;
+}
+
+static void
+_p_big_shl (_p_big *b, unsigned bits)
+{
+  unsigned words = bits / 32, i;
+
+  bits %= 32;
+  if (bits)
+    {
+      b->w[b->n] = 0;
+      for (i = b->n; i > 0; --i)
+        b->w[i] = (b->w[i] << bits) | (b->w[i - 1] >> (32 - bits));
+      b->w[0] <<= bits;
+      if (b->w[b->n])
+        ++b->n;
+    }
+  if (words && b->n)
+    {
+      for (i = b->n; i > 0; --i)
+        b->w[i - 1 + words] = b->w[i - 1];
+      for (i = 0; i < words; ++i)
+        b->w[i] = 0;
+      b->n += words;
+    }
+}
+
+static void
+_p_big_pow10 (_p_big *b, unsigned e)
+{
+  for (; e >= 9; e -= 9)
+    _p_big_mul (b, 1000000000);
+  while (e--)
+    _p_big_mul (b, 10);
+}
+
+static int
+_p_big_cmp (const _p_big *a, const _p_big *b)
+{
+  unsigned i;
+
+  if (a->n != b->n)
+    return a->n < b->n ? -1 : 1;
+  for (i = a->n; i > 0; --i)
+    if (a->w[i - 1] != b->w[i - 1])
+      return a->w[i - 1] < b->w[i - 1] ? -1 : 1;
+  return 0;
+}
+
+/* A += B. */
+static void
+_p_big_add (_p_big *a, const _p_big *b)
+{
+  unsigned long long carry = 0;
+  unsigned i;
+
+  for (i = 0; i < a->n || i < b->n; ++i)
+    {
+      carry += (unsigned long long)(i < a->n ? a->w[i] : 0)
+               + (i < b->n ? b->w[i] : 0);
+      a->w[i] = (unsigned)carry;
+      carry >>= 32;
+    }
+  a->n = i;
+  if (carry)
+    a->w[a->n++] = (unsigned)carry;
+}
+
+/* A -= B, B must not be larger. */
+static void
+_p_big_sub (_p_big *a, const _p_big *b)
+{
+  unsigned long long borrow = 0, d;
+  unsigned i;
+
+  for (i = 0; i < a->n; ++i)
+    {
+      d = (unsigned long long)a->w[i] - (i < b->n ? b->w[i] : 0) - borrow;
+      a->w[i] = (unsigned)d;
+      borrow = (d >> 32) & 1;
+    }
+  while (a->n && !a->w[a->n - 1])
+    --a->n;
+}
+
+/* Compare A + B with C. */
+static int
+_p_big_cmp_sum (const _p_big *a, const _p_big *b, const _p_big *c)
+{
+  _p_big sum;
+
+  _p_big_copy (&sum, a);
+  _p_big_add (&sum, b);
+  return _p_big_cmp (&sum, c);
+}
+
+/* Subtract D from NUM as often as it goes, at most 9 times. */
+static int
+_p_big_digit (_p_big *num, const _p_big *d)
+{
+  int digit = 0;
+
+  while (_p_big_cmp (num, d) >= 0)
+    {
+      _p_big_sub (num, d);
+      ++digit;
+    }
+  return digit;
+}
+// }}}
+
+// [ Exact digits ] {{{
+/* Digits of the positive finite value MANT * 2^EXP correctly rounded half
+   to even: the first N significant ones, or with FIXED set all of them
+   down to the N-th after the decimal point.  Sets *LEN to the number of
+   digits written to OUT, which is 0 when everything was rounded away,
+   and returns the decimal exponent of the first one. */
+static int
+_p_exact_digits (unsigned long long mant, int exp, char *out, int n,
+                 int fixed, int *len)
+{
+  _p_big num, den, next;
+  int e, i, bits = 64 - __builtin_clzll (mant), cmp;
+
+  _p_big_set (&num, mant);
+  _p_big_set (&den, 1);
+  if (exp > 0)
+    _p_big_shl (&num, exp);
+  else
+    _p_big_shl (&den, -exp);
+
+  /* log10(2) ~ 78913 / 2^18, may be one too small. */
+  e = ((exp + bits - 1) * 78913) >> 18;
+  if (e > 0)
+    _p_big_pow10 (&den, e);
+  else
+    _p_big_pow10 (&num, -e);
+  for (;;)
+    {
+      _p_big_copy (&next, &den);
+      _p_big_mul (&next, 10);
+      if (_p_big_cmp (&num, &next) < 0)
+        break;
+      _p_big_copy (&den, &next);
+      ++e;
+    }
+  while (_p_big_cmp (&num, &den) < 0)
+    {
+      _p_big_mul (&num, 10);
+      --e;
+    }
+
+  if (fixed)
+    n += e + 1;
+  *len = n > 0 ? n : 0;
+  if (n < 0)
+    return e;
+  if (n == 0)
+    {
+      /* Below one unit of the last place, round to it or to zero. */
+      _p_big_shl (&num, 1);
+      _p_big_mul (&den, 10);
+      if (_p_big_cmp (&num, &den) <= 0)
+        return e;
+      out[0] = '1';
+      *len = 1;
+      return e + 1;
+    }
+
+  for (i = 0; i < n; ++i)
+    {
+      out[i] = '0' + _p_big_digit (&num, &den);
+      if (i + 1 < n)
+        _p_big_mul (&num, 10);
+    }
+
+  _p_big_shl (&num, 1);
+  cmp = _p_big_cmp (&num, &den);
+  if (cmp > 0 || (cmp == 0 && (out[n - 1] - '0') % 2))
+    {
+      for (i = n - 1; i >= 0 && out[i] == '9'; --i)
+        out[i] = '0';
+      if (i >= 0)
+        ++out[i];
+      else
+        {
+          out[0] = '1';
+          ++e;
+        }
+    }
+  return e;
+}
+
+/* Shortest digits that read back as MANT * 2^EXP, the closest to it when
+   there are several, by Steele and White's free-format algorithm.  MANT
+   is the full 53-bit significand of a double, or less for subnormals.
+   Sets *LEN to the number of digits and returns the decimal exponent of
+   the first one. */
+static int
+_p_exact_shortest (unsigned long long mant, int exp, char *out, int *len)
+{
+  _p_big r, s, mp, mm, t;
+  int k, n = 0, digit, low, high, cmp, i;
+  int bits = 64 - __builtin_clzll (mant), even = !(mant & 1);
+  int closer = mant == 1ull << 52 && exp > -1074;
+
+  /* V = R / S, the neighbours are M+ / S and M- / S away on either side
+     and the halfway points to them round to V when the significand is
+     even. */
+  _p_big_set (&r, mant << (closer ? 2 : 1));
+  _p_big_set (&s, closer ? 4 : 2);
+  _p_big_set (&mp, closer ? 2 : 1);
+  _p_big_set (&mm, 1);
+  if (exp > 0)
+    {
+      _p_big_shl (&r, exp);
+      _p_big_shl (&mp, exp);
+      _p_big_shl (&mm, exp);
+    }
+  else
+    _p_big_shl (&s, -exp);
+
+  /* Scale by 10^K so that the upper halfway point lies in [0.1, 1). */
+  k = (((exp + bits - 1) * 78913) >> 18) + 1;
+  if (k > 0)
+    _p_big_pow10 (&s, k);
+  else
+    {
+      _p_big_pow10 (&r, -k);
+      _p_big_pow10 (&mp, -k);
+      _p_big_pow10 (&mm, -k);
+    }
+  while ((cmp = _p_big_cmp_sum (&r, &mp, &s)) > 0 || (cmp == 0 && even))
+    {
+      _p_big_mul (&s, 10);
+      ++k;
+    }
+  for (;;)
+    {
+      _p_big_copy (&t, &r);
+      _p_big_add (&t, &mp);
+      _p_big_mul (&t, 10);
+      cmp = _p_big_cmp (&t, &s);
+      if (cmp > 0 || (cmp == 0 && even))
+        break;
+      _p_big_mul (&r, 10);
+      _p_big_mul (&mp, 10);
+      _p_big_mul (&mm, 10);
+      --k;
+    }
+
+  /* Stop at the first digit after which V is within reach of either
+     neighbour's halfway point. */
+  for (;;)
+    {
+      _p_big_mul (&r, 10);
+      _p_big_mul (&mp, 10);
+      _p_big_mul (&mm, 10);
+      digit = _p_big_digit (&r, &s);
+
+      cmp = _p_big_cmp (&r, &mm);
+      low = cmp < 0 || (cmp == 0 && even);
+      cmp = _p_big_cmp_sum (&r, &mp, &s);
+      high = cmp > 0 || (cmp == 0 && even);
+      if (!low && !high)
+        {
+          out[n++] = '0' + digit;
+          continue;
+        }
+
+      if (low && high)
+        {
+          _p_big_shl (&r, 1);
+          cmp = _p_big_cmp (&r, &s);
+          high = cmp > 0 || (cmp == 0 && digit % 2);
+        }
+      out[n++] = '0' + digit + high;
+      break;
+    }
+
+  /* Rounding up a 9 carries into the digits before it. */
+  for (i = n - 1; i > 0 && out[i] > '9'; --i)
+    {
+      out[i] = '0';
+      ++out[i - 1];
+    }
+  if (out[0] > '9')
+    {
+      out[0] = '1';
+      ++k;
+    }
+  while (n > 1 && out[n - 1] == '0')
+    --n;
+
+  *len = n;
+  return k - 1;
+}
+// }}}
+
+// [ Grisu3 ] {{{
+static _p_diyfp
+_p_diy_mul (_p_diyfp a, _p_diyfp b)
+{
+  const unsigned long long m32 = 0xffffffffull;
+  unsigned long long ah = a.f >> 32, al = a.f & m32;
+  unsigned long long bh = b.f >> 32, bl = b.f & m32;
+  unsigned long long hh = ah * bh, lh = al * bh, hl = ah * bl, ll = al * bl;
+  unsigned long long mid = (ll >> 32) + (hl & m32) + (lh & m32);
+  _p_diyfp r;
+
+  mid += 1ull << 31; /* Round. */
+  r.f = hh + (hl >> 32) + (lh >> 32) + (mid >> 32);
+  r.e = a.e + b.e + 64;
+  return r;
+}
+
+static _p_diyfp
+_p_diy_normalize (_p_diyfp a)
+{
+  int shift = __builtin_clzll (a.f);
+
+  a.f <<= shift;
+  a.e -= shift;
+  return a;
+}
+
+/* Move the last digit of the N in OUT towards W, which is DIST below the
+   upper boundary, while that stays safe.  Returns 0 when the result
+   can't be proved to be the shortest closest one. */
+static int
+_p_round_weed (char *out, int n, unsigned long long dist,
+               unsigned long long unsafe, unsigned long long rest,
+               unsigned long long ten_kappa, unsigned long long unit)
+{
+  unsigned long long small = dist - unit, big = dist + unit;
+
+  while (rest < small && unsafe - rest >= ten_kappa
+         && (rest + ten_kappa < small
+             || small - rest >= rest + ten_kappa - small))
+    {
+      --out[n - 1];
+      rest += ten_kappa;
+    }
+
+  if (rest < big && unsafe - rest >= ten_kappa
+      && (rest + ten_kappa < big || big - rest > rest + ten_kappa - big))
+    return 0;
+
+  return 2 * unit <= rest && rest <= unsafe - 4 * unit;
+}
+
+/* Digits of W, which lies between LOW and HIGH, all scaled so that their
+   exponent is between -60 and -32.  Sets *LEN and *KAPPA so that the
+   digits times 10^KAPPA are W.  Returns 0 when Grisu3 gives up. */
+static int
+_p_digit_gen (_p_diyfp low, _p_diyfp w, _p_diyfp high, char *out, int *len,
+              int *kappa)
+{
+  unsigned long long unit = 1, one = 1ull << -w.e;
+  unsigned long long too_low = low.f - unit, too_high = high.f + unit;
+  unsigned long long unsafe = too_high - too_low;
+  unsigned long long frac = too_high & (one - 1), rest;
+  unsigned integral = too_high >> -w.e, divisor = 1;
+  int digits = 1;
+
+  while (integral / divisor >= 10)
+    {
+      divisor *= 10;
+      ++digits;
+    }
+
+  *kappa = digits;
+  *len = 0;
+  while (*kappa > 0)
+    {
+      out[(*len)++] = '0' + integral / divisor;
+      integral %= divisor;
+      --*kappa;
+      rest = ((unsigned long long)integral << -w.e) + frac;
+      if (rest < unsafe)
+        return _p_round_weed (out, *len, too_high - w.f, unsafe, rest,
+                              (unsigned long long)divisor << -w.e, unit);
+      divisor /= 10;
+    }
+
+  for (;;)
+    {
+      frac *= 10;
+      unit *= 10;
+      unsafe *= 10;
+      out[(*len)++] = '0' + (frac >> -w.e);
+      frac &= one - 1;
+      --*kappa;
+      if (frac < unsafe)
+        return _p_round_weed (out, *len, (too_high - w.f) * unit, unsafe,
+                              frac, one, unit);
+    }
+}
+
+/* Like _p_exact_shortest, returns 0 when it can't decide. */
+static int
+_p_grisu3 (unsigned long long mant, int exp, char *out, int *len, int *e10)
+{
+  _p_diyfp w = { mant, exp }, plus, minus, c;
+  int closer = mant == 1ull << 52 && exp > -1074;
+  int min_e, i, kappa;
+  double t;
+
+  w = _p_diy_normalize (w);
+  plus.f = (mant << 1) + 1;
+  plus.e = exp - 1;
+  plus = _p_diy_normalize (plus);
+  minus.f = closer ? (mant << 2) - 1 : (mant << 1) - 1;
+  minus.e = closer ? exp - 2 : exp - 1;
+  minus.f <<= minus.e - plus.e;
+  minus.e = plus.e;
+
+  /* A cached power that brings the exponent of W between -60 and -32. */
+  min_e = -60 - (w.e + 64);
+  t = (min_e + 63) * 0.30102999566398114;
+  i = (int)t;
+  if (i < t)
+    ++i;
+  i = (348 + i - 1) / 8 + 1;
+  while (i > 0 && _p_cached_pow10[i].e + w.e + 64 > -32)
+    --i;
+  while (i < 86 && _p_cached_pow10[i].e + w.e + 64 < -60)
+    ++i;
+  c.f = _p_cached_pow10[i].f;
+  c.e = _p_cached_pow10[i].e;
+
+  if (!_p_digit_gen (_p_diy_mul (minus, c), _p_diy_mul (w, c),
+                     _p_diy_mul (plus, c), out, len, &kappa))
+    return 0;
+  *e10 = kappa - _p_cached_pow10[i].k + *len - 1;
+  return 1;
+}
+// }}}
+
+// [ Reals ] {{{
+/* Split X into sign, significand and exponent.  Returns 0 for finite
+   values other than zero, 1 for zeros, 2 for infinities and 3 for NaN. */
+static int
+_p_real_split (double x, int *neg, unsigned long long *mant, int *exp)
+{
+  union
+  {
+    double d;
+    unsigned long long u;
+  } bits = { x };
+  int biased = (bits.u >> 52) & 0x7ff;
+
+  *neg = bits.u >> 63;
+  *mant = bits.u & ((1ull << 52) - 1);
+  if (biased == 0x7ff)
+    return *mant ? 3 : 2;
+  if (!biased && !*mant)
+    return 1;
+  if (biased)
+    *mant |= 1ull << 52;
+  else
+    biased = 1;
+  *exp = biased - 1075;
+  return 0;
+}
+
+/* Write zero, an infinity or NaN as KIND from _p_real_split. */
+static unsigned
+_p_fmt_special (char *out, int kind, int neg)
+{
+  const char *s = kind == 1 ? "0" : kind == 2 ? "inf" : "nan";
+  unsigned n = 0;
+
+  if (neg)
+    out[n++] = '-';
+  while (*s)
+    out[n++] = *s++;
+  return n;
+}
+
+/* Write X as the shortest decimal that reads back as X, returns the
+   length. */
+static unsigned
+_p_fmt_real (char *out, double x)
+{
+  unsigned long long mant;
+  char digits[20];
+  int neg, exp, kind, len, e, i;
+  unsigned n = 0;
+
+  kind = _p_real_split (x, &neg, &mant, &exp);
+  if (kind)
+    return _p_fmt_special (out, kind, neg);
+
+  if (!_p_grisu3 (mant, exp, digits, &len, &e))
+    e = _p_exact_shortest (mant, exp, digits, &len);
+  while (len > 1 && digits[len - 1] == '0')
+    --len;
+
+  if (neg)
+    out[n++] = '-';
+  if (e < -4 || e >= _P__REAL_DIGITS)
+    {
+      out[n++] = digits[0];
+      if (len > 1)
+        out[n++] = '.';
+      for (i = 1; i < len; ++i)
+        out[n++] = digits[i];
+      out[n++] = 'e';
+      out[n++] = e < 0 ? '-' : '+';
+      if (e < 0)
+        e = -e;
+      if (e >= 100)
+        out[n++] = '0' + e / 100;
+      out[n++] = '0' + e / 10 % 10;
+      out[n++] = '0' + e % 10;
+    }
+  else if (e >= 0)
+    {
+      for (i = 0; i <= e; ++i)
+        out[n++] = i < len ? digits[i] : '0';
+      if (len > e + 1)
+        out[n++] = '.';
+      for (; i < len; ++i)
+        out[n++] = digits[i];
+    }
+  else
+    {
+      out[n++] = '0';
+      out[n++] = '.';
+      for (i = e + 1; i < 0; ++i)
+        out[n++] = '0';
+      for (i = 0; i < len; ++i)
+        out[n++] = digits[i];
+    }
+  return n;
+}
+
+/* Write X with D decimals, D at most _P__MAX_DECIMALS, returns the
+   length. */
+static unsigned
+_p_fmt_fixed (char *out, double x, int d)
+{
+  static char digits[_P__FIXED_SIZE];
+  unsigned __int128 p, half;
+  unsigned long long mant, q;
+  int neg, exp, kind, len, e, i, digit;
+  unsigned n = 0, nd;
+
+  kind = _p_real_split (x, &neg, &mant, &exp);
+  if (kind > 1)
+    return _p_fmt_special (out, kind, neg);
+  if (neg)
+    out[n++] = '-';
+
+  /* X * 10^D rounded to an integer fits in 64 bits, in which case it
+     only needs the digits put around the point. */
+  if (kind == 0 && d < 20 && exp < 0 && exp > -128)
+    {
+      p = (unsigned __int128)mant * _p_pow10[d];
+      q = p >> -exp;
+      if (p >> -exp >> 64 == 0 && q != ~0ull)
+        {
+          half = (unsigned __int128)1 << (-exp - 1);
+          p &= ((unsigned __int128)1 << -exp) - 1;
+          if (p > half || (p == half && (q & 1)))
+            ++q;
+          nd = _p_ndigits (q);
+          if (nd <= (unsigned)d)
+            nd = d + 1;
+          for (i = 0; i < (int)nd; ++i)
+            digits[i] = '0';
+          _p_utoa (digits + nd, q);
+          for (i = 0; i < (int)nd; ++i)
+            {
+              if (i == (int)nd - d)
+                out[n++] = '.';
+              out[n++] = digits[i];
+            }
+          return n;
+        }
+    }
+
+  /* Integers below 2^63 have no fraction to round. */
+  if (kind == 0 && exp >= 0 && exp <= 10)
+    {
+      q = mant << exp;
+      nd = _p_ndigits (q);
+      _p_utoa (out + n + nd, q);
+      n += nd;
+      if (d > 0)
+        out[n++] = '.';
+      for (i = 0; i < d; ++i)
+        out[n++] = '0';
+      return n;
+    }
+
+  if (kind == 1)
+    len = 0, e = 0;
+  else
+    e = _p_exact_digits (mant, exp, digits, d, 1, &len);
+
+  /* Digit I of the result stands for 10^(E - I). */
+  for (i = e > 0 ? e : 0; i >= -d; --i)
+    {
+      if (i == -1)
+        out[n++] = '.';
+      digit = e - i;
+      out[n++] = digit >= 0 && digit < len ? digits[digit] : '0';
+    }
+  return n;
+}
+// }}}
+
+#endif /* not _P__FORMAT_C */
+
+/* ----- format.c end ----- */
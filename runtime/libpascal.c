@@ -1,27 +1,696 @@
 /* ----- libpascal.c begin ----- */
 
-#include <stdio.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+
+/* Pasted in front of this file when it goes into a program. */
+#ifndef _P__FORMAT_C
+#include "format.c"
+#endif
+#ifndef LIBPASCAL_H
+#include "libpascal.h"
+#endif
+
+/* Output is collected here and written when full, by _P__p_flush and at
+   exit, so stdio is not involved at all. */
+#define _P__P_BUF_SIZE 65536
+
+/* First chunk of string temporaries, later ones double in size. */
+#define _P__P_TMP_SIZE 4096
+
+/* CAP of a _P__str that borrows its heap buffer from the temporaries. */
+#define _P__STR_BORROWED ((unsigned long)-1)
+
+typedef struct _p_chunk
+{
+  struct _p_chunk *next;
+  size_t size, used;
+  char data[];
+} _p_chunk;
+
+static char _p_buf[_P__P_BUF_SIZE];
+static size_t _p_len;
+
+/* Chunks of string temporaries, the one allocations come from and the
+   first one _P__str_reset rewinds to. */
+static _p_chunk *_p_tmp_head, *_p_tmp_cur;
+
+/* Where _P__str_reset rewinds to instead, set by _P__str_enter. */
+static _p_chunk *_p_tmp_floor;
+static size_t _p_tmp_floor_used;
 
 void
-_P__p_write_int (int x)
+_P__p_flush (void)
+{
+  size_t done = 0;
+  ssize_t n;
+
+  while (done < _p_len)
+    {
+      n = write (STDOUT_FILENO, _p_buf + done, _p_len - done);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        break;
+      done += n;
+    }
+  _p_len = 0;
+}
+
+__attribute__ ((constructor)) static void
+_p_init (void)
+{
+  atexit (_P__p_flush);
+}
+
+/* Room for N more bytes, N is at most _P__P_BUF_SIZE. */
+static char *
+_p_reserve (size_t n)
+{
+  if (_p_len + n > _P__P_BUF_SIZE)
+    _P__p_flush ();
+  return _p_buf + _p_len;
+}
+
+static void
+_p_put (const char *s, size_t n)
+{
+  size_t room;
+
+  while (_p_len + n > _P__P_BUF_SIZE)
+    {
+      room = _P__P_BUF_SIZE - _p_len;
+      memcpy (_p_buf + _p_len, s, room);
+      _p_len += room;
+      s += room;
+      n -= room;
+      _P__p_flush ();
+    }
+  memcpy (_p_buf + _p_len, s, n);
+  _p_len += n;
+}
+
+/* N spaces, nothing when N is not positive. */
+static void
+_p_pad (long n)
+{
+  size_t k;
+
+  while (n > 0)
+    {
+      k = n < 64 ? n : 64;
+      memset (_p_reserve (k), ' ', k);
+      _p_len += k;
+      n -= k;
+    }
+}
+
+/* The N bytes formatted at the end of the buffer by _p_reserve, right
+   aligned in WIDTH columns. */
+static void
+_p_commit (unsigned n, long width)
+{
+  char num[_P__REAL_SIZE];
+
+  if (width <= (long)n)
+    {
+      _p_len += n;
+      return;
+    }
+  memcpy (num, _p_buf + _p_len, n);
+  _p_pad (width - n);
+  _p_put (num, n);
+}
+
+/* X with DECIMALS digits after the point in WIDTH columns, the Pascal
+   x:width:decimals. */
+static void
+_p_put_fixed (double x, long width, long decimals)
+{
+  static char num[_P__FIXED_SIZE];
+  long zeros = 0;
+  unsigned n;
+
+  if (decimals < 0)
+    decimals = 0;
+  if (decimals > _P__MAX_DECIMALS)
+    {
+      zeros = decimals - _P__MAX_DECIMALS;
+      decimals = _P__MAX_DECIMALS;
+    }
+  n = _p_fmt_fixed (num, x, decimals);
+  if (x - x != 0) /* inf or nan */
+    zeros = 0;
+  _p_pad (width - n - zeros);
+  _p_put (num, n);
+  for (; zeros > 0; --zeros)
+    _p_put ("0", 1);
+}
+
+static void
+_p_put_pstr (const _P__str *s, long width)
+{
+  _p_pad (width - (long)s->len);
+  _p_put (_P__STR_DATA (s), s->len);
+}
+
+static void
+_p_put_str (const char *s, long width)
 {
-  printf ("%d", x);
+  size_t n = strlen (s);
+
+  _p_pad (width - (long)n);
+  _p_put (s, n);
+}
+
+/* Write LEN bytes of FMT, where %i, %r, %s and %S take the next argument
+   as a long, double, string or _P__str pointer and %% is a percent sign.  A field width may
+   come between the % and the letter, and for %r a point and a number of
+   decimals after it.  Each is either digits or * taking it from a long
+   argument before the value. */
+void
+_P__p_write (const char *fmt, unsigned len, ...)
+{
+  const char *end = fmt + len, *pct;
+  long width, decimals;
+  va_list ap;
+
+  va_start (ap, len);
+  while (fmt < end)
+    {
+      pct = memchr (fmt, '%', end - fmt);
+      if (!pct)
+        pct = end;
+      _p_put (fmt, pct - fmt);
+      if (pct == end)
+        break;
+
+      width = 0;
+      if (*++pct == '*')
+        {
+          width = va_arg (ap, long);
+          ++pct;
+        }
+      else
+        while (*pct >= '0' && *pct <= '9')
+          width = width * 10 + *pct++ - '0';
+
+      decimals = -1;
+      if (*pct == '.')
+        {
+          decimals = 0;
+          if (*++pct == '*')
+            {
+              decimals = va_arg (ap, long);
+              ++pct;
+            }
+          else
+            while (*pct >= '0' && *pct <= '9')
+              decimals = decimals * 10 + *pct++ - '0';
+        }
+
+      switch (*pct)
+        {
+        case 'i':
+          _p_commit (_p_fmt_int (_p_reserve (_P__INT_SIZE), va_arg (ap, long)),
+                     width);
+          break;
+        case 'r':
+          if (decimals >= 0)
+            _p_put_fixed (va_arg (ap, double), width, decimals);
+          else
+            _p_commit (_p_fmt_real (_p_reserve (_P__REAL_SIZE),
+                                    va_arg (ap, double)),
+                       width);
+          break;
+        case 's':
+          _p_put_str (va_arg (ap, const char *), width);
+          break;
+        case 'S':
+          _p_put_pstr (va_arg (ap, const _P__str *), width);
+          break;
+        default:
+          _p_put (pct, 1);
+          break;
+        }
+      fmt = pct + 1;
+    }
+  va_end (ap);
+}
+
+void
+_P__p_write_int_w (long x, long width)
+{
+  _p_commit (_p_fmt_int (_p_reserve (_P__INT_SIZE), x), width);
+}
+void
+_P__p_write_int (long x)
+{
+  _p_len += _p_fmt_int (_p_reserve (_P__INT_SIZE), x);
+}
+void
+_P__p_write_real_w (double x, long width)
+{
+  _p_commit (_p_fmt_real (_p_reserve (_P__REAL_SIZE), x), width);
 }
 void
 _P__p_write_real (double x)
 {
-  printf ("%g", x);
+  _p_len += _p_fmt_real (_p_reserve (_P__REAL_SIZE), x);
+}
+void
+_P__p_write_fixed (double x, long width, long decimals)
+{
+  _p_put_fixed (x, width, decimals);
+}
+void
+_P__p_write_str_w (const char *s, long width)
+{
+  _p_pad (width - (long)_P__P_HDR (s)->len);
+  _p_put (s, _P__P_HDR (s)->len);
 }
 void
 _P__p_write_str (const char *s)
 {
-  printf ("%s", s);
+  _p_put (s, _P__P_HDR (s)->len);
 }
 void
 _P__p_write_char (char c)
 {
-  putchar (c);
+  *_p_reserve (1) = c;
+  ++_p_len;
+}
+
+/* Report running out of memory and exit. */
+static void
+_p_oom (void)
+{
+  static const char msg[] = "Error: Out of memory.\n";
+  ssize_t n;
+
+  _P__p_flush ();
+  n = write (STDERR_FILENO, msg, sizeof (msg) - 1);
+  (void)n;
+  _exit (1);
+}
+
+static void *
+_p_alloc (size_t n)
+{
+  void *p = malloc (n);
+
+  if (!p)
+    _p_oom ();
+  return p;
+}
+
+/* N bytes of temporaries, 8 aligned. */
+static void *
+_p_tmp (size_t n)
+{
+  _p_chunk *c = _p_tmp_cur, *next;
+  size_t size;
+
+  n = (n + 7) & ~(size_t)7;
+  while (c && c->used + n > c->size)
+    {
+      /* Chunks after the current one are empty. */
+      if (c->next && c->next->size >= n)
+        c = _p_tmp_cur = c->next;
+      else
+        {
+          size = c->size * 2 > n ? c->size * 2 : n;
+          next = _p_alloc (sizeof (_p_chunk) + size);
+          next->size = size;
+          next->used = 0;
+          next->next = c->next;
+          c->next = next;
+          c = _p_tmp_cur = next;
+        }
+    }
+  if (!c)
+    {
+      size = _P__P_TMP_SIZE > n ? _P__P_TMP_SIZE : n;
+      c = _p_tmp_head = _p_tmp_cur = _p_alloc (sizeof (_p_chunk) + size);
+      c->size = size;
+      c->used = 0;
+      c->next = NULL;
+    }
+  c->used += n;
+  return c->data + c->used - n;
+}
+
+/* A temporary of LEN bytes, its buffer in *BUF. */
+static _P__str *
+_p_str_tmp (unsigned long len, char **buf)
+{
+  _P__str *s = _p_tmp (sizeof (_P__str) + (len < _P__STR_SMALL ? 0 : len + 1));
+
+  s->len = len;
+  if (len < _P__STR_SMALL)
+    *buf = s->u.small;
+  else
+    {
+      *buf = (char *)(s + 1);
+      s->u.heap.ptr = *buf;
+      s->u.heap.cap = _P__STR_BORROWED;
+    }
+  (*buf)[len] = '\0';
+  return s;
+}
+
+/* Buffer of S when it owns one. */
+static char *
+_p_str_owned (const _P__str *s)
+{
+  if (s->len < _P__STR_SMALL || s->u.heap.cap == 0
+      || s->u.heap.cap == _P__STR_BORROWED)
+    return NULL;
+  return (char *)s->u.heap.ptr;
+}
+
+void
+_P__str_set (_P__str *dst, const char *lit, unsigned long len)
+{
+  free (_p_str_owned (dst));
+  if (len < _P__STR_SMALL)
+    {
+      memcpy (dst->u.small, lit, len);
+      dst->u.small[len] = '\0';
+    }
+  else
+    {
+      dst->u.heap.ptr = lit;
+      dst->u.heap.cap = 0;
+    }
+  dst->len = len;
+}
+
+void
+_P__str_assign (_P__str *dst, const _P__str *src)
+{
+  char *buf = _p_str_owned (dst);
+
+  if (dst == src)
+    return;
+
+  /* Short strings and literals are copied as they are. */
+  if (src->len < _P__STR_SMALL || src->u.heap.cap == 0)
+    {
+      free (buf);
+      *dst = *src;
+      return;
+    }
+
+  if (!buf || dst->u.heap.cap <= src->len)
+    {
+      free (buf);
+      buf = _p_alloc (src->len + 1);
+      dst->u.heap.cap = src->len + 1;
+    }
+  memcpy (buf, src->u.heap.ptr, src->len + 1);
+  dst->u.heap.ptr = buf;
+  dst->len = src->len;
+}
+
+void
+_P__str_append (_P__str *dst, const _P__str *src)
+{
+  unsigned long n = src->len, len = dst->len + n, cap;
+  char *buf = _p_str_owned (dst), *grown;
+
+  if (n == 0)
+    return;
+  if (len < _P__STR_SMALL)
+    {
+      memmove (dst->u.small + dst->len, _P__STR_DATA (src), n);
+      dst->u.small[len] = '\0';
+      dst->len = len;
+      return;
+    }
+
+  /* Capacity doubles so appending in a loop copies every byte a constant
+     number of times. */
+  if (!buf || dst->u.heap.cap <= len)
+    {
+      cap = buf && dst->u.heap.cap * 2 > len + 1 ? dst->u.heap.cap * 2
+                                                  : len + 1;
+      if (cap < 2 * _P__STR_SMALL)
+        cap = 2 * _P__STR_SMALL;
+      grown = _p_alloc (cap);
+      memcpy (grown, _P__STR_DATA (dst), dst->len);
+      memcpy (grown + dst->len, _P__STR_DATA (src), n);
+      free (buf);
+      dst->u.heap.ptr = grown;
+      dst->u.heap.cap = cap;
+      buf = grown;
+    }
+  else
+    memmove (buf + dst->len, _P__STR_DATA (src), n);
+  buf[len] = '\0';
+  dst->len = len;
+}
+
+int
+_P__str_cmp (const _P__str *a, const _P__str *b)
+{
+  int c = memcmp (_P__STR_DATA (a), _P__STR_DATA (b),
+                  a->len < b->len ? a->len : b->len);
+
+  if (c)
+    return c < 0 ? -1 : 1;
+  return (a->len > b->len) - (a->len < b->len);
+}
+
+const _P__str *
+_P__str_lit (const char *lit, unsigned long len)
+{
+  _P__str *s;
+  char *buf;
+
+  if (len < _P__STR_SMALL)
+    {
+      s = _p_str_tmp (len, &buf);
+      memcpy (buf, lit, len);
+      return s;
+    }
+  s = _p_tmp (sizeof (_P__str));
+  s->len = len;
+  s->u.heap.ptr = lit;
+  s->u.heap.cap = 0;
+  return s;
+}
+
+const _P__str *
+_P__str_cat (const _P__str *a, const _P__str *b)
+{
+  char *buf;
+  _P__str *s = _p_str_tmp (a->len + b->len, &buf);
+
+  memcpy (buf, _P__STR_DATA (a), a->len);
+  memcpy (buf + a->len, _P__STR_DATA (b), b->len);
+  return s;
+}
+
+/* The Pascal copy: COUNT bytes from the 1-based INDEX on, as far as S
+   goes. */
+const _P__str *
+_P__str_copy (const _P__str *s, long index, long count)
+{
+  unsigned long from = index > 1 ? index - 1 : 0, n;
+  char *buf;
+  _P__str *r;
+
+  if (from > s->len || count <= 0)
+    from = n = 0;
+  else
+    n = (unsigned long)count < s->len - from ? (unsigned long)count
+                                              : s->len - from;
+  r = _p_str_tmp (n, &buf);
+  memcpy (buf, _P__STR_DATA (s) + from, n);
+  return r;
+}
+
+void
+_P__str_reset (void)
+{
+  _p_chunk *c = _p_tmp_floor ? _p_tmp_floor : _p_tmp_head;
+
+  if (!c)
+    return;
+  c->used = _p_tmp_floor ? _p_tmp_floor_used : 0;
+  _p_tmp_cur = c;
+  for (c = c->next; c; c = c->next)
+    c->used = 0;
+}
+
+void
+_P__str_enter (_P__str_scope *scope)
+{
+  scope->chunk = _p_tmp_floor;
+  scope->used = _p_tmp_floor_used;
+  _p_tmp_floor = _p_tmp_cur;
+  _p_tmp_floor_used = _p_tmp_cur ? _p_tmp_cur->used : 0;
+}
+
+void
+_P__str_leave (const _P__str_scope *scope)
+{
+  _p_tmp_floor = scope->chunk;
+  _p_tmp_floor_used = scope->used;
+}
+
+/* A string of LEN bytes in a buffer of CAP, CAP > LEN. */
+static char *
+_p_str_new (unsigned long len, unsigned long cap)
+{
+  _P__p_hdr *h = _p_alloc (sizeof (_P__p_hdr) + cap);
+  char *r = (char *)(h + 1);
+
+  h->len = len;
+  h->cap = cap;
+  r[len] = '\0';
+  return r;
+}
+
+long
+_P__p_length (const char *s)
+{
+  return _P__P_HDR (s)->len;
+}
+
+const char *
+_P__p_concat (const char *a, const char *b)
+{
+  unsigned long na = _P__P_HDR (a)->len, nb = _P__P_HDR (b)->len;
+  char *r = _p_str_new (na + nb, na + nb + 1);
+
+  memcpy (r, a, na);
+  memcpy (r + na, b, nb);
+  return r;
+}
+
+/* S without its first N bytes. */
+const char *
+_P__p_drop (const char *s, long n)
+{
+  unsigned long len = _P__P_HDR (s)->len;
+  char *r;
+
+  if (n <= 0)
+    n = 0;
+  else if ((unsigned long)n > len)
+    n = len;
+  r = _p_str_new (len - n, len - n + 1);
+  memcpy (r, s + n, len - n);
+  return r;
+}
+
+/* The first N bytes of S. */
+const char *
+_P__p_take (const char *s, long n)
+{
+  unsigned long len = _P__P_HDR (s)->len;
+  char *r;
+
+  if (n <= 0)
+    n = 0;
+  else if ((unsigned long)n > len)
+    n = len;
+  r = _p_str_new (n, n + 1);
+  memcpy (r, s, n);
+  return r;
+}
+
+long
+_P__p_compare (const char *a, const char *b)
+{
+  unsigned long na = _P__P_HDR (a)->len, nb = _P__P_HDR (b)->len;
+  int c = memcmp (a, b, na < nb ? na : nb);
+
+  if (c)
+    return c < 0 ? -1 : 1;
+  return (na > nb) - (na < nb);
+}
+
+const char *
+_P__p_dup (const char *s)
+{
+  unsigned long len = _P__P_HDR (s)->len;
+  char *r;
+
+  if (_P__P_HDR (s)->cap == 0)
+    return s;
+  r = _p_str_new (len, len + 1);
+  memcpy (r, s, len);
+  return r;
+}
+
+void
+_P__p_free (const char *s)
+{
+  if (_P__P_HDR (s)->cap)
+    free (_P__P_HDR (s));
+}
+
+const char *
+_P__p_append (const char *s, const char *t)
+{
+  _P__p_hdr *h = _P__P_HDR (s);
+  unsigned long n = _P__P_HDR (t)->len, len = h->len + n, cap;
+  char *r;
+
+  if (h->cap > len)
+    {
+      r = (char *)s;
+      memcpy (r + h->len, t, n);
+      r[len] = '\0';
+      h->len = len;
+      return r;
+    }
+
+  /* Capacity doubles so appending in a loop copies every byte a constant
+     number of times. */
+  cap = h->cap * 2 > len + 1 ? h->cap * 2 : len + 1;
+  r = _p_str_new (len, cap);
+  memcpy (r, s, h->len);
+  memcpy (r + h->len, t, n);
+  _P__p_free (s);
+  return r;
+}
+
+void *
+_P__p_array (long n)
+{
+  void *p = calloc (n > 0 ? n : 1, 8);
+
+  if (!p)
+    _p_oom ();
+  return p;
+}
+
+void
+_P__p_bounds (long i, long n)
+{
+  char msg[2 * _P__INT_SIZE + 40], *p = msg;
+  ssize_t w;
+
+  memcpy (p, "Error: Index ", 13);
+  p += 13;
+  p += _p_fmt_int (p, i);
+  memcpy (p, " out of bounds 0..", 18);
+  p += 18;
+  p += _p_fmt_int (p, n - 1);
+  memcpy (p, ".\n", 2);
+  p += 2;
+
+  _P__p_flush ();
+  w = write (STDERR_FILENO, msg, p - msg);
+  (void)w;
+  _exit (1);
 }
 
 /* ----- libpascal.c end ----- */
@@ -0,0 +1,120 @@
+/* libpascal.h - Pascal runtime interface.
+
+   Prototypes of everything in libpascal.c.  codegen pastes this file in
+   front of a program that links against libpascal.a, and in front of the
+   runtime source when it pastes that in instead. */
+
+#ifndef LIBPASCAL_H
+#define LIBPASCAL_H
+
+void _P__p_write (const char *fmt, unsigned len, ...);
+void _P__p_write_int (long x);
+void _P__p_write_real (double x);
+void _P__p_write_str (const char *s);
+void _P__p_write_char (char c);
+
+/* The Pascal x:width and x:width:decimals, right aligned in WIDTH
+   columns.  Reals without decimals are written as the shortest form that
+   reads back the same. */
+void _P__p_write_int_w (long x, long width);
+void _P__p_write_real_w (double x, long width);
+void _P__p_write_fixed (double x, long width, long decimals);
+void _P__p_write_str_w (const char *s, long width);
+
+/* A string variable of the C backend.  Strings shorter than
+   _P__STR_SMALL bytes are kept inline, longer ones in a heap buffer of
+   CAP bytes the string owns, or a literal it doesn't when CAP is 0.  A
+   zeroed _P__str is the empty string. */
+#define _P__STR_SMALL 16
+
+typedef struct _P__str
+{
+  unsigned long len;
+  union
+  {
+    char small[_P__STR_SMALL];
+    struct
+    {
+      const char *ptr;
+      unsigned long cap;
+    } heap;
+  } u;
+} _P__str;
+
+#define _P__STR_DATA(s)                                                      \
+  ((s)->len < _P__STR_SMALL ? (s)->u.small : (s)->u.heap.ptr)
+
+void _P__str_set (_P__str *dst, const char *lit, unsigned long len);
+void _P__str_assign (_P__str *dst, const _P__str *src);
+void _P__str_append (_P__str *dst, const _P__str *src);
+int _P__str_cmp (const _P__str *a, const _P__str *b);
+
+/* Temporaries for string expressions, valid until _P__str_reset.  The
+   C backend resets before each statement that makes any. */
+const _P__str *_P__str_lit (const char *lit, unsigned long len);
+const _P__str *_P__str_cat (const _P__str *a, const _P__str *b);
+const _P__str *_P__str_copy (const _P__str *s, long index, long count);
+void _P__str_reset (void);
+
+/* The temporaries of a routine.  After _P__str_enter, _P__str_reset
+   keeps those made before it, which belong to the callers, until
+   _P__str_leave. */
+typedef struct _P__str_scope
+{
+  void *chunk;
+  unsigned long used;
+} _P__str_scope;
+
+void _P__str_enter (_P__str_scope *scope);
+void _P__str_leave (const _P__str_scope *scope);
+
+/* A string of the other backends points at its NUL terminated bytes,
+   right after their length and the capacity of the buffer.  Literals
+   have capacity 0 and are never freed, any other string belongs to the
+   one variable or temporary holding it. */
+typedef struct _P__p_hdr
+{
+  unsigned long len;
+  unsigned long cap;
+} _P__p_hdr;
+
+#define _P__P_HDR(s) ((_P__p_hdr *)(s) - 1)
+
+/* The string operations of those backends, each result a new string. */
+long _P__p_length (const char *s);
+const char *_P__p_concat (const char *a, const char *b);
+const char *_P__p_drop (const char *s, long n);
+const char *_P__p_take (const char *s, long n);
+long _P__p_compare (const char *a, const char *b);
+
+/* A string of its own with the bytes of S, S itself when a literal. */
+const char *_P__p_dup (const char *s);
+
+/* Free S unless it is a literal. */
+void _P__p_free (const char *s);
+
+/* S followed by T, in the buffer of S when it has the room.  S is used
+   up, T may be S. */
+const char *_P__p_append (const char *s, const char *t);
+
+/* Arrays of the other backends, N zeroed 8 byte elements that are
+   never freed. */
+void *_P__p_array (long n);
+
+/* Report index I of an array of N elements and exit.  The C backend
+   checks an index with _P__p_index, the others branch here themselves. */
+__attribute__ ((noreturn)) void _P__p_bounds (long i, long n);
+
+static inline long
+_P__p_index (long i, long n)
+{
+  if ((unsigned long)i >= (unsigned long)n)
+    _P__p_bounds (i, n);
+  return i;
+}
+
+/* Write out buffered output.  Done at exit, and must be done before
+   reading input or handing stdout to anyone else. */
+void _P__p_flush (void);
+
+#endif /* not LIBPASCAL_H */
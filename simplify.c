@@ -0,0 +1,596 @@
+#include <limits.h>
+
+#include "simplify.h"
+
+/* Simplify the statements of list PTR. */
+static void _stmts (arena *ar, ast_node *ptr);
+
+/* Simplify statement S, in place. */
+static void _stmt (arena *ar, ast_node *s);
+
+/* Simplify expression EXP, in place. */
+static void _exp (arena *ar, ast_node *exp);
+
+/* Simplify the arguments of call DATA. */
+static void _args (arena *ar, ast_data_funcall *data);
+
+/* Simplify operator EXP, its operands already simplified. */
+static void _op (arena *ar, ast_node *exp);
+
+/* Literal of the value of operator DATA, NULL unless its operands are
+   literals it folds. */
+static ast_node *_fold (arena *ar, ast_data_op *data);
+
+/* Whether compare OP holds of operands ORDER apart, negative when the
+   left one is the smaller. */
+static U8 _holds (U8 op, int order);
+
+/* What operator EXP reduces to for an operand of no effect, as in
+   x + 0, NULL when nothing. */
+static ast_node *_identity (arena *ar, ast_node *exp);
+
+/* Merge the literals of integer (x + a) - b and the like into one. */
+static void _reassoc (arena *ar, ast_node *exp);
+
+/* Drop the double negations and compares with true or false of EXP,
+   and push a negation into the compare under it. */
+static void _boolean (ast_node *exp);
+
+/* Turn an integer multiply of EXP by a power of two into a shift, and
+   a divide or mod of a value never negative into a shift or mask. */
+static void _reduce (ast_node *exp);
+
+/* Whether integer expression EXP is never negative, from itself. */
+static U8 _nonneg (ast_node *exp);
+
+/* Whether EXP is the literal VALUE, a real zero without its sign. */
+static U8 _is (ast_node *exp, long value);
+
+/* Whether EXP is an integer or boolean, compared without NaNs. */
+static U8 _discrete (ast_node *exp);
+
+/* Compare that holds when OP does not. */
+static U8 _negate (U8 op);
+
+/* Make NODE a copy of WITH, in its place in a list. */
+static void _replace (ast_node *node, ast_node *with);
+
+/* Make statement S an empty block. */
+static void _empty (arena *ar, ast_node *s);
+
+/* New node of TYPE holding DATA. */
+static ast_node *_node (arena *ar, enum ast_type type, void *data);
+
+/* New literals. */
+static ast_node *_int (arena *ar, long value);
+static ast_node *_real (arena *ar, double value);
+static ast_node *_bool (arena *ar, U16 value);
+
+void
+simplify (ast *ctx)
+{
+  ast_node *ptr;
+
+  for (ptr = ctx->root; ptr; ptr = ptr->next)
+    {
+      if (ptr->type == AST_ROUTINE)
+        _stmt (&ctx->ar, ((ast_data_routine *)ptr->data)->body);
+      else if (ptr->type == AST_MAIN_BLOCK)
+        _stmts (&ctx->ar, ((ast_data_block *)ptr->data)->next);
+    }
+}
+
+// [ Statements ] {{{
+void
+_stmts (arena *ar, ast_node *ptr)
+{
+  for (; ptr; ptr = ptr->next)
+    _stmt (ar, ptr);
+}
+
+void
+_stmt (arena *ar, ast_node *s)
+{
+  ast_data_var_assign *va_data;
+  ast_data_cond *cond_data;
+  ast_data_while *while_data;
+  ast_data_for *for_data;
+
+  switch (s->type)
+    {
+    case AST_BLOCK:
+      _stmts (ar, ((ast_data_block *)s->data)->next);
+      break;
+    case AST_VAR_ASSIGN:
+      va_data = s->data;
+      if (va_data->index)
+        _exp (ar, va_data->index);
+      _exp (ar, va_data->value);
+      break;
+    case AST_COND:
+      cond_data = s->data;
+      _exp (ar, cond_data->cond);
+      _stmt (ar, cond_data->yes);
+      if (cond_data->no)
+        _stmt (ar, cond_data->no);
+      if (cond_data->cond->type != AST_BOOL)
+        break;
+      if (*(U16 *)cond_data->cond->data)
+        _replace (s, cond_data->yes);
+      else if (cond_data->no)
+        _replace (s, cond_data->no);
+      else
+        _empty (ar, s);
+      break;
+    case AST_WHILE:
+      while_data = s->data;
+      _exp (ar, while_data->cond);
+      _stmt (ar, while_data->next);
+      if (while_data->cond->type == AST_BOOL
+          && !*(U16 *)while_data->cond->data)
+        _empty (ar, s);
+      break;
+    case AST_FOR:
+      for_data = s->data;
+      _exp (ar, for_data->from);
+      _exp (ar, for_data->to);
+      _stmt (ar, for_data->body);
+      break;
+    case AST_FUNCALL:
+      _args (ar, s->data);
+      break;
+    default:
+      break;
+    }
+}
+
+void
+_replace (ast_node *node, ast_node *with)
+{
+  node->type = with->type;
+  node->data = with->data;
+}
+
+void
+_empty (arena *ar, ast_node *s)
+{
+  ast_data_block *data = aralloc (ar, sizeof (ast_data_block));
+
+  data->next = NULL;
+  s->type = AST_BLOCK;
+  s->data = data;
+}
+// }}}
+// [ Expressions ] {{{
+void
+_exp (arena *ar, ast_node *exp)
+{
+  ast_data_op *op_data;
+
+  switch (exp->type)
+    {
+    case AST_INDEX:
+      _exp (ar, ((ast_data_index *)exp->data)->index);
+      break;
+    case AST_FUNCALL:
+      _args (ar, exp->data);
+      break;
+    case AST_OP:
+      op_data = exp->data;
+      if (op_data->left)
+        _exp (ar, op_data->left);
+      _exp (ar, op_data->right);
+      _op (ar, exp);
+      break;
+    default:
+      break;
+    }
+}
+
+void
+_args (arena *ar, ast_data_funcall *data)
+{
+  ast_data_write_arg *wa;
+  ast_node *arg;
+
+  for (arg = data->args_head; arg; arg = arg->next)
+    {
+      if (arg->type != AST_WRITE_ARG)
+        {
+          _exp (ar, arg);
+          continue;
+        }
+      wa = arg->data;
+      _exp (ar, wa->value);
+      if (wa->width)
+        _exp (ar, wa->width);
+      if (wa->decimals)
+        _exp (ar, wa->decimals);
+    }
+}
+
+void
+_op (arena *ar, ast_node *exp)
+{
+  ast_node *with;
+
+  with = _fold (ar, exp->data);
+  if (!with)
+    with = _identity (ar, exp);
+  if (with)
+    {
+      _replace (exp, with);
+      return;
+    }
+  _reassoc (ar, exp);
+  if (exp->type == AST_OP)
+    _boolean (exp);
+  if (exp->type == AST_OP)
+    _reduce (exp);
+}
+
+ast_node *
+_fold (arena *ar, ast_data_op *data)
+{
+  ast_node *l = data->left, *r = data->right;
+  unsigned long a, b;
+  double x, y, v;
+  int order;
+
+  if (!l)
+    {
+      if (data->op == '-' && r->type == AST_INTLIT)
+        return _int (ar, -(unsigned long)*(long *)r->data);
+      if (data->op == '-' && r->type == AST_FLOATLIT)
+        return _real (ar, -*(double *)r->data);
+      if (data->op == '!' && r->type == AST_BOOL)
+        return _bool (ar, !*(U16 *)r->data);
+      return NULL;
+    }
+
+  if (l->type == AST_INTLIT && r->type == AST_INTLIT)
+    {
+      /* Wrapping around as the backends do. */
+      a = *(long *)l->data;
+      b = *(long *)r->data;
+      switch (data->op)
+        {
+        case '+':
+          return _int (ar, a + b);
+        case '-':
+          return _int (ar, a - b);
+        case '*':
+          return _int (ar, a * b);
+        case '/':
+        case '%':
+          if (b == 0 || ((long)a == LONG_MIN && (long)b == -1))
+            return NULL;
+          return _int (ar, data->op == '/' ? (long)a / (long)b
+                                           : (long)a % (long)b);
+        }
+      order = ((long)a > (long)b) - ((long)a < (long)b);
+    }
+  else if (l->type == AST_BOOL && r->type == AST_BOOL)
+    order = (*(U16 *)l->data > *(U16 *)r->data)
+            - (*(U16 *)l->data < *(U16 *)r->data);
+  else if ((l->type == AST_INTLIT || l->type == AST_FLOATLIT)
+           && (r->type == AST_INTLIT || r->type == AST_FLOATLIT))
+    {
+      x = l->type == AST_INTLIT ? *(long *)l->data : *(double *)l->data;
+      y = r->type == AST_INTLIT ? *(long *)r->data : *(double *)r->data;
+      switch (data->op)
+        {
+        case '+':
+          v = x + y;
+          break;
+        case '-':
+          v = x - y;
+          break;
+        case '*':
+          v = x * y;
+          break;
+        case '/':
+          v = x / y;
+          break;
+        default:
+          v = 0.0;
+          break;
+        }
+      if (data->op == '+' || data->op == '-' || data->op == '*'
+          || data->op == '/')
+        return __builtin_isfinite (v) ? _real (ar, v) : NULL;
+      order = (x > y) - (x < y);
+    }
+  else
+    return NULL;
+
+  if (!ast_is_compare (data->op))
+    return NULL;
+  return _bool (ar, _holds (data->op, order));
+}
+
+U8
+_holds (U8 op, int order)
+{
+  switch (op)
+    {
+    case '<':
+      return order < 0;
+    case '>':
+      return order > 0;
+    case '=':
+      return order == 0;
+    case (U8)TOKEN_LEQ:
+      return order <= 0;
+    case (U8)TOKEN_GEQ:
+      return order >= 0;
+    default:
+      return order != 0;
+    }
+}
+
+ast_node *
+_identity (arena *ar, ast_node *exp)
+{
+  ast_data_op *data = exp->data;
+  ast_node *l = data->left, *r = data->right;
+  int type = ast_exp_type (exp);
+
+  if (!l)
+    return NULL;
+
+  switch (data->op)
+    {
+    case '+':
+      /* -0.0 + 0 is 0.0, only integers. */
+      if (type != AST_INTLIT)
+        return NULL;
+      if (_is (r, 0) && ast_exp_type (l) == type)
+        return l;
+      if (_is (l, 0) && ast_exp_type (r) == type)
+        return r;
+      break;
+    case '-':
+      if (_is (r, 0) && ast_exp_type (l) == type)
+        return l;
+      break;
+    case '*':
+      if (_is (r, 1) && ast_exp_type (l) == type)
+        return l;
+      if (_is (l, 1) && ast_exp_type (r) == type)
+        return r;
+      /* Only a variable is dropped, an index would skip its check. */
+      if (type == AST_INTLIT
+          && ((_is (r, 0) && l->type == AST_VAR_DECLARE)
+              || (_is (l, 0) && r->type == AST_VAR_DECLARE)))
+        return _int (ar, 0);
+      break;
+    case '/':
+      if (_is (r, 1) && ast_exp_type (l) == type)
+        return l;
+      break;
+    }
+  return NULL;
+}
+
+void
+_reassoc (arena *ar, ast_node *exp)
+{
+  ast_data_op *data = exp->data, *inner;
+  ast_node *l = data->left, *r = data->right;
+  unsigned long a, b, sum;
+
+  if (!l || (data->op != '+' && data->op != '-') || r->type != AST_INTLIT
+      || l->type != AST_OP)
+    return;
+  inner = l->data;
+  if (!inner->left || (inner->op != '+' && inner->op != '-')
+      || ((ast_node *)inner->right)->type != AST_INTLIT
+      || ast_exp_type (inner->left) != AST_INTLIT)
+    return;
+
+  a = *(long *)((ast_node *)inner->right)->data;
+  b = *(long *)r->data;
+  sum = (inner->op == '-' ? -a : a) + (data->op == '-' ? -b : b);
+  if (sum == 0)
+    {
+      _replace (exp, inner->left);
+      return;
+    }
+  data->left = inner->left;
+  data->op = (long)sum < 0 && (long)sum != LONG_MIN ? '-' : '+';
+  data->right = _int (ar, data->op == '-' ? -sum : sum);
+}
+
+void
+_boolean (ast_node *exp)
+{
+  ast_data_op *data = exp->data, *inner;
+  ast_node *x, *lit;
+
+  if (!data->left)
+    {
+      if (data->op != '!' || ((ast_node *)data->right)->type != AST_OP)
+        return;
+      inner = ((ast_node *)data->right)->data;
+      if (!inner->left && inner->op == '!'
+          && ast_exp_type (inner->right) == AST_BOOL)
+        _replace (exp, inner->right);
+      else if (inner->left && ast_is_compare (inner->op)
+               && _discrete (inner->left) && _discrete (inner->right))
+        {
+          data->op = _negate (inner->op);
+          data->left = inner->left;
+          data->right = inner->right;
+        }
+      return;
+    }
+
+  if (data->op != '=' && data->op != (U8)TOKEN_NEQ)
+    return;
+  if (((ast_node *)data->right)->type == AST_BOOL)
+    {
+      x = data->left;
+      lit = data->right;
+    }
+  else if (((ast_node *)data->left)->type == AST_BOOL)
+    {
+      x = data->right;
+      lit = data->left;
+    }
+  else
+    return;
+  if (ast_exp_type (x) != AST_BOOL)
+    return;
+
+  /* x = true and x <> false are x, the others not x. */
+  if ((*(U16 *)lit->data != 0) == (data->op == '='))
+    {
+      _replace (exp, x);
+      return;
+    }
+  data->op = '!';
+  data->left = NULL;
+  data->right = x;
+  _boolean (exp);
+}
+
+void
+_reduce (ast_node *exp)
+{
+  ast_data_op *data = exp->data;
+  void *swap;
+
+  if (!data->left || ast_exp_type (data->left) != AST_INTLIT
+      || ast_exp_type (data->right) != AST_INTLIT)
+    return;
+
+  if (data->op == '*' && ast_log2 (data->left) && !ast_log2 (data->right))
+    {
+      swap = data->left;
+      data->left = data->right;
+      data->right = swap;
+    }
+  if (!ast_log2 (data->right))
+    return;
+  if (data->op == '*')
+    data->op = AST_OP_SHL;
+  else if (data->op == '/' && _nonneg (data->left))
+    data->op = AST_OP_SHR;
+  else if (data->op == '%' && _nonneg (data->left))
+    data->op = AST_OP_AND;
+}
+
+U8
+_nonneg (ast_node *exp)
+{
+  ast_data_funcall *fun_data;
+  ast_data_op *op_data;
+
+  switch (exp->type)
+    {
+    case AST_INTLIT:
+      return *(long *)exp->data >= 0;
+    case AST_FUNCALL:
+      fun_data = exp->data;
+      return !fun_data->routine && streq (fun_data->name->data, "length");
+    case AST_OP:
+      op_data = exp->data;
+      if (!op_data->left)
+        return 0;
+      switch (op_data->op)
+        {
+        case AST_OP_SHR:
+        case AST_OP_AND:
+        case '%':
+          return _nonneg (op_data->left);
+        case '/':
+          return _nonneg (op_data->left) && _nonneg (op_data->right);
+        default:
+          return 0;
+        }
+    default:
+      return 0;
+    }
+}
+
+U8
+_is (ast_node *exp, long value)
+{
+  if (exp->type == AST_INTLIT)
+    return *(long *)exp->data == value;
+  if (exp->type == AST_FLOATLIT)
+    return *(double *)exp->data == value
+           && !__builtin_signbit (*(double *)exp->data);
+  return 0;
+}
+
+U8
+_discrete (ast_node *exp)
+{
+  int type = ast_exp_type (exp);
+
+  return type == AST_INTLIT || type == AST_BOOL;
+}
+
+U8
+_negate (U8 op)
+{
+  switch (op)
+    {
+    case '<':
+      return (U8)TOKEN_GEQ;
+    case '>':
+      return (U8)TOKEN_LEQ;
+    case '=':
+      return (U8)TOKEN_NEQ;
+    case (U8)TOKEN_LEQ:
+      return '>';
+    case (U8)TOKEN_GEQ:
+      return '<';
+    default:
+      return '=';
+    }
+}
+// }}}
+// [ Nodes ] {{{
+ast_node *
+_node (arena *ar, enum ast_type type, void *data)
+{
+  ast_node *new = aralloc (ar, sizeof (ast_node));
+
+  new->type = type;
+  new->next = NULL;
+  new->data = data;
+  return new;
+}
+
+ast_node *
+_int (arena *ar, long value)
+{
+  long *data = aralloc (ar, sizeof (long));
+
+  *data = value;
+  return _node (ar, AST_INTLIT, data);
+}
+
+ast_node *
+_real (arena *ar, double value)
+{
+  double *data = aralloc (ar, sizeof (double));
+
+  *data = value;
+  return _node (ar, AST_FLOATLIT, data);
+}
+
+ast_node *
+_bool (arena *ar, U16 value)
+{
+  U16 *data = aralloc (ar, sizeof (U16));
+
+  *data = value;
+  return _node (ar, AST_BOOL, data);
+}
+// }}}
+
+// vim:fdm=marker:
@@ -0,0 +1,17 @@
+#ifndef SIMPLIFY_H
+#define SIMPLIFY_H
+
+#include "ast.h"
+
+/* Rewrite the expressions of program CTX->root into cheaper ones of the
+   same value: operators on literals are folded, x + 0, x * 1 and the
+   like lose the literal, double negations and compares with true or
+   false go away and integer multiplies by a power of two become
+   shifts.  An if or while whose condition folds keeps only the branch
+   that runs.
+
+   Integers fold wrapping around, as the backends compute them; a divide
+   by zero and reals that would not be finite are left to the program. */
+void simplify (ast *ctx);
+
+#endif /* not SIMPLIFY_H */
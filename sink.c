@@ -0,0 +1,148 @@
+#include <errno.h>
+#include <unistd.h>
+
+#include "sink.h"
+
+/* Make room for at least NEEDED more bytes in a memory sink. */
+static int _sink_grow (sink *s, U32 needed);
+
+int
+sink_open_fd (sink *s, int fd, U32 capacity)
+{
+  s->kind = SINK_FD;
+  s->fd = fd;
+  s->size = 0;
+  s->capacity = capacity;
+  s->failed = 0;
+  s->buf = malloc (capacity);
+
+  return s->buf ? 0 : 1;
+}
+
+int
+sink_open_mem (sink *s, U32 capacity)
+{
+  if (sink_open_fd (s, -1, capacity))
+    return 1;
+
+  s->kind = SINK_MEMORY;
+  return 0;
+}
+
+void
+sink_write (sink *s, const char *data, U32 len)
+{
+  int n;
+
+  if (s->kind == SINK_MEMORY)
+    {
+      if (s->capacity - s->size < len && _sink_grow (s, len))
+        return;
+
+      memcpy (s->buf + s->size, data, len);
+      s->size += len;
+      return;
+    }
+
+  while (len > 0)
+    {
+      if (s->size == s->capacity && sink_flush (s))
+        return;
+
+      /* Large writes bypass the buffer once it is empty. */
+      if (s->size == 0 && len >= s->capacity)
+        {
+          n = write (s->fd, data, len);
+          if (n < 0)
+            {
+              if (errno == EINTR)
+                continue;
+              s->failed = 1;
+              return;
+            }
+        }
+      else
+        {
+          n = s->capacity - s->size < len ? s->capacity - s->size : len;
+          memcpy (s->buf + s->size, data, n);
+          s->size += n;
+        }
+
+      data += n;
+      len -= n;
+    }
+}
+
+void
+sink_puts (sink *s, const char *str)
+{
+  sink_write (s, str, strlen (str));
+}
+
+void
+sink_putch (sink *s, char ch)
+{
+  if (s->size < s->capacity)
+    s->buf[s->size++] = ch;
+  else
+    sink_write (s, &ch, 1);
+}
+
+int
+sink_flush (sink *s)
+{
+  U32 done = 0;
+  int n;
+
+  if (s->kind == SINK_MEMORY || s->failed)
+    return s->failed;
+
+  while (done < s->size)
+    {
+      n = write (s->fd, s->buf + done, s->size - done);
+      if (n < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          s->failed = 1;
+          return 1;
+        }
+      done += n;
+    }
+  s->size = 0;
+
+  return 0;
+}
+
+int
+sink_fold (sink *s)
+{
+  sink_flush (s);
+  free (s->buf);
+  s->buf = NULL;
+  s->size = 0;
+  s->capacity = 0;
+
+  return s->failed;
+}
+
+static int
+_sink_grow (sink *s, U32 needed)
+{
+  U32 capacity = s->capacity ? s->capacity : 64;
+  char *buf;
+
+  while (capacity - s->size < needed)
+    capacity *= 2;
+
+  buf = realloc (s->buf, capacity);
+  if (!buf)
+    {
+      s->failed = 1;
+      return 1;
+    }
+
+  s->buf = buf;
+  s->capacity = capacity;
+  return 0;
+}
@@ -0,0 +1,50 @@
+#ifndef SINK_H
+#define SINK_H
+
+#include "clomy.h"
+
+#ifndef SINK_CAPACITY
+#define SINK_CAPACITY (64 * 1024)
+#endif /* not SINK_CAPACITY */
+
+enum sink_kind
+{
+  SINK_FD = 0,
+  SINK_MEMORY
+};
+
+/* Buffered output.  A file descriptor sink (file, pipe, socket) never holds
+   more than its buffer capacity; a memory sink grows to fit everything
+   written and keeps it in BUF. */
+typedef struct sink
+{
+  char *buf;
+  U32 size;
+  U32 capacity;
+  int fd;
+  U8 kind;
+  U8 failed;
+} sink;
+
+/* Open sink writing to FD through a buffer of CAPACITY bytes. */
+int sink_open_fd (sink *s, int fd, U32 capacity);
+
+/* Open sink collecting output in memory, starting with CAPACITY bytes. */
+int sink_open_mem (sink *s, U32 capacity);
+
+/* Write LEN bytes of DATA. */
+void sink_write (sink *s, const char *data, U32 len);
+
+/* Write NUL terminated STR. */
+void sink_puts (sink *s, const char *str);
+
+/* Write single character CH. */
+void sink_putch (sink *s, char ch);
+
+/* Write buffered data to the file descriptor. */
+int sink_flush (sink *s);
+
+/* Flush and release the buffer.  Returns 1 if any write failed. */
+int sink_fold (sink *s);
+
+#endif /* not SINK_H */
@@ -0,0 +1,62 @@
+program Arrays;
+
+var
+  sq: integer[10];
+  half: real[5];
+  composite: boolean[40];
+  i: integer;
+  j: integer;
+  sum: integer;
+begin
+  i := 0;
+  while i < 10 do
+  begin
+    sq[i] := i * i;
+    i := i + 1;
+  end;
+
+  i := 9;
+  while i >= 0 do
+  begin
+    sum := sum + sq[i];
+    write(sq[i], ' ');
+    i := i - 1;
+  end;
+  writeln('sum ', sum, ' last ', sq[i + 10]);
+
+  i := 0;
+  while i < 5 do
+  begin
+    half[i] := i;
+    half[i] := half[i] / 2;
+    i := i + 1;
+  end;
+  writeln(half[0], ' ', half[3]:4:2, ' ', half[sq[2]]);
+
+  i := 2;
+  while i * i < 40 do
+  begin
+    if !composite[i] then
+    begin
+      j := i * i;
+      while j < 40 do
+      begin
+        composite[j] := true;
+        j := j + i;
+      end;
+    end;
+    i := i + 1;
+  end;
+
+  i := 2;
+  while i < 40 do
+  begin
+    if !composite[i] then
+      write(i, ' ');
+    i := i + 1;
+  end;
+  writeln('');
+
+  j := sum - 280;
+  writeln(sq[j], ' ', sq[sum / 100]);
+end.
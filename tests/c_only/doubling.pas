@@ -0,0 +1,79 @@
+program Doubling;
+{ Each routine calls the one before it twice, inlining them all takes
+  2^13 copies of the first. }
+var
+  n: integer;
+procedure pa;
+begin
+  n := n + 1;
+end;
+procedure pb;
+begin
+  pa;
+  pa;
+end;
+procedure pc;
+begin
+  pb;
+  pb;
+end;
+procedure pd;
+begin
+  pc;
+  pc;
+end;
+procedure pe;
+begin
+  pd;
+  pd;
+end;
+procedure pf;
+begin
+  pe;
+  pe;
+end;
+procedure pg;
+begin
+  pf;
+  pf;
+end;
+procedure ph;
+begin
+  pg;
+  pg;
+end;
+procedure pi;
+begin
+  ph;
+  ph;
+end;
+procedure pj;
+begin
+  pi;
+  pi;
+end;
+procedure pk;
+begin
+  pj;
+  pj;
+end;
+procedure pl;
+begin
+  pk;
+  pk;
+end;
+procedure pm;
+begin
+  pl;
+  pl;
+end;
+procedure pn;
+begin
+  pm;
+  pm;
+end;
+begin
+  n := 0;
+  pn;
+  writeln(n);
+end.
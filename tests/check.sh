@@ -0,0 +1,73 @@
+#!/bin/sh
+# Run every sample program through each backend and compare its output with
+# what the C backend produces at -O0, the C backend itself included at the
+# other levels, and check that every program in tests/errors/
+# is rejected and those in tests/c_only/ only build with the C backend.
+#
+# Usage: tests/check.sh [MPAS]
+
+MPAS=${1:-./mpas}
+TARGETS="c asm jit run pbc eval"
+LEVELS="-O0 -O1 -O2 -O3"
+
+tmp=$(mktemp -d) || exit 1
+trap 'rm -rf "$tmp"' EXIT
+
+fail=0
+for src in tests/*.pas examples/*.pas; do
+  if ! "$MPAS" "$src" -t c -o "$tmp/c" || ! "$tmp/c" > "$tmp/c.out"; then
+    echo "FAIL $src (c)"
+    fail=1
+    continue
+  fi
+
+  for target in $TARGETS; do
+    for level in $LEVELS; do
+      if [ "$target" = jit ] || [ "$target" = run ]; then
+        "$MPAS" "$src" -t "$target" "$level" > "$tmp/out"
+      elif [ "$target" = eval ]; then
+        "$MPAS" "$src" -t c -e "$level" -o "$tmp/prog" \
+          && "$tmp/prog" > "$tmp/out"
+      elif [ "$target" = pbc ]; then
+        "$MPAS" "$src" -t pbc "$level" -o "$tmp/prog.pbc" \
+          && "$MPAS" "$tmp/prog.pbc" > "$tmp/out"
+      else
+        "$MPAS" "$src" -t "$target" "$level" -o "$tmp/prog" \
+          && "$tmp/prog" > "$tmp/out"
+      fi
+      if [ $? = 0 ] && cmp -s "$tmp/c.out" "$tmp/out"; then
+        :
+      else
+        echo "FAIL $src ($target $level)"
+        fail=1
+      fi
+    done
+  done
+done
+
+# Rejected with a message and exit status 1, a crash is not a rejection.
+for src in tests/errors/*.pas; do
+  "$MPAS" "$src" -t ast > /dev/null 2> "$tmp/err"
+  status=$?
+  if [ "$status" != 1 ] || ! grep -q "^$src:" "$tmp/err"; then
+    echo "FAIL $src (status $status)"
+    fail=1
+  fi
+done
+
+# Too big once inlined, the backends that inline every call refuse them.
+for src in tests/c_only/*.pas; do
+  if ! "$MPAS" "$src" -t c -O3 -o "$tmp/c" || ! "$tmp/c" > /dev/null; then
+    echo "FAIL $src (c)"
+    fail=1
+  fi
+  "$MPAS" "$src" -t run > /dev/null 2> "$tmp/err"
+  status=$?
+  if [ "$status" != 1 ] || ! grep -q "^Error: Inlining" "$tmp/err"; then
+    echo "FAIL $src (run, status $status)"
+    fail=1
+  fi
+done
+
+[ "$fail" = 0 ] && echo "All targets match the C backend."
+exit "$fail"
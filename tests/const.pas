@@ -0,0 +1,46 @@
+program Consts;
+
+const
+  size = 10;
+  last = size;
+  step = -3;
+  ratio = 0.25;
+  name = 'const';
+  verbose = true;
+
+var
+  i: integer;
+var
+  total: integer;
+var
+  a: integer[size];
+var
+  r: real;
+
+{ A parameter may hide a constant. }
+function scale(size: integer): integer;
+begin
+  scale := size * 2;
+end;
+
+begin
+  for i := 0 to size - 1 do
+    a[i] := i * i;
+  total := 0;
+  for i := 0 to last - 1 do
+    total := total + a[i];
+  writeln(name, ' ', size, ' ', total, ' ', scale(4), ' ', size);
+
+  i := size;
+  while i > 0 do
+  begin
+    write(i, ' ');
+    i := i + step;
+  end;
+  writeln('');
+
+  r := size * ratio;
+  writeln(r, ' ', -ratio, ' ', step * step, ' ', verbose, ' ', !verbose);
+  if verbose then
+    writeln(name + '!', ' ', length(name), ' ', size / 4, ' ', size % 4);
+end.
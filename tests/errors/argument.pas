@@ -0,0 +1,11 @@
+program Argument;
+
+procedure show(s: string);
+begin
+  writeln(s);
+end;
+
+begin
+  { Value arguments must match their parameter too. }
+  show(1);
+end.
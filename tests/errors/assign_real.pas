@@ -0,0 +1,8 @@
+program AssignReal;
+
+var
+  i: integer;
+begin
+  { Reals are not truncated into integers. }
+  i := 2.5;
+end.
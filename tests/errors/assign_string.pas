@@ -0,0 +1,8 @@
+program AssignString;
+
+var
+  s: string;
+begin
+  { A number is not a string. }
+  s := 5;
+end.
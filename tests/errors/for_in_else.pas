@@ -0,0 +1,14 @@
+program ForInElse;
+
+var
+  i: integer;
+  j: integer;
+begin
+  { An error inside nested loops in a branch is reported, not a crash. }
+  if i = 0 then
+    writeln('zero')
+  else
+    for i := 1 to 3 do
+      for j := 1 to 3 do
+        i := j;
+end.
@@ -0,0 +1,12 @@
+program NestedFor;
+
+var
+  i: integer;
+  j: integer;
+begin
+  { The control variable of an enclosing loop cannot be reused. }
+  for i := 1 to 3 do
+    for j := 1 to 3 do
+      for i := 1 to 2 do
+        writeln(i, j);
+end.
@@ -0,0 +1,14 @@
+program StringFunction;
+
+var
+  s: string;
+
+{ Functions cannot return strings, a var parameter does. }
+function greeting: string;
+begin
+  greeting := 'hello';
+end;
+
+begin
+  s := greeting;
+end.
@@ -0,0 +1,92 @@
+program Eval;
+
+var
+  i: integer;
+var
+  n: integer;
+var
+  b: boolean;
+var
+  r: real;
+var
+  s: string;
+var
+  t: string;
+var
+  a: integer[16];
+
+function fact(n: integer): integer;
+var
+  i: integer;
+var
+  acc: integer;
+begin
+  acc := 1;
+  for i := 2 to n do
+    acc := acc * i;
+  fact := acc;
+end;
+
+function fib(n: integer): integer;
+var
+  a: integer;
+var
+  b: integer;
+begin
+  b := 1;
+  while n > 0 do
+  begin
+    b := a + b;
+    a := b - a;
+    n := n - 1;
+  end;
+  fib := a;
+end;
+
+procedure swap(var x: integer; var y: integer);
+var
+  t: integer;
+begin
+  t := x;
+  x := y;
+  y := t;
+end;
+
+procedure rev(s: string; var r: string);
+var
+  i: integer;
+begin
+  r := '';
+  for i := length(s) downto 1 do
+    r := r + copy(s, i, 1);
+end;
+
+begin
+  { Calls and var parameters. }
+  writeln(fact(20), ' ', fib(20));
+  for i := 0 to 15 do
+    a[i] := 15 - i;
+  for i := 0 to 7 do
+    swap(a[i], a[15 - i]);
+  for i := 0 to 15 do
+    write(a[i]:3);
+  writeln('');
+
+  { Strings, copy at and past either end. }
+  s := 'partial';
+  t := s + ' evaluation';
+  rev(t, s);
+  writeln(s, ' ', length(t), ' ', t < s, ' ', s < t);
+  s := 'partial';
+  writeln('[', copy(t, 0, 3), '|', copy(t, 9, 100), '|', copy(t, 19, 1),
+          '|', copy(t, 30, 2), '|', copy(t, 3, -1), ']');
+  writeln(s:10, '|', 'x':3, '|', 'tab\there':12);
+
+  { Numbers come out as the runtime writes them. }
+  n := -1234567;
+  writeln(n, ' ', n:12, ' ', n / 1000, ' ', n % 1000, ' ', n * n);
+  r := 1.0 / 3;
+  writeln(r, ' ', r:12:4, ' ', -r:0:0, ' ', 2.5:0:0, ' ', 3.5:0:0, ' ', r:n);
+  b := r > 0.25;
+  writeln(b, ' ', !b, ' ', 17 % -5, ' ', -17 / 5);
+end.
@@ -0,0 +1,60 @@
+program ForLoop;
+
+var
+  i: integer;
+var
+  j: integer;
+var
+  n: integer;
+var
+  sum: integer;
+var
+  a: integer[16];
+var
+  x: real[8];
+begin
+  for i := 1 to 5 do
+    write(i, ' ');
+  writeln('');
+
+  for i := 5 downto 1 do
+    write(i, ' ');
+  writeln('');
+
+  { The final value is read once. }
+  n := 3;
+  for i := 0 to n do
+  begin
+    n := n + 1;
+    write(i);
+  end;
+  writeln(' n=', n);
+
+  { Never runs. }
+  for i := 4 to 2 do
+    writeln('unreachable');
+
+  for i := 0 to 15 do
+    a[i] := i * i;
+  sum := 0;
+  for i := 15 downto 0 do
+    sum := sum + a[i];
+  writeln('sum ', sum);
+
+  for i := 0 to 7 do
+    x[i] := i / 2;
+  for i := 0 to 7 do
+    if i > 3 then
+      write(x[i]:4:1)
+    else
+      write(x[i]:4:2);
+  writeln('');
+
+  for i := 1 to 3 do
+    for j := i to 3 do
+    begin
+      write(i * j:3);
+      if j = 3 then
+        writeln('');
+    end;
+end.
@@ -0,0 +1,49 @@
+program ForBounds;
+
+var
+  n: integer;
+var
+  i: integer;
+var
+  c: integer;
+var
+  hi: integer;
+var
+  lo: integer;
+
+function next: integer;
+begin
+  n := n + 1;
+  next := n;
+end;
+
+begin
+  { The initial value is read before the final one. }
+  n := 0;
+  for i := next to next + 2 do
+    write(i, ' ');
+  writeln('');
+
+  { Loops ending on the largest and smallest integers stop there. }
+  hi := 1073741824;
+  hi := hi * hi;
+  hi := hi * 4;
+  lo := 0 - hi;
+  lo := lo + lo;
+  hi := lo + 1;
+  hi := 0 - hi;
+  c := 0;
+  for i := hi - 2 to hi do
+    c := c + 1;
+  writeln(c, ' ', hi - i);
+  c := 0;
+  for i := lo + 1 downto lo do
+    c := c + 1;
+  writeln(c, ' ', i - lo);
+
+  { A loop that never runs leaves its control variable alone. }
+  i := 7;
+  for i := 3 to 2 do
+    c := 100;
+  writeln(i, ' ', c);
+end.
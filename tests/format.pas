@@ -0,0 +1,30 @@
+program Format;
+
+var
+  n: integer;
+  w: integer;
+  d: integer;
+  x: real;
+  y: real;
+  s: string;
+begin
+  n := 42;
+  x := 0.1;
+  y := 2.675;
+  s := 'abc';
+  writeln('[', n:5, '|', n:1, '|', n:4:2, '|', 'lit':6, '|', s:5, '|', x:3:1, ']');
+  writeln(x, ' ', y, ' ', x:8, ' ', y:10:2, ' ', y:0:0);
+  x := 1.0 / 3.0;
+  writeln(x, ' ', x:0:20);
+  x := 123456789.0 * 987654321.0 * 100000000.0;
+  y := 0.0 - 0.00000015;
+  writeln(x, ' ', y, ' ', y:12:9);
+  w := 1;
+  d := 0;
+  while w < 12 do
+  begin
+    writeln(n:w, '|', x:w:d, '|', y:w:d, '|', s:w, '|', 'p':w);
+    w := w + 3;
+    d := d + 2;
+  end;
+end.
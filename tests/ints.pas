@@ -0,0 +1,23 @@
+program Ints;
+
+var
+  n: integer;
+  m: integer;
+  i: integer;
+begin
+  n := 1;
+  i := 0;
+  while i < 18 do
+  begin
+    m := n - 1;
+    writeln(n, ' ', m);
+    m := 0 - n;
+    writeln(m);
+    m := 1 - n;
+    writeln(m);
+    n := n * 10;
+    i := i + 1;
+  end;
+  m := n - 1;
+  writeln(n, ' ', m);
+end.
@@ -0,0 +1,34 @@
+program Nested;
+
+var
+  i: integer;
+  j: integer;
+  s: integer;
+  k: integer;
+  x: real;
+begin
+  i := 0;
+  s := 0;
+  k := 7;
+  x := 1.5;
+  while i < 5 do
+  begin
+    j := 0;
+    while j < i do
+    begin
+      s := s + k * 3;
+      if j > 1 then
+      begin
+        s := s - 1;
+      end;
+      if j < 2 then
+      begin
+        s := s + 2;
+      end;
+      j := j + 1;
+    end;
+    x := x * 2.0;
+    i := i + 1;
+  end;
+  writeln(s, ' ', x, ' ', i, ' ', j);
+end.
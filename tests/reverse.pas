@@ -0,0 +1,28 @@
+program Reverse;
+
+var
+  s: string;
+var
+  t: string;
+var
+  n: integer;
+
+begin
+  { Call results copied into loop variables. }
+  t := 'scratch';
+  s := '';
+  n := length(t);
+  while n > 0 do
+  begin
+    s := s + copy(t, n, 1);
+    n := n - 1;
+  end;
+  writeln(s, ' ', n);
+
+  while length(t) > 2 do
+  begin
+    write(t, ' ');
+    t := copy(t, 2, length(t));
+  end;
+  writeln(t);
+end.
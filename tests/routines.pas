@@ -0,0 +1,103 @@
+program Routines;
+
+var
+  i: integer;
+var
+  n: integer;
+var
+  total: integer;
+var
+  a: integer[8];
+var
+  s: string;
+var
+  r: real;
+
+procedure bump(var x: integer; by: integer);
+begin
+  x := x + by;
+end;
+
+function sq(n: integer): integer;
+begin
+  sq := n * n;
+end;
+
+function half(x: real): real;
+begin
+  half := x / 2;
+end;
+
+function big(n: integer): boolean;
+begin
+  big := n > 2;
+end;
+
+{ The local i hides the program's one. }
+function sum(var v: integer[8]; count: integer): integer;
+var
+  i: integer;
+var
+  acc: integer;
+begin
+  for i := 0 to count - 1 do
+    acc := acc + v[i];
+  sum := acc;
+end;
+
+procedure fill(var v: integer[8]; k: integer);
+var
+  j: integer;
+begin
+  for j := 0 to 7 do
+    v[j] := j * k;
+end;
+
+procedure greet(name: string);
+var
+  t: string;
+begin
+  t := 'hi ' + name;
+  name := 'x';
+  writeln(t, ' ', name);
+end;
+
+procedure twice(var x: integer);
+begin
+  bump(x, x);
+  bump(x, sq(2));
+end;
+
+begin
+  total := 0;
+  for i := 1 to 4 do
+    bump(total, sq(i));
+  writeln(total, ' ', sq(sq(3)));
+
+  fill(a, 3);
+  bump(a[2], 100);
+  i := 5;
+  twice(a[i - 4]);
+  writeln(a[1], ' ', a[2], ' ', a[7]);
+
+  { Locals start out as zero on every call. }
+  writeln(sum(a, 3), ' ', sum(a, 3), ' ', sum(a, 8));
+
+  n := 0;
+  while sq(n) < 50 do
+    n := n + 1;
+  writeln('n=', n);
+
+  for i := sq(1) to sq(2) do
+    if big(i) then
+      write(i, ' ');
+  writeln('');
+
+  r := half(half(5));
+  writeln(r:6:3);
+
+  s := 'bob';
+  greet(s);
+  greet('amy');
+  writeln(s);
+end.
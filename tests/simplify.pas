@@ -0,0 +1,72 @@
+program Simplify;
+
+var
+  i: integer;
+var
+  n: integer;
+var
+  m: integer;
+var
+  r: real;
+var
+  b: boolean;
+var
+  a: integer[8];
+var
+  s: string;
+begin
+  { Grouping, left to right, unary minus and mod. }
+  n := -5;
+  writeln(n, ' ', 3 - -2, ' ', 10 - 4 - 3, ' ', 64 / 4 / 2);
+  writeln((1 + 2) * 3, ' ', 2 * (n - 1), ' ', 17 % 5, ' ', -n * -n);
+  writeln(-(n - 1), ' ', 0 - (n + 1) * 2, ' ', n - (n - n));
+
+  { Right operands whose left end is negative. }
+  m := 4;
+  writeln(m - -11 % 7, ' ', m - -n * 2);
+  for i := 1 to m - -1 % 6 do
+    write(i, ' ');
+  writeln('');
+
+  { Literals fold. }
+  n := 2 * 3 + 7;
+  r := 1.5 * 4 - 0.25;
+  writeln(n, ' ', r:0:2, ' ', 7 / 2, ' ', -7 % 3, ' ', 7 / 2.0);
+  writeln(3 < 4, ' ', 2.5 = 2.5, ' ', 7 / 2.0 <= 3);
+
+  { Operands of no effect. }
+  m := 12;
+  writeln(m + 0, ' ', 0 + m, ' ', m - 0, ' ', m * 1, ' ', 1 * m, ' ', m / 1);
+  writeln(m * 0, ' ', 0 * m, ' ', m + 3 - 5, ' ', m - 3 + 3, ' ', m + 1 + 1);
+  r := -0.0;
+  writeln(r + 0, ' ', r - 0, ' ', r * 1.0);
+
+  { Powers of two, negative ones too. }
+  for i := -9 to 9 do
+    write(i * 4, ' ', 8 * i, ' ', i / 4, ' ', i % 4, ' ');
+  writeln('');
+  for i := 0 to 9 do
+    write(i / 4, ' ', i % 4, ' ');
+  writeln('');
+  s := 'twelve chars';
+  writeln(length(s) / 4, ' ', length(s) % 8, ' ', length(s) % 8 / 2);
+  for i := 0 to 7 do
+    a[i] := i * 16;
+  m := 0;
+  for i := 0 to 7 do
+    m := m + a[i] / 8 + a[i] % 32;
+  writeln(m);
+
+  { Booleans. }
+  b := m > 10;
+  writeln(b = true, ' ', b = false, ' ', b <> true, ' ', b <> false);
+  writeln(true = b, ' ', !!b, ' ', !(m < 10), ' ', !(b = false));
+  if 1 > 2 then
+    writeln('never')
+  else
+    writeln('folded');
+  if 2 > 1 then
+    writeln('always');
+  while 1 > 2 do
+    writeln('never');
+end.
@@ -0,0 +1,60 @@
+program Strings;
+var
+  s: string;
+  t: string[8];
+  n: integer;
+  k: integer;
+begin
+  s := 'hello';
+  t := s + ', world';
+  writeln(t, ' ', length(t));
+  if s = t then
+  begin
+    writeln('eq');
+  end
+  else
+  begin
+    writeln('ne');
+  end;
+  if copy(t, 1, 5) = 'hello' then
+  begin
+    writeln('prefix');
+  end
+  else
+  begin
+    writeln('no prefix');
+  end;
+  n := 0;
+  s := '';
+  while n < 40 do
+  begin
+    s := s + 'ab';
+    n := n + 1;
+  end;
+  writeln(s, ' ', length(s));
+  writeln(copy(t, 1, 5), '|', copy(t, 8, 100), '|', copy(t, 0, 2), '|', copy(t, 50, 2), '|');
+  writeln('abc' < 'abd', ' ', s > t, ' ', 'x' + 'y');
+  writeln(t:20, '|', copy(s, 3, 4):6, '|');
+  s := s + s;
+  writeln(length(s));
+  n := length('lit' + t) * 2;
+  writeln(n);
+  { A copy keeps its value when the string it came from grows. }
+  t := s;
+  s := s + '!';
+  writeln(length(s), ' ', length(t), ' ', copy(s, 160, 2), ' ', s > t);
+  s := '';
+  n := 0;
+  k := 0;
+  while n < 30000 do
+  begin
+    n := n + 1;
+    k := k + 1;
+    if k > 3 then
+    begin
+      k := 1;
+    end;
+    s := s + copy('xyz', k, 1);
+  end;
+  writeln(length(s), ' ', copy(s, 29998, 3));
+end.
@@ -0,0 +1,208 @@
+/* Compile programs on several threads at once.
+
+   Each program is compiled to C and to bytecode alone first, then all of
+   them together, one thread each, a few rounds over.  Every compilation
+   must give the same text as the one made alone.  The texts are kept in
+   the arena of the thread making them and handed to the program's own
+   arena before the thread ends, see clomy_arthread.
+
+   Usage: threads FILE...
+
+   Build with -fsanitize=thread to have the races reported as well. */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CLOMY_IMPLEMENTATION
+#include "../clomy.h"
+
+#include "../ast.h"
+#include "../bc.h"
+#include "../codegen.h"
+#include "../inline.h"
+#include "../ir.h"
+#include "../lexer.h"
+#include "../opt.h"
+#include "../range.h"
+#include "../simplify.h"
+#include "../sink.h"
+
+#ifndef THREADS_ROUNDS
+#define THREADS_ROUNDS 4
+#endif /* not THREADS_ROUNDS */
+
+typedef struct
+{
+  char *path;
+  arena ar;       /* Holds C and BC once the thread is done. */
+  const char *c;  /* What codegen wrote at -O2. */
+  const char *bc; /* What bc_dump wrote at -O2. */
+  int status;
+} job;
+
+/* Copy LEN bytes of DATA into the arena of the calling thread. */
+static const char *
+_keep (const char *data, size_t len)
+{
+  char *copy = aralloc (arthread (), len + 1);
+
+  memcpy (copy, data, len);
+  copy[len] = '\0';
+  return copy;
+}
+
+/* Parse and inline J->path with BUDGET, then give the tree to TO_C or
+   TO_BC.  Returns what it wrote, NULL when anything failed. */
+static const char *
+_compile (job *j, U32 budget, int to_c)
+{
+  lex lexer = { 0 };
+  ast tree = { 0 };
+  ast_node *root;
+  const char *text = NULL;
+
+  if (lex_init (&lexer, j->path) == 1)
+    return NULL;
+  tree.lexer = &lexer;
+  if (ast_init (&tree) == 1)
+    {
+      lex_fold (&lexer);
+      return NULL;
+    }
+  root = ast_parse (&tree);
+
+  if (root && !inline_calls (&tree, budget))
+    {
+      simplify (&tree);
+      range_check (root);
+
+      if (to_c)
+        {
+          cg cgctx = { 0 };
+          sink out;
+
+          if (sink_open_mem (&out, SINK_CAPACITY) == 0)
+            {
+              codegen (&cgctx, root, &out);
+              if (!out.failed)
+                text = _keep (out.buf, out.size);
+              sink_fold (&out);
+            }
+          codegen_fold (&cgctx);
+        }
+      else
+        {
+          ir_func fn = { 0 };
+          bc_prog prog = { 0 };
+          char *buf = NULL;
+          size_t len = 0;
+          FILE *out;
+
+          if (ir_init (&fn) == 0 && ir_lower (&fn, root) == 0)
+            {
+              opt_run (&fn, 2);
+              opt_leave_ssa (&fn);
+              if (bc_gen (&prog, &fn) == 0
+                  && (out = open_memstream (&buf, &len)))
+                {
+                  bc_dump (&prog, out);
+                  fclose (out);
+                  text = _keep (buf, len);
+                  free (buf);
+                }
+            }
+          bc_fold (&prog);
+          ir_fold (&fn);
+        }
+    }
+
+  ast_fold (&tree);
+  lex_fold (&lexer);
+  return text;
+}
+
+static void *
+_run (void *arg)
+{
+  job *j = arg;
+
+  j->c = _compile (j, INLINE_BUDGET (2), 1);
+  j->bc = _compile (j, INLINE_ALL, 0);
+  j->status = !j->c || !j->bc;
+
+  arhandoff (&j->ar, arthread ());
+  arthread_fold ();
+  return NULL;
+}
+
+int
+main (int argc, char **argv)
+{
+  int n = argc - 1, i, round, status = 0;
+  job *alone, *together;
+  pthread_t *threads;
+
+  if (n < 1)
+    {
+      fprintf (stderr, "Usage: %s FILE...\n", argv[0]);
+      return 2;
+    }
+
+  alone = calloc (n, sizeof (job));
+  together = calloc (n, sizeof (job));
+  threads = calloc (n, sizeof (pthread_t));
+  if (!alone || !together || !threads)
+    return 2;
+
+  for (i = 0; i < n; ++i)
+    {
+      alone[i].path = argv[i + 1];
+      _run (&alone[i]);
+      if (alone[i].status)
+        {
+          fprintf (stderr, "%s: Failed to compile.\n", alone[i].path);
+          status = 1;
+        }
+    }
+
+  for (round = 0; round < THREADS_ROUNDS && !status; ++round)
+    {
+      for (i = 0; i < n; ++i)
+        {
+          together[i].path = argv[i + 1];
+          if (pthread_create (&threads[i], NULL, _run, &together[i]))
+            {
+              fprintf (stderr, "Error: Failed to start a thread.\n");
+              return 2;
+            }
+        }
+
+      for (i = 0; i < n; ++i)
+        {
+          pthread_join (threads[i], NULL);
+          if (together[i].status || strcmp (together[i].c, alone[i].c)
+              || strcmp (together[i].bc, alone[i].bc))
+            {
+              fprintf (stderr, "%s: Differs when compiled on a thread.\n",
+                       together[i].path);
+              status = 1;
+            }
+          arfold (&together[i].ar);
+          memset (&together[i], 0, sizeof (job));
+        }
+    }
+
+  for (i = 0; i < n; ++i)
+    arfold (&alone[i].ar);
+  free (threads);
+  free (together);
+  free (alone);
+
+  if (!status)
+    printf ("%d programs compiled alike on %d threads.\n", n, n);
+  return status;
+}
@@ -0,0 +1,17 @@
+program Write;
+
+var
+  n: integer;
+  x: real;
+  s: string;
+begin
+  n := 42;
+  x := 2.5;
+  s := 'str';
+  writeln('n=', n, ', ', 'x=', x, ' 100%', ' s=', s);
+  write('\x4', '1', '|', '\101\t', '%i');
+  writeln();
+  write(n, x, s);
+  write();
+  writeln();
+end.
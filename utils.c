@@ -1,3 +1,5 @@
+#include <ctype.h>
+
 #include "utils.h"
 
 U8
@@ -12,3 +14,96 @@ streq (const char *a, const char *b)
     }
   return *a == *b;
 }
+
+U32
+unescape (char *dst, const char *src, U32 len)
+{
+  const char *end = src + len;
+  U32 n = 0, digits;
+  int ch;
+
+  while (src < end)
+    {
+      if (*src != '\\' || src + 1 == end)
+        {
+          dst[n++] = *src++;
+          continue;
+        }
+
+      ++src;
+      switch (*src)
+        {
+        case 'a':
+          ch = '\a';
+          break;
+        case 'b':
+          ch = '\b';
+          break;
+        case 'f':
+          ch = '\f';
+          break;
+        case 'n':
+          ch = '\n';
+          break;
+        case 'r':
+          ch = '\r';
+          break;
+        case 't':
+          ch = '\t';
+          break;
+        case 'v':
+          ch = '\v';
+          break;
+        case 'x':
+          for (ch = 0, ++src; src < end && isxdigit ((U8)*src); ++src)
+            ch = ch * 16 + (isdigit ((U8)*src) ? *src - '0'
+                                                : (*src | 0x20) - 'a' + 10);
+          dst[n++] = ch;
+          continue;
+        default:
+          if (*src >= '0' && *src <= '7')
+            {
+              for (ch = 0, digits = 0;
+                   digits < 3 && src < end && *src >= '0' && *src <= '7';
+                   ++digits)
+                ch = ch * 8 + *src++ - '0';
+              dst[n++] = ch;
+              continue;
+            }
+          ch = *src; /* \\, \', \" and \? */
+          break;
+        }
+      dst[n++] = ch;
+      ++src;
+    }
+
+  return n;
+}
+
+U32
+escape (char *dst, const char *src, U32 len)
+{
+  U32 i, n = 0;
+  U8 ch;
+
+  for (i = 0; i < len; ++i)
+    {
+      ch = src[i];
+      if (ch == '\\' || ch == '"')
+        {
+          dst[n++] = '\\';
+          dst[n++] = ch;
+        }
+      else if (isprint (ch))
+        dst[n++] = ch;
+      else
+        {
+          dst[n++] = '\\';
+          dst[n++] = '0' + (ch >> 6);
+          dst[n++] = '0' + (ch >> 3 & 7);
+          dst[n++] = '0' + (ch & 7);
+        }
+    }
+
+  return n;
+}
@@ -5,4 +5,15 @@
 /* Check if two string are equal. */
 U8 streq(const char *a, const char *b);
 
+/* Copy LEN bytes of SRC into DST resolving C escapes, the way the C
+   compiler reads string literals.  Returns the length written, DST needs
+   room for LEN bytes. */
+U32 unescape (char *dst, const char *src, U32 len);
+
+/* The reverse of unescape: copy LEN bytes of SRC into DST as the inside
+   of a C string literal, unprintable bytes as three digit octal escapes
+   so that literals can be pasted together safely.  Returns the length
+   written, DST needs room for 4 * LEN bytes. */
+U32 escape (char *dst, const char *src, U32 len);
+
 #endif /* not UTILS_H */
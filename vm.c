@@ -0,0 +1,282 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "runtime/libpascal.h"
+#include "vm.h"
+
+/* GCC and clang jump to the next handler straight from the end of the
+   previous one, everything else goes through a switch. */
+#if defined(__GNUC__) && !defined(VM_NO_COMPUTED_GOTO)
+#define VM_COMPUTED_GOTO
+#endif
+
+typedef union vm_value
+{
+  long i;
+  double f;
+  const char *s;
+  union vm_value *p;
+} vm_value;
+
+/* What string registers hold until they are set, an empty literal. */
+static const struct
+{
+  _P__p_hdr hdr;
+  char s[1];
+} _vm_empty = { { 0, 0 }, "" };
+
+#ifdef VM_COMPUTED_GOTO
+#define VM_CASE(op) L_##op:
+#define VM_DISPATCH() goto *labels[pc->op]
+#else
+#define VM_CASE(op) case op:
+#define VM_DISPATCH() continue
+#endif
+
+#define VM_NEXT()                                                             \
+  do                                                                          \
+    {                                                                         \
+      ++pc;                                                                   \
+      VM_DISPATCH ();                                                         \
+    }                                                                         \
+  while (0)
+
+#define VM_JUMP(to)                                                           \
+  do                                                                          \
+    {                                                                         \
+      pc = p->code + (to);                                                    \
+      VM_DISPATCH ();                                                         \
+    }                                                                         \
+  while (0)
+
+#define VM_BINARY(op, field, expr)                                            \
+  VM_CASE (op)                                                                \
+  {                                                                           \
+    r[pc->a].field = (expr);                                                  \
+    VM_NEXT ();                                                               \
+  }
+
+#define VM_COMPARE(op, field, cmp)                                            \
+  VM_BINARY (op, i, r[pc->b].field cmp r[pc->c].field)
+
+#define VM_BRANCH(op, field, cmp)                                             \
+  VM_CASE (op)                                                                \
+  {                                                                           \
+    if (r[pc->a].field cmp r[pc->b].field)                                    \
+      {                                                                       \
+        pc += (S16)pc->c;                                                     \
+        VM_DISPATCH ();                                                       \
+      }                                                                       \
+    VM_NEXT ();                                                               \
+  }
+
+int
+vm_run (const bc_prog *p)
+{
+  const bc_insn *pc = p->code;
+  vm_value *r;
+  U32 i;
+
+#ifdef VM_COMPUTED_GOTO
+  static const void *const labels[BC_OP_COUNT] = {
+    [BC_HALT] = &&L_BC_HALT,       [BC_MOV] = &&L_BC_MOV,
+    [BC_LOADI] = &&L_BC_LOADI,     [BC_LOADK] = &&L_BC_LOADK,
+    [BC_LOADS] = &&L_BC_LOADS,     [BC_ADD_I] = &&L_BC_ADD_I,
+    [BC_SUB_I] = &&L_BC_SUB_I,     [BC_MUL_I] = &&L_BC_MUL_I,
+    [BC_DIV_I] = &&L_BC_DIV_I,     [BC_MOD_I] = &&L_BC_MOD_I,
+    [BC_ADDK_I] = &&L_BC_ADDK_I,   [BC_NEG_I] = &&L_BC_NEG_I,
+    [BC_NOT] = &&L_BC_NOT,         [BC_ADD_F] = &&L_BC_ADD_F,
+    [BC_SUB_F] = &&L_BC_SUB_F,     [BC_MUL_F] = &&L_BC_MUL_F,
+    [BC_DIV_F] = &&L_BC_DIV_F,     [BC_NEG_F] = &&L_BC_NEG_F,
+    [BC_ITOF] = &&L_BC_ITOF,       [BC_LT_I] = &&L_BC_LT_I,
+    [BC_LE_I] = &&L_BC_LE_I,       [BC_GT_I] = &&L_BC_GT_I,
+    [BC_GE_I] = &&L_BC_GE_I,       [BC_EQ_I] = &&L_BC_EQ_I,
+    [BC_NE_I] = &&L_BC_NE_I,       [BC_LT_F] = &&L_BC_LT_F,
+    [BC_LE_F] = &&L_BC_LE_F,       [BC_GT_F] = &&L_BC_GT_F,
+    [BC_GE_F] = &&L_BC_GE_F,       [BC_EQ_F] = &&L_BC_EQ_F,
+    [BC_NE_F] = &&L_BC_NE_F,       [BC_JMP] = &&L_BC_JMP,
+    [BC_JT] = &&L_BC_JT,           [BC_JF] = &&L_BC_JF,
+    [BC_BLT_I] = &&L_BC_BLT_I,     [BC_BLE_I] = &&L_BC_BLE_I,
+    [BC_BGT_I] = &&L_BC_BGT_I,     [BC_BGE_I] = &&L_BC_BGE_I,
+    [BC_BEQ_I] = &&L_BC_BEQ_I,     [BC_BNE_I] = &&L_BC_BNE_I,
+    [BC_BLT_F] = &&L_BC_BLT_F,     [BC_BLE_F] = &&L_BC_BLE_F,
+    [BC_BGT_F] = &&L_BC_BGT_F,     [BC_BGE_F] = &&L_BC_BGE_F,
+    [BC_BEQ_F] = &&L_BC_BEQ_F,     [BC_BNE_F] = &&L_BC_BNE_F,
+    [BC_WRITE_I] = &&L_BC_WRITE_I, [BC_WRITE_F] = &&L_BC_WRITE_F,
+    [BC_WRITE_S] = &&L_BC_WRITE_S,   [BC_WRITE_IW] = &&L_BC_WRITE_IW,
+    [BC_WRITE_FW] = &&L_BC_WRITE_FW, [BC_WRITE_FX] = &&L_BC_WRITE_FX,
+    [BC_WRITE_SW] = &&L_BC_WRITE_SW, [BC_LEN_S] = &&L_BC_LEN_S,
+    [BC_CAT_S] = &&L_BC_CAT_S,       [BC_DROP_S] = &&L_BC_DROP_S,
+    [BC_TAKE_S] = &&L_BC_TAKE_S,     [BC_CMP_S] = &&L_BC_CMP_S,
+    [BC_DUP_S] = &&L_BC_DUP_S,       [BC_FREE_S] = &&L_BC_FREE_S,
+    [BC_APP_S] = &&L_BC_APP_S,
+    [BC_ARRAY] = &&L_BC_ARRAY,       [BC_BOUNDS] = &&L_BC_BOUNDS,
+    [BC_LOAD] = &&L_BC_LOAD,         [BC_STORE] = &&L_BC_STORE,
+  };
+#endif /* VM_COMPUTED_GOTO */
+
+  r = calloc (p->nregs ? p->nregs : 1, sizeof (vm_value));
+  if (!r)
+    {
+      fprintf (stderr, "Error: Out of memory for VM registers.\n");
+      return 1;
+    }
+  for (i = 0; i < p->nregs; ++i)
+    if (p->kinds[i] == BC_KIND_STR)
+      r[i].s = _vm_empty.s;
+
+#ifdef VM_COMPUTED_GOTO
+  VM_DISPATCH ();
+#else
+  for (;;)
+    switch (pc->op)
+#endif
+  {
+    VM_CASE (BC_HALT)
+    {
+      free (r);
+      _P__p_flush ();
+      return 0;
+    }
+    VM_CASE (BC_MOV)
+    {
+      r[pc->a] = r[pc->b];
+      VM_NEXT ();
+    }
+    VM_CASE (BC_LOADI)
+    {
+      r[pc->a].i = (S32)BC_WIDE (pc);
+      VM_NEXT ();
+    }
+    VM_CASE (BC_LOADK)
+    {
+      memcpy (&r[pc->a], &p->consts[BC_WIDE (pc)], sizeof (vm_value));
+      VM_NEXT ();
+    }
+    VM_CASE (BC_LOADS)
+    {
+      r[pc->a].s = p->strs + BC_WIDE (pc);
+      VM_NEXT ();
+    }
+    VM_BINARY (BC_ADD_I, i, r[pc->b].i + r[pc->c].i)
+    VM_BINARY (BC_SUB_I, i, r[pc->b].i - r[pc->c].i)
+    VM_BINARY (BC_MUL_I, i, r[pc->b].i * r[pc->c].i)
+    VM_BINARY (BC_DIV_I, i, r[pc->b].i / r[pc->c].i)
+    VM_BINARY (BC_MOD_I, i, r[pc->b].i % r[pc->c].i)
+    VM_BINARY (BC_ADDK_I, i, r[pc->b].i + (S16)pc->c)
+    VM_BINARY (BC_NEG_I, i, -r[pc->b].i)
+    VM_BINARY (BC_NOT, i, !r[pc->b].i)
+    VM_BINARY (BC_ADD_F, f, r[pc->b].f + r[pc->c].f)
+    VM_BINARY (BC_SUB_F, f, r[pc->b].f - r[pc->c].f)
+    VM_BINARY (BC_MUL_F, f, r[pc->b].f * r[pc->c].f)
+    VM_BINARY (BC_DIV_F, f, r[pc->b].f / r[pc->c].f)
+    VM_BINARY (BC_NEG_F, f, -r[pc->b].f)
+    VM_BINARY (BC_ITOF, f, (double)r[pc->b].i)
+    VM_COMPARE (BC_LT_I, i, <)
+    VM_COMPARE (BC_LE_I, i, <=)
+    VM_COMPARE (BC_GT_I, i, >)
+    VM_COMPARE (BC_GE_I, i, >=)
+    VM_COMPARE (BC_EQ_I, i, ==)
+    VM_COMPARE (BC_NE_I, i, !=)
+    VM_COMPARE (BC_LT_F, f, <)
+    VM_COMPARE (BC_LE_F, f, <=)
+    VM_COMPARE (BC_GT_F, f, >)
+    VM_COMPARE (BC_GE_F, f, >=)
+    VM_COMPARE (BC_EQ_F, f, ==)
+    VM_COMPARE (BC_NE_F, f, !=)
+    VM_CASE (BC_JMP)
+    {
+      VM_JUMP (BC_WIDE (pc));
+    }
+    VM_CASE (BC_JT)
+    {
+      if (r[pc->a].i)
+        VM_JUMP (BC_WIDE (pc));
+      VM_NEXT ();
+    }
+    VM_CASE (BC_JF)
+    {
+      if (!r[pc->a].i)
+        VM_JUMP (BC_WIDE (pc));
+      VM_NEXT ();
+    }
+    VM_BRANCH (BC_BLT_I, i, <)
+    VM_BRANCH (BC_BLE_I, i, <=)
+    VM_BRANCH (BC_BGT_I, i, >)
+    VM_BRANCH (BC_BGE_I, i, >=)
+    VM_BRANCH (BC_BEQ_I, i, ==)
+    VM_BRANCH (BC_BNE_I, i, !=)
+    VM_BRANCH (BC_BLT_F, f, <)
+    VM_BRANCH (BC_BLE_F, f, <=)
+    VM_BRANCH (BC_BGT_F, f, >)
+    VM_BRANCH (BC_BGE_F, f, >=)
+    VM_BRANCH (BC_BEQ_F, f, ==)
+    VM_BRANCH (BC_BNE_F, f, !=)
+    VM_CASE (BC_WRITE_I)
+    {
+      _P__p_write_int (r[pc->a].i);
+      VM_NEXT ();
+    }
+    VM_CASE (BC_WRITE_F)
+    {
+      _P__p_write_real (r[pc->a].f);
+      VM_NEXT ();
+    }
+    VM_CASE (BC_WRITE_S)
+    {
+      _P__p_write_str (r[pc->a].s);
+      VM_NEXT ();
+    }
+    VM_CASE (BC_WRITE_IW)
+    {
+      _P__p_write_int_w (r[pc->a].i, r[pc->b].i);
+      VM_NEXT ();
+    }
+    VM_CASE (BC_WRITE_FW)
+    {
+      _P__p_write_real_w (r[pc->a].f, r[pc->b].i);
+      VM_NEXT ();
+    }
+    VM_CASE (BC_WRITE_FX)
+    {
+      _P__p_write_fixed (r[pc->a].f, r[pc->b].i, r[pc->c].i);
+      VM_NEXT ();
+    }
+    VM_CASE (BC_WRITE_SW)
+    {
+      _P__p_write_str_w (r[pc->a].s, r[pc->b].i);
+      VM_NEXT ();
+    }
+    VM_BINARY (BC_LEN_S, i, _P__p_length (r[pc->b].s))
+    VM_BINARY (BC_CAT_S, s, _P__p_concat (r[pc->b].s, r[pc->c].s))
+    VM_BINARY (BC_DROP_S, s, _P__p_drop (r[pc->b].s, r[pc->c].i))
+    VM_BINARY (BC_TAKE_S, s, _P__p_take (r[pc->b].s, r[pc->c].i))
+    VM_BINARY (BC_CMP_S, i, _P__p_compare (r[pc->b].s, r[pc->c].s))
+    VM_BINARY (BC_DUP_S, s, _P__p_dup (r[pc->b].s))
+    VM_CASE (BC_FREE_S)
+    {
+      _P__p_free (r[pc->a].s);
+      VM_NEXT ();
+    }
+    VM_BINARY (BC_APP_S, s, _P__p_append (r[pc->b].s, r[pc->c].s))
+    VM_BINARY (BC_ARRAY, p, _P__p_array (r[pc->b].i))
+    VM_CASE (BC_BOUNDS)
+    {
+      _P__p_bounds (r[pc->a].i, r[pc->b].i);
+      VM_NEXT ();
+    }
+    VM_BINARY (BC_LOAD, i, r[pc->b].p[r[pc->c].i].i)
+    VM_CASE (BC_STORE)
+    {
+      r[pc->a].p[r[pc->b].i] = r[pc->c];
+      VM_NEXT ();
+    }
+#ifndef VM_COMPUTED_GOTO
+  default:
+    fprintf (stderr, "Error: Bad opcode %u in bytecode.\n", pc->op);
+    free (r);
+    return 1;
+#endif /* not VM_COMPUTED_GOTO */
+  }
+}
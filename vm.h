@@ -0,0 +1,11 @@
+#ifndef VM_H
+#define VM_H
+
+#include "bc.h"
+
+/* Run P on zeroed registers, writing through the libpascal functions
+   linked into mpas.  Stdout is flushed before returning.  Returns the
+   exit status of the program. */
+int vm_run (const bc_prog *p);
+
+#endif /* not VM_H */
@@ -0,0 +1,647 @@
+#include <limits.h>
+#include <stdint.h>
+
+#include "x86.h"
+#include "utils.h"
+
+typedef struct
+{
+  x86_func *xf;
+  ir_func *fn;
+  x86_block *bb;
+  U32 next; /* Number of the block laid out after BB. */
+} x86_select_ctx;
+
+static const U8 _x86_flags[X86_OP_COUNT] = {
+  [X86_MOV] = X86_F_WRITE_DST,
+  [X86_LEA] = X86_F_WRITE_DST | X86_F_DST_REG,
+  [X86_ADD] = X86_F_READ_DST | X86_F_WRITE_DST,
+  [X86_SUB] = X86_F_READ_DST | X86_F_WRITE_DST,
+  [X86_IMUL] = X86_F_READ_DST | X86_F_WRITE_DST | X86_F_DST_REG,
+  [X86_AND] = X86_F_READ_DST | X86_F_WRITE_DST,
+  [X86_OR] = X86_F_READ_DST | X86_F_WRITE_DST,
+  [X86_XOR] = X86_F_READ_DST | X86_F_WRITE_DST,
+  [X86_CMP] = X86_F_READ_DST,
+  [X86_NEG] = X86_F_READ_DST | X86_F_WRITE_DST,
+  [X86_IDIV] = X86_F_READ_DST,
+  [X86_SETCC] = X86_F_WRITE_DST | X86_F_DST_REG,
+  [X86_PUSH] = X86_F_READ_DST | X86_F_DST_REG,
+  [X86_POP] = X86_F_WRITE_DST | X86_F_DST_REG,
+  [X86_MOVSD] = X86_F_WRITE_DST,
+  [X86_MOVQ] = X86_F_WRITE_DST,
+  [X86_ADDSD] = X86_F_READ_DST | X86_F_WRITE_DST | X86_F_DST_REG,
+  [X86_SUBSD] = X86_F_READ_DST | X86_F_WRITE_DST | X86_F_DST_REG,
+  [X86_MULSD] = X86_F_READ_DST | X86_F_WRITE_DST | X86_F_DST_REG,
+  [X86_DIVSD] = X86_F_READ_DST | X86_F_WRITE_DST | X86_F_DST_REG,
+  [X86_UCOMISD] = X86_F_READ_DST | X86_F_DST_REG,
+  [X86_CVTSI2SD] = X86_F_WRITE_DST | X86_F_DST_REG,
+};
+
+/* Select instructions for IN at the end of CTX->bb. */
+static int _select_insn (x86_select_ctx *ctx, ir_insn *in);
+
+/* DST = A op B for a two-address OP. */
+static void _select_binary (x86_select_ctx *ctx, U8 op, U32 dst, U32 a,
+                            U32 b);
+
+/* DST = A cmp B as 0 or 1. */
+static void _select_compare (x86_select_ctx *ctx, U8 op, U32 dst, U32 a,
+                             U32 b);
+
+/* Address of element IDX of array BASE into RAX, for a load or store
+   through X86_MEM RAX. */
+static void _select_element (x86_select_ctx *ctx, U32 base, U32 idx);
+
+/* Move the arguments of call IN into place and call.  The CALL records
+   the registers it reads as a mask in its source operand. */
+static void _select_call (x86_select_ctx *ctx, ir_insn *in);
+
+/* Rewrite virtual register operands of IN to their locations. */
+static void _rewrite (x86_func *xf, x86_block *bb, x86_insn *in,
+                      U32 nsaved);
+
+/* Insert new instruction before or after POS in BB. */
+static x86_insn *_insert (x86_func *xf, x86_block *bb, x86_insn *pos,
+                          U8 after, U8 op, x86_opnd dst, x86_opnd src);
+
+U8
+x86_op_flags (U8 op)
+{
+  return _x86_flags[op];
+}
+
+x86_opnd
+x86_reg (U32 reg)
+{
+  x86_opnd o = { X86_REG, reg, 0 };
+  return o;
+}
+
+x86_opnd
+x86_imm (long imm)
+{
+  x86_opnd o = { X86_IMM, 0, imm };
+  return o;
+}
+
+x86_opnd
+x86_mem (U32 base, long disp)
+{
+  x86_opnd o = { X86_MEM, base, disp };
+  return o;
+}
+
+static x86_opnd
+_opnd (U8 kind, long imm)
+{
+  x86_opnd o = { 0 };
+
+  o.kind = kind;
+  o.imm = imm;
+  return o;
+}
+
+U32
+x86_new_vreg (x86_func *xf, U8 xmm)
+{
+  x86_vreg v = { X86_VREG, 0, xmm };
+
+  daappend (&xf->vregs, &v);
+  return X86_VREG + xf->vregs.size - 1;
+}
+
+x86_vreg *
+x86_vreg_get (x86_func *xf, U32 reg)
+{
+  return dageti (&xf->vregs, reg - X86_VREG);
+}
+
+x86_block *
+x86_block_get (x86_func *xf, U32 i)
+{
+  return dageti (&xf->blocks, i);
+}
+
+x86_insn *
+x86_emit (x86_func *xf, x86_block *bb, U8 op, x86_opnd dst, x86_opnd src)
+{
+  x86_insn *in = aralloc (&xf->ar, sizeof (x86_insn));
+
+  in->op = op;
+  in->cc = 0;
+  in->dst = dst;
+  in->src = src;
+  in->next = NULL;
+  in->prev = bb->tail;
+  if (bb->tail)
+    bb->tail->next = in;
+  else
+    bb->head = in;
+  bb->tail = in;
+
+  return in;
+}
+
+static x86_insn *
+_insert (x86_func *xf, x86_block *bb, x86_insn *pos, U8 after, U8 op,
+         x86_opnd dst, x86_opnd src)
+{
+  x86_insn *in = aralloc (&xf->ar, sizeof (x86_insn));
+
+  in->op = op;
+  in->cc = 0;
+  in->dst = dst;
+  in->src = src;
+  if (after)
+    {
+      in->prev = pos;
+      in->next = pos->next;
+      if (pos->next)
+        pos->next->prev = in;
+      else
+        bb->tail = in;
+      pos->next = in;
+    }
+  else
+    {
+      in->next = pos;
+      in->prev = pos->prev;
+      if (pos->prev)
+        pos->prev->next = in;
+      else
+        bb->head = in;
+      pos->prev = in;
+    }
+
+  return in;
+}
+
+// [ Instruction selection ] {{{
+int
+x86_select (x86_func *xf, ir_func *fn)
+{
+  x86_select_ctx ctx;
+  x86_block empty = { 0 };
+  ir_block *bb;
+  ir_insn *in;
+  U32 i, j;
+
+  if (dainit (&xf->blocks, &xf->ar, sizeof (x86_block), fn->blocks.size)
+      || dainit (&xf->strs, &xf->ar, sizeof (string *), 16)
+      || dainit (&xf->vregs, &xf->ar, sizeof (x86_vreg), fn->vregs.size))
+    return 1;
+  xf->slots = 0;
+  xf->saved = 0;
+
+  for (i = 0; i < fn->vregs.size; ++i)
+    x86_new_vreg (xf, ir_vreg_get (fn, i)->type == IR_REAL);
+
+  for (i = 0; i < fn->blocks.size; ++i)
+    {
+      bb = ir_block_get (fn, i);
+      empty.nsucc = bb->succs.size;
+      for (j = 0; j < bb->succs.size; ++j)
+        empty.succ[j] = (*(ir_block **)dageti (&bb->succs, j))->rpo;
+      empty.loop_depth = bb->loop_depth;
+      daappend (&xf->blocks, &empty);
+    }
+
+  ctx.xf = xf;
+  ctx.fn = fn;
+  for (i = 0; i < fn->blocks.size; ++i)
+    {
+      ctx.bb = x86_block_get (xf, i);
+      ctx.next = i + 1;
+      for (in = ir_block_get (fn, i)->head; in; in = in->next)
+        if (_select_insn (&ctx, in))
+          return 1;
+    }
+
+  return 0;
+}
+
+static int
+_select_insn (x86_select_ctx *ctx, ir_insn *in)
+{
+  x86_func *xf = ctx->xf;
+  x86_block *bb = ctx->bb;
+  U32 d = X86_VREG + in->dst, a = X86_VREG + in->a, b = X86_VREG + in->b;
+  U32 t, t2, idx;
+  U8 real = in->type == IR_REAL;
+  long bits;
+
+  switch (in->op)
+    {
+    case IR_NOP:
+      break;
+    case IR_CONST:
+      if (in->type == IR_STR)
+        {
+          idx = xf->strs.size;
+          daappend (&xf->strs, &in->imm.s);
+          x86_emit (xf, bb, X86_LEA, x86_reg (d), _opnd (X86_STR, idx));
+        }
+      else if (real)
+        {
+          memcpy (&bits, &in->imm.f, sizeof (bits));
+          t = x86_new_vreg (xf, 0);
+          x86_emit (xf, bb, X86_MOV, x86_reg (t), x86_imm (bits));
+          x86_emit (xf, bb, X86_MOVQ, x86_reg (d), x86_reg (t));
+        }
+      else
+        x86_emit (xf, bb, X86_MOV, x86_reg (d), x86_imm (in->imm.i));
+      break;
+    case IR_MOV:
+      if (d != a)
+        x86_emit (xf, bb, real ? X86_MOVSD : X86_MOV, x86_reg (d),
+                  x86_reg (a));
+      break;
+    case IR_ADD:
+      _select_binary (ctx, real ? X86_ADDSD : X86_ADD, d, a, b);
+      break;
+    case IR_SUB:
+      _select_binary (ctx, real ? X86_SUBSD : X86_SUB, d, a, b);
+      break;
+    case IR_MUL:
+      _select_binary (ctx, real ? X86_MULSD : X86_IMUL, d, a, b);
+      break;
+    case IR_DIV:
+    case IR_MOD:
+      if (real && in->op == IR_DIV)
+        {
+          _select_binary (ctx, X86_DIVSD, d, a, b);
+          break;
+        }
+      if (real)
+        {
+          fprintf (stderr, "Error: Real modulo is not supported.\n");
+          return 1;
+        }
+      x86_emit (xf, bb, X86_MOV, x86_reg (X86_RAX), x86_reg (a));
+      x86_emit (xf, bb, X86_CQO, x86_reg (X86_RDX), x86_reg (X86_RAX));
+      x86_emit (xf, bb, X86_IDIV, x86_reg (b), x86_reg (X86_RAX));
+      x86_emit (xf, bb, X86_MOV, x86_reg (d),
+                x86_reg (in->op == IR_DIV ? X86_RAX : X86_RDX));
+      break;
+    case IR_NEG:
+      if (!real)
+        {
+          if (d != a)
+            x86_emit (xf, bb, X86_MOV, x86_reg (d), x86_reg (a));
+          x86_emit (xf, bb, X86_NEG, x86_reg (d), _opnd (0, 0));
+          break;
+        }
+      /* Flip the sign bit, -0.0 included. */
+      t = x86_new_vreg (xf, 0);
+      t2 = x86_new_vreg (xf, 0);
+      x86_emit (xf, bb, X86_MOVQ, x86_reg (t), x86_reg (a));
+      x86_emit (xf, bb, X86_MOV, x86_reg (t2), x86_imm (LONG_MIN));
+      x86_emit (xf, bb, X86_XOR, x86_reg (t), x86_reg (t2));
+      x86_emit (xf, bb, X86_MOVQ, x86_reg (d), x86_reg (t));
+      break;
+    case IR_NOT:
+      if (d != a)
+        x86_emit (xf, bb, X86_MOV, x86_reg (d), x86_reg (a));
+      x86_emit (xf, bb, X86_XOR, x86_reg (d), x86_imm (1));
+      break;
+    case IR_LT:
+    case IR_LE:
+    case IR_GT:
+    case IR_GE:
+    case IR_EQ:
+    case IR_NE:
+      _select_compare (ctx, in->op, d, a, b);
+      break;
+    case IR_ITOF:
+      x86_emit (xf, bb, X86_CVTSI2SD, x86_reg (d), x86_reg (a));
+      break;
+    case IR_LOAD:
+      _select_element (ctx, a, b);
+      x86_emit (xf, bb, real ? X86_MOVSD : X86_MOV, x86_reg (d),
+                x86_mem (X86_RAX, 0));
+      break;
+    case IR_STORE:
+      _select_element (ctx, a, b);
+      x86_emit (xf, bb, real ? X86_MOVSD : X86_MOV, x86_mem (X86_RAX, 0),
+                x86_reg (X86_VREG + in->args[0]));
+      break;
+    case IR_CALL:
+      _select_call (ctx, in);
+      break;
+    case IR_JMP:
+      if (in->t->rpo != ctx->next)
+        x86_emit (xf, bb, X86_JMP, _opnd (X86_BLOCK, in->t->rpo),
+                  _opnd (0, 0));
+      break;
+    case IR_BR:
+      x86_emit (xf, bb, X86_CMP, x86_reg (a), x86_imm (0));
+      if (in->t->rpo == ctx->next)
+        x86_emit (xf, bb, X86_JCC, _opnd (X86_BLOCK, in->f->rpo),
+                  _opnd (0, 0))
+            ->cc
+            = X86_CC_E;
+      else
+        {
+          x86_emit (xf, bb, X86_JCC, _opnd (X86_BLOCK, in->t->rpo),
+                    _opnd (0, 0))
+              ->cc
+              = X86_CC_NE;
+          if (in->f->rpo != ctx->next)
+            x86_emit (xf, bb, X86_JMP, _opnd (X86_BLOCK, in->f->rpo),
+                      _opnd (0, 0));
+        }
+      break;
+    case IR_RET:
+      x86_emit (xf, bb, X86_MOV, x86_reg (X86_RAX), x86_imm (0));
+      x86_emit (xf, bb, X86_RET, _opnd (0, 0), _opnd (0, 0));
+      break;
+    default:
+      fprintf (stderr, "Error: Unexpected \"%s\" in native code.\n",
+               ir_op_name (in->op));
+      return 1;
+    }
+
+  return 0;
+}
+
+static void
+_select_binary (x86_select_ctx *ctx, U8 op, U32 dst, U32 a, U32 b)
+{
+  x86_func *xf = ctx->xf;
+  U8 xmm = x86_vreg_get (xf, dst)->xmm, mov = xmm ? X86_MOVSD : X86_MOV;
+  U32 t;
+
+  if (dst == b && dst != a)
+    {
+      if (op == X86_ADD || op == X86_IMUL || op == X86_ADDSD
+          || op == X86_MULSD)
+        {
+          x86_emit (xf, ctx->bb, op, x86_reg (dst), x86_reg (a));
+          return;
+        }
+      t = x86_new_vreg (xf, xmm);
+      x86_emit (xf, ctx->bb, mov, x86_reg (t), x86_reg (a));
+      x86_emit (xf, ctx->bb, op, x86_reg (t), x86_reg (b));
+      x86_emit (xf, ctx->bb, mov, x86_reg (dst), x86_reg (t));
+      return;
+    }
+
+  if (dst != a)
+    x86_emit (xf, ctx->bb, mov, x86_reg (dst), x86_reg (a));
+  x86_emit (xf, ctx->bb, op, x86_reg (dst), x86_reg (b));
+}
+
+static void
+_select_element (x86_select_ctx *ctx, U32 base, U32 idx)
+{
+  x86_func *xf = ctx->xf;
+
+  x86_emit (xf, ctx->bb, X86_MOV, x86_reg (X86_RAX), x86_reg (idx));
+  x86_emit (xf, ctx->bb, X86_IMUL, x86_reg (X86_RAX), x86_imm (8));
+  x86_emit (xf, ctx->bb, X86_ADD, x86_reg (X86_RAX), x86_reg (base));
+}
+
+static void
+_select_call (x86_select_ctx *ctx, ir_insn *in)
+{
+  static const U32 int_regs[] = { X86_RDI, X86_RSI, X86_RDX };
+  x86_func *xf = ctx->xf;
+  x86_block *bb = ctx->bb;
+  U32 i, reg, nint = 0, nxmm = 0;
+  long used = 0;
+
+  for (i = 0; i < in->nargs; ++i)
+    {
+      if (ir_vreg_get (ctx->fn, in->args[i])->type == IR_REAL)
+        {
+          reg = X86_XMM0 + nxmm++;
+          x86_emit (xf, bb, X86_MOVSD, x86_reg (reg),
+                    x86_reg (X86_VREG + in->args[i]));
+        }
+      else
+        {
+          reg = int_regs[nint++];
+          x86_emit (xf, bb, X86_MOV, x86_reg (reg),
+                    x86_reg (X86_VREG + in->args[i]));
+        }
+      used |= 1L << reg;
+    }
+  x86_emit (xf, bb, X86_CALL, _opnd (X86_SYM, in->callee),
+            _opnd (X86_NONE, used));
+  if (in->dst != IR_NONE)
+    x86_emit (xf, bb, X86_MOV, x86_reg (X86_VREG + in->dst),
+              x86_reg (X86_RAX));
+}
+
+static void
+_select_compare (x86_select_ctx *ctx, U8 op, U32 dst, U32 a, U32 b)
+{
+  static const U8 int_cc[] = { [IR_LT] = X86_CC_L, [IR_LE] = X86_CC_LE,
+                               [IR_GT] = X86_CC_G, [IR_GE] = X86_CC_GE,
+                               [IR_EQ] = X86_CC_E, [IR_NE] = X86_CC_NE };
+  x86_func *xf = ctx->xf;
+  x86_block *bb = ctx->bb;
+  U32 t;
+
+  if (!x86_vreg_get (xf, a)->xmm)
+    {
+      x86_emit (xf, bb, X86_CMP, x86_reg (a), x86_reg (b));
+      x86_emit (xf, bb, X86_SETCC, x86_reg (dst), _opnd (0, 0))->cc
+          = int_cc[op];
+      return;
+    }
+
+  /* Unordered operands set ZF, PF and CF, so only "above" conditions and
+     equality checked together with parity give C results for NaN. */
+  switch (op)
+    {
+    case IR_LT:
+    case IR_LE:
+      x86_emit (xf, bb, X86_UCOMISD, x86_reg (b), x86_reg (a));
+      x86_emit (xf, bb, X86_SETCC, x86_reg (dst), _opnd (0, 0))->cc
+          = op == IR_LT ? X86_CC_A : X86_CC_AE;
+      break;
+    case IR_GT:
+    case IR_GE:
+      x86_emit (xf, bb, X86_UCOMISD, x86_reg (a), x86_reg (b));
+      x86_emit (xf, bb, X86_SETCC, x86_reg (dst), _opnd (0, 0))->cc
+          = op == IR_GT ? X86_CC_A : X86_CC_AE;
+      break;
+    default:
+      t = x86_new_vreg (xf, 0);
+      x86_emit (xf, bb, X86_UCOMISD, x86_reg (a), x86_reg (b));
+      x86_emit (xf, bb, X86_SETCC, x86_reg (dst), _opnd (0, 0))->cc
+          = op == IR_EQ ? X86_CC_E : X86_CC_NE;
+      x86_emit (xf, bb, X86_SETCC, x86_reg (t), _opnd (0, 0))->cc
+          = op == IR_EQ ? X86_CC_NP : X86_CC_P;
+      x86_emit (xf, bb, op == IR_EQ ? X86_AND : X86_OR, x86_reg (dst),
+                x86_reg (t));
+      break;
+    }
+}
+// }}}
+// [ Frame ] {{{
+void
+x86_spill_all (x86_func *xf)
+{
+  x86_vreg *v;
+  U32 i;
+
+  for (i = 0; i < xf->vregs.size; ++i)
+    {
+      v = dageti (&xf->vregs, i);
+      v->loc = X86_VREG;
+      v->slot = xf->slots++;
+    }
+}
+
+void
+x86_finish (x86_func *xf)
+{
+  x86_block *bb;
+  x86_insn *in, *next, *pos;
+  U32 i, r, nsaved = 0, frame;
+
+  for (r = 0; r < X86_VREG; ++r)
+    if (xf->saved & (1u << r))
+      ++nsaved;
+
+  for (i = 0; i < xf->blocks.size; ++i)
+    {
+      bb = x86_block_get (xf, i);
+      for (in = bb->head; in; in = next)
+        {
+          next = in->next;
+          _rewrite (xf, bb, in, nsaved);
+        }
+
+      /* Drop copies the allocator made redundant. */
+      for (in = bb->head; in; in = next)
+        {
+          next = in->next;
+          if ((in->op == X86_MOV || in->op == X86_MOVSD)
+              && in->dst.kind == X86_REG && in->src.kind == X86_REG
+              && in->dst.reg == in->src.reg)
+            {
+              if (in->prev)
+                in->prev->next = in->next;
+              else
+                bb->head = in->next;
+              if (in->next)
+                in->next->prev = in->prev;
+              else
+                bb->tail = in->prev;
+            }
+        }
+    }
+
+  /* Keep the stack 16 byte aligned for calls. */
+  frame = xf->slots * 8;
+  if ((frame + nsaved * 8) % 16)
+    frame += 8;
+
+  /* Prologue. */
+  bb = x86_block_get (xf, 0);
+  if (bb->head)
+    pos = _insert (xf, bb, bb->head, 0, X86_PUSH, x86_reg (X86_RBP),
+                   _opnd (0, 0));
+  else
+    pos = x86_emit (xf, bb, X86_PUSH, x86_reg (X86_RBP), _opnd (0, 0));
+  pos = _insert (xf, bb, pos, 1, X86_MOV, x86_reg (X86_RBP),
+                 x86_reg (X86_RSP));
+  for (r = 0; r < X86_VREG; ++r)
+    if (xf->saved & (1u << r))
+      pos = _insert (xf, bb, pos, 1, X86_PUSH, x86_reg (r), _opnd (0, 0));
+  if (frame)
+    _insert (xf, bb, pos, 1, X86_SUB, x86_reg (X86_RSP), x86_imm (frame));
+
+  /* Epilogues. */
+  for (i = 0; i < xf->blocks.size; ++i)
+    {
+      bb = x86_block_get (xf, i);
+      for (in = bb->head; in; in = in->next)
+        {
+          if (in->op != X86_RET)
+            continue;
+          pos = _insert (xf, bb, in, 0, X86_LEA, x86_reg (X86_RSP),
+                         x86_mem (X86_RBP, -(long)nsaved * 8));
+          for (r = X86_VREG; r > 0; --r)
+            if (xf->saved & (1u << (r - 1)))
+              pos = _insert (xf, bb, pos, 1, X86_POP, x86_reg (r - 1),
+                             _opnd (0, 0));
+          _insert (xf, bb, pos, 1, X86_POP, x86_reg (X86_RBP), _opnd (0, 0));
+        }
+    }
+}
+
+static x86_opnd
+_slot (x86_func *xf, U32 reg, U32 nsaved)
+{
+  return x86_mem (X86_RBP,
+                  -(long)(nsaved + x86_vreg_get (xf, reg)->slot + 1) * 8);
+}
+
+static void
+_rewrite (x86_func *xf, x86_block *bb, x86_insn *in, U32 nsaved)
+{
+  x86_vreg *v;
+  x86_opnd mem;
+  U32 scratch;
+  U8 flags = _x86_flags[in->op], big;
+
+  if (in->dst.kind == X86_REG && in->dst.reg >= X86_VREG)
+    {
+      v = x86_vreg_get (xf, in->dst.reg);
+      if (v->loc < X86_VREG)
+        in->dst.reg = v->loc;
+      else
+        {
+          mem = _slot (xf, in->dst.reg, nsaved);
+          big = in->src.kind == X86_IMM
+                && (in->src.imm < INT32_MIN || in->src.imm > INT32_MAX);
+          if ((flags & X86_F_DST_REG) || big
+              || in->src.kind == X86_MEM)
+            {
+              scratch = v->xmm ? X86_XSCRATCH_DST : X86_SCRATCH_DST;
+              if (flags & X86_F_READ_DST)
+                _insert (xf, bb, in, 0, v->xmm ? X86_MOVSD : X86_MOV,
+                         x86_reg (scratch), mem);
+              if (flags & X86_F_WRITE_DST)
+                _insert (xf, bb, in, 1, v->xmm ? X86_MOVSD : X86_MOV, mem,
+                         x86_reg (scratch));
+              in->dst = x86_reg (scratch);
+            }
+          else
+            in->dst = mem;
+        }
+    }
+
+  if (in->src.kind == X86_REG && in->src.reg >= X86_VREG)
+    {
+      v = x86_vreg_get (xf, in->src.reg);
+      if (v->loc < X86_VREG)
+        in->src.reg = v->loc;
+      else
+        {
+          mem = _slot (xf, in->src.reg, nsaved);
+          if ((flags & X86_F_SRC_REG) || in->dst.kind == X86_MEM)
+            {
+              scratch = v->xmm ? X86_XSCRATCH_SRC : X86_SCRATCH_SRC;
+              _insert (xf, bb, in, 0, v->xmm ? X86_MOVSD : X86_MOV,
+                       x86_reg (scratch), mem);
+              in->src = x86_reg (scratch);
+            }
+          else
+            in->src = mem;
+        }
+    }
+}
+// }}}
+
+void
+x86_fold (x86_func *xf)
+{
+  arfold (&xf->ar);
+}
+
+// vim:fdm=marker:
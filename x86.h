@@ -0,0 +1,187 @@
+#ifndef X86_H
+#define X86_H
+
+#include "ir.h"
+
+/* Registers in encoding order, the SSE registers follow the general purpose
+   ones.  Numbers from X86_VREG on are virtual registers. */
+enum x86_reg
+{
+  X86_RAX = 0,
+  X86_RCX,
+  X86_RDX,
+  X86_RBX,
+  X86_RSP,
+  X86_RBP,
+  X86_RSI,
+  X86_RDI,
+  X86_R8,
+  X86_R9,
+  X86_R10,
+  X86_R11,
+  X86_R12,
+  X86_R13,
+  X86_R14,
+  X86_R15,
+  X86_XMM0,
+  X86_XMM15 = X86_XMM0 + 15,
+  X86_VREG
+};
+
+#define X86_IS_XMM(r) ((r) >= X86_XMM0 && (r) <= X86_XMM15)
+
+/* Reload spilled operands, never handed out by the allocator. */
+#define X86_SCRATCH_DST X86_R11
+#define X86_SCRATCH_SRC X86_R10
+#define X86_XSCRATCH_DST X86_XMM15
+#define X86_XSCRATCH_SRC (X86_XMM0 + 14)
+
+/* Condition codes in encoding order. */
+enum x86_cc
+{
+  X86_CC_O = 0,
+  X86_CC_NO,
+  X86_CC_B,
+  X86_CC_AE,
+  X86_CC_E,
+  X86_CC_NE,
+  X86_CC_BE,
+  X86_CC_A,
+  X86_CC_S,
+  X86_CC_NS,
+  X86_CC_P,
+  X86_CC_NP,
+  X86_CC_L,
+  X86_CC_GE,
+  X86_CC_LE,
+  X86_CC_G
+};
+
+enum x86_opnd_kind
+{
+  X86_NONE = 0,
+  X86_REG,   /* reg */
+  X86_IMM,   /* imm */
+  X86_MEM,   /* imm(reg) */
+  X86_BLOCK, /* block number imm */
+  X86_SYM,   /* enum ir_runtime imm */
+  X86_STR    /* address of string constant imm */
+};
+
+typedef struct x86_opnd
+{
+  U8 kind;
+  U32 reg;
+  long imm;
+} x86_opnd;
+
+/* All operations work on 64 bits.  Operands are written Intel style, DST
+   first. */
+enum x86_op
+{
+  X86_MOV = 0,
+  X86_LEA,
+  X86_ADD,
+  X86_SUB,
+  X86_IMUL,
+  X86_AND,
+  X86_OR,
+  X86_XOR,
+  X86_CMP,
+  X86_NEG,
+  X86_CQO,  /* rdx:rax = sign extended rax */
+  X86_IDIV, /* rax, rdx = rdx:rax / dst, rdx:rax % dst */
+  X86_SETCC,
+  X86_JMP,
+  X86_JCC,
+  X86_CALL, /* dst symbol, src.imm bit mask of argument registers */
+  X86_RET,
+  X86_PUSH,
+  X86_POP,
+  X86_MOVSD,
+  X86_MOVQ, /* between general purpose and SSE registers */
+  X86_ADDSD,
+  X86_SUBSD,
+  X86_MULSD,
+  X86_DIVSD,
+  X86_UCOMISD,
+  X86_CVTSI2SD,
+  X86_OP_COUNT
+};
+
+/* What an operation does with its operands. */
+#define X86_F_READ_DST (1 << 0)
+#define X86_F_WRITE_DST (1 << 1)
+#define X86_F_DST_REG (1 << 2) /* DST can't be memory. */
+#define X86_F_SRC_REG (1 << 3) /* SRC can't be memory. */
+
+typedef struct x86_insn
+{
+  struct x86_insn *prev, *next;
+  x86_opnd dst, src;
+  U8 op;
+  U8 cc;
+} x86_insn;
+
+typedef struct x86_block
+{
+  x86_insn *head, *tail;
+  U32 succ[2];
+  U8 nsucc;
+  U32 loop_depth;
+} x86_block;
+
+typedef struct x86_vreg
+{
+  U32 loc;  /* Assigned register, or X86_VREG when spilled. */
+  U32 slot; /* Spill slot. */
+  U8 xmm;
+} x86_vreg;
+
+typedef struct x86_func
+{
+  arena ar;
+  da blocks; /* x86_block, in layout order */
+  da strs;   /* string *, IR_STR constants */
+  da vregs;  /* x86_vreg, index is register - X86_VREG */
+  U32 slots; /* Spill slots in use. */
+  U32 saved; /* Callee-saved registers used, bit per register. */
+} x86_func;
+
+/* Flags of operation OP. */
+U8 x86_op_flags (U8 op);
+
+/* Operand constructors. */
+x86_opnd x86_reg (U32 reg);
+x86_opnd x86_imm (long imm);
+x86_opnd x86_mem (U32 base, long disp);
+
+/* Create new virtual register, an SSE one if XMM. */
+U32 x86_new_vreg (x86_func *xf, U8 xmm);
+
+/* Get virtual register REG. */
+x86_vreg *x86_vreg_get (x86_func *xf, U32 reg);
+
+/* Get Ith block. */
+x86_block *x86_block_get (x86_func *xf, U32 i);
+
+/* Append instruction to BB. */
+x86_insn *x86_emit (x86_func *xf, x86_block *bb, U8 op, x86_opnd dst,
+                    x86_opnd src);
+
+/* Select instructions for FN, which must be out of SSA form.  Every IR
+   vreg N becomes virtual register X86_VREG + N.  Returns 1 on input the
+   backend can't handle. */
+int x86_select (x86_func *xf, ir_func *fn);
+
+/* Give every virtual register its own stack slot. */
+void x86_spill_all (x86_func *xf);
+
+/* Replace virtual registers with their locations, reloading spilled ones
+   through the scratch registers, and add prologue and epilogue. */
+void x86_finish (x86_func *xf);
+
+/* Free the function. */
+void x86_fold (x86_func *xf);
+
+#endif /* not X86_H */